@@ -156,6 +156,7 @@
 #define PAGE_DIRTY                    0x040    /* Page has been written to */
 #define PAGE_SIZE                     0x080    /* Large page (2MB/1GB) */
 #define PAGE_GLOBAL                   0x100    /* Global page (not flushed on CR3 reload) */
+#define PAGE_COW                      0x200    /* Software bit: read-only copy-on-write share */
 
 /* Combined flags for common page types */
 #define PAGE_KERNEL_RW                (PAGE_PRESENT | PAGE_WRITABLE)  /* Kernel read-write */
@@ -28,6 +28,7 @@
 #include "../video/graphics.h"
 #include "../video/font.h"
 #include "../drivers/pci.h"
+#include "../drivers/smp.h"
 #include <string.h>
 
 // Forward declarations for other modules
@@ -412,6 +413,9 @@ static int boot_step_apic_setup(void) {
         if (apic_init() == 0) {
             boot_debug("Local APIC initialized, masking legacy PIC.");
             disable_pic();
+            if (apic_timer_calibrate() != 0) {
+                boot_debug("APIC timer calibration failed, idle keeps the periodic tick.");
+            }
         } else {
             boot_info("WARNING: APIC initialization failed, retaining PIC.");
         }
@@ -421,6 +425,12 @@ static int boot_step_apic_setup(void) {
     return 0;
 }
 
+static int boot_step_smp_setup(void) {
+    boot_debug("Starting application processors...");
+    smp_init();
+    return 0;
+}
+
 static int boot_step_pci_init(void) {
     boot_debug("Enumerating PCI devices...");
     if (pci_init() == 0) {
@@ -519,6 +529,7 @@ BOOT_INIT_STEP(drivers, "pic", boot_step_pic_setup);
 BOOT_INIT_STEP(drivers, "irq dispatcher", boot_step_irq_setup);
 BOOT_INIT_STEP(drivers, "timer", boot_step_timer_setup);
 BOOT_INIT_STEP(drivers, "apic", boot_step_apic_setup);
+BOOT_INIT_STEP(drivers, "smp", boot_step_smp_setup);
 BOOT_INIT_STEP(drivers, "pci", boot_step_pci_init);
 BOOT_INIT_STEP(drivers, "interrupt tests", boot_step_interrupt_tests);
 
@@ -554,7 +565,7 @@ static int boot_step_scheduler_init(void) {
 
 static int boot_step_shell_task(void) {
     boot_debug("Creating shell task...");
-    uint32_t shell_task_id = task_create("shell", shell_main, NULL, 5, 0x02);
+    uint32_t shell_task_id = task_create("shell", shell_main, NULL, TASK_PRIORITY_HIGH, 0x02);
     if (shell_task_id == INVALID_TASK_ID) {
         boot_info("ERROR: Failed to create shell task");
         return -1;
@@ -585,6 +596,14 @@ static int boot_step_idle_task(void) {
     return 0;
 }
 
+static int boot_step_smp_scheduler(void) {
+    /* Boot-time SMP work is done; give the APs to the scheduler */
+    scheduler_start_secondaries();
+    /* Halt any AP that could not join instead of leaving it polling */
+    smp_park_secondaries();
+    return 0;
+}
+
 static int boot_step_mark_kernel_ready(void) {
     kernel_initialized = 1;
     boot_info("Kernel core services initialized.");
@@ -596,6 +615,7 @@ BOOT_INIT_STEP(services, "task manager", boot_step_task_manager_init);
 BOOT_INIT_STEP(services, "scheduler", boot_step_scheduler_init);
 BOOT_INIT_STEP(services, "shell task", boot_step_shell_task);
 BOOT_INIT_STEP(services, "idle task", boot_step_idle_task);
+BOOT_INIT_STEP(services, "smp scheduler", boot_step_smp_scheduler);
 BOOT_INIT_STEP(services, "mark ready", boot_step_mark_kernel_ready);
 
 /* Optional/demo phase ---------------------------------------------------- */
@@ -7,6 +7,7 @@
 #include "constants.h"
 #include "log.h"
 #include "../drivers/serial.h"
+#include "../drivers/smp.h"
 
 #include <stdint.h>
 #include <stddef.h>
@@ -57,6 +58,10 @@ struct gdt_descriptor {
 static struct gdt_layout gdt_table;
 static struct tss64 kernel_tss;
 
+/* Application processors each need their own TSS, and so their own GDT */
+static struct gdt_layout secondary_gdt_tables[SMP_MAX_CPUS];
+static struct tss64 secondary_tss[SMP_MAX_CPUS];
+
 static void load_gdt(const struct gdt_descriptor *descriptor) {
     __asm__ volatile ("lgdt %0" : : "m" (*descriptor));
 
@@ -84,20 +89,18 @@ static void load_tss(void) {
     __asm__ volatile ("ltr %0" : : "r" (selector) : "memory");
 }
 
-void gdt_init(void) {
-    boot_log_debug("GDT: Initializing descriptor tables");
-
-    memset(&gdt_table, 0, sizeof(gdt_table));
-    memset(&kernel_tss, 0, sizeof(kernel_tss));
-
-    gdt_table.entries[0] = GDT_NULL_DESCRIPTOR;
-    gdt_table.entries[1] = GDT_CODE_DESCRIPTOR_64;
-    gdt_table.entries[2] = GDT_DATA_DESCRIPTOR_64;
+/*
+ * Fill in the null/code/data descriptors and point the TSS descriptor at tss
+ */
+static void gdt_build(struct gdt_layout *table, struct tss64 *tss) {
+    table->entries[0] = GDT_NULL_DESCRIPTOR;
+    table->entries[1] = GDT_CODE_DESCRIPTOR_64;
+    table->entries[2] = GDT_DATA_DESCRIPTOR_64;
 
-    uint64_t tss_base = (uint64_t)&kernel_tss;
-    uint16_t tss_limit = sizeof(kernel_tss) - 1;
+    uint64_t tss_base = (uint64_t)tss;
+    uint16_t tss_limit = sizeof(*tss) - 1;
 
-    struct gdt_tss_entry *tss_entry = &gdt_table.tss_entry;
+    struct gdt_tss_entry *tss_entry = &table->tss_entry;
     tss_entry->limit_low = tss_limit & 0xFFFF;
     tss_entry->base_low = tss_base & 0xFFFF;
     tss_entry->base_mid = (tss_base >> 16) & 0xFF;
@@ -107,7 +110,16 @@ void gdt_init(void) {
     tss_entry->base_upper = (uint32_t)(tss_base >> 32);
     tss_entry->reserved = 0;
 
-    kernel_tss.iomap_base = sizeof(struct tss64);
+    tss->iomap_base = sizeof(struct tss64);
+}
+
+void gdt_init(void) {
+    boot_log_debug("GDT: Initializing descriptor tables");
+
+    memset(&gdt_table, 0, sizeof(gdt_table));
+    memset(&kernel_tss, 0, sizeof(kernel_tss));
+
+    gdt_build(&gdt_table, &kernel_tss);
     kernel_tss.rsp0 = (uint64_t)&kernel_stack_top;
 
     struct gdt_descriptor descriptor = {
@@ -121,9 +133,40 @@ void gdt_init(void) {
     boot_log_debug("GDT: Initialized with TSS loaded");
 }
 
+/*
+ * Load a private GDT and TSS on application processor cpu
+ * IST stacks must have been set with gdt_set_secondary_ist() beforehand,
+ * since the IDT sends critical exceptions to them on every CPU
+ */
+void gdt_init_secondary(uint32_t cpu, uint64_t rsp0) {
+    if (cpu == 0 || cpu >= SMP_MAX_CPUS) {
+        return;
+    }
+
+    struct gdt_layout *table = &secondary_gdt_tables[cpu];
+    struct tss64 *tss = &secondary_tss[cpu];
+    gdt_build(table, tss);
+    tss->rsp0 = rsp0;
+
+    struct gdt_descriptor descriptor = {
+        .limit = (uint16_t)(sizeof(*table) - 1),
+        .base = (uint64_t)table
+    };
+
+    load_gdt(&descriptor);
+    load_tss();
+}
+
 void gdt_set_ist(uint8_t index, uint64_t stack_top) {
     if (index == 0 || index > 7) {
         return;
     }
     kernel_tss.ist[index - 1] = stack_top;
 }
+
+void gdt_set_secondary_ist(uint32_t cpu, uint8_t index, uint64_t stack_top) {
+    if (cpu == 0 || cpu >= SMP_MAX_CPUS || index == 0 || index > 7) {
+        return;
+    }
+    secondary_tss[cpu].ist[index - 1] = stack_top;
+}
@@ -11,7 +11,13 @@
 /* Initialize kernel GDT and load TSS */
 void gdt_init(void);
 
+/* Load a per-CPU GDT and TSS on an application processor */
+void gdt_init_secondary(uint32_t cpu, uint64_t rsp0);
+
 /* Configure Interrupt Stack Table entry (1-based index) */
 void gdt_set_ist(uint8_t index, uint64_t stack_top);
 
+/* Configure an IST entry in an application processor's TSS */
+void gdt_set_secondary_ist(uint32_t cpu, uint8_t index, uint64_t stack_top);
+
 #endif /* GDT_H */
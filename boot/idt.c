@@ -9,6 +9,8 @@
 #include "log.h"
 #include "../drivers/serial.h"
 #include "../drivers/irq.h"
+#include "../mm/paging.h"
+#include "../mm/vmem_regions.h"
 
 extern void kernel_panic(const char *message);
 
@@ -87,6 +89,11 @@ void idt_init(void) {
     idt_set_gate(46, (uint64_t)irq14, 0x08, IDT_GATE_INTERRUPT); // ATA Primary
     idt_set_gate(47, (uint64_t)irq15, 0x08, IDT_GATE_INTERRUPT); // ATA Secondary
 
+    // Install local APIC vectors used by the scheduler and paging on every CPU
+    idt_set_gate(IRQ_LOCAL_TIMER_VECTOR, (uint64_t)irq_local_timer, 0x08, IDT_GATE_INTERRUPT);
+    idt_set_gate(IRQ_RESCHEDULE_VECTOR, (uint64_t)irq_reschedule, 0x08, IDT_GATE_INTERRUPT);
+    idt_set_gate(IRQ_TLB_SHOOTDOWN_VECTOR, (uint64_t)irq_tlb_shootdown, 0x08, IDT_GATE_INTERRUPT);
+
     initialize_handler_tables();
 
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
@@ -238,6 +245,14 @@ void idt_load(void) {
     boot_log_debug("IDT: Successfully loaded");
 }
 
+/*
+ * Load the shared IDT on an application processor (no logging, the
+ * serial port is owned by the BSP)
+ */
+void idt_load_secondary(void) {
+    __asm__ volatile ("lidt %0" : : "m" (idt_pointer));
+}
+
 /*
  * Common exception handler dispatcher
  */
@@ -577,6 +592,19 @@ void exception_page_fault(struct interrupt_frame *frame) {
         return;
     }
 
+    /* Writes to present copy-on-write pages get a private copy */
+    if ((frame->error_code & 0x3) == 0x3 && paging_resolve_cow_fault(fault_addr) == 0) {
+        return;
+    }
+
+    /* Not-present faults inside a VMA are demand paging, not errors */
+    if (!(frame->error_code & 0x1)) {
+        process_page_dir_t *page_dir = get_current_page_directory();
+        if (page_dir && handle_vma_page_fault(page_dir->process_id, fault_addr) == 0) {
+            return;
+        }
+    }
+
     kprintln("FATAL: Page fault");
     kprint("Fault address: ");
     kprint_hex(fault_addr);
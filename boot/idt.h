@@ -52,6 +52,11 @@
 #define IRQ_ATA_PRIMARY (IRQ_BASE_VECTOR + 14)
 #define IRQ_ATA_SECONDARY (IRQ_BASE_VECTOR + 15)
 
+// Local APIC vectors used between CPUs (above the legacy IRQ range)
+#define IRQ_LOCAL_TIMER_VECTOR  0xEF    // Per-CPU LAPIC scheduler tick
+#define IRQ_RESCHEDULE_VECTOR   0xF0    // Run schedule() on interrupt exit
+#define IRQ_TLB_SHOOTDOWN_VECTOR 0xF1   // Flush torn-down kernel mappings
+
 #define IDT_ENTRIES 256
 
 enum exception_mode {
@@ -105,6 +110,7 @@ void idt_set_gate(uint8_t vector, uint64_t handler, uint16_t selector, uint8_t t
 void idt_install_exception_handler(uint8_t vector, exception_handler_t handler);
 void idt_set_ist(uint8_t vector, uint8_t ist_index);
 void idt_load(void);
+void idt_load_secondary(void);
 
 // Exception handlers
 void exception_divide_error(struct interrupt_frame *frame);
@@ -168,5 +174,8 @@ extern void irq12(void);  // Mouse
 extern void irq13(void);  // FPU
 extern void irq14(void);  // ATA Primary
 extern void irq15(void);  // ATA Secondary
+extern void irq_local_timer(void);  // Local APIC timer tick
+extern void irq_reschedule(void);   // Reschedule IPI
+extern void irq_tlb_shootdown(void); // TLB shootdown IPI
 
 #endif // IDT_H
@@ -214,4 +214,18 @@ irq14:
 
 .global irq15
 irq15:
-    INTERRUPT_HANDLER 47, 0   # ATA Secondary
\ No newline at end of file
+    INTERRUPT_HANDLER 47, 0   # ATA Secondary
+
+# Local APIC vectors delivered between CPUs
+
+.global irq_local_timer
+irq_local_timer:
+    INTERRUPT_HANDLER 239, 0  # Local APIC timer tick
+
+.global irq_reschedule
+irq_reschedule:
+    INTERRUPT_HANDLER 240, 0  # Reschedule IPI
+
+.global irq_tlb_shootdown
+irq_tlb_shootdown:
+    INTERRUPT_HANDLER 241, 0  # TLB shootdown IPI
\ No newline at end of file
@@ -74,6 +74,15 @@ static volatile struct limine_kernel_file_request kernel_file_request = {
     .response = NULL
 };
 
+/* Request application processor startup from Limine */
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_smp_request smp_request = {
+    .id = LIMINE_SMP_REQUEST,
+    .revision = 0,
+    .response = NULL,
+    .flags = 0
+};
+
 /* Mark end of requests */
 __attribute__((used, section(".limine_requests_end_marker")))
 static volatile uint64_t limine_requests_end_marker[1] = {0};
@@ -374,3 +383,8 @@ const struct limine_memmap_response *limine_get_memmap_response(void) {
 const struct limine_hhdm_response *limine_get_hhdm_response(void) {
     return (const struct limine_hhdm_response *)hhdm_request.response;
 }
+
+/* Not const: APs are released by writing their goto_address */
+struct limine_smp_response *limine_get_smp_response(void) {
+    return (struct limine_smp_response *)smp_request.response;
+}
@@ -19,5 +19,6 @@ const char *get_kernel_cmdline(void);
 
 const struct limine_memmap_response *limine_get_memmap_response(void);
 const struct limine_hhdm_response *limine_get_hhdm_response(void);
+struct limine_smp_response *limine_get_smp_response(void);
 
 #endif /* SLOPOS_LIMINE_PROTOCOL_H */
@@ -10,6 +10,7 @@
 #include "log.h"
 
 #include "../drivers/serial.h"
+#include "../drivers/smp.h"
 #include "../mm/page_alloc.h"
 #include "../mm/paging.h"
 #include "../mm/phys_virt.h"
@@ -57,8 +58,16 @@ static struct exception_stack_info stack_table[] = {
     },
 };
 
+#define STACK_TABLE_SIZE (sizeof(stack_table) / sizeof(stack_table[0]))
+
+/* Application processors get a copy of the table's stacks after the BSP's */
+#define SECONDARY_STACKS_BASE \
+    (EXCEPTION_STACK_REGION_BASE + STACK_TABLE_SIZE * EXCEPTION_STACK_REGION_STRIDE)
+#define SECONDARY_STACKS_END \
+    (EXCEPTION_STACK_REGION_BASE + SMP_MAX_CPUS * STACK_TABLE_SIZE * EXCEPTION_STACK_REGION_STRIDE)
+
 static struct exception_stack_info *find_stack_by_vector(uint8_t vector) {
-    for (size_t i = 0; i < sizeof(stack_table) / sizeof(stack_table[0]); i++) {
+    for (size_t i = 0; i < STACK_TABLE_SIZE; i++) {
         if (stack_table[i].vector == vector) {
             return &stack_table[i];
         }
@@ -67,7 +76,7 @@ static struct exception_stack_info *find_stack_by_vector(uint8_t vector) {
 }
 
 static struct exception_stack_info *find_stack_by_address(uint64_t addr) {
-    for (size_t i = 0; i < sizeof(stack_table) / sizeof(stack_table[0]); i++) {
+    for (size_t i = 0; i < STACK_TABLE_SIZE; i++) {
         struct exception_stack_info *info = &stack_table[i];
         if (addr >= info->guard_start && addr < info->stack_top) {
             return info;
@@ -97,7 +106,7 @@ static void map_stack_pages(struct exception_stack_info *stack) {
 void safe_stack_init(void) {
     boot_log_debug("SAFE STACK: Initializing dedicated IST stacks");
 
-    for (size_t i = 0; i < sizeof(stack_table) / sizeof(stack_table[0]); i++) {
+    for (size_t i = 0; i < STACK_TABLE_SIZE; i++) {
         struct exception_stack_info *stack = &stack_table[i];
 
         stack->region_base = EXCEPTION_STACK_REGION_BASE +
@@ -131,12 +140,43 @@ void safe_stack_init(void) {
     boot_log_debug("SAFE STACK: IST stacks ready");
 }
 
+/*
+ * Map IST stacks for application processor cpu and install them in its TSS
+ * Runs on the BSP before the AP starts. Usage is only tracked for the
+ * BSP's stacks; guard pages still catch overflows on every CPU
+ */
+void safe_stack_init_secondary(uint32_t cpu) {
+    if (cpu == 0 || cpu >= SMP_MAX_CPUS) {
+        return;
+    }
+
+    for (size_t i = 0; i < STACK_TABLE_SIZE; i++) {
+        struct exception_stack_info stack = {
+            .name = stack_table[i].name,
+            .vector = stack_table[i].vector,
+            .ist_index = stack_table[i].ist_index,
+        };
+
+        stack.region_base = EXCEPTION_STACK_REGION_BASE +
+                            ((uint64_t)cpu * STACK_TABLE_SIZE + i) * EXCEPTION_STACK_REGION_STRIDE;
+        stack.stack_base = stack.region_base + EXCEPTION_STACK_GUARD_SIZE;
+        stack.stack_top = stack.stack_base + EXCEPTION_STACK_SIZE;
+
+        map_stack_pages(&stack);
+        gdt_set_secondary_ist(cpu, stack.ist_index, stack.stack_top);
+    }
+}
+
 void safe_stack_record_usage(uint8_t vector, uint64_t frame_ptr) {
     struct exception_stack_info *stack = find_stack_by_vector(vector);
     if (!stack) {
         return;
     }
 
+    if (frame_ptr >= SECONDARY_STACKS_BASE && frame_ptr < SECONDARY_STACKS_END) {
+        return;
+    }
+
     if (frame_ptr < stack->stack_base || frame_ptr > stack->stack_top) {
         if (!stack->out_of_bounds_reported) {
             BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_INFO, {
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 void safe_stack_init(void);
+void safe_stack_init_secondary(uint32_t cpu);
 void safe_stack_record_usage(uint8_t vector, uint64_t frame_ptr);
 int safe_stack_guard_fault(uint64_t fault_addr, const char **stack_name);
 
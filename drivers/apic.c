@@ -4,8 +4,10 @@
  */
 
 #include "apic.h"
+#include "pit.h"
 #include "serial.h"
 #include "../boot/log.h"
+#include "../lib/cpu.h"
 
 // Limine boot protocol exports
 extern uint64_t get_hhdm_offset(void);
@@ -18,6 +20,12 @@ static uint64_t apic_base_address = 0;
 static uint64_t apic_base_physical = 0;
 static int apic_enabled = 0;
 
+// Timer calibration against the PIT, zero until apic_timer_calibrate() runs
+#define APIC_TIMER_CALIBRATION_MS 10
+static uint64_t apic_timer_counts_per_ms = 0;   // LAPIC timer counts at divide-by-16
+static uint64_t apic_tsc_per_ms = 0;
+static int apic_tsc_deadline = 0;
+
 /*
  * Read MSR (Model Specific Register)
  */
@@ -237,6 +245,20 @@ uint32_t apic_get_id(void) {
     return id >> 24;  // APIC ID is in bits 31:24
 }
 
+/*
+ * Send a fixed interrupt on vector to the CPU with the given APIC ID
+ * Waits for the local APIC to accept the command before returning
+ */
+void apic_send_ipi(uint32_t apic_id, uint32_t vector) {
+    if (!apic_enabled) return;
+
+    apic_write_register(LAPIC_ICR_HIGH, apic_id << 24);
+    apic_write_register(LAPIC_ICR_LOW, vector | LAPIC_ICR_ASSERT);
+    while (apic_read_register(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile ("pause" ::: "memory");
+    }
+}
+
 /*
  * Get APIC version
  */
@@ -284,10 +306,15 @@ void apic_timer_start(uint32_t initial_count) {
 
 /*
  * Stop APIC timer
+ * Masks the LVT entry and clears both the count and any TSC deadline
  */
 void apic_timer_stop(void) {
     if (!apic_enabled) return;
+    apic_write_register(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
     apic_write_register(LAPIC_TIMER_ICR, 0);
+    if (apic_tsc_deadline) {
+        write_msr(MSR_IA32_TSC_DEADLINE, 0);
+    }
 }
 
 /*
@@ -306,6 +333,111 @@ void apic_timer_set_divisor(uint32_t divisor) {
     apic_write_register(LAPIC_TIMER_DCR, divisor);
 }
 
+/*
+ * Measure the LAPIC timer and TSC rates against a PIT-timed interval
+ * Needed before apic_timer_oneshot_us(). Returns 0 on success
+ */
+int apic_timer_calibrate(void) {
+    if (!apic_enabled) return -1;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    apic_tsc_deadline = (ecx & CPUID_FEAT_ECX_TSC_DEADLINE) != 0;
+
+    // Free-run the timer masked so it counts down without interrupting
+    apic_timer_set_divisor(LAPIC_TIMER_DIV_16);
+    apic_write_register(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_ONESHOT);
+    apic_write_register(LAPIC_TIMER_ICR, 0xFFFFFFFF);
+    uint64_t tsc_start = cpu_read_tsc();
+
+    pit_poll_delay_ms(APIC_TIMER_CALIBRATION_MS);
+
+    uint64_t tsc_end = cpu_read_tsc();
+    uint32_t remaining = apic_read_register(LAPIC_TIMER_CCR);
+    apic_write_register(LAPIC_TIMER_ICR, 0);
+
+    apic_timer_counts_per_ms = (0xFFFFFFFFULL - remaining) / APIC_TIMER_CALIBRATION_MS;
+    apic_tsc_per_ms = (tsc_end - tsc_start) / APIC_TIMER_CALIBRATION_MS;
+
+    BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
+        kprint("APIC: Timer ");
+        kprint_dec(apic_timer_counts_per_ms);
+        kprint(" counts/ms, TSC ");
+        kprint_dec(apic_tsc_per_ms);
+        kprint(" cycles/ms");
+        kprintln(apic_tsc_deadline ? ", TSC-deadline mode available" : "");
+    });
+
+    if (!apic_tsc_per_ms || (!apic_tsc_deadline && !apic_timer_counts_per_ms)) {
+        apic_tsc_per_ms = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int apic_timer_has_tsc_deadline(void) {
+    return apic_tsc_deadline;
+}
+
+/*
+ * Arm a single timer interrupt on vector after the given delay
+ * Uses TSC-deadline mode when the CPU has it, one-shot count mode otherwise.
+ * Returns -1 if the timer has not been calibrated
+ */
+int apic_timer_oneshot_us(uint32_t vector, uint64_t microseconds) {
+    if (!apic_enabled || !apic_tsc_per_ms) return -1;
+
+    if (apic_tsc_deadline) {
+        apic_write_register(LAPIC_LVT_TIMER, vector | LAPIC_TIMER_TSC_DEADLINE);
+        // The LVT mode switch must land before the deadline write
+        __asm__ volatile ("mfence" ::: "memory");
+        write_msr(MSR_IA32_TSC_DEADLINE,
+                  cpu_read_tsc() + (microseconds * apic_tsc_per_ms) / 1000);
+        return 0;
+    }
+
+    uint64_t count = (microseconds * apic_timer_counts_per_ms) / 1000;
+    if (count == 0) {
+        count = 1;
+    } else if (count > 0xFFFFFFFFULL) {
+        count = 0xFFFFFFFFULL;
+    }
+
+    apic_timer_set_divisor(LAPIC_TIMER_DIV_16);
+    apic_write_register(LAPIC_LVT_TIMER, vector | LAPIC_TIMER_ONESHOT);
+    apic_write_register(LAPIC_TIMER_ICR, (uint32_t)count);
+    return 0;
+}
+
+/*
+ * Start a periodic timer interrupt on vector every period_us microseconds
+ * Programs the calling CPU's local APIC. Returns -1 if the timer has not
+ * been calibrated
+ */
+int apic_timer_periodic_us(uint32_t vector, uint64_t period_us) {
+    if (!apic_enabled || !apic_timer_counts_per_ms) return -1;
+
+    uint64_t count = (period_us * apic_timer_counts_per_ms) / 1000;
+    if (count == 0) {
+        count = 1;
+    } else if (count > 0xFFFFFFFFULL) {
+        count = 0xFFFFFFFFULL;
+    }
+
+    apic_timer_set_divisor(LAPIC_TIMER_DIV_16);
+    apic_write_register(LAPIC_LVT_TIMER, vector | LAPIC_TIMER_PERIODIC);
+    apic_write_register(LAPIC_TIMER_ICR, (uint32_t)count);
+    return 0;
+}
+
+/*
+ * Convert a TSC cycle delta to microseconds using the calibrated rate
+ */
+uint64_t apic_timer_tsc_to_us(uint64_t cycles) {
+    if (!apic_tsc_per_ms) return 0;
+    return (cycles * 1000) / apic_tsc_per_ms;
+}
+
 /*
  * Get APIC base address
  */
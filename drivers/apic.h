@@ -11,6 +11,7 @@
 // CPUID feature flags for APIC detection
 #define CPUID_FEAT_EDX_APIC     (1 << 9)   // Local APIC present
 #define CPUID_FEAT_ECX_X2APIC   (1 << 21)  // x2APIC mode available
+#define CPUID_FEAT_ECX_TSC_DEADLINE (1 << 24)  // LAPIC timer TSC-deadline mode
 
 // MSR addresses for APIC
 #define MSR_APIC_BASE           0x1B
@@ -21,6 +22,7 @@
 #define MSR_X2APIC_LVT_LINT1    0x836
 #define MSR_X2APIC_LVT_ERROR    0x837
 #define MSR_X2APIC_SPURIOUS     0x80F
+#define MSR_IA32_TSC_DEADLINE   0x6E0
 
 // APIC base register flags
 #define APIC_BASE_BSP           (1 << 8)   // Bootstrap Processor
@@ -62,6 +64,10 @@
 #define LAPIC_LVT_ACTIVE_LOW    (1 << 13)   // Active low
 #define LAPIC_LVT_PENDING       (1 << 12)   // Delivery pending
 
+// LAPIC Interrupt Command Register flags
+#define LAPIC_ICR_PENDING       (1 << 12)   // Delivery status: send pending
+#define LAPIC_ICR_ASSERT        (1 << 14)   // Level assert (required for fixed IPIs)
+
 // Timer modes
 #define LAPIC_TIMER_ONESHOT     0x00000000
 #define LAPIC_TIMER_PERIODIC    0x00020000
@@ -91,6 +97,7 @@ void apic_disable(void);
 void apic_send_eoi(void);
 uint32_t apic_get_id(void);
 uint32_t apic_get_version(void);
+void apic_send_ipi(uint32_t apic_id, uint32_t vector);
 
 // APIC timer
 void apic_timer_init(uint32_t vector, uint32_t frequency);
@@ -98,6 +105,11 @@ void apic_timer_start(uint32_t initial_count);
 void apic_timer_stop(void);
 uint32_t apic_timer_get_current_count(void);
 void apic_timer_set_divisor(uint32_t divisor);
+int apic_timer_calibrate(void);
+int apic_timer_has_tsc_deadline(void);
+int apic_timer_oneshot_us(uint32_t vector, uint64_t microseconds);
+int apic_timer_periodic_us(uint32_t vector, uint64_t period_us);
+uint64_t apic_timer_tsc_to_us(uint64_t cycles);
 
 // Utility functions
 void apic_dump_state(void);
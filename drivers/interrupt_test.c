@@ -1298,6 +1298,24 @@ int run_scheduler_tests(void) {
         kprint("INTERRUPT_TEST: Kernel heap tests failed\n");
     }
 
+    /* Run scheduler run queue regression tests */
+    extern int run_sched_queue_tests(void);
+    int sched_tests_passed = run_sched_queue_tests();
+    if (sched_tests_passed > 0) {
+        total_passed += sched_tests_passed;
+    } else {
+        kprint("INTERRUPT_TEST: Scheduler run queue tests failed\n");
+    }
+
+    /* Run page allocator regression tests */
+    extern int run_page_alloc_tests(void);
+    int page_tests_passed = run_page_alloc_tests();
+    if (page_tests_passed > 0) {
+        total_passed += page_tests_passed;
+    } else {
+        kprint("INTERRUPT_TEST: Page allocator tests failed\n");
+    }
+
     extern int run_ramfs_tests(void);
     int ramfs_tests_passed = run_ramfs_tests();
     if (ramfs_tests_passed > 0) {
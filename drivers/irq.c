@@ -3,9 +3,11 @@
 #include "pic.h"
 #include "apic.h"
 #include "keyboard.h"
+#include "smp.h"
 #include "../boot/idt.h"
 #include "../boot/log.h"
 #include "../sched/scheduler.h"
+#include "../mm/paging.h"
 
 #include <stddef.h>
 #include <stdint.h>
@@ -137,6 +139,14 @@ uint64_t irq_get_timer_ticks(void) {
     return timer_tick_counter;
 }
 
+/*
+ * Account ticks that elapsed while the periodic tick was stopped
+ * Must be called with interrupts disabled
+ */
+void irq_credit_timer_ticks(uint64_t ticks) {
+    timer_tick_counter += ticks;
+}
+
 void irq_init(void) {
     for (int i = 0; i < IRQ_LINES; i++) {
         irq_table[i].handler = NULL;
@@ -251,6 +261,30 @@ void irq_dispatch(struct interrupt_frame *frame) {
         return;
     }
 
+    if (vector == IRQ_LOCAL_TIMER_VECTOR) {
+        apic_send_eoi();
+        if (smp_current_cpu() == 0) {
+            /* The BSP's local tick stands in for the PIT under the APIC */
+            timer_irq_handler(0, frame, NULL);
+        } else {
+            scheduler_timer_tick();
+        }
+        scheduler_handle_post_irq();
+        return;
+    }
+
+    if (vector == IRQ_RESCHEDULE_VECTOR) {
+        apic_send_eoi();
+        scheduler_handle_post_irq();
+        return;
+    }
+
+    if (vector == IRQ_TLB_SHOOTDOWN_VECTOR) {
+        paging_handle_tlb_shootdown();
+        apic_send_eoi();
+        return;
+    }
+
     uint8_t irq = vector - IRQ_BASE_VECTOR;
 
     if (irq >= IRQ_LINES) {
@@ -6,12 +6,23 @@
 #include <stdint.h>
 
 #define PIT_CHANNEL0_PORT 0x40
+#define PIT_CHANNEL2_PORT 0x42
 #define PIT_COMMAND_PORT  0x43
+#define PIT_SPEAKER_PORT  0x61
 
 #define PIT_COMMAND_CHANNEL0       0x00
+#define PIT_COMMAND_CHANNEL2       0x80
 #define PIT_COMMAND_ACCESS_LOHI    0x30
 #define PIT_COMMAND_MODE_SQUARE    0x06
 #define PIT_COMMAND_BINARY         0x00
+#define PIT_COMMAND_MODE_ONESHOT   0x00
+
+#define PIT_SPEAKER_GATE2          0x01
+#define PIT_SPEAKER_DATA           0x02
+#define PIT_SPEAKER_OUT2           0x20
+
+/* Longest interval channel 2 can time in one pass (65535 / 1193182 Hz) */
+#define PIT_POLL_CHUNK_MS          50
 
 static uint32_t current_frequency_hz = 0;
 
@@ -23,6 +34,12 @@ static inline void pit_outb(uint16_t port, uint8_t value) {
     __asm__ volatile ("outb %0, %1" : : "a" (value), "Nd" (port));
 }
 
+static inline uint8_t pit_inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile ("inb %1, %0" : "=a" (value) : "Nd" (port));
+    return value;
+}
+
 static uint16_t pit_calculate_divisor(uint32_t frequency_hz) {
     if (frequency_hz == 0) {
         frequency_hz = PIT_DEFAULT_FREQUENCY_HZ;
@@ -91,3 +108,32 @@ void pit_disable_irq(void) {
     }
 }
 
+/*
+ * Busy-wait using channel 2, which needs no interrupts and leaves the
+ * channel 0 tick alone. Used to calibrate other clocks against the PIT
+ */
+void pit_poll_delay_ms(uint32_t milliseconds) {
+    uint8_t saved = pit_inb(PIT_SPEAKER_PORT);
+
+    while (milliseconds > 0) {
+        uint32_t chunk = milliseconds > PIT_POLL_CHUNK_MS ? PIT_POLL_CHUNK_MS : milliseconds;
+        uint32_t count = (PIT_BASE_FREQUENCY_HZ * chunk) / 1000;
+
+        /* Gate channel 2 on with the speaker disconnected, then load the count */
+        pit_outb(PIT_SPEAKER_PORT, (uint8_t)((saved & ~PIT_SPEAKER_DATA) | PIT_SPEAKER_GATE2));
+        pit_outb(PIT_COMMAND_PORT, PIT_COMMAND_CHANNEL2 |
+                                      PIT_COMMAND_ACCESS_LOHI |
+                                      PIT_COMMAND_MODE_ONESHOT |
+                                      PIT_COMMAND_BINARY);
+        pit_outb(PIT_CHANNEL2_PORT, (uint8_t)(count & 0xFF));
+        pit_outb(PIT_CHANNEL2_PORT, (uint8_t)((count >> 8) & 0xFF));
+
+        /* OUT2 goes high at terminal count */
+        while (!(pit_inb(PIT_SPEAKER_PORT) & PIT_SPEAKER_OUT2)) {
+            __asm__ volatile ("pause");
+        }
+        milliseconds -= chunk;
+    }
+
+    pit_outb(PIT_SPEAKER_PORT, saved);
+}
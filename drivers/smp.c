@@ -0,0 +1,378 @@
+/*
+ * SlopOS SMP Support
+ * Starts the application processors reported by Limine and hands them
+ * self-contained work through per-CPU work slots.
+ *
+ * Limine performs the INIT/SIPI sequence and leaves every AP in long mode
+ * on the boot page tables, spinning on its goto_address. Each AP switches
+ * to the kernel page tables and its own GDT/TSS, then polls its work slot.
+ * Boot-time work only touches its own arguments; once the scheduler is up,
+ * smp_hand_over() gives the AP to it for good, and smp_park_secondaries()
+ * halts any AP that was not handed over.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "smp.h"
+#include "apic.h"
+#include "serial.h"
+#include "../boot/gdt.h"
+#include "../boot/idt.h"
+#include "../boot/log.h"
+#include "../boot/limine_protocol.h"
+#include "../boot/safe_stack.h"
+#include "../mm/paging.h"
+
+/* Pause iterations to wait for an AP to report in before giving up */
+#define SMP_AP_START_SPINS      100000000ULL
+
+/* The BSP counts as online even before smp_init() runs */
+static cpu_local_t cpus[SMP_MAX_CPUS] = {
+    [0] = { .cpu_index = 0, .state = SMP_CPU_ONLINE },
+};
+static uint32_t cpu_count = 1;
+
+/* Logical CPU index by local APIC ID, for smp_current_cpu() */
+static uint8_t lapic_to_cpu[256];
+
+/* ========================================================================
+ * APPLICATION PROCESSOR ENTRY
+ * ======================================================================== */
+
+static void smp_ap_loop(cpu_local_t *cpu) {
+    for (;;) {
+        smp_work_fn fn = __atomic_load_n(&cpu->work, __ATOMIC_ACQUIRE);
+        if (fn) {
+            /* Polling APs are not shot down; drop kernel mappings torn down since */
+            paging_flush_local_tlb();
+            fn(cpu->cpu_index, cpu->work_arg);
+            cpu->work_completed++;
+            __atomic_store_n(&cpu->work, NULL, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (__atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE) == SMP_CPU_PARKED) {
+            break;
+        }
+        __asm__ volatile ("pause" ::: "memory");
+    }
+
+    for (;;) {
+        __asm__ volatile ("cli; hlt" ::: "memory");
+    }
+}
+
+/*
+ * Entered by Limine on the AP's own stack with interrupts disabled.
+ * Switches to the kernel page tables, its own GDT and TSS (kernel stack
+ * and IST stacks for interrupts) and the shared IDT, and enables the
+ * local APIC with every LVT entry masked before reporting in
+ */
+static void smp_ap_entry(struct limine_smp_info *info) {
+    cpu_local_t *cpu = (cpu_local_t *)info->extra_argument;
+    uint64_t rsp;
+
+    __asm__ volatile ("cli" ::: "memory");
+    paging_init_secondary();
+    __asm__ volatile ("mov %%rsp, %0" : "=r"(rsp));
+    gdt_init_secondary(cpu->cpu_index, rsp);
+    idt_load_secondary();
+
+    uint32_t spurious = apic_read_register(LAPIC_SPURIOUS);
+    apic_write_register(LAPIC_SPURIOUS,
+                        spurious | LAPIC_SPURIOUS_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    apic_write_register(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    apic_write_register(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    apic_write_register(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    apic_write_register(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    apic_write_register(LAPIC_LVT_PERFCNT, LAPIC_LVT_MASKED);
+
+    __atomic_store_n(&cpu->state, SMP_CPU_ONLINE, __ATOMIC_RELEASE);
+    smp_ap_loop(cpu);
+}
+
+/* ========================================================================
+ * BRING-UP
+ * ======================================================================== */
+
+/*
+ * Register the BSP as CPU 0 and start every other CPU Limine reports.
+ * Always leaves at least the BSP online; APs that do not report in are
+ * left offline
+ */
+int smp_init(void) {
+    cpus[0].cpu_index = 0;
+    cpus[0].lapic_id = apic_get_id();
+    cpus[0].state = SMP_CPU_ONLINE;
+    cpu_count = 1;
+
+    struct limine_smp_response *smp = limine_get_smp_response();
+    if (!smp || !apic_is_enabled()) {
+        boot_log_debug("SMP: No SMP response or local APIC, running on the BSP only");
+        return 0;
+    }
+    cpus[0].lapic_id = smp->bsp_lapic_id;
+    lapic_to_cpu[smp->bsp_lapic_id & 0xFF] = 0;
+
+    uint32_t started = 0;
+    for (uint64_t i = 0; i < smp->cpu_count; i++) {
+        struct limine_smp_info *info = smp->cpus[i];
+        if (info->lapic_id == smp->bsp_lapic_id) {
+            continue;
+        }
+        if (cpu_count >= SMP_MAX_CPUS) {
+            boot_log_info("SMP: WARNING - more CPUs than SMP_MAX_CPUS, ignoring the rest");
+            break;
+        }
+
+        cpu_local_t *cpu = &cpus[cpu_count];
+        cpu->cpu_index = cpu_count;
+        cpu->lapic_id = info->lapic_id;
+        cpu->state = SMP_CPU_OFFLINE;
+        cpu->work = NULL;
+        cpu->work_arg = NULL;
+        cpu->work_completed = 0;
+        if (info->lapic_id < sizeof(lapic_to_cpu)) {
+            lapic_to_cpu[info->lapic_id] = (uint8_t)cpu->cpu_index;
+        }
+        cpu_count++;
+
+        safe_stack_init_secondary(cpu->cpu_index);
+        info->extra_argument = (uint64_t)cpu;
+        __atomic_store_n(&info->goto_address, smp_ap_entry, __ATOMIC_SEQ_CST);
+
+        uint64_t spins = 0;
+        while (__atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE) == SMP_CPU_OFFLINE &&
+               spins++ < SMP_AP_START_SPINS) {
+            __asm__ volatile ("pause" ::: "memory");
+        }
+
+        if (cpu->state == SMP_CPU_OFFLINE) {
+            BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_INFO, {
+                kprint("SMP: WARNING - CPU with LAPIC ID ");
+                kprint_decimal(info->lapic_id);
+                kprintln(" did not come online");
+            });
+            continue;
+        }
+        started++;
+    }
+
+    BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_INFO, {
+        kprint("SMP: ");
+        kprint_decimal(started + 1);
+        kprint(" of ");
+        kprint_decimal(smp->cpu_count);
+        kprintln(" CPUs online");
+    });
+    return 0;
+}
+
+/*
+ * Halt every idle AP for good so they stop polling once boot-time users
+ * are done with them. Waits for work still in flight first
+ */
+void smp_park_secondaries(void) {
+    uint32_t parked = 0;
+    for (uint32_t i = 1; i < cpu_count; i++) {
+        if (cpus[i].state != SMP_CPU_ONLINE) {
+            continue;
+        }
+        smp_wait(i);
+        __atomic_store_n(&cpus[i].state, SMP_CPU_PARKED, __ATOMIC_RELEASE);
+        parked++;
+    }
+
+    if (parked) {
+        BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
+            kprint("SMP: Parked ");
+            kprint_decimal(parked);
+            kprintln(" application processors");
+        });
+    }
+}
+
+/* ========================================================================
+ * TOPOLOGY
+ * ======================================================================== */
+
+/* CPUs discovered, including any that failed to start */
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+/* CPUs that accept work, the BSP included */
+uint32_t smp_online_count(void) {
+    uint32_t online = 0;
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        if (cpus[i].state == SMP_CPU_ONLINE) {
+            online++;
+        }
+    }
+    return online;
+}
+
+uint32_t smp_current_cpu(void) {
+    if (cpu_count == 1) {
+        return 0;
+    }
+
+    uint32_t lapic_id = apic_get_id();
+    if (lapic_id < sizeof(lapic_to_cpu)) {
+        return lapic_to_cpu[lapic_id];
+    }
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        if (cpus[i].lapic_id == lapic_id) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+const cpu_local_t *smp_get_cpu(uint32_t cpu) {
+    if (cpu >= cpu_count) {
+        return NULL;
+    }
+    return &cpus[cpu];
+}
+
+/* ========================================================================
+ * WORK DISPATCH
+ * ======================================================================== */
+
+/*
+ * Post work to an idle AP. Returns -1 for the BSP, for CPUs that are not
+ * online and for CPUs that still have work pending
+ */
+int smp_run_on(uint32_t cpu, smp_work_fn fn, void *arg) {
+    if (cpu == 0 || cpu >= cpu_count || !fn) {
+        return -1;
+    }
+
+    cpu_local_t *target = &cpus[cpu];
+    if (target->state != SMP_CPU_ONLINE ||
+        __atomic_load_n(&target->work, __ATOMIC_ACQUIRE) != NULL) {
+        return -1;
+    }
+
+    target->work_arg = arg;
+    __atomic_store_n(&target->work, fn, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Give an AP to fn for good: fn runs from the AP's work loop and never
+ * returns (the scheduler's entry point). Waits for earlier work to finish.
+ * Returns -1 for the BSP and for CPUs that are not online
+ */
+int smp_hand_over(uint32_t cpu, smp_work_fn fn, void *arg) {
+    if (cpu == 0 || cpu >= cpu_count || !fn ||
+        __atomic_load_n(&cpus[cpu].state, __ATOMIC_ACQUIRE) != SMP_CPU_ONLINE) {
+        return -1;
+    }
+
+    smp_wait(cpu);
+    __atomic_store_n(&cpus[cpu].state, SMP_CPU_SCHEDULING, __ATOMIC_RELEASE);
+    cpus[cpu].work_arg = arg;
+    __atomic_store_n(&cpus[cpu].work, fn, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Halt the calling AP for good
+ * It is marked parked first, so CPUs waiting on it (for a TLB shootdown)
+ * stop waiting
+ */
+void smp_park_self(void) {
+    uint32_t cpu = smp_current_cpu();
+    if (cpu != 0) {
+        __atomic_store_n(&cpus[cpu].state, SMP_CPU_PARKED, __ATOMIC_RELEASE);
+    }
+
+    for (;;) {
+        __asm__ volatile ("cli; hlt" ::: "memory");
+    }
+}
+
+/* Interrupt a CPU with the given vector; ignored for unknown CPUs */
+void smp_send_ipi(uint32_t cpu, uint32_t vector) {
+    if (cpu >= cpu_count) {
+        return;
+    }
+    apic_send_ipi(cpus[cpu].lapic_id, vector);
+}
+
+/* Spin until the CPU's work slot is empty; its results are then visible */
+void smp_wait(uint32_t cpu) {
+    if (cpu == 0 || cpu >= cpu_count) {
+        return;
+    }
+    while (__atomic_load_n(&cpus[cpu].work, __ATOMIC_ACQUIRE) != NULL) {
+        __asm__ volatile ("pause" ::: "memory");
+    }
+}
+
+typedef struct smp_parallel_job {
+    uint32_t next_item;
+    uint32_t items;
+    smp_item_fn fn;
+    void *arg;
+    uint32_t taken[SMP_MAX_CPUS];
+} smp_parallel_job_t;
+
+/*
+ * Every participating CPU pulls the next unclaimed item until none are
+ * left, so a CPU that finishes early keeps taking work from the others
+ * instead of waiting on a fixed share
+ */
+static void smp_parallel_worker(uint32_t cpu, void *arg) {
+    smp_parallel_job_t *job = (smp_parallel_job_t *)arg;
+
+    for (;;) {
+        uint32_t item = __atomic_fetch_add(&job->next_item, 1, __ATOMIC_RELAXED);
+        if (item >= job->items) {
+            break;
+        }
+        job->fn(item, job->arg);
+        job->taken[cpu]++;
+    }
+}
+
+/*
+ * Run fn over items 0..items-1 on the BSP and up to cpus-1 online APs.
+ * fn must not touch kernel state that is not safe for concurrent use.
+ * items_per_cpu (optional, SMP_MAX_CPUS entries) receives how many items
+ * each CPU ran. Returns the number of CPUs that took part
+ */
+int smp_parallel_for(uint32_t items, uint32_t cpus_wanted, smp_item_fn fn, void *arg,
+                     uint32_t *items_per_cpu) {
+    if (!fn) {
+        return -1;
+    }
+
+    smp_parallel_job_t job = {
+        .next_item = 0,
+        .items = items,
+        .fn = fn,
+        .arg = arg,
+    };
+
+    uint32_t helpers[SMP_MAX_CPUS];
+    uint32_t helper_count = 0;
+    for (uint32_t i = 1; i < cpu_count && helper_count + 1 < cpus_wanted; i++) {
+        if (smp_run_on(i, smp_parallel_worker, &job) == 0) {
+            helpers[helper_count++] = i;
+        }
+    }
+
+    smp_parallel_worker(0, &job);
+    for (uint32_t i = 0; i < helper_count; i++) {
+        smp_wait(helpers[i]);
+    }
+
+    if (items_per_cpu) {
+        for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+            items_per_cpu[i] = job.taken[i];
+        }
+    }
+    return (int)(helper_count + 1);
+}
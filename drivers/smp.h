@@ -0,0 +1,54 @@
+/*
+ * SlopOS SMP Support
+ * Application processor bring-up, per-CPU work dispatch and IPIs
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+#define SMP_MAX_CPUS            16
+
+/* Per-CPU states */
+#define SMP_CPU_OFFLINE         0
+#define SMP_CPU_ONLINE          1   /* Polling its work slot */
+#define SMP_CPU_PARKED          2   /* Halted for good */
+#define SMP_CPU_SCHEDULING      3   /* Handed over to the scheduler */
+
+/* Work run on a CPU; cpu is the logical index of the CPU running it */
+typedef void (*smp_work_fn)(uint32_t cpu, void *arg);
+
+/* Work item body for smp_parallel_for */
+typedef void (*smp_item_fn)(uint32_t item, void *arg);
+
+/* Per-CPU data, indexed by logical CPU number (the BSP is CPU 0) */
+typedef struct cpu_local {
+    uint32_t cpu_index;
+    uint32_t lapic_id;
+    volatile uint32_t state;
+    smp_work_fn work;                 /* Pending work, NULL when idle */
+    void *work_arg;
+    volatile uint64_t work_completed;
+} cpu_local_t;
+
+/* Bring-up */
+int smp_init(void);
+void smp_park_secondaries(void);
+
+/* Topology */
+uint32_t smp_cpu_count(void);
+uint32_t smp_online_count(void);
+uint32_t smp_current_cpu(void);
+const cpu_local_t *smp_get_cpu(uint32_t cpu);
+
+/* Work dispatch */
+int smp_run_on(uint32_t cpu, smp_work_fn fn, void *arg);
+void smp_wait(uint32_t cpu);
+int smp_hand_over(uint32_t cpu, smp_work_fn fn, void *arg);
+void smp_park_self(void);
+void smp_send_ipi(uint32_t cpu, uint32_t vector);
+int smp_parallel_for(uint32_t items, uint32_t cpus, smp_item_fn fn, void *arg,
+                     uint32_t *items_per_cpu);
+
+#endif /* SMP_H */
@@ -5,13 +5,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "../lib/cpu.h"
 #include "../sched/scheduler.h"
 
 /* ========================================================================
  * WAIT QUEUE FOR BLOCKING INPUT
  * ======================================================================== */
 
-#define TTY_MAX_WAITERS MAX_TASKS
+#define TTY_MAX_WAITERS 32
 
 typedef struct tty_wait_queue {
     task_t *tasks[TTY_MAX_WAITERS];
@@ -57,6 +58,31 @@ static task_t *tty_wait_queue_pop(void) {
     return task;
 }
 
+/*
+ * Drop every entry for the task, keeping the order of the others
+ */
+static void tty_wait_queue_remove(task_t *task) {
+    size_t remaining = tty_wait_queue.count;
+    size_t kept = 0;
+    size_t read = tty_wait_queue.head;
+    size_t write = tty_wait_queue.head;
+
+    while (remaining-- > 0) {
+        task_t *entry = tty_wait_queue.tasks[read];
+        tty_wait_queue.tasks[read] = NULL;
+        read = (read + 1) % TTY_MAX_WAITERS;
+        if (entry == task) {
+            continue;
+        }
+        tty_wait_queue.tasks[write] = entry;
+        write = (write + 1) % TTY_MAX_WAITERS;
+        kept++;
+    }
+
+    tty_wait_queue.tail = write;
+    tty_wait_queue.count = kept;
+}
+
 static int tty_input_available(void) {
     if (keyboard_has_input()) {
         return 1;
@@ -110,12 +136,13 @@ static void tty_block_until_input_ready(void) {
         return;
     }
 
-    task_set_state(current->task_id, TASK_STATE_BLOCKED);
-    unschedule_task(current);
+    /*
+     * Block with interrupts still off so the keyboard IRQ cannot wake the
+     * task before it is switched out; each context restores its own flags
+     */
+    block_current_task();
 
     tty_interrupts_enable();
-
-    schedule();
 }
 
 void tty_notify_input_ready(void) {
@@ -150,6 +177,20 @@ void tty_notify_input_ready(void) {
     }
 }
 
+/*
+ * Forget a task waiting for input before its control block is freed, so
+ * tty_notify_input_ready never touches it afterwards
+ */
+void tty_cancel_wait(task_t *task) {
+    if (!task) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    tty_wait_queue_remove(task);
+    cpu_irq_restore(flags);
+}
+
 /* ========================================================================
  * HELPER FUNCTIONS
  * ======================================================================== */
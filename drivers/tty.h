@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+struct task;
+
 /* ========================================================================
  * TERMINAL/TTY API
  * ======================================================================== */
@@ -35,5 +37,11 @@ size_t tty_read_line(char *buffer, size_t buffer_size);
  */
 void tty_notify_input_ready(void);
 
+/*
+ * Remove a task from the input wait queue.
+ * Called when the task terminates, before its control block is freed.
+ */
+void tty_cancel_wait(struct task *task);
+
 #endif /* DRIVERS_TTY_H */
 
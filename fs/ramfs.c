@@ -3,6 +3,7 @@
 #include <stddef.h>
 
 #include "../mm/kernel_heap.h"
+#include "../mm/kmem_cache.h"
 #include "../lib/string.h"
 #include "../lib/memory.h"
 #include "../drivers/serial.h"
@@ -15,6 +16,7 @@ typedef enum {
 
 static ramfs_node_t *ramfs_root = NULL;
 static int ramfs_initialized = 0;
+static kmem_cache_t *ramfs_node_cache = NULL;
 
 static void ramfs_link_child(ramfs_node_t *parent, ramfs_node_t *child) {
     if (!parent || !child) {
@@ -74,18 +76,18 @@ static void ramfs_free_node_recursive(ramfs_node_t *node) {
         node->name = NULL;
     }
 
-    kfree(node);
+    kmem_cache_free(ramfs_node_cache, node);
 }
 
 static ramfs_node_t *ramfs_allocate_node(const char *name, size_t name_len, int type, ramfs_node_t *parent) {
-    ramfs_node_t *node = kmalloc(sizeof(ramfs_node_t));
+    ramfs_node_t *node = kmem_cache_alloc(ramfs_node_cache);
     if (!node) {
         return NULL;
     }
 
     char *name_copy = kmalloc(name_len + 1);
     if (!name_copy) {
-        kfree(node);
+        kmem_cache_free(ramfs_node_cache, node);
         return NULL;
     }
 
@@ -252,6 +254,13 @@ int ramfs_init(void) {
         return 0;
     }
 
+    if (!ramfs_node_cache) {
+        ramfs_node_cache = kmem_cache_create("ramfs_node", sizeof(ramfs_node_t), 0);
+        if (!ramfs_node_cache) {
+            return -1;
+        }
+    }
+
     const char root_name[] = "/";
     ramfs_node_t *root = ramfs_allocate_node(root_name, 1, RAMFS_TYPE_DIRECTORY, NULL);
     if (!root) {
@@ -335,7 +344,7 @@ ramfs_node_t *ramfs_create_file(const char *path, const void *data, size_t size)
         node->data = kmalloc(size);
         if (!node->data) {
             kfree(node->name);
-            kfree(node);
+            kmem_cache_free(ramfs_node_cache, node);
             return NULL;
         }
 
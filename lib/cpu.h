@@ -0,0 +1,34 @@
+#ifndef LIB_CPU_H
+#define LIB_CPU_H
+
+#include <stdint.h>
+
+/* Read the time-stamp counter (cycle count used by in-kernel benchmarks) */
+static inline uint64_t cpu_read_tsc(void) {
+    uint32_t low, high;
+    __asm__ volatile ("lfence; rdtsc" : "=a"(low), "=d"(high) :: "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+/* Disable interrupts, returning the previous RFLAGS for cpu_irq_restore */
+static inline uint64_t cpu_irq_save(void) {
+    uint64_t flags;
+    __asm__ volatile ("pushfq; popq %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+/* Re-enable interrupts if they were enabled when cpu_irq_save ran */
+static inline void cpu_irq_restore(uint64_t flags) {
+    if (flags & (1ULL << 9)) {
+        __asm__ volatile ("sti" ::: "memory");
+    }
+}
+
+/* Read CR3 (current PML4 base plus PCID bits) */
+static inline uint64_t cpu_read_cr3(void) {
+    uint64_t cr3;
+    __asm__ volatile ("movq %%cr3, %0" : "=r"(cr3));
+    return cr3;
+}
+
+#endif /* LIB_CPU_H */
@@ -0,0 +1,50 @@
+#ifndef LIB_SPINLOCK_H
+#define LIB_SPINLOCK_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+/* Test-and-test-and-set lock for data shared between CPUs */
+typedef struct spinlock {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock_init(spinlock_t *lock) {
+    lock->locked = 0;
+}
+
+/* Take the lock if it is free; returns 1 on success */
+static inline int spin_trylock(spinlock_t *lock) {
+    return __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    while (!spin_trylock(lock)) {
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            __asm__ volatile ("pause" ::: "memory");
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Locks also taken from interrupt handlers must be held with interrupts
+ * off, or a handler on the same CPU would spin on it forever
+ */
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock) {
+    uint64_t flags = cpu_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
+    spin_unlock(lock);
+    cpu_irq_restore(flags);
+}
+
+#endif /* LIB_SPINLOCK_H */
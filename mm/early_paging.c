@@ -262,6 +262,7 @@ static int setup_kernel_mapping(void) {
 
     /* Map kernel using 2MB large pages */
     /* Start at 1MB physical, map to higher-half virtual */
+    /* Global: the kernel image is mapped identically in every address space */
     uint64_t kernel_phys = KERNEL_PHYSICAL_START;
     uint32_t kernel_pages = (KERNEL_PHYSICAL_SIZE + PAGE_SIZE_2MB - 1) / PAGE_SIZE_2MB;
 
@@ -273,7 +274,8 @@ static int setup_kernel_mapping(void) {
         }
 
         early_paging.pd_kernel->entries[pd_entry] = create_pte(kernel_phys + (i * PAGE_SIZE_2MB),
-                                                                PAGE_PRESENT | PAGE_WRITABLE | PAGE_SIZE);
+                                                                PAGE_PRESENT | PAGE_WRITABLE | PAGE_SIZE |
+                                                                PAGE_GLOBAL);
     }
 
     kprint("Higher-half mapping: ");
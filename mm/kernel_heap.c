@@ -10,6 +10,7 @@
 #include "../drivers/serial.h"
 #include "../boot/log.h"
 #include "kernel_heap.h"
+#include "kmem_cache.h"
 #include "page_alloc.h"
 #include "paging.h"
 
@@ -25,19 +26,50 @@ void kernel_panic(const char *message);
 #define KERNEL_HEAP_SIZE              0x10000000             /* 256MB initial heap */
 #define KERNEL_HEAP_PAGE_COUNT        (KERNEL_HEAP_SIZE / PAGE_SIZE_4KB)
 
+/* Heap growth is rounded to 2MB chunks so each can be one huge page */
+#define KERNEL_HEAP_HUGE_CHUNK        PAGE_SIZE_2MB
+#define KERNEL_HEAP_HUGE_FRAMES       (PAGE_SIZE_2MB / PAGE_SIZE_4KB)
+
 /* Allocation size constants */
 #define MIN_ALLOC_SIZE                16        /* Minimum allocation size */
-#define MAX_ALLOC_SIZE                0x100000  /* Maximum single allocation (1MB) */
+#define MAX_ALLOC_SIZE                0x10000000 /* Maximum single allocation (256MB) */
 #define HEAP_ALIGNMENT                8         /* Default alignment */
 
+/* Large allocations bypass the free lists and get their own page span */
+#define KMALLOC_LARGE_THRESHOLD       0x10000                /* Requests above 64KB */
+#define KMALLOC_LARGE_REGION_START    0xFFFFFFFFC0000000ULL  /* Large span virtual base */
+#define KMALLOC_LARGE_REGION_SIZE     0x20000000ULL          /* 512MB */
+#define KMALLOC_LARGE_MAX_SPANS       256                    /* Side table capacity */
+
 /* Block header magic values for debugging */
 #define BLOCK_MAGIC_ALLOCATED         0xDEADBEEF
 #define BLOCK_MAGIC_FREE              0xFEEDFACE
+#define BLOCK_MAGIC_FOOTER            0xB0DA7A65
+
+/*
+ * Two-level segregated fit (TLSF) index
+ * First level splits sizes by power of two, second level splits each power
+ * of two into HEAP_SL_INDEX_COUNT equal ranges. Sizes below
+ * HEAP_SMALL_BLOCK_SIZE share first level 0 in HEAP_ALIGNMENT-byte steps.
+ */
+#define HEAP_SL_INDEX_LOG2            3
+#define HEAP_SL_INDEX_COUNT           (1U << HEAP_SL_INDEX_LOG2)
+#define HEAP_FL_INDEX_SHIFT           (HEAP_SL_INDEX_LOG2 + 3)
+#define HEAP_FL_INDEX_MAX             28        /* Covers blocks up to the 256MB window */
+#define HEAP_FL_INDEX_COUNT           (HEAP_FL_INDEX_MAX - HEAP_FL_INDEX_SHIFT + 1)
+#define HEAP_SMALL_BLOCK_SIZE         (1U << HEAP_FL_INDEX_SHIFT)
 
 /* Heap allocation flags */
 #define HEAP_FLAG_ZERO                0x01     /* Zero memory after allocation */
 #define HEAP_FLAG_ATOMIC              0x02     /* Atomic allocation (no sleep) */
 
+/* Block flags */
+#define HEAP_BLOCK_FLAG_TRIMMED       0x01     /* Free block has unmapped interior pages */
+
+/* Heap trimming watermarks */
+#define HEAP_TRIM_THRESHOLD           0x100000  /* Free tail size that triggers a trim (1MB) */
+#define HEAP_TRIM_RETAIN              0x10000   /* Free tail kept mapped after auto trim (64KB) */
+
 /* ========================================================================
  * HEAP BLOCK STRUCTURES
  * ======================================================================== */
@@ -52,11 +84,19 @@ typedef struct heap_block {
     struct heap_block *prev;      /* Previous block in free list */
 } heap_block_t;
 
-/* Free list entry for different size classes */
+/* Heap block footer - boundary tag locating the header of the block it ends */
+typedef struct heap_block_footer {
+    uint32_t magic;               /* Footer magic for validation */
+    uint32_t size;                /* Copy of owning block's data size */
+} heap_block_footer_t;
+
+/* Bookkeeping bytes surrounding every block's data area */
+#define HEAP_BLOCK_OVERHEAD           (sizeof(heap_block_t) + sizeof(heap_block_footer_t))
+
+/* Free list entry for one second-level size class */
 typedef struct free_list {
     heap_block_t *head;           /* Head of free list */
     uint32_t count;               /* Number of blocks in list */
-    uint32_t size_class;          /* Size class for this list */
 } free_list_t;
 
 /* Heap statistics structure is now in kernel_heap.h */
@@ -66,22 +106,31 @@ typedef struct kernel_heap {
     uint64_t start_addr;          /* Heap start virtual address */
     uint64_t end_addr;            /* Heap end virtual address */
     uint64_t current_break;       /* Current heap break */
-    free_list_t free_lists[16];   /* Free lists for different sizes */
+    uint32_t fl_bitmap;                               /* First levels with free blocks */
+    uint32_t sl_bitmap[HEAP_FL_INDEX_COUNT];          /* Non-empty lists per first level */
+    free_list_t free_lists[HEAP_FL_INDEX_COUNT][HEAP_SL_INDEX_COUNT]; /* Segregated free lists */
     heap_stats_t stats;           /* Heap statistics */
     uint32_t initialized;         /* Initialization flag */
 } kernel_heap_t;
 
+/* Large allocation span - one page-granular mapping per kmalloc */
+typedef struct large_span {
+    uint64_t virt_addr;           /* Start of mapped span */
+    uint32_t pages;               /* Pages backing the span */
+    uint32_t size;                /* Requested size in bytes */
+} large_span_t;
+
+/* Side table of live large allocations, sorted by address */
+typedef struct large_span_table {
+    large_span_t spans[KMALLOC_LARGE_MAX_SPANS];
+    uint32_t count;
+} large_span_table_t;
+
 /* Global kernel heap instance */
 static kernel_heap_t kernel_heap = {0};
+static large_span_table_t large_spans = {0};
 static uint32_t heap_diagnostics_enabled = 1;
 
-/* Upper bounds for each size class to aid diagnostics */
-static const uint32_t size_class_thresholds[15] = {
-    16, 32, 64, 128, 256, 512,
-    1024, 2048, 4096, 8192, 16384,
-    32768, 65536, 131072, 262144
-};
-
 /* ========================================================================
  * UTILITY FUNCTIONS
  * ======================================================================== */
@@ -117,42 +166,59 @@ static int validate_block(heap_block_t *block) {
 }
 
 /*
- * Get size class index for allocation size
+ * Footer of a block sits directly after its data area
+ */
+static inline heap_block_footer_t *block_footer(heap_block_t *block) {
+    return (heap_block_footer_t*)((uint8_t*)block + sizeof(heap_block_t) + block->size);
+}
+
+/*
+ * Refresh the boundary tag after a block's size changes
+ */
+static void write_block_footer(heap_block_t *block) {
+    heap_block_footer_t *footer = block_footer(block);
+    footer->magic = BLOCK_MAGIC_FOOTER;
+    footer->size = block->size;
+}
+
+/*
+ * Map a block size to its first/second-level free list indices
  */
-static uint32_t get_size_class(uint32_t size) {
-    if (size <= 16) return 0;
-    if (size <= 32) return 1;
-    if (size <= 64) return 2;
-    if (size <= 128) return 3;
-    if (size <= 256) return 4;
-    if (size <= 512) return 5;
-    if (size <= 1024) return 6;
-    if (size <= 2048) return 7;
-    if (size <= 4096) return 8;
-    if (size <= 8192) return 9;
-    if (size <= 16384) return 10;
-    if (size <= 32768) return 11;
-    if (size <= 65536) return 12;
-    if (size <= 131072) return 13;
-    if (size <= 262144) return 14;
-    return 15;  /* Large allocations */
+static void mapping_insert(uint32_t size, uint32_t *fl, uint32_t *sl) {
+    if (size < HEAP_SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = size / (HEAP_SMALL_BLOCK_SIZE / HEAP_SL_INDEX_COUNT);
+        return;
+    }
+
+    uint32_t msb = 31 - (uint32_t)__builtin_clz(size);
+    *sl = (size >> (msb - HEAP_SL_INDEX_LOG2)) ^ HEAP_SL_INDEX_COUNT;
+    *fl = msb - (HEAP_FL_INDEX_SHIFT - 1);
+}
+
+/*
+ * Round a request up to the start of the next second-level range so that
+ * every block in the list it maps to is guaranteed to satisfy it
+ */
+static uint32_t adjust_search_size(uint32_t size) {
+    if (size < HEAP_SMALL_BLOCK_SIZE) {
+        return size;
+    }
+
+    uint32_t msb = 31 - (uint32_t)__builtin_clz(size);
+    uint32_t mask = (1U << (msb - HEAP_SL_INDEX_LOG2)) - 1;
+    return (size + mask) & ~mask;
 }
 
 /*
- * Round up size to next power of 2 or minimum allocation size
+ * Round up size to heap alignment or minimum allocation size
  */
 static uint32_t round_up_size(uint32_t size) {
     if (size < MIN_ALLOC_SIZE) {
         return MIN_ALLOC_SIZE;
     }
 
-    /* Round up to next power of 2 */
-    uint32_t rounded = MIN_ALLOC_SIZE;
-    while (rounded < size) {
-        rounded <<= 1;
-    }
-
-    return rounded;
+    return (size + HEAP_ALIGNMENT - 1) & ~(uint32_t)(HEAP_ALIGNMENT - 1);
 }
 
 /* ========================================================================
@@ -160,24 +226,15 @@ static uint32_t round_up_size(uint32_t size) {
  * ======================================================================== */
 
 /*
- * Add block to appropriate free list
+ * Link block at the head of its size-class list and mark the list non-empty
  */
-static void add_to_free_list(heap_block_t *block) {
-    if (!validate_block(block)) {
-        kprint("add_to_free_list: Invalid block\n");
-        return;
-    }
-
-    uint32_t size_class = get_size_class(block->size);
-    free_list_t *list = &kernel_heap.free_lists[size_class];
+static void free_list_push(heap_block_t *block) {
+    uint32_t fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    free_list_t *list = &kernel_heap.free_lists[fl][sl];
 
-    block->magic = BLOCK_MAGIC_FREE;
-    block->flags = 0;
-    block->checksum = calculate_checksum(block);
-
-    /* Add to head of list */
-    block->next = list->head;
     block->prev = NULL;
+    block->next = list->head;
 
     if (list->head) {
         list->head->prev = block;
@@ -186,26 +243,21 @@ static void add_to_free_list(heap_block_t *block) {
     list->head = block;
     list->count++;
 
-    kernel_heap.stats.free_blocks++;
-    kernel_heap.stats.allocated_blocks--;
+    kernel_heap.sl_bitmap[fl] |= (1U << sl);
+    kernel_heap.fl_bitmap |= (1U << fl);
 }
 
 /*
- * Remove block from free list
+ * Unlink block from its size-class list, clearing bitmap bits once empty
  */
-static void remove_from_free_list(heap_block_t *block) {
-    if (!validate_block(block)) {
-        kprint("remove_from_free_list: Invalid block\n");
-        return;
-    }
-
-    uint32_t size_class = get_size_class(block->size);
-    free_list_t *list = &kernel_heap.free_lists[size_class];
+static void free_list_unlink(heap_block_t *block) {
+    uint32_t fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    free_list_t *list = &kernel_heap.free_lists[fl][sl];
 
-    /* Remove from linked list */
     if (block->prev) {
         block->prev->next = block->next;
-    } else {
+    } else if (list->head == block) {
         list->head = block->next;
     }
 
@@ -213,44 +265,66 @@ static void remove_from_free_list(heap_block_t *block) {
         block->next->prev = block->prev;
     }
 
-    list->count--;
+    if (list->count > 0) {
+        list->count--;
+    }
+
+    if (!list->head) {
+        kernel_heap.sl_bitmap[fl] &= ~(1U << sl);
+        if (!kernel_heap.sl_bitmap[fl]) {
+            kernel_heap.fl_bitmap &= ~(1U << fl);
+        }
+    }
 
-    block->magic = BLOCK_MAGIC_ALLOCATED;
     block->next = NULL;
     block->prev = NULL;
+}
+
+/*
+ * Add block to appropriate free list
+ */
+static void add_to_free_list(heap_block_t *block) {
+    if (!validate_block(block)) {
+        kprint("add_to_free_list: Invalid block\n");
+        return;
+    }
+
+    block->magic = BLOCK_MAGIC_FREE;
     block->checksum = calculate_checksum(block);
 
-    kernel_heap.stats.allocated_blocks++;
-    kernel_heap.stats.free_blocks--;
+    free_list_push(block);
+
+    kernel_heap.stats.free_blocks++;
+    kernel_heap.stats.allocated_blocks--;
 }
 
 /*
- * Detach block from free list without altering allocation counters
+ * Remove block from free list
  */
-static void unlink_free_block(heap_block_t *block) {
-    if (!block || block->magic != BLOCK_MAGIC_FREE) {
+static void remove_from_free_list(heap_block_t *block) {
+    if (!validate_block(block)) {
+        kprint("remove_from_free_list: Invalid block\n");
         return;
     }
 
-    uint32_t size_class = get_size_class(block->size);
-    free_list_t *list = &kernel_heap.free_lists[size_class];
+    free_list_unlink(block);
 
-    if (block->prev) {
-        block->prev->next = block->next;
-    } else if (list->head == block) {
-        list->head = block->next;
-    }
+    block->magic = BLOCK_MAGIC_ALLOCATED;
+    block->checksum = calculate_checksum(block);
 
-    if (block->next) {
-        block->next->prev = block->prev;
-    }
+    kernel_heap.stats.allocated_blocks++;
+    kernel_heap.stats.free_blocks--;
+}
 
-    if (list->count > 0) {
-        list->count--;
+/*
+ * Detach block from free list without altering allocation counters
+ */
+static void unlink_free_block(heap_block_t *block) {
+    if (!block || block->magic != BLOCK_MAGIC_FREE) {
+        return;
     }
 
-    block->next = NULL;
-    block->prev = NULL;
+    free_list_unlink(block);
 
     if (kernel_heap.stats.free_blocks > 0) {
         kernel_heap.stats.free_blocks--;
@@ -265,48 +339,40 @@ static void reinsert_free_block(heap_block_t *block) {
         return;
     }
 
-    uint32_t size_class = get_size_class(block->size);
-    free_list_t *list = &kernel_heap.free_lists[size_class];
-
     block->magic = BLOCK_MAGIC_FREE;
     block->checksum = calculate_checksum(block);
-    block->flags = 0;
-
-    block->prev = NULL;
-    block->next = list->head;
-
-    if (list->head) {
-        list->head->prev = block;
-    }
 
-    list->head = block;
-    list->count++;
+    free_list_push(block);
     kernel_heap.stats.free_blocks++;
 }
 
 /*
  * Find suitable block in free lists
- * Iterates through each size class list to find a block large enough,
- * not just checking the head node
+ * The request is rounded up to a second-level boundary, then the bitmaps
+ * locate the first non-empty list at or above it. Any block in that list
+ * fits, so only the head is inspected.
  */
 static heap_block_t *find_free_block(uint32_t size) {
-    uint32_t size_class = get_size_class(size);
+    uint32_t fl, sl;
+    mapping_insert(adjust_search_size(size), &fl, &sl);
 
-    /* Search from appropriate size class up to larger ones */
-    for (uint32_t i = size_class; i < 16; i++) {
-        free_list_t *list = &kernel_heap.free_lists[i];
-        heap_block_t *candidate = list->head;
+    if (fl >= HEAP_FL_INDEX_COUNT) {
+        return NULL;
+    }
 
-        /* Walk through the entire list for this size class */
-        while (candidate) {
-            if (candidate->size >= size) {
-                return candidate;
-            }
-            candidate = candidate->next;
+    uint32_t sl_map = kernel_heap.sl_bitmap[fl] & (~0U << sl);
+    if (!sl_map) {
+        uint32_t fl_map = kernel_heap.fl_bitmap & (~0U << (fl + 1));
+        if (!fl_map) {
+            return NULL;
         }
+
+        fl = (uint32_t)__builtin_ctz(fl_map);
+        sl_map = kernel_heap.sl_bitmap[fl];
     }
 
-    return NULL;
+    sl = (uint32_t)__builtin_ctz(sl_map);
+    return kernel_heap.free_lists[fl][sl].head;
 }
 
 /*
@@ -315,22 +381,191 @@ static heap_block_t *find_free_block(uint32_t size) {
  */
 static uint64_t check_available_free_space(void) {
     uint64_t total_free = 0;
-    for (uint32_t i = 0; i < 16; i++) {
-        heap_block_t *cursor = kernel_heap.free_lists[i].head;
-        while (cursor) {
-            total_free += cursor->size;
-            cursor = cursor->next;
+    for (uint32_t fl = 0; fl < HEAP_FL_INDEX_COUNT; fl++) {
+        for (uint32_t sl = 0; sl < HEAP_SL_INDEX_COUNT; sl++) {
+            heap_block_t *cursor = kernel_heap.free_lists[fl][sl].head;
+            while (cursor) {
+                total_free += cursor->size;
+                cursor = cursor->next;
+            }
         }
     }
     return total_free;
 }
 
+/* ========================================================================
+ * HEAP PAGE BACKING
+ * ======================================================================== */
+
+/*
+ * Unmap every mapped page in [start, end) and return frames to the page allocator
+ * Returns number of pages released
+ */
+static uint32_t heap_release_pages(uint64_t start, uint64_t end) {
+    uint32_t released = 0;
+    uint64_t virt = start;
+
+    while (virt < end) {
+        if (get_page_size(virt) == PAGE_SIZE_2MB) {
+            uint64_t huge_base = virt & ~(uint64_t)(KERNEL_HEAP_HUGE_CHUNK - 1);
+
+            /* A fully covered huge page goes back in one piece */
+            if (huge_base == virt && virt + KERNEL_HEAP_HUGE_CHUNK <= end) {
+                uint64_t phys = virt_to_phys(virt);
+                unmap_page(virt);
+                for (uint32_t i = 0; i < KERNEL_HEAP_HUGE_FRAMES; i++) {
+                    free_page_frame(phys + (uint64_t)i * PAGE_SIZE_4KB);
+                }
+                kernel_heap.stats.huge_page_bytes -= KERNEL_HEAP_HUGE_CHUNK;
+                released += KERNEL_HEAP_HUGE_FRAMES;
+                virt += KERNEL_HEAP_HUGE_CHUNK;
+                continue;
+            }
+
+            /* Partially covered - demote so single pages can be unmapped */
+            if (split_page_2mb(virt) != 0) {
+                virt = huge_base + KERNEL_HEAP_HUGE_CHUNK;
+                continue;
+            }
+            kernel_heap.stats.huge_page_bytes -= KERNEL_HEAP_HUGE_CHUNK;
+        }
+
+        uint64_t phys = virt_to_phys(virt);
+        if (phys) {
+            unmap_page(virt);
+            free_page_frame(phys);
+            released++;
+        }
+        virt += PAGE_SIZE_4KB;
+    }
+
+    kernel_heap.stats.total_size -= (uint64_t)released * PAGE_SIZE_4KB;
+    return released;
+}
+
+/*
+ * Map fresh frames behind any unmapped page overlapping [start, end)
+ */
+static int heap_populate_pages(uint64_t start, uint64_t end) {
+    uint64_t first = start & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+
+    for (uint64_t virt = first; virt < end; virt += PAGE_SIZE_4KB) {
+        if (virt_to_phys(virt)) {
+            continue;
+        }
+
+        uint64_t phys = alloc_page_frame(0);
+        if (!phys) {
+            kprint("kmalloc: Failed to repopulate trimmed heap page\n");
+            return -1;
+        }
+
+        if (map_page_4kb(virt, phys, PAGE_KERNEL_RW) != 0) {
+            free_page_frame(phys);
+            return -1;
+        }
+
+        kernel_heap.stats.total_size += PAGE_SIZE_4KB;
+    }
+
+    return 0;
+}
+
+/*
+ * Release the whole pages strictly inside a free block's data area
+ * Header and footer pages stay mapped so neighbours can still be inspected
+ */
+static uint32_t trim_free_block_interior(heap_block_t *block) {
+    uint64_t data_start = (uint64_t)(uintptr_t)block + sizeof(heap_block_t);
+    uint64_t data_end = data_start + block->size;
+    uint64_t lo = (data_start + PAGE_SIZE_4KB - 1) & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+    uint64_t hi = data_end & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+
+    if (hi <= lo) {
+        return 0;
+    }
+
+    uint32_t released = heap_release_pages(lo, hi);
+    if (released > 0 || (block->flags & HEAP_BLOCK_FLAG_TRIMMED)) {
+        block->flags |= HEAP_BLOCK_FLAG_TRIMMED;
+        block->checksum = calculate_checksum(block);
+    }
+
+    return released;
+}
+
+/*
+ * Shrink a free block that ends at the heap break, moving the break down
+ * Keeps at least retain bytes of the block mapped
+ * Returns number of pages released
+ */
+static uint32_t trim_heap_tail(heap_block_t *block, uint32_t retain) {
+    uint64_t block_addr = (uint64_t)(uintptr_t)block;
+
+    if (!block || block->magic != BLOCK_MAGIC_FREE ||
+        block_addr + HEAP_BLOCK_OVERHEAD + block->size != kernel_heap.current_break) {
+        return 0;
+    }
+
+    if (retain < MIN_ALLOC_SIZE) {
+        retain = MIN_ALLOC_SIZE;
+    }
+
+    uint64_t new_break = block_addr + HEAP_BLOCK_OVERHEAD + retain;
+    new_break = (new_break + PAGE_SIZE_4KB - 1) & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+
+    /* Keep a huge-page-backed tail whole rather than splitting it */
+    if (get_page_size(new_break) == PAGE_SIZE_2MB) {
+        new_break = (new_break + KERNEL_HEAP_HUGE_CHUNK - 1) &
+                    ~(uint64_t)(KERNEL_HEAP_HUGE_CHUNK - 1);
+    }
+
+    if (new_break >= kernel_heap.current_break) {
+        return 0;
+    }
+
+    uint32_t new_size = (uint32_t)(new_break - block_addr - HEAP_BLOCK_OVERHEAD);
+    uint32_t released_bytes = block->size - new_size;
+
+    /* The new footer may land on a page trimmed from the block interior */
+    if (heap_populate_pages(new_break - sizeof(heap_block_footer_t), new_break) != 0) {
+        return 0;
+    }
+
+    free_list_unlink(block);
+    block->size = new_size;
+    block->checksum = calculate_checksum(block);
+    write_block_footer(block);
+    free_list_push(block);
+
+    uint32_t released = heap_release_pages(new_break, kernel_heap.current_break);
+    kernel_heap.current_break = new_break;
+    kernel_heap.stats.free_size -= released_bytes;
+
+    return released;
+}
+
+/*
+ * Record a trim pass in heap statistics
+ */
+static void account_trim(uint32_t pages) {
+    if (pages == 0) {
+        return;
+    }
+
+    kernel_heap.stats.trim_count++;
+    kernel_heap.stats.trimmed_bytes += (uint64_t)pages * PAGE_SIZE_4KB;
+}
+
 /* ========================================================================
  * HEAP EXPANSION
  * ======================================================================== */
 
 /*
  * Expand heap by allocating more pages
+ * Growth is rounded up to the next 2MB boundary; aligned 2MB chunks are
+ * mapped with huge pages when a contiguous block is available, and with
+ * 4KB pages otherwise
  */
 static int expand_heap(uint32_t min_size) {
     /* Calculate pages needed */
@@ -341,38 +576,50 @@ static int expand_heap(uint32_t min_size) {
         pages_needed = 4;
     }
 
+    uint64_t expansion_start = kernel_heap.current_break;
+    uint64_t expansion_end = expansion_start + (uint64_t)pages_needed * PAGE_SIZE_4KB;
+    uint64_t chunk_end = (expansion_end + KERNEL_HEAP_HUGE_CHUNK - 1) &
+                         ~(uint64_t)(KERNEL_HEAP_HUGE_CHUNK - 1);
+
+    if (expansion_end > kernel_heap.end_addr) {
+        boot_log_info("expand_heap: Kernel heap window exhausted");
+        return -1;
+    }
+    if (chunk_end <= kernel_heap.end_addr) {
+        expansion_end = chunk_end;
+    }
+
+    uint32_t total_bytes = (uint32_t)(expansion_end - expansion_start);
+
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
         kprint("Expanding heap by ");
-        kprint_decimal(pages_needed);
+        kprint_decimal(total_bytes / PAGE_SIZE_4KB);
         kprint(" pages\n");
     });
 
-    uint64_t expansion_start = kernel_heap.current_break;
-    uint32_t total_bytes = pages_needed * PAGE_SIZE_4KB;
-    uint32_t mapped_pages = 0;
-
-    /* Allocate physical pages and map them */
-    for (uint32_t i = 0; i < pages_needed; i++) {
-        uint64_t phys_page = alloc_page_frame(0);
-        if (!phys_page) {
-            boot_log_info("expand_heap: Failed to allocate physical page");
-            goto rollback;
-        }
-
-        uint64_t virt_page = expansion_start + (uint64_t)i * PAGE_SIZE_4KB;
+    /*
+     * Map the whole expansion in one batched walk; aligned 2MB chunks get
+     * huge pages when a contiguous block is available. Frames stay
+     * independent so trimming can later release them one by one
+     */
+    if (map_range(expansion_start, MAP_RANGE_ALLOC, total_bytes / PAGE_SIZE_4KB,
+                  PAGE_KERNEL_RW | PAGE_SIZE) != 0) {
+        boot_log_info("expand_heap: Failed to map heap pages");
+        return -1;
+    }
 
-        if (map_page_4kb(virt_page, phys_page, PAGE_KERNEL_RW) != 0) {
-            boot_log_info("expand_heap: Failed to map heap page");
-            free_page_frame(phys_page);
-            goto rollback;
+    kernel_heap.stats.total_size += total_bytes;
+    uint64_t first_chunk = (expansion_start + KERNEL_HEAP_HUGE_CHUNK - 1) &
+                           ~(uint64_t)(KERNEL_HEAP_HUGE_CHUNK - 1);
+    for (uint64_t chunk = first_chunk; chunk < expansion_end; chunk += KERNEL_HEAP_HUGE_CHUNK) {
+        if (get_page_size(chunk) == PAGE_SIZE_2MB) {
+            kernel_heap.stats.huge_page_bytes += KERNEL_HEAP_HUGE_CHUNK;
         }
-
-        mapped_pages++;
     }
 
     /* Create large free block from new pages */
     uint64_t new_block_addr = expansion_start;
-    uint32_t new_block_size = total_bytes - sizeof(heap_block_t);
+    uint32_t new_block_size = total_bytes - HEAP_BLOCK_OVERHEAD;
 
     heap_block_t *new_block = (heap_block_t*)new_block_addr;
     new_block->magic = BLOCK_MAGIC_FREE;
@@ -381,30 +628,137 @@ static int expand_heap(uint32_t min_size) {
     new_block->next = NULL;
     new_block->prev = NULL;
     new_block->checksum = calculate_checksum(new_block);
+    write_block_footer(new_block);
 
     /* Update heap break */
     kernel_heap.current_break += total_bytes;
-    kernel_heap.stats.total_size += total_bytes;
     kernel_heap.stats.free_size += new_block_size;
 
     /* Add to free lists */
     add_to_free_list(new_block);
 
     return 0;
+}
+
+/* ========================================================================
+ * LARGE ALLOCATION PATH
+ * ======================================================================== */
+
+static inline int large_span_owns(const void *ptr) {
+    uint64_t addr = (uint64_t)(uintptr_t)ptr;
+    return addr >= KMALLOC_LARGE_REGION_START &&
+           addr < KMALLOC_LARGE_REGION_START + KMALLOC_LARGE_REGION_SIZE;
+}
 
-rollback:
-    for (uint32_t j = 0; j < mapped_pages; j++) {
-        uint64_t virt_page = expansion_start + (uint64_t)j * PAGE_SIZE_4KB;
-        uint64_t mapped_phys = virt_to_phys(virt_page);
-        if (mapped_phys) {
-            unmap_page(virt_page);
-            free_page_frame(mapped_phys);
+/*
+ * Binary search the side table for the span starting at addr
+ * Returns table index, or -1 if no span starts there
+ */
+static int large_span_find(uint64_t addr) {
+    int lo = 0;
+    int hi = (int)large_spans.count - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        uint64_t start = large_spans.spans[mid].virt_addr;
+
+        if (start == addr) {
+            return mid;
+        }
+        if (start < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
         }
     }
 
     return -1;
 }
 
+/*
+ * Map a page span for a large request
+ * Spans are separated by an unmapped guard page to catch overruns.
+ * Returns NULL when the side table or region is full; kmalloc then
+ * serves the request from the free lists instead
+ */
+static void *kmalloc_large(size_t size) {
+    if (large_spans.count >= KMALLOC_LARGE_MAX_SPANS) {
+        return NULL;
+    }
+
+    uint32_t pages = (uint32_t)((size + PAGE_SIZE_4KB - 1) / PAGE_SIZE_4KB);
+    uint64_t span_bytes = (uint64_t)pages * PAGE_SIZE_4KB;
+
+    /* First fit over the gaps between existing spans */
+    uint64_t cursor = KMALLOC_LARGE_REGION_START;
+    uint32_t slot = 0;
+    for (; slot < large_spans.count; slot++) {
+        large_span_t *span = &large_spans.spans[slot];
+        if (span->virt_addr >= cursor + span_bytes + PAGE_SIZE_4KB) {
+            break;
+        }
+        cursor = span->virt_addr + (uint64_t)span->pages * PAGE_SIZE_4KB + PAGE_SIZE_4KB;
+    }
+
+    if (cursor + span_bytes > KMALLOC_LARGE_REGION_START + KMALLOC_LARGE_REGION_SIZE) {
+        return NULL;
+    }
+
+    /* Back the span with one contiguous buddy block when it fits */
+    uint64_t block_phys = 0;
+    if (pages <= (1U << PAGE_ALLOC_MAX_ORDER)) {
+        block_phys = alloc_page_frames(pages, 0);
+    }
+
+    uint64_t map_phys = block_phys ? block_phys : MAP_RANGE_ALLOC;
+    if (map_range(cursor, map_phys, pages, PAGE_KERNEL_RW) != 0) {
+        kprint("kmalloc: Failed to back large allocation\n");
+        if (block_phys) {
+            for (uint32_t i = 0; i < pages; i++) {
+                free_page_frame(block_phys + (uint64_t)i * PAGE_SIZE_4KB);
+            }
+        }
+        return NULL;
+    }
+
+    for (uint32_t i = large_spans.count; i > slot; i--) {
+        large_spans.spans[i] = large_spans.spans[i - 1];
+    }
+    large_spans.spans[slot].virt_addr = cursor;
+    large_spans.spans[slot].pages = pages;
+    large_spans.spans[slot].size = (uint32_t)size;
+    large_spans.count++;
+
+    kernel_heap.stats.large_allocations++;
+    kernel_heap.stats.large_allocated_size += span_bytes;
+    kernel_heap.stats.allocation_count++;
+
+    return (void*)(uintptr_t)cursor;
+}
+
+/*
+ * Unmap a large span and return its frames to the page allocator
+ */
+static void kfree_large(void *ptr) {
+    int index = large_span_find((uint64_t)(uintptr_t)ptr);
+    if (index < 0) {
+        kprint("kfree: Invalid large allocation or double free detected\n");
+        return;
+    }
+
+    large_span_t *span = &large_spans.spans[index];
+    unmap_range(span->virt_addr, span->pages, UNMAP_RANGE_FREE_FRAMES);
+
+    kernel_heap.stats.large_allocations--;
+    kernel_heap.stats.large_allocated_size -= (uint64_t)span->pages * PAGE_SIZE_4KB;
+    kernel_heap.stats.free_count++;
+
+    for (uint32_t i = (uint32_t)index; i + 1 < large_spans.count; i++) {
+        large_spans.spans[i] = large_spans.spans[i + 1];
+    }
+    large_spans.count--;
+}
+
 /* ========================================================================
  * MEMORY ALLOCATION AND DEALLOCATION
  * ======================================================================== */
@@ -423,12 +777,28 @@ void *kmalloc(size_t size) {
         return NULL;
     }
 
-    /* Round up size and add header overhead */
+    /* Large requests get a dedicated page span while the span table has room */
+    if (size > KMALLOC_LARGE_THRESHOLD) {
+        void *span = kmalloc_large(size);
+        if (span) {
+            return span;
+        }
+    }
+
+    /* Small requests are served by the size-class object caches */
+    if (size <= KMEM_CACHE_MAX_KMALLOC_SIZE) {
+        void *object = kmem_cache_kmalloc(size);
+        if (object) {
+            return object;
+        }
+    }
+
+    /* Round up size and add header and footer overhead */
     uint32_t rounded_size = round_up_size(size);
-    uint32_t total_size = rounded_size + sizeof(heap_block_t);
+    uint32_t total_size = rounded_size + HEAP_BLOCK_OVERHEAD;
 
     /* Find suitable free block */
-    heap_block_t *block = find_free_block(total_size);
+    heap_block_t *block = find_free_block(rounded_size);
 
     /* Expand heap if no suitable block found */
     if (!block) {
@@ -442,10 +812,11 @@ void *kmalloc(size_t size) {
             kprint(" bytes are available in free lists (fragmentation issue)\n");
         }
         
-        if (expand_heap(total_size) != 0) {
+        /* Grow by enough that the new block lands in a searchable class */
+        if (expand_heap(adjust_search_size(rounded_size) + HEAP_BLOCK_OVERHEAD) != 0) {
             return NULL;
         }
-        block = find_free_block(total_size);
+        block = find_free_block(rounded_size);
     }
 
     if (!block) {
@@ -453,23 +824,40 @@ void *kmalloc(size_t size) {
         return NULL;
     }
 
+    int split = block->size > total_size + HEAP_BLOCK_OVERHEAD + MIN_ALLOC_SIZE;
+    uint32_t trimmed = block->flags & HEAP_BLOCK_FLAG_TRIMMED;
+
+    /* Back the part of a trimmed block being handed out (plus the remainder header) */
+    if (trimmed) {
+        uint64_t populate_start = (uint64_t)(uintptr_t)block;
+        uint64_t populate_end = populate_start + (split ? total_size + sizeof(heap_block_t)
+                                                        : HEAP_BLOCK_OVERHEAD + block->size);
+        if (heap_populate_pages(populate_start, populate_end) != 0) {
+            return NULL;
+        }
+    }
+
     /* Remove from free list */
     remove_from_free_list(block);
+    block->flags = 0;
+    block->checksum = calculate_checksum(block);
 
     /* Split block if it's significantly larger */
-    if (block->size > total_size + sizeof(heap_block_t) + MIN_ALLOC_SIZE) {
+    if (split) {
         /* Create new block from remainder */
-        heap_block_t *new_block = (heap_block_t*)((uint8_t*)block + sizeof(heap_block_t) + rounded_size);
+        heap_block_t *new_block = (heap_block_t*)((uint8_t*)block + total_size);
         new_block->magic = BLOCK_MAGIC_FREE;
         new_block->size = block->size - total_size;
-        new_block->flags = 0;
+        new_block->flags = trimmed;
         new_block->next = NULL;
         new_block->prev = NULL;
         new_block->checksum = calculate_checksum(new_block);
+        write_block_footer(new_block);
 
         /* Update original block size */
         block->size = rounded_size;
         block->checksum = calculate_checksum(block);
+        write_block_footer(block);
 
         /* Add remainder to free list */
         add_to_free_list(new_block);
@@ -504,31 +892,35 @@ void *kzalloc(size_t size) {
 
 /*
  * Find free block that sits immediately before the given block in memory
+ * The boundary tag preceding the header locates the neighbour in O(1)
  */
 static heap_block_t *find_adjacent_previous_block(heap_block_t *block) {
     if (!block) {
         return NULL;
     }
 
-    uint8_t *block_addr = (uint8_t*)block;
-
-    for (uint32_t i = 0; i < 16; i++) {
-        heap_block_t *candidate = kernel_heap.free_lists[i].head;
+    uint64_t block_addr = (uint64_t)(uintptr_t)block;
+    if (block_addr < kernel_heap.start_addr + HEAP_BLOCK_OVERHEAD) {
+        return NULL;
+    }
 
-        while (candidate) {
-            if (candidate != block) {
-                uint8_t *candidate_end = (uint8_t*)candidate + sizeof(heap_block_t) + candidate->size;
+    heap_block_footer_t *footer = (heap_block_footer_t*)block - 1;
+    if (footer->magic != BLOCK_MAGIC_FOOTER) {
+        return NULL;
+    }
 
-                if (candidate_end == block_addr) {
-                    return candidate;
-                }
-            }
+    uint64_t prev_addr = block_addr - HEAP_BLOCK_OVERHEAD - footer->size;
+    if (prev_addr < kernel_heap.start_addr) {
+        return NULL;
+    }
 
-            candidate = candidate->next;
-        }
+    heap_block_t *prev = (heap_block_t*)(uintptr_t)prev_addr;
+    if (!validate_block(prev) || prev->magic != BLOCK_MAGIC_FREE ||
+        prev->size != footer->size) {
+        return NULL;
     }
 
-    return NULL;
+    return prev;
 }
 
 /*
@@ -539,7 +931,7 @@ static heap_block_t *find_adjacent_next_block(heap_block_t *block) {
         return NULL;
     }
 
-    uint8_t *next_addr = (uint8_t*)block + sizeof(heap_block_t) + block->size;
+    uint8_t *next_addr = (uint8_t*)block + HEAP_BLOCK_OVERHEAD + block->size;
     uint64_t next_header_addr = (uint64_t)(uintptr_t)next_addr;
 
     if (next_header_addr + sizeof(heap_block_t) > kernel_heap.current_break) {
@@ -558,22 +950,24 @@ static heap_block_t *find_adjacent_next_block(heap_block_t *block) {
 /*
  * Attempt to merge the supplied free block with adjacent free blocks
  */
-static void coalesce_free_block(heap_block_t *block) {
+static heap_block_t *coalesce_free_block(heap_block_t *block) {
     if (!block || block->magic != BLOCK_MAGIC_FREE) {
-        return;
+        return block;
     }
 
     unlink_free_block(block);
 
     heap_block_t *current = block;
+    uint32_t merged_flags = block->flags;
     uint32_t reclaimed_headers = 0;
-    const uint32_t header_size = sizeof(heap_block_t);
+    const uint32_t block_overhead = HEAP_BLOCK_OVERHEAD;
 
     while (1) {
         heap_block_t *prev = find_adjacent_previous_block(current);
         if (prev) {
             unlink_free_block(prev);
-            prev->size += header_size + current->size;
+            merged_flags |= prev->flags;
+            prev->size += block_overhead + current->size;
             prev->flags = 0;
             prev->checksum = calculate_checksum(prev);
             reclaimed_headers++;
@@ -584,7 +978,8 @@ static void coalesce_free_block(heap_block_t *block) {
         heap_block_t *next = find_adjacent_next_block(current);
         if (next) {
             unlink_free_block(next);
-            current->size += header_size + next->size;
+            merged_flags |= next->flags;
+            current->size += block_overhead + next->size;
             current->flags = 0;
             current->checksum = calculate_checksum(current);
             reclaimed_headers++;
@@ -594,13 +989,16 @@ static void coalesce_free_block(heap_block_t *block) {
         break;
     }
 
-    current->flags = 0;
+    current->flags = merged_flags;
     current->checksum = calculate_checksum(current);
+    write_block_footer(current);
     reinsert_free_block(current);
 
     if (reclaimed_headers > 0) {
-        kernel_heap.stats.free_size += (uint64_t)reclaimed_headers * header_size;
+        kernel_heap.stats.free_size += (uint64_t)reclaimed_headers * block_overhead;
     }
+
+    return current;
 }
 
 /*
@@ -611,6 +1009,16 @@ void kfree(void *ptr) {
         return;
     }
 
+    if (kmem_cache_owns(ptr)) {
+        kmem_cache_kfree(ptr);
+        return;
+    }
+
+    if (large_span_owns(ptr)) {
+        kfree_large(ptr);
+        return;
+    }
+
     /* Get block header */
     heap_block_t *block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
 
@@ -626,7 +1034,43 @@ void kfree(void *ptr) {
 
     /* Add to free list and attempt coalescing */
     add_to_free_list(block);
-    coalesce_free_block(block);
+    heap_block_t *merged = coalesce_free_block(block);
+
+    /* Give a large free tail back to the page allocator */
+    if (merged->size >= HEAP_TRIM_THRESHOLD) {
+        account_trim(trim_heap_tail(merged, HEAP_TRIM_RETAIN));
+    }
+}
+
+/*
+ * Return fully free heap pages to the page allocator
+ * Shrinks the heap break past a free tail and unmaps whole pages inside
+ * every other free block. Returns number of bytes released.
+ */
+uint64_t kheap_trim(void) {
+    if (!kernel_heap.initialized) {
+        return 0;
+    }
+
+    uint32_t released = 0;
+
+    for (uint32_t fl = 0; fl < HEAP_FL_INDEX_COUNT; fl++) {
+        for (uint32_t sl = 0; sl < HEAP_SL_INDEX_COUNT; sl++) {
+            heap_block_t *cursor = kernel_heap.free_lists[fl][sl].head;
+            while (cursor) {
+                released += trim_free_block_interior(cursor);
+                cursor = cursor->next;
+            }
+        }
+    }
+
+    heap_block_t *tail = find_adjacent_previous_block((heap_block_t*)(uintptr_t)kernel_heap.current_break);
+    if (tail) {
+        released += trim_heap_tail(tail, 0);
+    }
+
+    account_trim(released);
+    return (uint64_t)released * PAGE_SIZE_4KB;
 }
 
 /* ========================================================================
@@ -644,11 +1088,14 @@ int init_kernel_heap(void) {
     kernel_heap.end_addr = KERNEL_HEAP_START + KERNEL_HEAP_SIZE;
     kernel_heap.current_break = KERNEL_HEAP_START;
 
-    /* Initialize free lists */
-    for (uint32_t i = 0; i < 16; i++) {
-        kernel_heap.free_lists[i].head = NULL;
-        kernel_heap.free_lists[i].count = 0;
-        kernel_heap.free_lists[i].size_class = i;
+    /* Initialize free lists and their bitmaps */
+    kernel_heap.fl_bitmap = 0;
+    for (uint32_t fl = 0; fl < HEAP_FL_INDEX_COUNT; fl++) {
+        kernel_heap.sl_bitmap[fl] = 0;
+        for (uint32_t sl = 0; sl < HEAP_SL_INDEX_COUNT; sl++) {
+            kernel_heap.free_lists[fl][sl].head = NULL;
+            kernel_heap.free_lists[fl][sl].count = 0;
+        }
     }
 
     /* Initialize statistics */
@@ -660,12 +1107,22 @@ int init_kernel_heap(void) {
     kernel_heap.stats.free_blocks = 0;
     kernel_heap.stats.allocation_count = 0;
     kernel_heap.stats.free_count = 0;
+    kernel_heap.stats.trimmed_bytes = 0;
+    kernel_heap.stats.trim_count = 0;
+    kernel_heap.stats.large_allocated_size = 0;
+    kernel_heap.stats.large_allocations = 0;
+    kernel_heap.stats.huge_page_bytes = 0;
+    large_spans.count = 0;
 
     /* Perform initial heap expansion */
     if (expand_heap(PAGE_SIZE_4KB * 4) != 0) {
         kernel_panic("Failed to initialize kernel heap");
     }
 
+    if (init_kmem_caches() != 0) {
+        kernel_panic("Failed to initialize kernel object caches");
+    }
+
     kernel_heap.initialized = 1;
 
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
@@ -710,6 +1167,23 @@ void print_heap_stats(void) {
     kprint("Frees: ");
     kprint_decimal(kernel_heap.stats.free_count);
     kprint("\n");
+    kprint("Trimmed: ");
+    kprint_decimal(kernel_heap.stats.trimmed_bytes);
+    kprint(" bytes in ");
+    kprint_decimal(kernel_heap.stats.trim_count);
+    kprint(" passes\n");
+    kprint("Large spans: ");
+    kprint_decimal(kernel_heap.stats.large_allocations);
+    kprint(" (");
+    kprint_decimal(kernel_heap.stats.large_allocated_size);
+    kprint(" bytes)\n");
+    kprint("Huge-page backed: ");
+    kprint_decimal(kernel_heap.stats.huge_page_bytes);
+    kprint(" of ");
+    kprint_decimal(kernel_heap.stats.total_size);
+    kprint(" bytes\n");
+
+    print_kmem_cache_stats();
 
     if (!heap_diagnostics_enabled) {
         return;
@@ -720,17 +1194,20 @@ void print_heap_stats(void) {
     uint64_t total_free_blocks = 0;
     uint64_t largest_free_block = 0;
 
-    for (uint32_t i = 0; i < 16; i++) {
-        heap_block_t *cursor = kernel_heap.free_lists[i].head;
+    for (uint32_t fl = 0; fl < HEAP_FL_INDEX_COUNT; fl++) {
         uint32_t class_count = 0;
 
-        while (cursor) {
-            class_count++;
-            total_free_blocks++;
-            if (cursor->size > largest_free_block) {
-                largest_free_block = cursor->size;
+        for (uint32_t sl = 0; sl < HEAP_SL_INDEX_COUNT; sl++) {
+            heap_block_t *cursor = kernel_heap.free_lists[fl][sl].head;
+
+            while (cursor) {
+                class_count++;
+                total_free_blocks++;
+                if (cursor->size > largest_free_block) {
+                    largest_free_block = cursor->size;
+                }
+                cursor = cursor->next;
             }
-            cursor = cursor->next;
         }
 
         if (class_count == 0) {
@@ -738,12 +1215,12 @@ void print_heap_stats(void) {
         }
 
         kprint("  ");
-        if (i < 15) {
-            kprint("<= ");
-            kprint_decimal((uint64_t)size_class_thresholds[i]);
+        if (fl == 0) {
+            kprint("< ");
+            kprint_decimal((uint64_t)HEAP_SMALL_BLOCK_SIZE);
         } else {
-            kprint("> ");
-            kprint_decimal((uint64_t)size_class_thresholds[14]);
+            kprint(">= ");
+            kprint_decimal(1ULL << (fl + HEAP_FL_INDEX_SHIFT - 1));
         }
         kprint(": ");
         kprint_decimal((uint64_t)class_count);
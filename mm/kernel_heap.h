@@ -11,6 +11,7 @@
 
 void *kmalloc(size_t size);
 void kfree(void *ptr);
+uint64_t kheap_trim(void);
 void print_heap_stats(void);
 void kernel_heap_enable_diagnostics(int enable);
 
@@ -24,6 +25,11 @@ typedef struct {
     uint32_t free_blocks;         /* Number of free blocks */
     uint32_t allocation_count;    /* Total allocations made */
     uint32_t free_count;          /* Total frees made */
+    uint64_t trimmed_bytes;       /* Bytes returned to the page allocator */
+    uint32_t trim_count;          /* Trim passes that released pages */
+    uint64_t large_allocated_size; /* Bytes mapped for large allocations */
+    uint32_t large_allocations;   /* Live large allocations */
+    uint64_t huge_page_bytes;     /* Heap bytes mapped with 2MB pages */
 } heap_stats_t;
 
 void get_heap_stats(heap_stats_t *stats);
@@ -0,0 +1,647 @@
+/*
+ * SlopOS Memory Management - Object Cache (Slab) Allocator
+ * Serves fixed-size kernel objects from slabs carved out of whole pages
+ * Small kmalloc requests are routed through per-size-class caches
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../boot/constants.h"
+#include "../drivers/serial.h"
+#include "../boot/log.h"
+#include "kmem_cache.h"
+#include "page_alloc.h"
+#include "paging.h"
+
+/* ========================================================================
+ * OBJECT CACHE CONSTANTS
+ * ======================================================================== */
+
+/* Dedicated virtual window for slabs (between kernel heap and IST stacks) */
+#define KMEM_SLAB_REGION_START        0xFFFFFFFFA0000000ULL
+#define KMEM_SLAB_REGION_SIZE         0x10000000ULL          /* 256MB */
+
+/* Every slab spans the same number of pages and is aligned to its size */
+#define KMEM_SLAB_PAGES               4
+#define KMEM_SLAB_SIZE                (KMEM_SLAB_PAGES * PAGE_SIZE_4KB)
+#define KMEM_SLAB_SLOTS               (KMEM_SLAB_REGION_SIZE / KMEM_SLAB_SIZE)
+#define KMEM_SLOT_WORDS               (KMEM_SLAB_SLOTS / 64)
+#define KMEM_SLAB_MAP_WORDS           (KMEM_SLAB_SIZE / sizeof(void *) / 64) /* One bit per object */
+#define KMEM_INVALID_SLOT             0xFFFFFFFF
+
+/* Cache configuration */
+#define KMEM_MAX_CACHES               32
+#define KMEM_CACHE_NAME_MAX           24
+#define KMEM_MIN_OBJECT_SIZE          sizeof(void *)
+#define KMEM_DEFAULT_ALIGN            8
+#define KMEM_MAX_EMPTY_SLABS          1         /* Empty slabs kept per cache */
+
+/* kmalloc size classes: 16, 32, ... 2048 bytes */
+#define KMEM_KMALLOC_MIN_SHIFT        4
+#define KMEM_KMALLOC_CLASSES          8
+
+/* Slab header magic for validation */
+#define KMEM_SLAB_MAGIC               0x51AB51AB
+
+/* Slab list membership */
+#define KMEM_LIST_PARTIAL             0
+#define KMEM_LIST_FULL                1
+#define KMEM_LIST_EMPTY               2
+#define KMEM_LIST_COUNT               3
+
+/* ========================================================================
+ * OBJECT CACHE STRUCTURES
+ * ======================================================================== */
+
+/* Slab header - lives at the start of every slab */
+typedef struct kmem_slab {
+    uint32_t magic;               /* Magic number for validation */
+    uint32_t inuse;               /* Objects currently allocated */
+    uint32_t next_unused;         /* Objects never handed out start here */
+    uint32_t list_id;             /* Which cache list holds this slab */
+    struct kmem_cache *cache;     /* Owning cache */
+    void *free_list;              /* Freed objects (next pointer embedded) */
+    struct kmem_slab *next;       /* Next slab in cache list */
+    struct kmem_slab *prev;       /* Previous slab in cache list */
+    uint64_t allocated[KMEM_SLAB_MAP_WORDS]; /* Objects currently handed out */
+} kmem_slab_t;
+
+/* Doubly linked list of slabs */
+typedef struct kmem_slab_list {
+    kmem_slab_t *head;            /* First slab in list */
+    uint32_t count;               /* Number of slabs in list */
+} kmem_slab_list_t;
+
+/* Object cache descriptor */
+struct kmem_cache {
+    char name[KMEM_CACHE_NAME_MAX];          /* Cache name for diagnostics */
+    uint32_t object_size;                    /* Object size after alignment */
+    uint32_t align;                          /* Object alignment */
+    uint32_t first_object_offset;            /* Offset of object 0 in a slab */
+    uint32_t objects_per_slab;               /* Objects carved from each slab */
+    kmem_slab_list_t lists[KMEM_LIST_COUNT]; /* Partial, full and empty slabs */
+    uint32_t active_objects;                 /* Objects currently handed out */
+    uint32_t alloc_count;                    /* Total allocations made */
+    uint32_t free_count;                     /* Total frees made */
+    uint32_t slabs_created;                  /* Slabs carved since creation */
+    uint32_t slabs_released;                 /* Slabs returned to page allocator */
+    uint32_t in_use;                         /* Descriptor slot in use */
+};
+
+/* Global object cache manager */
+typedef struct kmem_manager {
+    kmem_cache_t caches[KMEM_MAX_CACHES];             /* Cache descriptors */
+    kmem_cache_t *kmalloc_caches[KMEM_KMALLOC_CLASSES]; /* kmalloc size classes */
+    uint64_t slot_bitmap[KMEM_SLOT_WORDS];            /* Reserved slab slots */
+    uint32_t slot_hint;                               /* Word to start slot search */
+    uint32_t slots_in_use;                            /* Slabs currently mapped */
+    uint32_t initialized;                             /* Initialization flag */
+} kmem_manager_t;
+
+/* Global object cache manager instance */
+static kmem_manager_t kmem_manager = {0};
+
+static const char *const kmalloc_cache_names[KMEM_KMALLOC_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+
+/* ========================================================================
+ * UTILITY FUNCTIONS
+ * ======================================================================== */
+
+static inline uint32_t kmem_align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline uint64_t kmem_slot_to_addr(uint32_t slot) {
+    return KMEM_SLAB_REGION_START + (uint64_t)slot * KMEM_SLAB_SIZE;
+}
+
+static inline uint32_t kmem_addr_to_slot(uint64_t addr) {
+    return (uint32_t)((addr - KMEM_SLAB_REGION_START) / KMEM_SLAB_SIZE);
+}
+
+/*
+ * Locate the slab header for an object pointer (slabs are size-aligned)
+ */
+static inline kmem_slab_t *kmem_slab_from_ptr(const void *ptr) {
+    return (kmem_slab_t *)((uintptr_t)ptr & ~((uintptr_t)KMEM_SLAB_SIZE - 1));
+}
+
+/*
+ * Map a kmalloc request size to its size-class cache index
+ */
+static inline uint32_t kmem_kmalloc_class(size_t size) {
+    if (size <= (1U << KMEM_KMALLOC_MIN_SHIFT)) {
+        return 0;
+    }
+    uint32_t shift = 32 - (uint32_t)__builtin_clz((uint32_t)size - 1);
+    return shift - KMEM_KMALLOC_MIN_SHIFT;
+}
+
+/* ========================================================================
+ * SLAB SLOT MANAGEMENT
+ * ======================================================================== */
+
+/*
+ * Reserve a slab-sized slot in the slab virtual window
+ */
+static uint32_t kmem_slot_reserve(void) {
+    for (uint32_t n = 0; n < KMEM_SLOT_WORDS; n++) {
+        uint32_t word = (kmem_manager.slot_hint + n) % KMEM_SLOT_WORDS;
+        uint64_t bits = kmem_manager.slot_bitmap[word];
+
+        if (bits == ~0ULL) {
+            continue;
+        }
+
+        uint32_t bit = (uint32_t)__builtin_ctzll(~bits);
+        kmem_manager.slot_bitmap[word] |= (1ULL << bit);
+        kmem_manager.slot_hint = word;
+        kmem_manager.slots_in_use++;
+        return word * 64 + bit;
+    }
+
+    return KMEM_INVALID_SLOT;
+}
+
+static void kmem_slot_release(uint32_t slot) {
+    if (slot >= KMEM_SLAB_SLOTS) {
+        return;
+    }
+
+    kmem_manager.slot_bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+    if (kmem_manager.slots_in_use > 0) {
+        kmem_manager.slots_in_use--;
+    }
+}
+
+/* ========================================================================
+ * SLAB LIST MANAGEMENT
+ * ======================================================================== */
+
+static void kmem_list_add(kmem_cache_t *cache, kmem_slab_t *slab, uint32_t list_id) {
+    kmem_slab_list_t *list = &cache->lists[list_id];
+
+    slab->list_id = list_id;
+    slab->prev = NULL;
+    slab->next = list->head;
+    if (list->head) {
+        list->head->prev = slab;
+    }
+    list->head = slab;
+    list->count++;
+}
+
+static void kmem_list_remove(kmem_cache_t *cache, kmem_slab_t *slab) {
+    kmem_slab_list_t *list = &cache->lists[slab->list_id];
+
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        list->head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+
+    slab->next = NULL;
+    slab->prev = NULL;
+    if (list->count > 0) {
+        list->count--;
+    }
+}
+
+/*
+ * Move slab to the list matching its occupancy
+ */
+static void kmem_slab_relink(kmem_cache_t *cache, kmem_slab_t *slab) {
+    uint32_t target = KMEM_LIST_PARTIAL;
+    if (slab->inuse == 0) {
+        target = KMEM_LIST_EMPTY;
+    } else if (slab->inuse == cache->objects_per_slab) {
+        target = KMEM_LIST_FULL;
+    }
+
+    if (slab->list_id == target) {
+        return;
+    }
+
+    kmem_list_remove(cache, slab);
+    kmem_list_add(cache, slab, target);
+}
+
+/* ========================================================================
+ * SLAB CREATION AND RELEASE
+ * ======================================================================== */
+
+/*
+ * Unmap slab pages and hand the frames back to the page allocator
+ */
+static void kmem_slab_unmap(uint64_t base, uint32_t pages) {
+    for (uint32_t i = 0; i < pages; i++) {
+        uint64_t virt = base + (uint64_t)i * PAGE_SIZE_4KB;
+        uint64_t phys = virt_to_phys(virt);
+        if (phys) {
+            unmap_page(virt);
+            free_page_frame(phys);
+        }
+    }
+}
+
+/*
+ * Carve a new slab for the cache from freshly mapped pages
+ */
+static kmem_slab_t *kmem_slab_create(kmem_cache_t *cache) {
+    uint32_t slot = kmem_slot_reserve();
+    if (slot == KMEM_INVALID_SLOT) {
+        kprint("kmem_cache: Slab window exhausted\n");
+        return NULL;
+    }
+
+    uint64_t base = kmem_slot_to_addr(slot);
+    uint32_t mapped = 0;
+
+    for (uint32_t i = 0; i < KMEM_SLAB_PAGES; i++) {
+        uint64_t phys = alloc_page_frame(0);
+        if (!phys) {
+            kprint("kmem_cache: Failed to allocate slab page\n");
+            goto rollback;
+        }
+
+        if (map_page_4kb(base + (uint64_t)i * PAGE_SIZE_4KB, phys, PAGE_KERNEL_RW) != 0) {
+            kprint("kmem_cache: Failed to map slab page\n");
+            free_page_frame(phys);
+            goto rollback;
+        }
+        mapped++;
+    }
+
+    kmem_slab_t *slab = (kmem_slab_t *)base;
+    slab->magic = KMEM_SLAB_MAGIC;
+    slab->inuse = 0;
+    slab->next_unused = 0;
+    slab->cache = cache;
+    slab->free_list = NULL;
+    slab->next = NULL;
+    slab->prev = NULL;
+    for (uint32_t i = 0; i < KMEM_SLAB_MAP_WORDS; i++) {
+        slab->allocated[i] = 0;
+    }
+
+    kmem_list_add(cache, slab, KMEM_LIST_EMPTY);
+    cache->slabs_created++;
+
+    return slab;
+
+rollback:
+    kmem_slab_unmap(base, mapped);
+    kmem_slot_release(slot);
+    return NULL;
+}
+
+static void kmem_slab_release(kmem_cache_t *cache, kmem_slab_t *slab) {
+    uint64_t base = (uint64_t)(uintptr_t)slab;
+
+    kmem_list_remove(cache, slab);
+    slab->magic = 0;
+    slab->cache = NULL;
+
+    kmem_slab_unmap(base, KMEM_SLAB_PAGES);
+    kmem_slot_release(kmem_addr_to_slot(base));
+    cache->slabs_released++;
+}
+
+static inline uint32_t kmem_slab_index(const kmem_slab_t *slab, const void *ptr) {
+    uint64_t offset = (uint64_t)(uintptr_t)ptr - (uint64_t)(uintptr_t)slab;
+    return (uint32_t)((offset - slab->cache->first_object_offset) / slab->cache->object_size);
+}
+
+static inline int kmem_slab_is_allocated(const kmem_slab_t *slab, uint32_t index) {
+    return (slab->allocated[index / 64] >> (index % 64)) & 1;
+}
+
+/*
+ * Validate that ptr is an object boundary inside a live slab of the cache
+ */
+static kmem_slab_t *kmem_slab_validate(kmem_cache_t *cache, const void *ptr) {
+    if (!kmem_cache_owns(ptr)) {
+        return NULL;
+    }
+
+    kmem_slab_t *slab = kmem_slab_from_ptr(ptr);
+    if (slab->magic != KMEM_SLAB_MAGIC || (cache && slab->cache != cache)) {
+        return NULL;
+    }
+
+    uint64_t offset = (uint64_t)(uintptr_t)ptr - (uint64_t)(uintptr_t)slab;
+    kmem_cache_t *owner = slab->cache;
+    if (offset < owner->first_object_offset ||
+        (offset - owner->first_object_offset) % owner->object_size != 0 ||
+        (offset - owner->first_object_offset) / owner->object_size >= owner->objects_per_slab ||
+        slab->inuse == 0) {
+        return NULL;
+    }
+
+    return slab;
+}
+
+/* ========================================================================
+ * PUBLIC CACHE INTERFACE
+ * ======================================================================== */
+
+/*
+ * Create an object cache
+ * Returns cache handle, NULL on failure
+ */
+kmem_cache_t *kmem_cache_create(const char *name, size_t object_size, size_t align) {
+    if (object_size == 0) {
+        return NULL;
+    }
+
+    if (align == 0) {
+        align = KMEM_DEFAULT_ALIGN;
+    }
+
+    if ((align & (align - 1)) != 0 || align > PAGE_SIZE_4KB) {
+        kprint("kmem_cache_create: Invalid alignment\n");
+        return NULL;
+    }
+
+    if (object_size < KMEM_MIN_OBJECT_SIZE) {
+        object_size = KMEM_MIN_OBJECT_SIZE;
+    }
+
+    uint32_t size = kmem_align_up((uint32_t)object_size, (uint32_t)align);
+    uint32_t offset = kmem_align_up(sizeof(kmem_slab_t), (uint32_t)align);
+
+    if (object_size > KMEM_SLAB_SIZE || offset + size > KMEM_SLAB_SIZE) {
+        kprint("kmem_cache_create: Object too large for slab\n");
+        return NULL;
+    }
+
+    kmem_cache_t *cache = NULL;
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        if (!kmem_manager.caches[i].in_use) {
+            cache = &kmem_manager.caches[i];
+            break;
+        }
+    }
+
+    if (!cache) {
+        kprint("kmem_cache_create: No free cache descriptors\n");
+        return NULL;
+    }
+
+    uint32_t n = 0;
+    if (name) {
+        while (n < KMEM_CACHE_NAME_MAX - 1 && name[n]) {
+            cache->name[n] = name[n];
+            n++;
+        }
+    }
+    cache->name[n] = '\0';
+
+    cache->object_size = size;
+    cache->align = (uint32_t)align;
+    cache->first_object_offset = offset;
+    cache->objects_per_slab = (KMEM_SLAB_SIZE - offset) / size;
+    for (uint32_t i = 0; i < KMEM_LIST_COUNT; i++) {
+        cache->lists[i].head = NULL;
+        cache->lists[i].count = 0;
+    }
+    cache->active_objects = 0;
+    cache->alloc_count = 0;
+    cache->free_count = 0;
+    cache->slabs_created = 0;
+    cache->slabs_released = 0;
+    cache->in_use = 1;
+
+    return cache;
+}
+
+/*
+ * Destroy an object cache and release its slabs
+ * Fails if objects are still allocated from it
+ */
+int kmem_cache_destroy(kmem_cache_t *cache) {
+    if (!cache || !cache->in_use) {
+        return -1;
+    }
+
+    if (cache->active_objects != 0) {
+        kprint("kmem_cache_destroy: Cache still has live objects\n");
+        return -1;
+    }
+
+    kmem_cache_shrink(cache);
+    cache->in_use = 0;
+    return 0;
+}
+
+/*
+ * Allocate one object from the cache
+ */
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (!cache || !cache->in_use) {
+        return NULL;
+    }
+
+    kmem_slab_t *slab = cache->lists[KMEM_LIST_PARTIAL].head;
+    if (!slab) {
+        slab = cache->lists[KMEM_LIST_EMPTY].head;
+    }
+    if (!slab) {
+        slab = kmem_slab_create(cache);
+        if (!slab) {
+            return NULL;
+        }
+    }
+
+    void *object = slab->free_list;
+    if (object) {
+        slab->free_list = *(void **)object;
+    } else {
+        object = (uint8_t *)slab + cache->first_object_offset +
+                 (uint64_t)slab->next_unused * cache->object_size;
+        slab->next_unused++;
+    }
+
+    uint32_t index = kmem_slab_index(slab, object);
+    slab->allocated[index / 64] |= 1ULL << (index % 64);
+    slab->inuse++;
+    kmem_slab_relink(cache, slab);
+
+    cache->active_objects++;
+    cache->alloc_count++;
+
+    return object;
+}
+
+/*
+ * Return one object to its cache
+ */
+void kmem_cache_free(kmem_cache_t *cache, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    kmem_slab_t *slab = kmem_slab_validate(cache, ptr);
+    if (!slab) {
+        kprint("kmem_cache_free: Invalid object pointer\n");
+        return;
+    }
+
+    cache = slab->cache;
+
+    /* Freed twice, or never handed out: leave the freelist intact */
+    uint32_t index = kmem_slab_index(slab, ptr);
+    if (!kmem_slab_is_allocated(slab, index)) {
+        kprint("kmem_cache_free: Double free or unallocated object\n");
+        return;
+    }
+    slab->allocated[index / 64] &= ~(1ULL << (index % 64));
+
+    *(void **)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->inuse--;
+    kmem_slab_relink(cache, slab);
+
+    cache->active_objects--;
+    cache->free_count++;
+
+    if (cache->lists[KMEM_LIST_EMPTY].count > KMEM_MAX_EMPTY_SLABS) {
+        kmem_slab_release(cache, slab);
+    }
+}
+
+/*
+ * Release every empty slab held by the cache
+ * Returns number of slabs released
+ */
+uint32_t kmem_cache_shrink(kmem_cache_t *cache) {
+    if (!cache || !cache->in_use) {
+        return 0;
+    }
+
+    uint32_t released = 0;
+    while (cache->lists[KMEM_LIST_EMPTY].head) {
+        kmem_slab_release(cache, cache->lists[KMEM_LIST_EMPTY].head);
+        released++;
+    }
+
+    return released;
+}
+
+void kmem_cache_get_stats(const kmem_cache_t *cache, kmem_cache_stats_t *stats) {
+    if (!cache || !stats) {
+        return;
+    }
+
+    stats->object_size = cache->object_size;
+    stats->objects_per_slab = cache->objects_per_slab;
+    stats->active_objects = cache->active_objects;
+    stats->total_slabs = cache->lists[KMEM_LIST_PARTIAL].count +
+                         cache->lists[KMEM_LIST_FULL].count +
+                         cache->lists[KMEM_LIST_EMPTY].count;
+    stats->empty_slabs = cache->lists[KMEM_LIST_EMPTY].count;
+    stats->alloc_count = cache->alloc_count;
+    stats->free_count = cache->free_count;
+    stats->slabs_created = cache->slabs_created;
+    stats->slabs_released = cache->slabs_released;
+}
+
+/* ========================================================================
+ * KMALLOC INTEGRATION
+ * ======================================================================== */
+
+/*
+ * Initialize the object cache layer and the kmalloc size-class caches
+ */
+int init_kmem_caches(void) {
+    boot_log_debug("Initializing kernel object caches");
+
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        kmem_manager.caches[i].in_use = 0;
+    }
+    for (uint32_t i = 0; i < KMEM_SLOT_WORDS; i++) {
+        kmem_manager.slot_bitmap[i] = 0;
+    }
+    kmem_manager.slot_hint = 0;
+    kmem_manager.slots_in_use = 0;
+
+    for (uint32_t i = 0; i < KMEM_KMALLOC_CLASSES; i++) {
+        size_t size = (size_t)1 << (KMEM_KMALLOC_MIN_SHIFT + i);
+        kmem_cache_t *cache = kmem_cache_create(kmalloc_cache_names[i], size, KMEM_DEFAULT_ALIGN);
+        if (!cache) {
+            boot_log_info("init_kmem_caches: Failed to create kmalloc cache");
+            return -1;
+        }
+        kmem_manager.kmalloc_caches[i] = cache;
+    }
+
+    kmem_manager.initialized = 1;
+    return 0;
+}
+
+/*
+ * Check whether ptr lies inside the slab window
+ */
+int kmem_cache_owns(const void *ptr) {
+    uint64_t addr = (uint64_t)(uintptr_t)ptr;
+    return addr >= KMEM_SLAB_REGION_START &&
+           addr < KMEM_SLAB_REGION_START + KMEM_SLAB_REGION_SIZE;
+}
+
+/*
+ * Serve a small kmalloc request from its size-class cache
+ */
+void *kmem_cache_kmalloc(size_t size) {
+    if (!kmem_manager.initialized || size == 0 || size > KMEM_CACHE_MAX_KMALLOC_SIZE) {
+        return NULL;
+    }
+
+    return kmem_cache_alloc(kmem_manager.kmalloc_caches[kmem_kmalloc_class(size)]);
+}
+
+/*
+ * Return a kmalloc object; the owning cache is recovered from its slab
+ */
+void kmem_cache_kfree(void *ptr) {
+    kmem_cache_free(NULL, ptr);
+}
+
+/*
+ * Print per-cache statistics for debugging
+ */
+void print_kmem_cache_stats(void) {
+    kprint("=== Kernel Object Caches ===\n");
+    kprint("Slabs mapped: ");
+    kprint_decimal(kmem_manager.slots_in_use);
+    kprint(" (");
+    kprint_decimal(((uint64_t)kmem_manager.slots_in_use * KMEM_SLAB_SIZE) / 1024);
+    kprint(" KB)\n");
+
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        kmem_cache_t *cache = &kmem_manager.caches[i];
+        if (!cache->in_use) {
+            continue;
+        }
+
+        kmem_cache_stats_t stats;
+        kmem_cache_get_stats(cache, &stats);
+
+        kprint("  ");
+        kprint(cache->name);
+        kprint(": ");
+        kprint_decimal(stats.active_objects);
+        kprint(" objects, ");
+        kprint_decimal(stats.total_slabs);
+        kprint(" slabs (");
+        kprint_decimal(stats.objects_per_slab);
+        kprint(" x ");
+        kprint_decimal(stats.object_size);
+        kprint(" bytes)\n");
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * SlopOS Memory Management - Object Cache (Slab) Interface
+ * Fixed-size object caches carved from whole pages, layered under kmalloc
+ */
+
+#ifndef MM_KMEM_CACHE_H
+#define MM_KMEM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest request kmalloc routes through the size-class caches */
+#define KMEM_CACHE_MAX_KMALLOC_SIZE   2048
+
+typedef struct kmem_cache kmem_cache_t;
+
+/* Per-cache statistics for diagnostics and tests */
+typedef struct kmem_cache_stats {
+    uint32_t object_size;         /* Object size after alignment */
+    uint32_t objects_per_slab;    /* Objects carved from each slab */
+    uint32_t active_objects;      /* Objects currently handed out */
+    uint32_t total_slabs;         /* Slabs currently backing the cache */
+    uint32_t empty_slabs;         /* Fully free slabs kept for reuse */
+    uint32_t alloc_count;         /* Total allocations made */
+    uint32_t free_count;          /* Total frees made */
+    uint32_t slabs_created;       /* Slabs carved since creation */
+    uint32_t slabs_released;      /* Slabs returned to the page allocator */
+} kmem_cache_stats_t;
+
+kmem_cache_t *kmem_cache_create(const char *name, size_t object_size, size_t align);
+int kmem_cache_destroy(kmem_cache_t *cache);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *ptr);
+uint32_t kmem_cache_shrink(kmem_cache_t *cache);
+void kmem_cache_get_stats(const kmem_cache_t *cache, kmem_cache_stats_t *stats);
+
+/* kmalloc integration */
+int init_kmem_caches(void);
+int kmem_cache_owns(const void *ptr);
+void *kmem_cache_kmalloc(size_t size);
+void kmem_cache_kfree(void *ptr);
+void print_kmem_cache_stats(void);
+
+#endif /* MM_KMEM_CACHE_H */
@@ -16,17 +16,11 @@
 #include "page_alloc.h"
 #include "phys_virt.h"
 
-/* Descriptor sizing helpers from allocator implementations */
-size_t buddy_allocator_block_descriptor_size(void);
-uint32_t buddy_allocator_max_supported_blocks(void);
-
 /* Forward declarations */
 void kernel_panic(const char *message);
 
 /* Memory subsystem initialization functions */
 void init_kernel_memory_layout(void);
-int init_buddy_allocator(void *block_array, uint32_t max_blocks);
-int buddy_add_zone(uint64_t start_addr, uint64_t size, uint8_t zone_type);
 int init_kernel_heap(void);
 int init_process_vm(void);
 int init_vmem_regions(void);
@@ -46,11 +40,7 @@ static inline uint64_t align_down_u64(uint64_t value, uint64_t alignment) {
 
 typedef struct allocator_buffer_plan {
     void *page_buffer;
-    uint32_t page_capacity;
     size_t page_buffer_bytes;
-    void *buddy_buffer;
-    uint32_t buddy_capacity;
-    size_t buddy_buffer_bytes;
     uint64_t reserved_phys_base;
     uint64_t reserved_phys_size;
     int prepared;
@@ -62,7 +52,6 @@ typedef struct memory_init_state {
     int limine_memmap_parsed;
     int hhdm_received;
     int page_allocator_done;
-    int buddy_allocator_done;
     int kernel_heap_done;
     int process_vm_done;
     int vmem_regions_done;
@@ -74,7 +63,10 @@ typedef struct memory_init_state {
     uint32_t reserved_region_count;
     uint64_t hhdm_offset;
     uint32_t tracked_page_frames;
-    uint32_t tracked_buddy_blocks;
+    uint32_t frame_map_sections;
+    uint32_t deferred_sections;
+    uint64_t frame_init_cycles;
+    uint64_t dense_metadata_bytes;
     uint64_t allocator_metadata_bytes;
 } memory_init_state_t;
 
@@ -275,12 +267,6 @@ static void register_usable_subrange(uint64_t start, uint64_t end) {
             kprint("MM: WARNING - failed to register page allocator region\n");
         });
     }
-
-    if (buddy_add_zone(aligned_start, aligned_size, EFI_CONVENTIONAL_MEMORY) != 0) {
-        BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_INFO, {
-            kprint("MM: WARNING - failed to register buddy allocator zone\n");
-        });
-    }
 }
 
 static void register_usable_region(uint64_t base, uint64_t length) {
@@ -339,28 +325,6 @@ static void register_usable_region(uint64_t base, uint64_t length) {
  * ALLOCATOR BUFFER PREPARATION
  * ======================================================================== */
 
-static uint32_t clamp_required_frames(uint64_t required_frames_64) {
-    uint32_t max_supported = page_allocator_max_supported_frames();
-    if (required_frames_64 > (uint64_t)max_supported) {
-        BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
-            kprint("MM: WARNING - Limiting tracked page frames to allocator maximum\n");
-        });
-        return max_supported;
-    }
-    return (uint32_t)required_frames_64;
-}
-
-static uint32_t clamp_required_blocks(uint64_t required_blocks_64) {
-    uint32_t max_supported = buddy_allocator_max_supported_blocks();
-    if (required_blocks_64 > (uint64_t)max_supported) {
-        BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
-            kprint("MM: WARNING - Limiting buddy blocks to allocator maximum\n");
-        });
-        return max_supported;
-    }
-    return (uint32_t)required_blocks_64;
-}
-
 static int prepare_allocator_buffers(const struct limine_memmap_response *memmap,
                                      uint64_t hhdm_offset) {
     if (allocator_buffers.prepared) {
@@ -392,6 +356,13 @@ static int prepare_allocator_buffers(const struct limine_memmap_response *memmap
             if (!largest_usable || entry->length > largest_usable->length) {
                 largest_usable = entry;
             }
+
+            /* Only sections holding usable memory get frame descriptors */
+            if (page_allocator_plan_range(entry->base, entry->length) != 0) {
+                BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_INFO, {
+                    kprint("MM: WARNING - Usable memory beyond frame map limits ignored\n");
+                });
+            }
         }
     }
 
@@ -405,30 +376,21 @@ static int prepare_allocator_buffers(const struct limine_memmap_response *memmap
         return -1;
     }
 
+    /* A dense map would need a descriptor for every frame below the top */
     uint64_t aligned_highest_phys = align_up_u64(highest_phys_addr, PAGE_SIZE_4KB);
-    uint64_t required_frames_64 = aligned_highest_phys / PAGE_SIZE_4KB;
-    if (required_frames_64 == 0) {
-        required_frames_64 = 1;
-    }
-
-    uint32_t required_frames = clamp_required_frames(required_frames_64);
-    uint32_t required_blocks = clamp_required_blocks(required_frames_64);
-
-    size_t page_desc_size = page_allocator_descriptor_size();
-    size_t buddy_desc_size = buddy_allocator_block_descriptor_size();
+    init_state.dense_metadata_bytes = (aligned_highest_phys / PAGE_SIZE_4KB) *
+                                      (uint64_t)page_allocator_descriptor_size();
 
-    uint64_t page_bytes_u64 = (uint64_t)required_frames * (uint64_t)page_desc_size;
-    uint64_t buddy_bytes_u64 = (uint64_t)required_blocks * (uint64_t)buddy_desc_size;
+    uint64_t page_bytes_u64 = (uint64_t)page_allocator_metadata_bytes();
 
-    if (page_bytes_u64 == 0 || buddy_bytes_u64 == 0) {
+    if (page_bytes_u64 == 0) {
         boot_log_info("MM: ERROR - Calculated zero-sized allocator metadata buffers");
         return -1;
     }
 
     const size_t descriptor_alignment = 64;
     size_t page_bytes_aligned = (size_t)align_up_u64(page_bytes_u64, descriptor_alignment);
-    size_t buddy_bytes_aligned = (size_t)align_up_u64(buddy_bytes_u64, descriptor_alignment);
-    uint64_t total_meta_bytes = (uint64_t)page_bytes_aligned + (uint64_t)buddy_bytes_aligned;
+    uint64_t total_meta_bytes = (uint64_t)page_bytes_aligned;
 
     uint64_t reserved_bytes = align_up_u64(total_meta_bytes, PAGE_SIZE_4KB);
 
@@ -448,9 +410,6 @@ static int prepare_allocator_buffers(const struct limine_memmap_response *memmap
     uintptr_t cursor = align_up_u64(reserve_virt_base, descriptor_alignment);
     uintptr_t page_buffer_virtual = cursor;
     cursor += page_bytes_aligned;
-    cursor = align_up_u64(cursor, descriptor_alignment);
-    uintptr_t buddy_buffer_virtual = cursor;
-    cursor += buddy_bytes_aligned;
 
     if (cursor > reserve_virt_end) {
         boot_log_info("MM: ERROR - Allocator metadata alignment exceeded reserved window");
@@ -458,16 +417,12 @@ static int prepare_allocator_buffers(const struct limine_memmap_response *memmap
     }
 
     allocator_buffers.page_buffer = (void *)page_buffer_virtual;
-    allocator_buffers.page_capacity = required_frames;
     allocator_buffers.page_buffer_bytes = page_bytes_u64;
-    allocator_buffers.buddy_buffer = (void *)buddy_buffer_virtual;
-    allocator_buffers.buddy_capacity = required_blocks;
-    allocator_buffers.buddy_buffer_bytes = buddy_bytes_u64;
     allocator_buffers.reserved_phys_base = reserve_phys_base;
     allocator_buffers.reserved_phys_size = reserved_bytes;
     allocator_buffers.prepared = 1;
 
-    init_state.allocator_metadata_bytes = page_bytes_u64 + buddy_bytes_u64;
+    init_state.allocator_metadata_bytes = page_bytes_u64;
 
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
         kprint("MM: Allocator metadata reserved at phys 0x");
@@ -561,6 +516,8 @@ static int initialize_memory_discovery(const struct limine_memmap_response *memm
             kprint("MM: WARNING - page allocator finalization reported issues\n");
         });
     }
+    get_page_frame_init_stats(&init_state.deferred_sections,
+                              &init_state.frame_init_cycles, NULL);
 
     boot_log_info("MM: Memory discovery completed successfully");
     return 0;
@@ -568,7 +525,7 @@ static int initialize_memory_discovery(const struct limine_memmap_response *memm
 
 /**
  * Initialize physical memory allocators
- * Sets up page allocator and buddy allocator with discovered memory
+ * Sets up the buddy page allocator with discovered memory
  */
 static int initialize_physical_allocators(void) {
     boot_log_debug("MM: Initializing physical memory allocators...");
@@ -578,23 +535,18 @@ static int initialize_physical_allocators(void) {
         return -1;
     }
 
-    /* Initialize page allocator with static frame array */
+    /* Initialize page allocator over the planned frame map sections */
     if (init_page_allocator(allocator_buffers.page_buffer,
-                            allocator_buffers.page_capacity) != 0) {
+                            allocator_buffers.page_buffer_bytes) != 0) {
         kernel_panic("MM: Page allocator initialization failed");
         return -1;
     }
     init_state.page_allocator_done = 1;
 
-    init_state.tracked_page_frames = allocator_buffers.page_capacity;
-
-    if (init_buddy_allocator(allocator_buffers.buddy_buffer,
-                             allocator_buffers.buddy_capacity) != 0) {
-        kernel_panic("MM: Buddy allocator initialization failed");
-        return -1;
-    }
-    init_state.buddy_allocator_done = 1;
-    init_state.tracked_buddy_blocks = allocator_buffers.buddy_capacity;
+    uint32_t tracked_frames = 0;
+    get_page_allocator_stats(&tracked_frames, NULL, NULL);
+    init_state.tracked_page_frames = tracked_frames;
+    init_state.frame_map_sections = page_allocator_section_count();
 
     boot_log_debug("MM: Physical memory allocators initialized successfully");
     return 0;
@@ -675,23 +627,27 @@ static void display_memory_summary(void) {
     kprint("Page Allocator:        ");
     kprint(init_state.page_allocator_done ? "OK" : "FAILED");
     kprint("\n");
-    kprint("Buddy Allocator:       ");
-    kprint(init_state.buddy_allocator_done ? "OK" : "FAILED");
-    kprint("\n");
     if (init_state.tracked_page_frames) {
         kprint("Tracked Frames:        ");
         kprint_decimal(init_state.tracked_page_frames);
         kprint("\n");
     }
-    if (init_state.tracked_buddy_blocks) {
-        kprint("Tracked Buddy Blocks:  ");
-        kprint_decimal(init_state.tracked_buddy_blocks);
+    if (init_state.frame_map_sections) {
+        kprint("Frame Map Sections:    ");
+        kprint_decimal(init_state.frame_map_sections);
+        kprint(" x 128 MB (");
+        kprint_decimal(init_state.deferred_sections);
+        kprint(" deferred)\n");
+        kprint("Frame Init Cycles:     ");
+        kprint_decimal(init_state.frame_init_cycles);
         kprint("\n");
     }
     if (init_state.allocator_metadata_bytes) {
         kprint("Allocator Metadata:    ");
         kprint_decimal((uint32_t)(init_state.allocator_metadata_bytes / 1024));
-        kprint(" KB\n");
+        kprint(" KB (dense map: ");
+        kprint_decimal((uint32_t)(init_state.dense_metadata_bytes / 1024));
+        kprint(" KB)\n");
     }
     if (init_state.reserved_region_count) {
         kprint("Reserved Regions:      ");
@@ -815,7 +771,6 @@ int is_memory_system_initialized(void) {
             init_state.limine_memmap_parsed &&
             init_state.hhdm_received &&
             init_state.page_allocator_done &&
-            init_state.buddy_allocator_done &&
             init_state.kernel_heap_done &&
             init_state.process_vm_done &&
             init_state.vmem_regions_done &&
@@ -1,7 +1,7 @@
 /*
  * SlopOS Memory Management - Physical Page Frame Allocator
  * Manages allocation and deallocation of physical memory pages
- * Coordinates with buddy allocator for efficient memory management
+ * Buddy allocator over a sparse, sectioned frame descriptor map
  */
 
 #include <stdint.h>
@@ -9,6 +9,7 @@
 #include "../boot/constants.h"
 #include "../boot/log.h"
 #include "../drivers/serial.h"
+#include "../lib/cpu.h"
 #include "page_alloc.h"
 #include "phys_virt.h"
 
@@ -20,105 +21,190 @@ void kernel_panic(const char *message);
  * ======================================================================== */
 
 /* Physical page frame states */
-#define PAGE_FRAME_FREE               0x00   /* Available for allocation */
+#define PAGE_FRAME_FREE               0x00   /* Head of a free buddy block */
 #define PAGE_FRAME_ALLOCATED          0x01   /* Currently allocated */
 #define PAGE_FRAME_RESERVED           0x02   /* Reserved by system */
 #define PAGE_FRAME_KERNEL             0x03   /* Kernel-only page */
 #define PAGE_FRAME_DMA                0x04   /* DMA-capable page */
+#define PAGE_FRAME_TAIL               0x05   /* Non-head frame inside a buddy block */
+#define PAGE_FRAME_PAGE_TABLE         0x06   /* Paging structure counting its entries */
 
-/* Maximum physical pages we can track (4GB / 4KB = 1M pages) */
-#define MAX_PHYSICAL_PAGES            1048576
 #define INVALID_PAGE_FRAME            0xFFFFFFFF
+
+/*
+ * Sparse frame map. Descriptors exist only for 128MB sections that contain
+ * usable memory. A two-level table maps any 52-bit physical address to its
+ * section; frames are then named by a compact 32-bit index
+ * (section slot << PAGE_SECTION_SHIFT | offset within the section).
+ */
+#define PAGE_PHYS_ADDR_BITS           52
+#define PAGE_SECTION_SHIFT            15     /* 2^15 frames = 128MB per section */
+#define PAGE_SECTION_FRAMES           (1U << PAGE_SECTION_SHIFT)
+#define PAGE_SECTION_FRAME_MASK       (PAGE_SECTION_FRAMES - 1)
+#define PAGE_SECTION_BITS             (PAGE_PHYS_ADDR_BITS - 12 - PAGE_SECTION_SHIFT)
+#define PAGE_SECTION_LEAF_SHIFT       13     /* Sections per leaf table (1TB) */
+#define PAGE_SECTION_LEAF_ENTRIES     (1U << PAGE_SECTION_LEAF_SHIFT)
+#define PAGE_SECTION_ROOT_ENTRIES     (1U << (PAGE_SECTION_BITS - PAGE_SECTION_LEAF_SHIFT))
+#define MAX_PAGE_SECTIONS             4096   /* 512GB of populated sections */
+#define PAGE_EAGER_SECTIONS           2      /* Sections initialized during boot */
 #define DMA_MEMORY_LIMIT              0x01000000ULL
+#define DMA_FRAME_LIMIT               ((uint32_t)(DMA_MEMORY_LIMIT >> 12))
 
-/* Page frame allocation flags */
-#define ALLOC_FLAG_ZERO               0x01   /* Zero the page after allocation */
-#define ALLOC_FLAG_DMA                0x02   /* Allocate DMA-capable page */
-#define ALLOC_FLAG_KERNEL             0x04   /* Kernel-only allocation */
+/* Pre-zeroed frame pool refilled while the CPU is idle */
+#define PAGE_ZERO_POOL_CAPACITY       64
+#define PAGE_ZERO_POOL_RESERVE        1024   /* Free frames left untouched by refill */
+
+/* Memory zones - DMA blocks never merge across the 16MB boundary */
+#define PAGE_ZONE_DMA                 0
+#define PAGE_ZONE_NORMAL              1
+#define PAGE_ZONE_COUNT               2
 
 /* ========================================================================
  * PAGE FRAME TRACKING STRUCTURES
  * ======================================================================== */
 
-/* Physical page frame descriptor */
+/* Physical page frame descriptor (12 bytes) */
 typedef struct page_frame {
-    uint32_t ref_count;           /* Reference count for sharing */
+    union {
+        struct {
+            uint32_t next_free;   /* Next free block of same order */
+            uint32_t prev_free;   /* Previous free block of same order */
+        };
+        uint32_t table_entries;   /* Present entries (PAGE_FRAME_PAGE_TABLE only) */
+    };
+    uint16_t ref_count;           /* Reference count for sharing */
     uint8_t state;                /* Page frame state */
-    uint8_t flags;                /* Page frame flags */
-    uint16_t order;               /* Buddy allocator order (for multi-page blocks) */
-    uint32_t next_free;           /* Next free page frame (for free lists) */
+    uint8_t order;                /* Buddy order of the block this frame heads */
 } page_frame_t;
 
+/* One populated 128MB section of the frame map */
+typedef struct page_section {
+    uint64_t start_pfn;           /* First frame number covered */
+    page_frame_t *frames;         /* PAGE_SECTION_FRAMES descriptors */
+    uint32_t initialized;         /* Descriptors valid and free frames released */
+} page_section_t;
+
 /* Physical memory region information */
 typedef struct phys_region {
     uint64_t start_addr;          /* Start physical address */
     uint64_t size;                /* Size in bytes */
-    uint32_t start_frame;         /* First page frame number */
-    uint32_t num_frames;          /* Number of page frames */
+    uint64_t start_pfn;           /* First page frame number */
+    uint64_t num_frames;          /* Number of page frames */
     uint8_t type;                 /* Memory type (from EFI) */
     uint8_t available;            /* Available for allocation */
 } phys_region_t;
 
+/* Free blocks of a single order */
+typedef struct page_free_area {
+    uint32_t head;                /* First free block head frame */
+    uint32_t count;               /* Number of free blocks */
+} page_free_area_t;
+
+/* Buddy zone - free areas for one physical address range */
+typedef struct page_zone {
+    page_free_area_t free_areas[PAGE_ALLOC_MAX_ORDER + 1];  /* Free lists per order */
+    uint32_t free_frames;         /* Free frames in zone */
+} page_zone_t;
+
 /* Page frame allocator state */
 typedef struct page_allocator {
-    page_frame_t *frames;         /* Array of page frame descriptors */
-    uint32_t total_frames;        /* Total number of page frames */
+    page_section_t sections[MAX_PAGE_SECTIONS];  /* Populated sections, by start pfn */
+    uint32_t section_count;       /* Number of populated sections */
+    uint16_t *section_root[PAGE_SECTION_ROOT_ENTRIES];  /* Leaf tables: slot + 1, 0 = hole */
+    uint32_t leaf_count;          /* Leaf tables needed by the plan */
+    uint32_t total_frames;        /* Frames covered by populated sections */
+    uint32_t next_deferred;       /* Lowest slot not yet initialized */
+    uint32_t deferred_sections;   /* Sections still awaiting initialization */
+    uint64_t boot_init_cycles;    /* TSC cycles spent initializing at boot */
+    uint64_t deferred_init_cycles;  /* TSC cycles spent on deferred sections */
     uint32_t free_frames;         /* Number of free page frames */
     uint32_t allocated_frames;    /* Number of allocated page frames */
     uint32_t reserved_frames;     /* Number of reserved page frames */
     phys_region_t regions[MAX_MEMORY_REGIONS];  /* Physical memory regions */
     uint32_t num_regions;         /* Number of memory regions */
-    uint32_t free_list_head;      /* Head of free page list */
+    page_zone_t zones[PAGE_ZONE_COUNT];         /* Buddy zones */
 } page_allocator_t;
 
+/* Pool of order-0 frames zeroed ahead of ALLOC_FLAG_ZERO requests */
+typedef struct page_zero_pool {
+    uint64_t frames[PAGE_ZERO_POOL_CAPACITY];  /* Physical addresses, already zeroed */
+    uint32_t count;               /* Frames currently pooled */
+    uint64_t hits;                /* Zeroed requests served from the pool */
+    uint64_t misses;              /* Zeroed requests that zeroed synchronously */
+} page_zero_pool_t;
+
 /* Global page allocator instance */
 static page_allocator_t page_allocator = {0};
+static page_zero_pool_t zero_pool = {0};
 
 /* ========================================================================
  * UTILITY FUNCTIONS
  * ======================================================================== */
 
 /*
- * Convert physical address to page frame number
+ * Convert physical address to compact frame index
+ * Returns INVALID_PAGE_FRAME if the address lies in an unpopulated section
  */
 static inline uint32_t phys_to_frame(uint64_t phys_addr) {
-    return (uint32_t)(phys_addr >> 12);  /* Divide by 4KB */
+    uint64_t pfn = phys_addr >> 12;
+    uint64_t section_nr = pfn >> PAGE_SECTION_SHIFT;
+
+    if (section_nr >= ((uint64_t)1 << PAGE_SECTION_BITS)) {
+        return INVALID_PAGE_FRAME;
+    }
+
+    const uint16_t *leaf = page_allocator.section_root[section_nr >> PAGE_SECTION_LEAF_SHIFT];
+    if (!leaf) {
+        return INVALID_PAGE_FRAME;
+    }
+
+    uint16_t slot = leaf[section_nr & (PAGE_SECTION_LEAF_ENTRIES - 1)];
+    if (slot == 0) {
+        return INVALID_PAGE_FRAME;
+    }
+
+    return ((uint32_t)(slot - 1) << PAGE_SECTION_SHIFT) | (uint32_t)(pfn & PAGE_SECTION_FRAME_MASK);
 }
 
 /*
- * Convert page frame number to physical address
+ * Convert compact frame index to physical address
  */
 static inline uint64_t frame_to_phys(uint32_t frame_num) {
-    return (uint64_t)frame_num << 12;  /* Multiply by 4KB */
+    const page_section_t *section = &page_allocator.sections[frame_num >> PAGE_SECTION_SHIFT];
+    return (section->start_pfn + (frame_num & PAGE_SECTION_FRAME_MASK)) << 12;
 }
 
 /*
- * Check if a page frame number is valid
+ * Check if a compact frame index is valid
  */
 static inline int is_valid_frame(uint32_t frame_num) {
-    return frame_num < page_allocator.total_frames;
+    return frame_num != INVALID_PAGE_FRAME &&
+           (frame_num >> PAGE_SECTION_SHIFT) < page_allocator.section_count &&
+           page_allocator.sections[frame_num >> PAGE_SECTION_SHIFT].initialized;
 }
 
 /*
- * Get page frame descriptor for frame number
+ * Get page frame descriptor for frame index
  */
 static inline page_frame_t *get_frame_desc(uint32_t frame_num) {
     if (!is_valid_frame(frame_num)) {
         return NULL;
     }
-    return &page_allocator.frames[frame_num];
+    return &page_allocator.sections[frame_num >> PAGE_SECTION_SHIFT]
+                .frames[frame_num & PAGE_SECTION_FRAME_MASK];
+}
+
+/*
+ * Get zone index that owns a frame
+ */
+static inline uint32_t frame_zone_index(uint32_t frame_num) {
+    return (frame_to_phys(frame_num) >> 12) < DMA_FRAME_LIMIT ? PAGE_ZONE_DMA : PAGE_ZONE_NORMAL;
 }
 
 /* Forward declarations for helpers used before definition */
-static void add_to_free_list(uint32_t frame_num);
 #if defined(PAGE_ALLOC_DEBUG)
 static void page_alloc_debug_self_test(void);
-static uint64_t alloc_page_frames(uint32_t count, uint32_t flags);
 #endif
-static int frame_satisfies_flags(uint32_t frame_num, uint32_t flags);
-static int unlink_frame_from_free_list(uint32_t frame_num);
-static void rollback_contiguous_allocation(uint32_t start_frame, uint32_t count);
-static int find_contiguous_frames(uint32_t count, uint32_t flags, uint32_t *start_frame_out);
 
 /* ========================================================================
  * DEBUG LOGGING HELPERS
@@ -143,6 +229,9 @@ static void page_alloc_log_contiguous(uint64_t phys_addr, uint32_t count) {
  * ======================================================================== */
 
 static uint8_t page_state_for_flags(uint32_t flags) {
+    if (flags & ALLOC_FLAG_PAGE_TABLE) {
+        return PAGE_FRAME_PAGE_TABLE;
+    }
     if (flags & ALLOC_FLAG_DMA) {
         return PAGE_FRAME_DMA;
     }
@@ -152,138 +241,22 @@ static uint8_t page_state_for_flags(uint32_t flags) {
     return PAGE_FRAME_ALLOCATED;
 }
 
-static int frame_satisfies_flags(uint32_t frame_num, uint32_t flags) {
-    page_frame_t *frame = get_frame_desc(frame_num);
-    if (!frame || frame->state != PAGE_FRAME_FREE) {
-        return 0;
-    }
-
-    if (flags & ALLOC_FLAG_DMA) {
-        uint64_t phys_addr = frame_to_phys(frame_num);
-        if (phys_addr >= DMA_MEMORY_LIMIT) {
-            return 0;
-        }
-    }
-
-    return 1;
-}
-
 static int frame_state_is_allocated(uint8_t state) {
     return state == PAGE_FRAME_ALLOCATED ||
            state == PAGE_FRAME_KERNEL ||
-           state == PAGE_FRAME_DMA;
-}
-
-static int unlink_frame_from_free_list(uint32_t frame_num) {
-    if (!is_valid_frame(frame_num)) {
-        return -1;
-    }
-
-    uint32_t current = page_allocator.free_list_head;
-    uint32_t previous = INVALID_PAGE_FRAME;
-
-    while (current != INVALID_PAGE_FRAME) {
-        if (current == frame_num) {
-            page_frame_t *frame = get_frame_desc(frame_num);
-
-            if (previous == INVALID_PAGE_FRAME) {
-                page_allocator.free_list_head = frame->next_free;
-            } else {
-                page_frame_t *prev_frame = get_frame_desc(previous);
-                if (prev_frame) {
-                    prev_frame->next_free = frame->next_free;
-                }
-            }
-
-            frame->next_free = INVALID_PAGE_FRAME;
-            frame->state = PAGE_FRAME_ALLOCATED;
-            frame->ref_count = 0;
-
-            if (page_allocator.free_frames > 0) {
-                page_allocator.free_frames--;
-            }
-            page_allocator.allocated_frames++;
-
-            return 0;
-        }
-
-        previous = current;
-        page_frame_t *current_frame = get_frame_desc(current);
-        if (!current_frame) {
-            break;
-        }
-        current = current_frame->next_free;
-    }
-
-    return -1;
-}
-
-static void rollback_contiguous_allocation(uint32_t start_frame, uint32_t count) {
-    for (uint32_t i = 0; i < count; i++) {
-        uint32_t frame_num = start_frame + i;
-        if (!is_valid_frame(frame_num)) {
-            continue;
-        }
-
-        page_frame_t *frame = get_frame_desc(frame_num);
-        if (!frame) {
-            continue;
-        }
-
-        frame->ref_count = 0;
-        frame->flags = 0;
-        frame->order = 0;
-
-        if (page_allocator.allocated_frames > 0) {
-            page_allocator.allocated_frames--;
-        }
-
-        add_to_free_list(frame_num);
-    }
+           state == PAGE_FRAME_DMA ||
+           state == PAGE_FRAME_PAGE_TABLE;
 }
 
-static int find_contiguous_frames(uint32_t count, uint32_t flags, uint32_t *start_frame_out) {
-    if (!start_frame_out || count == 0) {
-        return -1;
-    }
-
-    uint32_t consecutive = 0;
-    uint32_t candidate_start = 0;
-
-    for (uint32_t frame_num = 0; frame_num < page_allocator.total_frames; frame_num++) {
-        page_frame_t *frame = get_frame_desc(frame_num);
-        if (!frame) {
-            consecutive = 0;
-            continue;
-        }
-
-        if (frame->state == PAGE_FRAME_RESERVED) {
-            consecutive = 0;
-            continue;
-        }
-
-        if (frame_state_is_allocated(frame->state)) {
-            consecutive = 0;
-            continue;
-        }
-
-        if (frame_satisfies_flags(frame_num, flags)) {
-            if (consecutive == 0) {
-                candidate_start = frame_num;
-            }
-
-            consecutive++;
-
-            if (consecutive == count) {
-                *start_frame_out = candidate_start;
-                return 0;
-            }
-        } else {
-            consecutive = 0;
-        }
+/*
+ * Smallest order whose block holds count pages
+ */
+static uint32_t order_for_count(uint32_t count) {
+    uint32_t order = 0;
+    while ((1U << order) < count) {
+        order++;
     }
-
-    return -1;
+    return order;
 }
 
 #ifdef PAGE_ALLOC_DEBUG
@@ -304,20 +277,8 @@ static void page_alloc_debug_self_test(void) {
             continue;
         }
 
-        uint32_t first_frame = phys_to_frame(phys_base);
-        int contiguous_ok = 1;
-
-        for (uint32_t page = 0; page < count; page++) {
-            uint64_t expected = frame_to_phys(first_frame + page);
-            uint64_t actual = phys_base + ((uint64_t)page << 12);
-            if (actual != expected) {
-                contiguous_ok = 0;
-                break;
-            }
-        }
-
-        if (!contiguous_ok) {
-            kprint("[page_alloc] Contiguity check failed for ");
+        if (phys_base & (((uint64_t)1 << (12 + order_for_count(count))) - 1)) {
+            kprint("[page_alloc] Alignment check failed for ");
             kprint_decimal(count);
             kprintln(" pages");
         }
@@ -338,164 +299,326 @@ static void page_alloc_debug_self_test(void) {
 
 
 /* ========================================================================
- * FREE LIST MANAGEMENT
+ * BUDDY FREE AREA MANAGEMENT
  * ======================================================================== */
 
 /*
- * Add page frame to free list
+ * Insert a free block headed by frame_num into its zone's free area
  */
-static void add_to_free_list(uint32_t frame_num) {
-    if (!is_valid_frame(frame_num)) {
-        boot_log_info("add_to_free_list: Invalid frame number");
-        return;
-    }
-
+static void free_area_add(uint32_t frame_num, uint32_t order) {
     page_frame_t *frame = get_frame_desc(frame_num);
-    frame->next_free = page_allocator.free_list_head;
-    page_allocator.free_list_head = frame_num;
+    page_zone_t *zone = &page_allocator.zones[frame_zone_index(frame_num)];
+    page_free_area_t *area = &zone->free_areas[order];
+
     frame->state = PAGE_FRAME_FREE;
-    frame->flags = 0;
-    frame->order = 0;
+    frame->order = (uint8_t)order;
     frame->ref_count = 0;
-    page_allocator.free_frames++;
+    frame->prev_free = INVALID_PAGE_FRAME;
+    frame->next_free = area->head;
+
+    if (area->head != INVALID_PAGE_FRAME) {
+        get_frame_desc(area->head)->prev_free = frame_num;
+    }
+
+    area->head = frame_num;
+    area->count++;
+
+    zone->free_frames += 1U << order;
+    page_allocator.free_frames += 1U << order;
 }
 
 /*
- * Remove page frame from free list
- * Returns frame number, or INVALID_PAGE_FRAME if list is empty
+ * Detach a free block from its free area; the head becomes a tail frame
+ * until the caller gives it a new state
  */
-static uint32_t remove_from_free_list(void) {
-    if (page_allocator.free_list_head == INVALID_PAGE_FRAME) {
-        return INVALID_PAGE_FRAME;
+static void free_area_remove(uint32_t frame_num, uint32_t order) {
+    page_frame_t *frame = get_frame_desc(frame_num);
+    page_zone_t *zone = &page_allocator.zones[frame_zone_index(frame_num)];
+    page_free_area_t *area = &zone->free_areas[order];
+
+    if (frame->prev_free != INVALID_PAGE_FRAME) {
+        get_frame_desc(frame->prev_free)->next_free = frame->next_free;
+    } else {
+        area->head = frame->next_free;
     }
 
-    uint32_t frame_num = page_allocator.free_list_head;
-    page_frame_t *frame = get_frame_desc(frame_num);
+    if (frame->next_free != INVALID_PAGE_FRAME) {
+        get_frame_desc(frame->next_free)->prev_free = frame->prev_free;
+    }
 
-    page_allocator.free_list_head = frame->next_free;
     frame->next_free = INVALID_PAGE_FRAME;
-    frame->state = PAGE_FRAME_ALLOCATED;
-    frame->ref_count = 0;
-    page_allocator.free_frames--;
-    page_allocator.allocated_frames++;
+    frame->prev_free = INVALID_PAGE_FRAME;
+    frame->state = PAGE_FRAME_TAIL;
+
+    area->count--;
+    zone->free_frames -= 1U << order;
+    page_allocator.free_frames -= 1U << order;
+}
+
+/*
+ * Take a block of the requested order from a zone, splitting larger blocks
+ * Returns head frame, or INVALID_PAGE_FRAME if the zone cannot satisfy it
+ */
+static uint32_t zone_alloc_block(page_zone_t *zone, uint32_t order) {
+    uint32_t current_order = order;
+    while (current_order <= PAGE_ALLOC_MAX_ORDER &&
+           zone->free_areas[current_order].head == INVALID_PAGE_FRAME) {
+        current_order++;
+    }
+
+    if (current_order > PAGE_ALLOC_MAX_ORDER) {
+        return INVALID_PAGE_FRAME;
+    }
+
+    uint32_t frame_num = zone->free_areas[current_order].head;
+    free_area_remove(frame_num, current_order);
+
+    /* Return upper halves to the free areas until the block fits */
+    while (current_order > order) {
+        current_order--;
+        free_area_add(frame_num + (1U << current_order), current_order);
+    }
 
     return frame_num;
 }
 
+/*
+ * Return a block to the free areas, merging with free buddies
+ */
+static void release_block(uint32_t frame_num, uint32_t order) {
+    uint32_t zone_index = frame_zone_index(frame_num);
+
+    while (order < PAGE_ALLOC_MAX_ORDER) {
+        uint32_t buddy_num = frame_num ^ (1U << order);
+        page_frame_t *buddy = get_frame_desc(buddy_num);
+
+        if (!buddy || buddy->state != PAGE_FRAME_FREE || buddy->order != order ||
+            frame_zone_index(buddy_num) != zone_index) {
+            break;
+        }
+
+        free_area_remove(buddy_num, order);
+        get_frame_desc(frame_num)->state = PAGE_FRAME_TAIL;
+
+        if (buddy_num < frame_num) {
+            frame_num = buddy_num;
+        }
+        order++;
+    }
+
+    free_area_add(frame_num, order);
+}
+
 /* ========================================================================
  * PAGE FRAME ALLOCATION AND DEALLOCATION
  * ======================================================================== */
 
 /*
- * Allocate a single physical page frame
- * Returns physical address of allocated page, 0 on failure
+ * Pick a zone for the request and take a block from it
+ * Normal memory is preferred so the DMA zone stays available for devices
  */
-uint64_t alloc_page_frame(uint32_t flags) {
-    uint32_t frame_num = remove_from_free_list();
+static uint32_t alloc_block_from_zones(uint32_t order, uint32_t flags) {
+    uint32_t frame_num = INVALID_PAGE_FRAME;
 
+    if (!(flags & ALLOC_FLAG_DMA)) {
+        frame_num = zone_alloc_block(&page_allocator.zones[PAGE_ZONE_NORMAL], order);
+    }
     if (frame_num == INVALID_PAGE_FRAME) {
-        boot_log_info("alloc_page_frame: No free pages available");
+        frame_num = zone_alloc_block(&page_allocator.zones[PAGE_ZONE_DMA], order);
+    }
+
+    return frame_num;
+}
+
+/*
+ * Return every pooled zero frame to the buddy free lists
+ */
+static void zero_pool_drain(void) {
+    while (zero_pool.count > 0) {
+        free_page_frame(zero_pool.frames[--zero_pool.count]);
+    }
+}
+
+/*
+ * Allocate a naturally aligned block of 2^order physical pages
+ * Returns physical address of first page, 0 on failure
+ */
+uint64_t alloc_pages(uint32_t order, uint32_t flags) {
+    if (order > PAGE_ALLOC_MAX_ORDER) {
+        boot_log_info("alloc_pages: Order too large");
+        return 0;
+    }
+
+    uint64_t irq_flags = cpu_irq_save();
+    uint32_t frame_num = alloc_block_from_zones(order, flags);
+
+    /* Bring deferred sections online before falling back further */
+    while (frame_num == INVALID_PAGE_FRAME && page_alloc_init_deferred(1) > 0) {
+        frame_num = alloc_block_from_zones(order, flags);
+    }
+
+    /* Pooled zero frames are a cache - give them back before failing */
+    if (frame_num == INVALID_PAGE_FRAME && zero_pool.count > 0) {
+        zero_pool_drain();
+        frame_num = alloc_block_from_zones(order, flags);
+    }
+
+    if (frame_num == INVALID_PAGE_FRAME) {
+        cpu_irq_restore(irq_flags);
+        boot_log_info("alloc_pages: No free block available");
         return 0;
     }
 
     page_frame_t *frame = get_frame_desc(frame_num);
     frame->ref_count = 1;
-    frame->flags = flags;
-    frame->order = 0;  /* Single page */
+    frame->order = (uint8_t)order;
     frame->state = page_state_for_flags(flags);
+    if (frame->state == PAGE_FRAME_PAGE_TABLE) {
+        frame->table_entries = 0;
+    }
+    page_allocator.allocated_frames += 1U << order;
+    cpu_irq_restore(irq_flags);
 
     uint64_t phys_addr = frame_to_phys(frame_num);
 
-    /* Zero page if requested */
+    /* Zero pages if requested */
     if (flags & ALLOC_FLAG_ZERO) {
-        if (mm_zero_physical_page(phys_addr) != 0) {
-            frame->ref_count = 0;
-            frame->flags = 0;
-            frame->order = 0;
-            add_to_free_list(frame_num);
-            if (page_allocator.allocated_frames > 0) {
-                page_allocator.allocated_frames--;
+        for (uint32_t i = 0; i < (1U << order); i++) {
+            if (mm_zero_physical_page(phys_addr + ((uint64_t)i << 12)) != 0) {
+                free_page_frame(phys_addr);
+                return 0;
             }
-            return 0;
         }
     }
 
     return phys_addr;
 }
 
-#if defined(PAGE_ALLOC_DEBUG)
 /*
- * Allocate multiple contiguous physical page frames
- * Returns physical address of first page, 0 on failure
+ * Allocate a single physical page frame
+ * Returns physical address of allocated page, 0 on failure
  */
-static uint64_t alloc_page_frames(uint32_t count, uint32_t flags) {
-    if (count == 0) {
-        return 0;
+uint64_t alloc_page_frame(uint32_t flags) {
+    if ((flags & ALLOC_FLAG_ZERO) && !(flags & ALLOC_FLAG_DMA)) {
+        uint64_t irq_flags = cpu_irq_save();
+        if (zero_pool.count > 0) {
+            uint64_t phys_addr = zero_pool.frames[--zero_pool.count];
+            page_frame_t *frame = get_frame_desc(phys_to_frame(phys_addr));
+            frame->state = page_state_for_flags(flags);
+            if (frame->state == PAGE_FRAME_PAGE_TABLE) {
+                frame->table_entries = 0;
+            }
+            zero_pool.hits++;
+            cpu_irq_restore(irq_flags);
+            return phys_addr;
+        }
+        zero_pool.misses++;
+        cpu_irq_restore(irq_flags);
     }
 
-    if (count == 1) {
-        return alloc_page_frame(flags);
-    }
+    return alloc_pages(0, flags);
+}
 
-    uint32_t start_frame = 0;
-    if (find_contiguous_frames(count, flags, &start_frame) != 0) {
-        boot_log_info("alloc_page_frames: Unable to satisfy contiguous allocation");
-        return 0;
-    }
+/*
+ * Zero up to max_pages free frames into the pre-zeroed pool
+ * Intended for the idle task; stops early once the pool is full or free
+ * memory drops to the reserve. The idle task can be preempted by tasks
+ * that allocate, so only the zeroing runs with interrupts enabled.
+ * Returns number of frames added.
+ */
+uint32_t page_alloc_refill_zero_pool(uint32_t max_pages) {
+    uint32_t added = 0;
+
+    while (added < max_pages) {
+        uint64_t irq_flags = cpu_irq_save();
+        if (zero_pool.count >= PAGE_ZERO_POOL_CAPACITY ||
+            page_allocator.free_frames <= PAGE_ZERO_POOL_RESERVE) {
+            cpu_irq_restore(irq_flags);
+            break;
+        }
 
-    uint32_t frames_removed = 0;
-    for (uint32_t i = 0; i < count; i++) {
-        uint32_t frame_num = start_frame + i;
+        uint32_t frame_num = zone_alloc_block(&page_allocator.zones[PAGE_ZONE_NORMAL], 0);
+        if (frame_num == INVALID_PAGE_FRAME) {
+            cpu_irq_restore(irq_flags);
+            break;
+        }
+
+        page_frame_t *frame = get_frame_desc(frame_num);
+        frame->ref_count = 1;
+        frame->order = 0;
+        frame->state = PAGE_FRAME_ALLOCATED;
+        page_allocator.allocated_frames++;
+        cpu_irq_restore(irq_flags);
 
-        if (!frame_satisfies_flags(frame_num, flags)) {
+        uint64_t phys_addr = frame_to_phys(frame_num);
+        if (mm_zero_physical_page(phys_addr) != 0) {
+            free_page_frame(phys_addr);
             break;
         }
 
-        if (unlink_frame_from_free_list(frame_num) != 0) {
+        /* The pool may have been topped up meanwhile; hand back the extra */
+        irq_flags = cpu_irq_save();
+        if (zero_pool.count >= PAGE_ZERO_POOL_CAPACITY) {
+            cpu_irq_restore(irq_flags);
+            free_page_frame(phys_addr);
             break;
         }
+        zero_pool.frames[zero_pool.count++] = phys_addr;
+        cpu_irq_restore(irq_flags);
+        added++;
+    }
 
-        frames_removed++;
+    return added;
+}
+
+/*
+ * Allocate multiple contiguous physical page frames
+ * The backing buddy block is split into independent frames so each page
+ * can be freed on its own; pages past count go straight back.
+ * Returns physical address of first page, 0 on failure
+ */
+uint64_t alloc_page_frames(uint32_t count, uint32_t flags) {
+    if (count == 0) {
+        return 0;
     }
 
-    if (frames_removed != count) {
-        rollback_contiguous_allocation(start_frame, frames_removed);
-        boot_log_info("alloc_page_frames: Failed to unlink frames from free list");
+    uint32_t order = order_for_count(count);
+    if (order > PAGE_ALLOC_MAX_ORDER) {
+        boot_log_info("alloc_page_frames: Unable to satisfy contiguous allocation");
         return 0;
     }
 
-    if (flags & ALLOC_FLAG_ZERO) {
-        for (uint32_t i = 0; i < count; i++) {
-            uint64_t phys_addr = frame_to_phys(start_frame + i);
-            if (mm_zero_physical_page(phys_addr) != 0) {
-                rollback_contiguous_allocation(start_frame, count);
-                boot_log_info("alloc_page_frames: Zeroing contiguous pages failed");
-                return 0;
-            }
-        }
+    uint64_t start_phys = alloc_pages(order, flags & ~ALLOC_FLAG_ZERO);
+    if (!start_phys) {
+        return 0;
     }
 
-    for (uint32_t i = 0; i < count; i++) {
-        uint32_t frame_num = start_frame + i;
-        page_frame_t *frame = get_frame_desc(frame_num);
-        if (!frame) {
-            continue;
-        }
+    uint32_t start_frame = phys_to_frame(start_phys);
+    uint8_t state = page_state_for_flags(flags);
 
+    for (uint32_t i = 0; i < (1U << order); i++) {
+        page_frame_t *frame = get_frame_desc(start_frame + i);
         frame->ref_count = 1;
-        frame->flags = flags;
         frame->order = 0;
-        frame->state = page_state_for_flags(flags);
+        frame->state = state;
+    }
+
+    for (uint32_t i = count; i < (1U << order); i++) {
+        free_page_frame(frame_to_phys(start_frame + i));
+    }
+
+    if (flags & ALLOC_FLAG_ZERO) {
+        for (uint32_t i = 0; i < count; i++) {
+            mm_zero_physical_page(frame_to_phys(start_frame + i));
+        }
     }
 
-    uint64_t start_phys = frame_to_phys(start_frame);
     page_alloc_log_contiguous(start_phys, count);
     return start_phys;
 }
-#endif /* PAGE_ALLOC_DEBUG */
 
 /*
- * Free a physical page frame
+ * Free a physical page frame (or the whole block it heads)
  * Returns 0 on success, -1 on failure
  */
 int free_page_frame(uint64_t phys_addr) {
@@ -507,8 +630,10 @@ int free_page_frame(uint64_t phys_addr) {
     }
 
     page_frame_t *frame = get_frame_desc(frame_num);
+    uint64_t irq_flags = cpu_irq_save();
 
     if (!frame_state_is_allocated(frame->state)) {
+        cpu_irq_restore(irq_flags);
         boot_log_info("free_page_frame: Page not allocated");
         return -1;
     }
@@ -516,19 +641,20 @@ int free_page_frame(uint64_t phys_addr) {
     if (frame->ref_count > 1) {
         /* Decrease reference count but don't free yet */
         frame->ref_count--;
+        cpu_irq_restore(irq_flags);
         return 0;
     }
 
-    /* Free the page frame */
+    /* Free the block */
+    uint32_t order = frame->order;
     frame->ref_count = 0;
-    frame->flags = 0;
-    frame->order = 0;
 
-    add_to_free_list(frame_num);
-    if (page_allocator.allocated_frames > 0) {
-        page_allocator.allocated_frames--;
+    if (page_allocator.allocated_frames >= (1U << order)) {
+        page_allocator.allocated_frames -= 1U << order;
     }
 
+    release_block(frame_num, order);
+    cpu_irq_restore(irq_flags);
     return 0;
 }
 
@@ -545,16 +671,138 @@ int ref_page_frame(uint64_t phys_addr) {
     }
 
     page_frame_t *frame = get_frame_desc(frame_num);
+    uint64_t irq_flags = cpu_irq_save();
 
     if (!frame_state_is_allocated(frame->state)) {
+        cpu_irq_restore(irq_flags);
         boot_log_info("ref_page_frame: Page not allocated");
         return -1;
     }
 
+    if (frame->ref_count == UINT16_MAX) {
+        cpu_irq_restore(irq_flags);
+        boot_log_info("ref_page_frame: Reference count overflow");
+        return -1;
+    }
+
     frame->ref_count++;
+    cpu_irq_restore(irq_flags);
+    return 0;
+}
+
+/*
+ * Get the reference count of an allocated page frame
+ * Returns 0 for free or invalid frames
+ */
+uint32_t page_frame_ref_count(uint64_t phys_addr) {
+    uint32_t frame_num = phys_to_frame(phys_addr);
+
+    if (!is_valid_frame(frame_num)) {
+        return 0;
+    }
+
+    page_frame_t *frame = get_frame_desc(frame_num);
+    if (!frame_state_is_allocated(frame->state)) {
+        return 0;
+    }
+
+    return frame->ref_count;
+}
+
+/*
+ * Adjust the present-entry count of a paging structure frame
+ * The count shares storage with the free-list links, which allocated
+ * frames do not use. Returns the new count, or -1 if the frame was not
+ * allocated with ALLOC_FLAG_PAGE_TABLE (delta 0 just reads the count)
+ */
+int32_t page_table_entries_add(uint64_t phys_addr, int32_t delta) {
+    uint32_t frame_num = phys_to_frame(phys_addr);
+
+    if (!is_valid_frame(frame_num)) {
+        return -1;
+    }
+
+    page_frame_t *frame = get_frame_desc(frame_num);
+    if (frame->state != PAGE_FRAME_PAGE_TABLE) {
+        return -1;
+    }
+
+    frame->table_entries = (uint32_t)((int32_t)frame->table_entries + delta);
+    return (int32_t)frame->table_entries;
+}
+
+/* ========================================================================
+ * SPARSE FRAME MAP PLANNING
+ * ======================================================================== */
+
+/*
+ * Record that [start_addr, start_addr + size) holds usable memory
+ * Must be called for every usable range before the metadata buffer is
+ * sized; each touched 128MB section gets descriptors at init time.
+ */
+int page_allocator_plan_range(uint64_t start_addr, uint64_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    uint64_t first_section = (start_addr >> 12) >> PAGE_SECTION_SHIFT;
+    uint64_t last_section = ((start_addr + size - 1) >> 12) >> PAGE_SECTION_SHIFT;
+
+    if (last_section >= ((uint64_t)1 << PAGE_SECTION_BITS)) {
+        boot_log_info("page_allocator_plan_range: Range beyond physical address width");
+        return -1;
+    }
+
+    for (uint64_t section_nr = first_section; section_nr <= last_section; section_nr++) {
+        uint64_t start_pfn = section_nr << PAGE_SECTION_SHIFT;
+
+        /* Keep sections sorted so slot order follows physical order */
+        uint32_t slot = 0;
+        while (slot < page_allocator.section_count &&
+               page_allocator.sections[slot].start_pfn < start_pfn) {
+            slot++;
+        }
+        if (slot < page_allocator.section_count &&
+            page_allocator.sections[slot].start_pfn == start_pfn) {
+            continue;
+        }
+
+        if (page_allocator.section_count >= MAX_PAGE_SECTIONS) {
+            boot_log_info("page_allocator_plan_range: Too many populated sections");
+            return -1;
+        }
+
+        for (uint32_t i = page_allocator.section_count; i > slot; i--) {
+            page_allocator.sections[i] = page_allocator.sections[i - 1];
+        }
+        page_allocator.sections[slot].start_pfn = start_pfn;
+        page_allocator.sections[slot].frames = NULL;
+        page_allocator.section_count++;
+    }
+
     return 0;
 }
 
+/*
+ * Bytes of descriptor metadata the planned sections require
+ */
+size_t page_allocator_metadata_bytes(void) {
+    uint32_t leaves = 0;
+    uint64_t last_root = (uint64_t)-1;
+
+    for (uint32_t i = 0; i < page_allocator.section_count; i++) {
+        uint64_t root = (page_allocator.sections[i].start_pfn >> PAGE_SECTION_SHIFT) >>
+                        PAGE_SECTION_LEAF_SHIFT;
+        if (root != last_root) {
+            leaves++;
+            last_root = root;
+        }
+    }
+
+    return (size_t)page_allocator.section_count * PAGE_SECTION_FRAMES * sizeof(page_frame_t) +
+           (size_t)leaves * PAGE_SECTION_LEAF_ENTRIES * sizeof(uint16_t);
+}
+
 /* ========================================================================
  * MEMORY REGION MANAGEMENT
  * ======================================================================== */
@@ -579,13 +827,12 @@ int add_page_alloc_region(uint64_t start_addr, uint64_t size, uint8_t type) {
     }
 
     uint64_t aligned_size = aligned_end - aligned_start;
-    uint32_t start_frame = phys_to_frame(aligned_start);
-    uint32_t num_frames = (uint32_t)(aligned_size >> 12);
+    uint64_t num_frames = aligned_size >> 12;
 
     phys_region_t *region = &page_allocator.regions[page_allocator.num_regions];
     region->start_addr = aligned_start;
     region->size = aligned_size;
-    region->start_frame = start_frame;
+    region->start_pfn = aligned_start >> 12;
     region->num_frames = num_frames;
     region->type = type;
     region->available = (type == EFI_CONVENTIONAL_MEMORY) ? 1 : 0;
@@ -611,53 +858,99 @@ int add_page_alloc_region(uint64_t start_addr, uint64_t size, uint8_t type) {
 
 /*
  * Initialize the physical page frame allocator
- * Must be called after EFI memory map is parsed
+ * Carves the planned sections' descriptors and leaf tables out of the
+ * metadata buffer. Must be called after every usable range is planned.
  */
-int init_page_allocator(void *frame_array, uint32_t max_frames) {
-    page_frame_t *frames = (page_frame_t *)frame_array;
-
-    if (!frames || max_frames == 0) {
+int init_page_allocator(void *metadata, size_t metadata_bytes) {
+    if (!metadata || page_allocator.section_count == 0 ||
+        metadata_bytes < page_allocator_metadata_bytes()) {
         kernel_panic("init_page_allocator: Invalid parameters");
     }
 
     boot_log_debug("Initializing page frame allocator");
 
-    page_allocator.frames = frames;
-    page_allocator.total_frames = max_frames;
     page_allocator.free_frames = 0;
     page_allocator.allocated_frames = 0;
     page_allocator.reserved_frames = 0;
     page_allocator.num_regions = 0;
-    page_allocator.free_list_head = INVALID_PAGE_FRAME;
+    page_allocator.leaf_count = 0;
+    page_allocator.next_deferred = 0;
+    page_allocator.deferred_sections = 0;
+    page_allocator.total_frames = page_allocator.section_count * PAGE_SECTION_FRAMES;
+
+    for (uint32_t z = 0; z < PAGE_ZONE_COUNT; z++) {
+        page_allocator.zones[z].free_frames = 0;
+        for (uint32_t order = 0; order <= PAGE_ALLOC_MAX_ORDER; order++) {
+            page_allocator.zones[z].free_areas[order].head = INVALID_PAGE_FRAME;
+            page_allocator.zones[z].free_areas[order].count = 0;
+        }
+    }
+
+    for (uint32_t r = 0; r < PAGE_SECTION_ROOT_ENTRIES; r++) {
+        page_allocator.section_root[r] = NULL;
+    }
+
+    uint8_t *cursor = (uint8_t *)metadata;
+
+    for (uint32_t slot = 0; slot < page_allocator.section_count; slot++) {
+        page_section_t *section = &page_allocator.sections[slot];
+        uint64_t section_nr = section->start_pfn >> PAGE_SECTION_SHIFT;
+        uint16_t **root = &page_allocator.section_root[section_nr >> PAGE_SECTION_LEAF_SHIFT];
+
+        if (!*root) {
+            uint16_t *leaf = (uint16_t *)cursor;
+            cursor += PAGE_SECTION_LEAF_ENTRIES * sizeof(uint16_t);
+            for (uint32_t i = 0; i < PAGE_SECTION_LEAF_ENTRIES; i++) {
+                leaf[i] = 0;
+            }
+            *root = leaf;
+            page_allocator.leaf_count++;
+        }
+        (*root)[section_nr & (PAGE_SECTION_LEAF_ENTRIES - 1)] = (uint16_t)(slot + 1);
 
-    /* Initialize all frame descriptors */
-    for (uint32_t i = 0; i < max_frames; i++) {
-        frames[i].ref_count = 0;
-        frames[i].state = PAGE_FRAME_RESERVED;
-        frames[i].flags = 0;
-        frames[i].order = 0;
-        frames[i].next_free = INVALID_PAGE_FRAME;
+        /* Descriptors are written when the section is initialized */
+        section->frames = (page_frame_t *)cursor;
+        section->initialized = 0;
+        cursor += PAGE_SECTION_FRAMES * sizeof(page_frame_t);
     }
 
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
         kprint("Page frame allocator initialized with ");
-        kprint_decimal(max_frames);
-        kprint(" frame descriptors\n");
+        kprint_decimal(page_allocator.total_frames);
+        kprint(" frames in ");
+        kprint_decimal(page_allocator.section_count);
+        kprint(" sections\n");
     });
 
     return 0;
 }
 
 /*
- * Finalize page allocator setup after all regions are added
- * Builds free lists from available memory regions
+ * Write a section's descriptors and release the available frames inside it
+ * Regions are clipped to the section, and blocks never straddle sections
+ * because they are pfn-aligned and smaller than a section.
+ * Returns number of frames released.
  */
-int finalize_page_allocator(void) {
-    boot_log_debug("Finalizing page frame allocator");
+static uint32_t page_section_init(uint32_t slot) {
+    page_section_t *section = &page_allocator.sections[slot];
+    if (section->initialized) {
+        return 0;
+    }
 
-    uint32_t total_available = 0;
+    for (uint32_t i = 0; i < PAGE_SECTION_FRAMES; i++) {
+        section->frames[i].ref_count = 0;
+        section->frames[i].state = PAGE_FRAME_RESERVED;
+        section->frames[i].order = 0;
+        section->frames[i].next_free = INVALID_PAGE_FRAME;
+        section->frames[i].prev_free = INVALID_PAGE_FRAME;
+    }
+    section->initialized = 1;
+
+    uint64_t section_start = section->start_pfn;
+    uint64_t section_end = section_start + PAGE_SECTION_FRAMES;
+    uint32_t slot_base = slot << PAGE_SECTION_SHIFT;
+    uint32_t released = 0;
 
-    /* Process all memory regions */
     for (uint32_t i = 0; i < page_allocator.num_regions; i++) {
         phys_region_t *region = &page_allocator.regions[i];
 
@@ -665,21 +958,106 @@ int finalize_page_allocator(void) {
             continue;  /* Skip non-available regions */
         }
 
-        /* Add all frames in this region to free list */
-        for (uint32_t j = 0; j < region->num_frames; j++) {
-            uint32_t frame_num = region->start_frame + j;
+        uint64_t pfn = region->start_pfn;
+        uint64_t end_pfn = region->start_pfn + region->num_frames;
+        if (pfn < section_start) {
+            pfn = section_start;
+        }
+        if (end_pfn > section_end) {
+            end_pfn = section_end;
+        }
 
-            if (is_valid_frame(frame_num)) {
-                add_to_free_list(frame_num);
-                total_available++;
+        while (pfn < end_pfn) {
+            uint32_t order = PAGE_ALLOC_MAX_ORDER;
+            while (order > 0 &&
+                   ((pfn & ((1U << order) - 1)) != 0 ||
+                    pfn + (1U << order) > end_pfn)) {
+                order--;
             }
+
+            uint32_t frame_num = slot_base | (uint32_t)(pfn - section_start);
+            for (uint32_t k = 1; k < (1U << order); k++) {
+                get_frame_desc(frame_num + k)->state = PAGE_FRAME_TAIL;
+            }
+            release_block(frame_num, order);
+
+            pfn += 1U << order;
+            released += 1U << order;
         }
     }
 
+    return released;
+}
+
+/*
+ * Initialize up to max_sections sections left over from boot
+ * Called when the free lists run dry and from the idle task, which can be
+ * preempted by a task that allocates, so each section is brought online
+ * with interrupts disabled. Returns number of sections initialized.
+ */
+uint32_t page_alloc_init_deferred(uint32_t max_sections) {
+    uint32_t done = 0;
+
+    while (done < max_sections) {
+        uint64_t irq_flags = cpu_irq_save();
+        if (page_allocator.deferred_sections == 0) {
+            cpu_irq_restore(irq_flags);
+            break;
+        }
+
+        uint64_t start = cpu_read_tsc();
+
+        while (page_allocator.next_deferred < page_allocator.section_count &&
+               page_allocator.sections[page_allocator.next_deferred].initialized) {
+            page_allocator.next_deferred++;
+        }
+        if (page_allocator.next_deferred >= page_allocator.section_count) {
+            page_allocator.deferred_sections = 0;
+            cpu_irq_restore(irq_flags);
+            break;
+        }
+
+        page_section_init(page_allocator.next_deferred++);
+        page_allocator.deferred_sections--;
+        page_allocator.deferred_init_cycles += cpu_read_tsc() - start;
+        cpu_irq_restore(irq_flags);
+        done++;
+    }
+
+    return done;
+}
+
+/*
+ * Finalize page allocator setup after all regions are added
+ * Only the lowest PAGE_EAGER_SECTIONS sections are initialized now; the
+ * rest come online on demand or from the idle task, keeping boot cost
+ * independent of RAM size.
+ */
+int finalize_page_allocator(void) {
+    boot_log_debug("Finalizing page frame allocator");
+
+    uint64_t start = cpu_read_tsc();
+    uint32_t total_available = 0;
+
+    uint32_t eager = page_allocator.section_count;
+    if (eager > PAGE_EAGER_SECTIONS) {
+        eager = PAGE_EAGER_SECTIONS;
+    }
+
+    for (uint32_t slot = 0; slot < eager; slot++) {
+        total_available += page_section_init(slot);
+    }
+
+    page_allocator.next_deferred = eager;
+    page_allocator.deferred_sections = page_allocator.section_count - eager;
+    page_allocator.boot_init_cycles = cpu_read_tsc() - start;
+
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
         kprint("Page allocator ready: ");
         kprint_decimal(total_available);
-        kprint(" pages available\n");
+        kprint(" pages available, ");
+        kprint_decimal(page_allocator.deferred_sections);
+        kprint(" sections deferred\n");
     });
 
 #ifdef PAGE_ALLOC_DEBUG
@@ -689,6 +1067,16 @@ int finalize_page_allocator(void) {
     return 0;
 }
 
+/*
+ * Get frame map initialization progress
+ */
+void get_page_frame_init_stats(uint32_t *deferred_sections, uint64_t *boot_cycles,
+                               uint64_t *deferred_cycles) {
+    if (deferred_sections) *deferred_sections = page_allocator.deferred_sections;
+    if (boot_cycles) *boot_cycles = page_allocator.boot_init_cycles;
+    if (deferred_cycles) *deferred_cycles = page_allocator.deferred_init_cycles;
+}
+
 /*
  * Get page allocator statistics
  */
@@ -698,10 +1086,34 @@ void get_page_allocator_stats(uint32_t *total, uint32_t *free, uint32_t *allocat
     if (allocated) *allocated = page_allocator.allocated_frames;
 }
 
+/*
+ * Get pre-zeroed pool occupancy and hit/miss counters
+ */
+void get_page_zero_pool_stats(uint32_t *pooled, uint64_t *hits, uint64_t *misses) {
+    if (pooled) *pooled = zero_pool.count;
+    if (hits) *hits = zero_pool.hits;
+    if (misses) *misses = zero_pool.misses;
+}
+
+/*
+ * Count free blocks of one buddy order across all zones
+ */
+uint32_t page_allocator_free_blocks(uint32_t order) {
+    if (order > PAGE_ALLOC_MAX_ORDER) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t z = 0; z < PAGE_ZONE_COUNT; z++) {
+        count += page_allocator.zones[z].free_areas[order].count;
+    }
+    return count;
+}
+
 size_t page_allocator_descriptor_size(void) {
     return sizeof(page_frame_t);
 }
 
-uint32_t page_allocator_max_supported_frames(void) {
-    return MAX_PHYSICAL_PAGES;
+uint32_t page_allocator_section_count(void) {
+    return page_allocator.section_count;
 }
@@ -8,17 +8,42 @@
  * Physical page allocator interface.
  * Provides low-level frame allocation used by paging, kernel heap, and VM subsystems.
  * Keeps the page allocator distinct from higher-level virtual memory mapping code.
+ * Frames are managed as power-of-two buddy blocks up to PAGE_ALLOC_MAX_ORDER.
+ * Descriptors are kept per populated 128MB section, so physical memory may
+ * be sparse and extend across the full 52-bit physical address range.
  */
 
-int init_page_allocator(void *frame_array, uint32_t max_frames);
+/* Largest buddy block order (2^10 pages = 4MB) */
+#define PAGE_ALLOC_MAX_ORDER          10
+
+/* Page frame allocation flags */
+#define ALLOC_FLAG_ZERO               0x01   /* Zero the page after allocation */
+#define ALLOC_FLAG_DMA                0x02   /* Allocate DMA-capable page */
+#define ALLOC_FLAG_KERNEL             0x04   /* Kernel-only allocation */
+#define ALLOC_FLAG_PAGE_TABLE         0x08   /* Paging structure with an occupancy count */
+
+int page_allocator_plan_range(uint64_t start_addr, uint64_t size);
+size_t page_allocator_metadata_bytes(void);
+int init_page_allocator(void *metadata, size_t metadata_bytes);
 int finalize_page_allocator(void);
 int add_page_alloc_region(uint64_t start_addr, uint64_t size, uint8_t type);
 
 uint64_t alloc_page_frame(uint32_t flags);
+uint64_t alloc_pages(uint32_t order, uint32_t flags);
+uint64_t alloc_page_frames(uint32_t count, uint32_t flags);
 int free_page_frame(uint64_t phys_addr);
+int ref_page_frame(uint64_t phys_addr);
+uint32_t page_frame_ref_count(uint64_t phys_addr);
+int32_t page_table_entries_add(uint64_t phys_addr, int32_t delta);
+uint32_t page_alloc_refill_zero_pool(uint32_t max_pages);
+uint32_t page_alloc_init_deferred(uint32_t max_sections);
 
 size_t page_allocator_descriptor_size(void);
-uint32_t page_allocator_max_supported_frames(void);
+uint32_t page_allocator_section_count(void);
+void get_page_frame_init_stats(uint32_t *deferred_sections, uint64_t *boot_cycles,
+                               uint64_t *deferred_cycles);
 void get_page_allocator_stats(uint32_t *total, uint32_t *free, uint32_t *allocated);
+uint32_t page_allocator_free_blocks(uint32_t order);
+void get_page_zero_pool_stats(uint32_t *pooled, uint64_t *hits, uint64_t *misses);
 
 #endif /* MM_PAGE_ALLOC_H */
@@ -12,6 +12,10 @@
 #include "page_alloc.h"
 #include "../boot/limine_protocol.h"
 #include "phys_virt.h"
+#include "../drivers/apic.h"
+#include "../drivers/smp.h"
+#include "../boot/idt.h"
+#include "../lib/spinlock.h"
 
 /* Forward declarations */
 void kernel_panic(const char *message);
@@ -28,6 +32,17 @@ void kernel_panic(const char *message);
 /* Page table entry mask for extracting physical address */
 #define PTE_ADDRESS_MASK              0x000FFFFFFFFFF000ULL
 
+/* Process-context identifiers (CR4.PCIDE) */
+#define CPUID_FEAT_ECX_PCID           (1U << 17)
+#define CR4_PCIDE                     (1ULL << 17)
+#define CR3_PCID_MASK                 0xFFFULL
+#define CR3_NOFLUSH                   (1ULL << 63)  /* Keep TLB entries tagged with the PCID */
+#define PCID_COUNT                    4096
+
+/* Global pages (CR4.PGE) */
+#define CR4_PGE                       (1ULL << 7)
+#define PML4_KERNEL_FIRST_ENTRY       256     /* First higher-half PML4 slot */
+
 /* ========================================================================
  * PAGE TABLE STRUCTURES AND MANAGEMENT
  * ======================================================================== */
@@ -43,12 +58,91 @@ static process_page_dir_t kernel_page_dir = {
     .pml4_phys = 0,  /* Will be set during initialization */
     .ref_count = 1,
     .process_id = 0, /* Kernel process ID */
+    .pcid = 0,       /* PCID 0 is reserved for the kernel page directory */
+    .tlb_generation = { 1 },
     .next = NULL
 };
 
 /* Current active page directory for running process */
 static process_page_dir_t *current_page_dir = &kernel_page_dir;
 
+/*
+ * PCID allocator and TLB generation tracking
+ * Higher-half mappings are shared by every address space. Unless they are
+ * global they are cached per PCID, so tearing one down bumps
+ * kernel_generation; a directory loaded with a stale generation gets a
+ * flushing CR3 write instead of a no-flush one. Each CPU has its own TLB,
+ * so directories record the generation per CPU and each CPU counts its
+ * own loads
+ */
+static struct {
+    int enabled;                          /* CR4.PCIDE is set */
+    int noflush;                          /* Use no-flush CR3 loads when safe */
+    spinlock_t lock;                      /* Guards the PCID bitmap */
+    uint32_t in_use;                      /* PCIDs handed out to process directories */
+    uint64_t bitmap[PCID_COUNT / 64];     /* Allocated PCIDs */
+    uint64_t kernel_generation;           /* Bumped on every shared mapping teardown */
+    uint64_t noflush_loads[SMP_MAX_CPUS]; /* CR3 loads that kept the PCID's TLB entries */
+    uint64_t flush_loads[SMP_MAX_CPUS];   /* CR3 loads that flushed the PCID */
+} pcid_state = {
+    .enabled = 0,
+    .noflush = 1,
+    .lock = SPINLOCK_INIT,
+    .kernel_generation = 1,
+};
+
+/*
+ * Cross-CPU TLB shootdown
+ * Kernel mappings are shared by every CPU, so a teardown on one CPU leaves
+ * stale translations in the others' TLBs. The initiator publishes the
+ * range, interrupts every other CPU that runs kernel code with interrupts
+ * on, and waits until each has flushed it or stopped for good
+ */
+static struct {
+    spinlock_t lock;                      /* One shootdown in flight at a time */
+    uint64_t vaddr;                       /* First page of the published range */
+    uint64_t npages;                      /* Pages in the published range */
+    volatile uint8_t pending[SMP_MAX_CPUS]; /* CPUs that still owe a flush */
+    uint64_t shootdowns;                  /* Teardowns that interrupted other CPUs */
+    uint64_t ipis;                        /* Shootdown IPIs sent */
+} tlb_shootdown = {
+    .lock = SPINLOCK_INIT,
+};
+
+/* Higher-half leaf entries carry PAGE_GLOBAL once CR4.PGE is on */
+static int global_pages_enabled = 0;
+
+/* Paging structures allocated and reclaimed once empty */
+static struct {
+    uint64_t allocated;                   /* PDPT/PD/PT pages allocated */
+    uint64_t reclaimed;                   /* PDPT/PD/PT pages freed again */
+} page_table_stats = {0};
+
+/* Number of ready-made PML4 pages kept for process creation */
+#define PML4_CACHE_SIZE               16
+
+/*
+ * PML4 template cache
+ * Cached pages already hold the kernel directory's entries (the template)
+ * and nothing else. Kernel PML4 slots that change later are pushed into
+ * every cached page, so a pop needs no zeroing or copying
+ */
+static struct {
+    int enabled;                          /* Serve PML4s from the cache */
+    uint32_t count;                       /* Pages currently cached */
+    uint64_t frames[PML4_CACHE_SIZE];     /* Physical addresses of cached PML4s */
+    uint64_t hits;                        /* PML4s served from the cache */
+    uint64_t misses;                      /* PML4s built from scratch */
+} pml4_cache = {
+    .enabled = 1,
+};
+
+/* Copy-on-write fault resolutions */
+static struct {
+    uint64_t copies;                      /* Shared pages copied on write */
+    uint64_t reuses;                      /* Last sharer regained write access */
+} cow_stats = {0};
+
 static inline page_table_t *phys_to_page_table_ptr(uint64_t phys_addr) {
     return (page_table_t *)mm_phys_to_virt(phys_addr);
 }
@@ -60,6 +154,8 @@ static inline page_table_t *phys_to_page_table_ptr(uint64_t phys_addr) {
 /*
  * Copy kernel mappings from the bootstrap PML4 into the destination table.
  * New process address spaces inherit higher-half kernel identity.
+ * The copied PML4 entries share the kernel's lower tables, whose leaf
+ * entries are global, so kernel translations survive process switches.
  */
 void paging_copy_kernel_mappings(page_table_t *dest_pml4) {
     if (!dest_pml4) {
@@ -182,6 +278,293 @@ static inline void set_cr3(uint64_t pml4_phys) {
     __asm__ volatile ("movq %0, %%cr3" :: "r" (pml4_phys) : "memory");
 }
 
+static inline uint64_t get_cr4(void) {
+    uint64_t cr4;
+    __asm__ volatile ("movq %%cr4, %0" : "=r" (cr4));
+    return cr4;
+}
+
+static inline void set_cr4(uint64_t cr4) {
+    __asm__ volatile ("movq %0, %%cr4" :: "r" (cr4) : "memory");
+}
+
+/*
+ * Flush the entire TLB including global entries
+ * Toggling CR4.PGE drops every translation for every PCID, which a CR3
+ * reload cannot do once kernel mappings are global
+ */
+static inline void flush_tlb_global(void) {
+    uint64_t cr4 = get_cr4();
+    set_cr4(cr4 ^ CR4_PGE);
+    set_cr4(cr4);
+}
+
+/*
+ * Extra leaf flags for a mapping at vaddr
+ * Higher-half translations are identical in every address space, so they
+ * are marked global and survive CR3 reloads
+ */
+static inline uint64_t leaf_global_flag(uint64_t vaddr) {
+    return (global_pages_enabled && vaddr >= USER_SPACE_END) ? PAGE_GLOBAL : 0;
+}
+
+static void tlb_shootdown_kernel(uint64_t vaddr, uint64_t npages);
+
+/*
+ * Record that higher-half translations were removed or changed
+ * Called after the local flush. A global leaf is dropped from every PCID
+ * by the invlpg that goes with the change, and kernel paging structures
+ * are never freed. Only without CR4.PGE is the translation cached per
+ * PCID, so other address spaces must then flush their copy the next time
+ * they are loaded. Other CPUs drop the range through a shootdown
+ */
+static inline void note_shared_unmap(uint64_t vaddr, uint64_t npages) {
+    if (vaddr < USER_SPACE_END) {
+        return;
+    }
+    if (!global_pages_enabled) {
+        __atomic_fetch_add(&pcid_state.kernel_generation, 1, __ATOMIC_RELEASE);
+    }
+    tlb_shootdown_kernel(vaddr, npages);
+}
+
+/*
+ * Make the next load of page_dir flush its PCID on every CPU
+ */
+static void page_dir_tlb_stale(process_page_dir_t *page_dir) {
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        page_dir->tlb_generation[cpu] = 0;
+    }
+}
+
+/* ========================================================================
+ * PAGE TABLE OCCUPANCY
+ * ======================================================================== */
+
+/*
+ * User-half tables of process directories are private to that directory
+ * and cached only under its PCID, so they can be freed once empty. Kernel
+ * tables are shared by every PML4 and are never reclaimed
+ */
+static inline int table_reclaimable(uint64_t vaddr) {
+    return current_page_dir != &kernel_page_dir && vaddr < USER_SPACE_END;
+}
+
+/*
+ * Allocate a zeroed paging structure
+ * Reclaimable tables carry a present-entry count in their frame descriptor;
+ * page_table_entries_add() ignores updates to tables without one (PML4s,
+ * kernel tables), so callers can account entries unconditionally
+ */
+static uint64_t alloc_page_table(int reclaimable) {
+    uint64_t phys = alloc_page_frame(ALLOC_FLAG_ZERO | (reclaimable ? ALLOC_FLAG_PAGE_TABLE : 0));
+    if (phys) {
+        page_table_stats.allocated++;
+    }
+    return phys;
+}
+
+static void free_page_table(uint64_t phys) {
+    free_page_frame(phys);
+    page_table_stats.reclaimed++;
+}
+
+/*
+ * Free the table an entry points to if nothing in it is mapped anymore
+ * parent_phys is the table holding the entry. Returns 1 if freed; the
+ * caller flushes the TLB for the covered range afterwards
+ */
+static int reclaim_table_entry(uint64_t *entry, uint64_t parent_phys) {
+    if (!pte_present(*entry) || pte_huge(*entry)) {
+        return 0;
+    }
+
+    uint64_t table_phys = pte_address(*entry);
+    if (page_table_entries_add(table_phys, 0) != 0) {
+        return 0;  /* Still in use, or not a counted table */
+    }
+
+    *entry = 0;
+    page_table_entries_add(parent_phys, -1);
+    free_page_table(table_phys);
+    return 1;
+}
+
+/*
+ * Free every table on the walk to vaddr left empty by an unmap
+ * Works bottom-up and stops at the first table still in use
+ */
+static void reclaim_page_tables(uint64_t vaddr) {
+    if (!table_reclaimable(vaddr)) {
+        return;
+    }
+
+    uint64_t pml4_phys = current_page_dir->pml4_phys;
+    uint64_t *pml4_entry = &current_page_dir->pml4->entries[pml4_index(vaddr)];
+    if (!pte_present(*pml4_entry)) {
+        return;
+    }
+
+    uint64_t pdpt_phys = pte_address(*pml4_entry);
+    page_table_t *pdpt = phys_to_page_table_ptr(pdpt_phys);
+    uint64_t *pdpt_entry = &pdpt->entries[pdpt_index(vaddr)];
+
+    if (pte_present(*pdpt_entry) && !pte_huge(*pdpt_entry)) {
+        uint64_t pd_phys = pte_address(*pdpt_entry);
+        page_table_t *pd = phys_to_page_table_ptr(pd_phys);
+        if (!reclaim_table_entry(&pd->entries[pd_index(vaddr)], pd_phys) &&
+            pte_present(pd->entries[pd_index(vaddr)])) {
+            return;
+        }
+        if (!reclaim_table_entry(pdpt_entry, pdpt_phys) && pte_present(*pdpt_entry)) {
+            return;
+        }
+    }
+
+    reclaim_table_entry(pml4_entry, pml4_phys);
+}
+
+void get_page_table_stats(uint64_t *allocated, uint64_t *reclaimed) {
+    if (allocated) {
+        *allocated = page_table_stats.allocated;
+    }
+    if (reclaimed) {
+        *reclaimed = page_table_stats.reclaimed;
+    }
+}
+
+/* ========================================================================
+ * PML4 TEMPLATE CACHE
+ * ======================================================================== */
+
+/*
+ * Whether a user-half PML4 entry points at a table the kernel directory
+ * also uses (copied in by paging_copy_kernel_mappings). The CPU sets
+ * accessed bits per copy, so table addresses are compared
+ */
+static inline int pml4_slot_shared_with_kernel(uint32_t index, uint64_t entry) {
+    uint64_t kernel_entry = kernel_page_dir.pml4->entries[index];
+    return pte_present(kernel_entry) && pte_address(entry) == pte_address(kernel_entry);
+}
+
+/*
+ * Push a kernel directory PML4 slot into every cached PML4
+ * No-op for changes made to process directories
+ */
+static void pml4_cache_sync_slot(uint32_t index) {
+    if (current_page_dir != &kernel_page_dir) {
+        return;
+    }
+
+    uint64_t entry = kernel_page_dir.pml4->entries[index];
+    for (uint32_t i = 0; i < pml4_cache.count; i++) {
+        phys_to_page_table_ptr(pml4_cache.frames[i])->entries[index] = entry;
+    }
+}
+
+/*
+ * Build a PML4 from scratch: zeroed, then the kernel template copied in
+ */
+static uint64_t pml4_build(void) {
+    uint64_t phys = alloc_page_frame(ALLOC_FLAG_ZERO);
+    if (!phys) {
+        return 0;
+    }
+
+    paging_copy_kernel_mappings(phys_to_page_table_ptr(phys));
+    return phys;
+}
+
+/*
+ * Get a PML4 for a new process directory, holding only kernel mappings
+ * Returns the physical address, 0 on failure
+ */
+uint64_t paging_alloc_pml4(void) {
+    if (pml4_cache.enabled && pml4_cache.count > 0) {
+        pml4_cache.hits++;
+        return pml4_cache.frames[--pml4_cache.count];
+    }
+
+    pml4_cache.misses++;
+    return pml4_build();
+}
+
+/*
+ * Give back the PML4 of a destroyed process directory
+ * Its user mappings must already be released. Pages whose user half still
+ * holds private tables are freed rather than cached
+ */
+void paging_free_pml4(uint64_t pml4_phys) {
+    page_table_t *pml4 = pml4_phys ? phys_to_page_table_ptr(pml4_phys) : NULL;
+    if (!pml4) {
+        return;
+    }
+
+    if (!pml4_cache.enabled || pml4_cache.count >= PML4_CACHE_SIZE) {
+        free_page_frame(pml4_phys);
+        return;
+    }
+
+    for (uint32_t i = 0; i < PML4_KERNEL_FIRST_ENTRY; i++) {
+        uint64_t entry = pml4->entries[i];
+        if (pte_present(entry) && !pml4_slot_shared_with_kernel(i, entry)) {
+            free_page_frame(pml4_phys);
+            return;
+        }
+    }
+
+    /* Reset to the template so accessed bits and stale slots go away */
+    for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
+        pml4->entries[i] = kernel_page_dir.pml4->entries[i];
+    }
+
+    pml4_cache.frames[pml4_cache.count++] = pml4_phys;
+}
+
+/*
+ * Build up to max_pages cached PML4s ahead of process creation
+ * Returns the number of pages added
+ */
+uint32_t paging_refill_pml4_cache(uint32_t max_pages) {
+    uint32_t added = 0;
+
+    while (added < max_pages && pml4_cache.count < PML4_CACHE_SIZE) {
+        uint64_t phys = pml4_build();
+        if (!phys) {
+            break;
+        }
+        pml4_cache.frames[pml4_cache.count++] = phys;
+        added++;
+    }
+
+    return added;
+}
+
+/*
+ * Serve PML4s from the cache or always build them (benchmarks compare both)
+ * Disabling the cache releases the pages it holds
+ */
+void paging_set_pml4_cache(int enable) {
+    pml4_cache.enabled = enable ? 1 : 0;
+    if (!pml4_cache.enabled) {
+        while (pml4_cache.count > 0) {
+            free_page_frame(pml4_cache.frames[--pml4_cache.count]);
+        }
+    }
+}
+
+void get_pml4_cache_stats(uint32_t *cached, uint64_t *hits, uint64_t *misses) {
+    if (cached) {
+        *cached = pml4_cache.count;
+    }
+    if (hits) {
+        *hits = pml4_cache.hits;
+    }
+    if (misses) {
+        *misses = pml4_cache.misses;
+    }
+}
+
 /* ========================================================================
  * CORE PAGE TABLE TRAVERSAL AND TRANSLATION
  * ======================================================================== */
@@ -290,6 +673,8 @@ uint64_t virt_to_phys_process(uint64_t vaddr, process_page_dir_t *page_dir) {
 /*
  * Map a 2MB large page in current process page directory
  * Used for kernel initialization and efficient memory mapping
+ * Allocates missing PDPT/PD tables; fails if the 2MB slot already holds a
+ * page table so callers can fall back to 4KB pages
  */
 int map_page_2mb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
     if (!current_page_dir || !current_page_dir->pml4) {
@@ -303,42 +688,77 @@ int map_page_2mb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
         return -1;
     }
 
+    int is_user_mapping = (flags & PAGE_USER) && is_user_address(vaddr);
+    uint64_t intermediate_flags = is_user_mapping ?
+        (PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) : PAGE_KERNEL_RW;
+
     uint16_t pml4_idx = pml4_index(vaddr);
     uint16_t pdpt_idx = pdpt_index(vaddr);
     uint16_t pd_idx = pd_index(vaddr);
 
-    /* Check PML4 entry exists */
+    int reclaimable = table_reclaimable(vaddr);
+
+    /* Get or create PDPT table */
     uint64_t pml4_entry = current_page_dir->pml4->entries[pml4_idx];
     if (!pte_present(pml4_entry)) {
-        kprint("map_page_2mb: PML4 entry not present\n");
-        return -1;
+        uint64_t pdpt_phys = alloc_page_table(reclaimable);
+        if (!pdpt_phys) {
+            kprint("map_page_2mb: Failed to allocate PDPT\n");
+            return -1;
+        }
+        pml4_entry = pdpt_phys | intermediate_flags;
+        current_page_dir->pml4->entries[pml4_idx] = pml4_entry;
+        pml4_cache_sync_slot(pml4_idx);
     }
 
-    /* Get PDPT table */
     page_table_t *pdpt = phys_to_page_table_ptr(pte_address(pml4_entry));
     if (!pdpt) {
         kprint("map_page_2mb: Invalid PDPT address\n");
         return -1;
     }
 
+    /* Get or create PD table */
     uint64_t pdpt_entry = pdpt->entries[pdpt_idx];
     if (!pte_present(pdpt_entry)) {
-        kprint("map_page_2mb: PDPT entry not present\n");
+        uint64_t pd_phys = alloc_page_table(reclaimable);
+        if (!pd_phys) {
+            kprint("map_page_2mb: Failed to allocate PD\n");
+            return -1;
+        }
+        pdpt_entry = pd_phys | intermediate_flags;
+        pdpt->entries[pdpt_idx] = pdpt_entry;
+        page_table_entries_add(pte_address(pml4_entry), 1);
+    } else if (pte_huge(pdpt_entry)) {
+        kprint("map_page_2mb: PDPT entry is a huge page\n");
         return -1;
     }
 
-    /* Get PD table */
     page_table_t *pd = phys_to_page_table_ptr(pte_address(pdpt_entry));
     if (!pd) {
         kprint("map_page_2mb: Invalid PD address\n");
         return -1;
     }
 
+    /* A page table already covers this 2MB - leave it to 4KB mappings */
+    uint64_t pd_entry = pd->entries[pd_idx];
+    if (pte_present(pd_entry) && !pte_huge(pd_entry)) {
+        return -1;
+    }
+
+    /* Replacing an existing 2MB translation */
+    int replaced = pte_present(pd_entry);
+    if (!replaced) {
+        page_table_entries_add(pte_address(pdpt_entry), 1);
+    }
+
     /* Create 2MB page entry with large page flag */
-    pd->entries[pd_idx] = paddr | flags | PAGE_SIZE | PAGE_PRESENT;
+    pd->entries[pd_idx] = paddr | flags | PAGE_SIZE | PAGE_PRESENT | leaf_global_flag(vaddr);
 
     /* Invalidate TLB for this virtual address */
     invlpg(vaddr);
+    if (replaced) {
+        note_shared_unmap(vaddr, 1);
+    }
 
     return 0;
 }
@@ -383,20 +803,19 @@ int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
     int allocated_pd = 0;
     int allocated_pt = 0;
 
+    int reclaimable = table_reclaimable(vaddr);
+
     uint64_t pml4_entry = pml4->entries[pml4_idx];
     if (!pte_present(pml4_entry)) {
-        pdpt_phys = alloc_page_frame(0);
+        pdpt_phys = alloc_page_table(reclaimable);
         if (!pdpt_phys) {
             kprint("map_page_4kb: Failed to allocate PDPT\n");
             return -1;
         }
 
         pdpt = phys_to_page_table_ptr(pdpt_phys);
-        for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
-            pdpt->entries[i] = 0;
-        }
-
         pml4->entries[pml4_idx] = pdpt_phys | intermediate_flags;
+        pml4_cache_sync_slot(pml4_idx);
         allocated_pdpt = 1;
     } else {
         pdpt_phys = pte_address(pml4_entry);
@@ -405,6 +824,7 @@ int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
         /* Update existing PML4 entry flags if needed for user mapping */
         if (is_user_mapping && !(pml4_entry & PAGE_USER)) {
             pml4->entries[pml4_idx] = (pml4_entry & ~0xFFF) | intermediate_flags;
+            pml4_cache_sync_slot(pml4_idx);
         }
     }
 
@@ -415,18 +835,15 @@ int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
 
     uint64_t pdpt_entry = pdpt->entries[pdpt_idx];
     if (!pte_present(pdpt_entry)) {
-        pd_phys = alloc_page_frame(0);
+        pd_phys = alloc_page_table(reclaimable);
         if (!pd_phys) {
             kprint("map_page_4kb: Failed to allocate PD\n");
             goto failure;
         }
 
         pd = phys_to_page_table_ptr(pd_phys);
-        for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
-            pd->entries[i] = 0;
-        }
-
         pdpt->entries[pdpt_idx] = pd_phys | intermediate_flags;
+        page_table_entries_add(pdpt_phys, 1);
         allocated_pd = 1;
     } else {
         if (pte_huge(pdpt_entry)) {
@@ -450,18 +867,15 @@ int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
 
     uint64_t pd_entry = pd->entries[pd_idx];
     if (!pte_present(pd_entry)) {
-        pt_phys = alloc_page_frame(0);
+        pt_phys = alloc_page_table(reclaimable);
         if (!pt_phys) {
             kprint("map_page_4kb: Failed to allocate PT\n");
             goto failure;
         }
 
         pt = phys_to_page_table_ptr(pt_phys);
-        for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
-            pt->entries[i] = 0;
-        }
-
         pd->entries[pd_idx] = pt_phys | intermediate_flags;
+        page_table_entries_add(pd_phys, 1);
         allocated_pt = 1;
     } else {
         if (pte_huge(pd_entry)) {
@@ -489,7 +903,8 @@ int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags) {
         goto failure;
     }
 
-    pt->entries[pt_idx] = paddr | (flags | PAGE_PRESENT);
+    pt->entries[pt_idx] = paddr | (flags | PAGE_PRESENT) | leaf_global_flag(vaddr);
+    page_table_entries_add(pt_phys, 1);
     invlpg(vaddr);
 
     return 0;
@@ -498,25 +913,28 @@ failure:
     if (allocated_pt) {
         if (pd) {
             pd->entries[pd_idx] = 0;
+            page_table_entries_add(pd_phys, -1);
         }
         if (pt_phys) {
-            free_page_frame(pt_phys);
+            free_page_table(pt_phys);
         }
     }
 
     if (allocated_pd) {
         if (pdpt) {
             pdpt->entries[pdpt_idx] = 0;
+            page_table_entries_add(pdpt_phys, -1);
         }
         if (pd_phys) {
-            free_page_frame(pd_phys);
+            free_page_table(pd_phys);
         }
     }
 
     if (allocated_pdpt) {
         pml4->entries[pml4_idx] = 0;
+        pml4_cache_sync_slot(pml4_idx);
         if (pdpt_phys) {
-            free_page_frame(pdpt_phys);
+            free_page_table(pdpt_phys);
         }
     }
 
@@ -553,7 +971,10 @@ int unmap_page(uint64_t vaddr) {
     /* Check for 1GB huge page */
     if (pte_huge(pdpt_entry)) {
         pdpt->entries[pdpt_idx] = 0;
+        page_table_entries_add(pte_address(pml4_entry), -1);
+        reclaim_page_tables(vaddr);
         invlpg(vaddr);
+        note_shared_unmap(vaddr, 1);
         return 0;
     }
 
@@ -566,87 +987,1086 @@ int unmap_page(uint64_t vaddr) {
     /* Check for 2MB large page */
     if (pte_huge(pd_entry)) {
         pd->entries[pd_idx] = 0;
+        page_table_entries_add(pte_address(pdpt_entry), -1);
+        reclaim_page_tables(vaddr);
         invlpg(vaddr);
+        note_shared_unmap(vaddr, 1);
         return 0;
     }
 
-    /* 4KB page - clear PT entry */
+    /* 4KB page - clear PT entry, freeing tables it leaves empty */
     page_table_t *pt = phys_to_page_table_ptr(pte_address(pd_entry));
+    if (!pte_present(pt->entries[pt_idx])) {
+        return 0;  /* Already unmapped */
+    }
     pt->entries[pt_idx] = 0;
+    page_table_entries_add(pte_address(pd_entry), -1);
+    reclaim_page_tables(vaddr);
     invlpg(vaddr);
+    note_shared_unmap(vaddr, 1);
 
     return 0;
 }
 
-/* ========================================================================
- * PROCESS PAGE DIRECTORY MANAGEMENT
- * ======================================================================== */
-
 /*
- * Switch to a different process page directory
- * Used for process context switching
+ * Demote the 2MB page covering vaddr to a page table of 4KB entries
+ * Physical backing and permissions are preserved, so individual 4KB pages
+ * can then be unmapped. Returns 0 on success or if vaddr is not covered
+ * by a 2MB page, -1 on failure
  */
-int switch_page_directory(process_page_dir_t *page_dir) {
-    if (!page_dir || !page_dir->pml4) {
-        kprint("switch_page_directory: Invalid page directory\n");
+int split_page_2mb(uint64_t vaddr) {
+    if (!current_page_dir || !current_page_dir->pml4) {
+        kprint("split_page_2mb: No current page directory\n");
         return -1;
     }
 
-    /* Update CR3 to switch to new page directory */
-    set_cr3(page_dir->pml4_phys);
-    current_page_dir = page_dir;
+    uint64_t pml4_entry = current_page_dir->pml4->entries[pml4_index(vaddr)];
+    if (!pte_present(pml4_entry)) {
+        return 0;
+    }
 
-    boot_log_debug("Switched to process page directory");
-    return 0;
-}
+    page_table_t *pdpt = phys_to_page_table_ptr(pte_address(pml4_entry));
+    uint64_t pdpt_entry = pdpt->entries[pdpt_index(vaddr)];
+    if (!pte_present(pdpt_entry) || pte_huge(pdpt_entry)) {
+        return 0;
+    }
 
-/*
- * Get current process page directory
- */
-process_page_dir_t *get_current_page_directory(void) {
-    return current_page_dir;
+    page_table_t *pd = phys_to_page_table_ptr(pte_address(pdpt_entry));
+    uint16_t pd_idx = pd_index(vaddr);
+    uint64_t pd_entry = pd->entries[pd_idx];
+    if (!pte_present(pd_entry) || !pte_huge(pd_entry)) {
+        return 0;
+    }
+
+    uint64_t pt_phys = alloc_page_table(table_reclaimable(vaddr));
+    if (!pt_phys) {
+        kprint("split_page_2mb: Failed to allocate PT\n");
+        return -1;
+    }
+    page_table_entries_add(pt_phys, ENTRIES_PER_PAGE_TABLE);
+
+    page_table_t *pt = phys_to_page_table_ptr(pt_phys);
+    uint64_t base = pte_address(pd_entry);
+    uint64_t leaf_flags = pd_entry & ~(PTE_ADDRESS_MASK | PAGE_SIZE);
+
+    for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
+        pt->entries[i] = (base + (uint64_t)i * PAGE_SIZE_4KB) | leaf_flags;
+    }
+
+    pd->entries[pd_idx] = pt_phys | (pd_entry & (PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER));
+    invlpg(vaddr & ~(uint64_t)(PAGE_SIZE_2MB - 1));
+
+    return 0;
 }
 
 /* ========================================================================
- * SYSTEM INITIALIZATION
+ * BATCHED RANGE MAPPING
  * ======================================================================== */
 
+/* Ranges at least this long are flushed with one CR3 reload */
+#define RANGE_FLUSH_ALL_THRESHOLD     32
+
 /*
- * Initialize paging system during early kernel boot
- * Sets up process-centric paging infrastructure
+ * Flush the TLB for a range once all of its entries have been rewritten
+ * Short ranges use invlpg per page, long ones reload CR3 a single time
+ * (or toggle CR4.PGE when the range holds global kernel entries)
  */
-void init_paging(void) {
-    boot_log_debug("Initializing paging system");
-
-    /* Get current CR3 value set by bootloader */
-    uint64_t cr3 = get_cr3();
-    kernel_page_dir.pml4_phys = cr3 & ~0xFFF;
+static void flush_tlb_range(uint64_t vaddr, uint64_t npages) {
+    if (npages >= RANGE_FLUSH_ALL_THRESHOLD) {
+        if (leaf_global_flag(vaddr)) {
+            flush_tlb_global();
+        } else {
+            flush_tlb();
+        }
+        return;
+    }
 
-    /* Ensure kernel PML4 pointer references the mapped table */
-    page_table_t *pml4_ptr = phys_to_page_table_ptr(kernel_page_dir.pml4_phys);
-    if (!pml4_ptr) {
-        kernel_panic("Failed to translate kernel PML4 physical address");
+    for (uint64_t i = 0; i < npages; i++) {
+        invlpg(vaddr + i * PAGE_SIZE_4KB);
     }
-    kernel_page_dir.pml4 = pml4_ptr;
+}
 
-    /* Verify higher-half kernel mapping exists */
-    uint64_t kernel_phys = virt_to_phys(KERNEL_VIRTUAL_BASE);
-    if (kernel_phys == 0) {
-        kernel_panic("Higher-half kernel mapping not found");
+/*
+ * Return the table an intermediate entry points to, allocating a zeroed
+ * one if the entry is empty (and counting it in the parent table at
+ * parent_phys). Returns NULL on allocation failure or when the entry is a
+ * huge page
+ */
+static page_table_t *range_table_get_or_create(uint64_t *entry, uint64_t parent_phys,
+                                               uint64_t intermediate_flags,
+                                               int is_user_mapping, int reclaimable) {
+    uint64_t value = *entry;
+
+    if (!pte_present(value)) {
+        uint64_t table_phys = alloc_page_table(reclaimable);
+        if (!table_phys) {
+            return NULL;
+        }
+        *entry = table_phys | intermediate_flags;
+        page_table_entries_add(parent_phys, 1);
+        return phys_to_page_table_ptr(table_phys);
     }
 
-    BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
-        kprint("Higher-half kernel mapping verified at ");
-        kprint_hex(kernel_phys);
-        kprint("\n");
-    });
+    if (pte_huge(value)) {
+        return NULL;
+    }
 
-    /* Verify identity mapping exists for early boot hardware access */
-    uint64_t identity_phys = virt_to_phys(0x100000); /* 1MB mark */
-    if (identity_phys == 0x100000 || is_hhdm_available()) {
-        boot_log_debug("Identity mapping verified");
-    } else {
-        boot_log_debug("Identity mapping not found (may be normal after early boot)");
+    if (is_user_mapping && !(value & PAGE_USER)) {
+        *entry = (value & ~0xFFFULL) | intermediate_flags;
+    }
+
+    return phys_to_page_table_ptr(pte_address(value));
+}
+
+/*
+ * Next boundary of a naturally aligned region of the given size, clamped
+ * to end (also guards the wrap at the top of the address space)
+ */
+static inline uint64_t range_boundary(uint64_t vaddr, uint64_t size, uint64_t end) {
+    uint64_t next = (vaddr & ~(size - 1)) + size;
+    return (next == 0 || next > end) ? end : next;
+}
+
+/*
+ * Map npages contiguous virtual pages starting at vaddr
+ * paddr gives the physical base, or MAP_RANGE_ALLOC / MAP_RANGE_ALLOC_ZERO to
+ * back every page with a fresh (zeroed) frame. Each PDPT/PD/PT is walked once and its entries filled as a
+ * run; passing PAGE_SIZE in flags lets 2MB-aligned stretches use 2MB
+ * entries (allocated backing is still independent 4KB frames). The TLB is
+ * flushed once at the end. On failure everything mapped so far is undone
+ */
+int map_range(uint64_t vaddr, uint64_t paddr, uint64_t npages, uint64_t flags) {
+    if (!current_page_dir || !current_page_dir->pml4) {
+        kprint("map_range: No current page directory\n");
+        return -1;
+    }
+
+    int allocate = (paddr == MAP_RANGE_ALLOC || paddr == MAP_RANGE_ALLOC_ZERO);
+    uint32_t alloc_flags = (paddr == MAP_RANGE_ALLOC_ZERO) ? ALLOC_FLAG_ZERO : 0;
+    if (allocate) {
+        paddr = 0;
+    }
+
+    if ((vaddr & (PAGE_SIZE_4KB - 1)) || (paddr & (PAGE_SIZE_4KB - 1))) {
+        kprint("map_range: Addresses must be 4KB aligned\n");
+        return -1;
+    }
+
+    if (npages == 0) {
+        return 0;
+    }
+
+    int allow_huge = (flags & PAGE_SIZE) != 0;
+    uint64_t leaf_flags = (flags & ~(uint64_t)PAGE_SIZE) | PAGE_PRESENT | leaf_global_flag(vaddr);
+
+    int is_user_mapping = (flags & PAGE_USER) && is_user_address(vaddr);
+    uint64_t intermediate_flags = is_user_mapping ?
+        (PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER) : PAGE_KERNEL_RW;
+
+    page_table_t *pml4 = current_page_dir->pml4;
+    int reclaimable = table_reclaimable(vaddr);
+    uint64_t end = vaddr + npages * PAGE_SIZE_4KB;
+    uint64_t virt = vaddr;
+    uint64_t phys = paddr;
+    uint64_t mapped = 0;
+
+    while (virt < end) {
+        uint64_t *pml4_entry = &pml4->entries[pml4_index(virt)];
+        uint64_t old_pml4_entry = *pml4_entry;
+        page_table_t *pdpt = range_table_get_or_create(pml4_entry, current_page_dir->pml4_phys,
+                                                       intermediate_flags, is_user_mapping,
+                                                       reclaimable);
+        if (*pml4_entry != old_pml4_entry) {
+            pml4_cache_sync_slot(pml4_index(virt));
+        }
+        if (!pdpt) {
+            kprint("map_range: Failed to get PDPT\n");
+            goto failure;
+        }
+        uint64_t pdpt_phys = pte_address(*pml4_entry);
+
+        uint64_t *pdpt_entry = &pdpt->entries[pdpt_index(virt)];
+        page_table_t *pd = range_table_get_or_create(pdpt_entry, pdpt_phys,
+                                                     intermediate_flags, is_user_mapping,
+                                                     reclaimable);
+        if (!pd) {
+            kprint("map_range: Failed to get PD\n");
+            goto failure;
+        }
+        uint64_t pd_phys = pte_address(*pdpt_entry);
+
+        uint64_t pd_end = range_boundary(virt, PAGE_SIZE_1GB, end);
+        while (virt < pd_end) {
+            uint64_t *pd_entry = &pd->entries[pd_index(virt)];
+
+            /* Promote a whole, empty, aligned 2MB stretch to a single entry */
+            if (allow_huge && !(virt & (PAGE_SIZE_2MB - 1)) &&
+                pd_end - virt >= PAGE_SIZE_2MB && !pte_present(*pd_entry)) {
+                uint64_t huge_phys = 0;
+                if (allocate) {
+                    huge_phys = alloc_page_frames(ENTRIES_PER_PAGE_TABLE, alloc_flags);
+                } else if (!(phys & (PAGE_SIZE_2MB - 1))) {
+                    huge_phys = phys;
+                }
+
+                if (huge_phys) {
+                    *pd_entry = huge_phys | leaf_flags | PAGE_SIZE;
+                    page_table_entries_add(pd_phys, 1);
+                    virt += PAGE_SIZE_2MB;
+                    phys += allocate ? 0 : PAGE_SIZE_2MB;
+                    mapped += ENTRIES_PER_PAGE_TABLE;
+                    continue;
+                }
+            }
+
+            page_table_t *pt = range_table_get_or_create(pd_entry, pd_phys, intermediate_flags,
+                                                         is_user_mapping, reclaimable);
+            if (!pt) {
+                kprint("map_range: Failed to get PT\n");
+                goto failure;
+            }
+            uint64_t pt_phys = pte_address(*pd_entry);
+
+            /* Occupancy is added once per run rather than per entry */
+            uint64_t pt_end = range_boundary(virt, PAGE_SIZE_2MB, pd_end);
+            int32_t filled = 0;
+            for (uint16_t pt_idx = pt_index(virt); virt < pt_end; pt_idx++) {
+                if (pte_present(pt->entries[pt_idx])) {
+                    kprint("map_range: Virtual address already mapped\n");
+                    page_table_entries_add(pt_phys, filled);
+                    goto failure;
+                }
+
+                uint64_t frame = phys;
+                if (allocate) {
+                    frame = alloc_page_frame(alloc_flags);
+                    if (!frame) {
+                        kprint("map_range: Failed to allocate frame\n");
+                        page_table_entries_add(pt_phys, filled);
+                        goto failure;
+                    }
+                } else {
+                    phys += PAGE_SIZE_4KB;
+                }
+
+                pt->entries[pt_idx] = frame | leaf_flags;
+                virt += PAGE_SIZE_4KB;
+                filled++;
+                mapped++;
+            }
+            page_table_entries_add(pt_phys, filled);
+        }
+    }
+
+    flush_tlb_range(vaddr, npages);
+    return 0;
+
+failure:
+    if (mapped) {
+        unmap_range(vaddr, mapped, allocate ? UNMAP_RANGE_FREE_FRAMES : 0);
+    }
+    return -1;
+}
+
+/*
+ * Unmap npages virtual pages starting at vaddr
+ * Holes are skipped a whole table at a time. 2MB entries fully inside the
+ * range are dropped in one step; partially covered ones are split first.
+ * With UNMAP_RANGE_FREE_FRAMES the backing frames go back to the page
+ * allocator. Returns the number of 4KB pages that were unmapped
+ */
+uint64_t unmap_range(uint64_t vaddr, uint64_t npages, uint32_t flags) {
+    if (!current_page_dir || !current_page_dir->pml4) {
+        kprint("unmap_range: No current page directory\n");
+        return 0;
+    }
+
+    if (npages == 0) {
+        return 0;
+    }
+
+    page_table_t *pml4 = current_page_dir->pml4;
+    int reclaimable = table_reclaimable(vaddr);
+    uint64_t start = vaddr & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+    uint64_t end = start + npages * PAGE_SIZE_4KB;
+    uint64_t virt = start;
+    uint64_t unmapped = 0;
+
+    while (virt < end) {
+        uint64_t *pml4_entry = &pml4->entries[pml4_index(virt)];
+        if (!pte_present(*pml4_entry)) {
+            virt = range_boundary(virt, (uint64_t)PAGE_SIZE_1GB * ENTRIES_PER_PAGE_TABLE, end);
+            continue;
+        }
+
+        uint64_t pdpt_phys = pte_address(*pml4_entry);
+        page_table_t *pdpt = phys_to_page_table_ptr(pdpt_phys);
+        uint64_t *pdpt_entry = &pdpt->entries[pdpt_index(virt)];
+        if (!pte_present(*pdpt_entry) || pte_huge(*pdpt_entry)) {
+            /* 1GB pages are never created by the range API */
+            virt = range_boundary(virt, PAGE_SIZE_1GB, end);
+            continue;
+        }
+
+        uint64_t pd_phys = pte_address(*pdpt_entry);
+        page_table_t *pd = phys_to_page_table_ptr(pd_phys);
+        uint64_t pd_end = range_boundary(virt, PAGE_SIZE_1GB, end);
+        while (virt < pd_end) {
+            uint64_t *pd_entry = &pd->entries[pd_index(virt)];
+            uint64_t pt_end = range_boundary(virt, PAGE_SIZE_2MB, pd_end);
+
+            if (!pte_present(*pd_entry)) {
+                virt = pt_end;
+                continue;
+            }
+
+            if (pte_huge(*pd_entry)) {
+                if (!(virt & (PAGE_SIZE_2MB - 1)) && pt_end - virt == PAGE_SIZE_2MB) {
+                    uint64_t base = pte_address(*pd_entry);
+                    *pd_entry = 0;
+                    page_table_entries_add(pd_phys, -1);
+                    if (flags & UNMAP_RANGE_FREE_FRAMES) {
+                        for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
+                            free_page_frame(base + (uint64_t)i * PAGE_SIZE_4KB);
+                        }
+                    }
+                    unmapped += ENTRIES_PER_PAGE_TABLE;
+                    virt = pt_end;
+                    continue;
+                }
+
+                if (split_page_2mb(virt) != 0) {
+                    kprint("unmap_range: Failed to split 2MB page\n");
+                    virt = pt_end;
+                    continue;
+                }
+            }
+
+            uint64_t pt_phys = pte_address(*pd_entry);
+            page_table_t *pt = phys_to_page_table_ptr(pt_phys);
+            int32_t cleared = 0;
+            for (uint16_t pt_idx = pt_index(virt); virt < pt_end; pt_idx++) {
+                uint64_t pt_entry = pt->entries[pt_idx];
+                if (pte_present(pt_entry)) {
+                    pt->entries[pt_idx] = 0;
+                    if (flags & UNMAP_RANGE_FREE_FRAMES) {
+                        free_page_frame(pte_address(pt_entry));
+                    }
+                    cleared++;
+                }
+                virt += PAGE_SIZE_4KB;
+            }
+            page_table_entries_add(pt_phys, -cleared);
+            unmapped += (uint64_t)cleared;
+
+            if (reclaimable) {
+                reclaim_table_entry(pd_entry, pd_phys);
+            }
+        }
+
+        /* Tables emptied here are flushed with the range below */
+        if (reclaimable && reclaim_table_entry(pdpt_entry, pdpt_phys)) {
+            reclaim_table_entry(pml4_entry, current_page_dir->pml4_phys);
+        }
+    }
+
+    if (unmapped) {
+        flush_tlb_range(start, npages);
+        note_shared_unmap(start, npages);
+    }
+    return unmapped;
+}
+
+/* ========================================================================
+ * COPY-ON-WRITE ADDRESS SPACE CLONING
+ * ======================================================================== */
+
+/*
+ * Copy a page frame into a newly allocated one
+ * Returns the physical address of the copy, 0 on failure
+ */
+static uint64_t copy_page_frame(uint64_t old_phys) {
+    uint64_t new_phys = alloc_page_frame(0);
+    uint64_t to_virt = new_phys ? mm_phys_to_virt(new_phys) : 0;
+    uint64_t from_virt = mm_phys_to_virt(old_phys);
+    if (!to_virt || !from_virt) {
+        if (new_phys) {
+            free_page_frame(new_phys);
+        }
+        return 0;
+    }
+
+    const uint64_t *from = (const uint64_t *)(uintptr_t)from_virt;
+    uint64_t *to = (uint64_t *)(uintptr_t)to_virt;
+    for (uint32_t i = 0; i < PAGE_SIZE_4KB / sizeof(uint64_t); i++) {
+        to[i] = from[i];
+    }
+    return new_phys;
+}
+
+/*
+ * Share one level of user page tables with a clone
+ * Intermediate tables are duplicated; leaf pages get an extra frame
+ * reference, and writable ones turn read-only with PAGE_COW in both trees.
+ * A frame whose reference count is saturated is copied for dst right away.
+ * Level 4 is the PML4 (user half only), level 1 a page table
+ */
+static int cow_clone_table(page_table_t *src, page_table_t *dst, uint64_t dst_phys,
+                           int level, uint64_t *shared) {
+    uint32_t limit = (level == 4) ? PML4_KERNEL_FIRST_ENTRY : ENTRIES_PER_PAGE_TABLE;
+
+    for (uint32_t i = 0; i < limit; i++) {
+        uint64_t entry = src->entries[i];
+        if (!pte_present(entry)) {
+            continue;
+        }
+
+        /* dst already shares the kernel's own tables */
+        if (level == 4 && pml4_slot_shared_with_kernel(i, entry)) {
+            continue;
+        }
+
+        if (level == 1) {
+            uint64_t phys = pte_address(entry);
+            if (ref_page_frame(phys) == 0) {
+                if (entry & PAGE_WRITABLE) {
+                    entry = (entry & ~(uint64_t)PAGE_WRITABLE) | PAGE_COW;
+                    src->entries[i] = entry;
+                }
+            } else if (page_frame_ref_count(phys) != 0) {
+                /* Allocator frame that cannot take another reference */
+                uint64_t copy = copy_page_frame(phys);
+                if (!copy) {
+                    kprint("paging_clone_user_cow: Failed to copy unshareable page\n");
+                    return -1;
+                }
+                entry = copy | (entry & ~PTE_ADDRESS_MASK);
+                if (entry & PAGE_COW) {
+                    entry = (entry & ~(uint64_t)PAGE_COW) | PAGE_WRITABLE;
+                }
+            }
+            /* Frames outside the allocator (device memory) stay plain shared */
+            dst->entries[i] = entry;
+            page_table_entries_add(dst_phys, 1);
+            (*shared)++;
+            continue;
+        }
+
+        if (pte_huge(entry)) {
+            kprint("paging_clone_user_cow: Huge user mappings cannot be shared\n");
+            return -1;
+        }
+
+        uint64_t table_phys = alloc_page_table(1);
+        page_table_t *table = table_phys ? phys_to_page_table_ptr(table_phys) : NULL;
+        if (!table) {
+            kprint("paging_clone_user_cow: Failed to allocate page table\n");
+            return -1;
+        }
+
+        dst->entries[i] = table_phys | (entry & ~PTE_ADDRESS_MASK);
+        page_table_entries_add(dst_phys, 1);
+        if (cow_clone_table(phys_to_page_table_ptr(pte_address(entry)), table, table_phys,
+                            level - 1, shared) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Share every user mapping of src with dst copy-on-write
+ * dst must hold no user mappings yet. On failure dst is left partially
+ * populated and must be torn down by the caller. Returns 0 on success
+ */
+int paging_clone_user_cow(process_page_dir_t *src, process_page_dir_t *dst, uint64_t *shared_pages) {
+    if (!src || !src->pml4 || !dst || !dst->pml4 || src == dst) {
+        return -1;
+    }
+
+    uint64_t shared = 0;
+    int result = cow_clone_table(src->pml4, dst->pml4, dst->pml4_phys, 4, &shared);
+
+    /* Writable translations of src may be cached under its PCID on any CPU */
+    if (src == current_page_dir) {
+        flush_tlb();
+    }
+    page_dir_tlb_stale(src);
+
+    if (shared_pages) {
+        *shared_pages = shared;
+    }
+    return result;
+}
+
+/*
+ * Resolve a write fault on a copy-on-write page in the current address space
+ * The last sharer just regains write access; otherwise the page is copied
+ * into a private frame. Returns -1 if vaddr is not a COW page
+ */
+int paging_resolve_cow_fault(uint64_t vaddr) {
+    if (!current_page_dir || !current_page_dir->pml4 || vaddr >= USER_SPACE_END) {
+        return -1;
+    }
+
+    uint64_t entry = current_page_dir->pml4->entries[pml4_index(vaddr)];
+    if (!pte_present(entry)) {
+        return -1;
+    }
+
+    page_table_t *pdpt = phys_to_page_table_ptr(pte_address(entry));
+    entry = pdpt->entries[pdpt_index(vaddr)];
+    if (!pte_present(entry) || pte_huge(entry)) {
+        return -1;
+    }
+
+    page_table_t *pd = phys_to_page_table_ptr(pte_address(entry));
+    entry = pd->entries[pd_index(vaddr)];
+    if (!pte_present(entry) || pte_huge(entry)) {
+        return -1;
+    }
+
+    page_table_t *pt = phys_to_page_table_ptr(pte_address(entry));
+    uint64_t *pte = &pt->entries[pt_index(vaddr)];
+    if (!pte_present(*pte) || !(*pte & PAGE_COW)) {
+        return -1;
+    }
+
+    uint64_t old_phys = pte_address(*pte);
+    uint64_t flags = (*pte & ~PTE_ADDRESS_MASK & ~(uint64_t)PAGE_COW) | PAGE_WRITABLE;
+
+    if (page_frame_ref_count(old_phys) <= 1) {
+        *pte = old_phys | flags;
+        cow_stats.reuses++;
+    } else {
+        uint64_t new_phys = copy_page_frame(old_phys);
+        if (!new_phys) {
+            kprint("paging_resolve_cow_fault: Failed to copy shared page\n");
+            return -1;
+        }
+
+        *pte = new_phys | flags;
+        free_page_frame(old_phys);  /* Drops this address space's reference */
+        cow_stats.copies++;
+    }
+
+    invlpg(vaddr & ~(uint64_t)(PAGE_SIZE_4KB - 1));
+    return 0;
+}
+
+void get_cow_stats(uint64_t *copies, uint64_t *reuses) {
+    if (copies) {
+        *copies = cow_stats.copies;
+    }
+    if (reuses) {
+        *reuses = cow_stats.reuses;
+    }
+}
+
+/* ========================================================================
+ * ADDRESS SPACE TEARDOWN
+ * ======================================================================== */
+
+/*
+ * Drop a leaf frame's reference if the page allocator owns it
+ * Device memory and reserved frames are mapped without a reference
+ */
+static void release_user_frame(uint64_t phys, uint64_t *released) {
+    if (page_frame_ref_count(phys) == 0) {
+        return;
+    }
+    free_page_frame(phys);
+    (*released)++;
+}
+
+/*
+ * Free one level of a user page table subtree, children first
+ * Leaf frames lose one reference each, so pages still shared
+ * copy-on-write survive in the other address spaces. Level 3 is a PDPT
+ */
+static void free_user_table(page_table_t *table, int level, uint64_t *released) {
+    for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
+        uint64_t entry = table->entries[i];
+        if (!pte_present(entry)) {
+            continue;
+        }
+
+        if (level == 1) {
+            release_user_frame(pte_address(entry), released);
+            continue;
+        }
+
+        if (pte_huge(entry)) {
+            /* 2MB range mappings are backed by independent 4KB frames */
+            if (level == 2) {
+                for (uint32_t j = 0; j < ENTRIES_PER_PAGE_TABLE; j++) {
+                    release_user_frame(pte_address(entry) + (uint64_t)j * PAGE_SIZE_4KB,
+                                       released);
+                }
+            }
+            continue;
+        }
+
+        uint64_t child_phys = pte_address(entry);
+        free_user_table(phys_to_page_table_ptr(child_phys), level - 1, released);
+        free_page_table(child_phys);
+    }
+}
+
+/*
+ * Release every user mapping of a process directory in one pass
+ * Walks the user half of the PML4 once, freeing leaf frames and the
+ * tables holding them bottom-up, then invalidates the directory's TLB
+ * entries once. PML4 slots shared with the kernel directory are left
+ * alone. The PML4 itself stays allocated. Returns the number of leaf
+ * frame references dropped
+ */
+uint64_t paging_free_user_mappings(process_page_dir_t *page_dir) {
+    if (!page_dir || !page_dir->pml4 || page_dir == &kernel_page_dir) {
+        return 0;
+    }
+
+    uint64_t released = 0;
+    for (uint32_t i = 0; i < PML4_KERNEL_FIRST_ENTRY; i++) {
+        uint64_t entry = page_dir->pml4->entries[i];
+        if (!pte_present(entry) || pml4_slot_shared_with_kernel(i, entry)) {
+            continue;
+        }
+
+        uint64_t pdpt_phys = pte_address(entry);
+        free_user_table(phys_to_page_table_ptr(pdpt_phys), 3, &released);
+        free_page_table(pdpt_phys);
+        page_dir->pml4->entries[i] = 0;
+    }
+
+    if (page_dir == current_page_dir) {
+        flush_tlb();
+    }
+    page_dir_tlb_stale(page_dir);
+
+    return released;
+}
+
+/* ========================================================================
+ * GLOBAL KERNEL MAPPINGS
+ * ======================================================================== */
+
+/*
+ * Set PAGE_GLOBAL on every leaf entry below one table
+ * level is 3 for a PDPT, 2 for a PD and 1 for a PT
+ */
+static uint64_t mark_table_global(page_table_t *table, int level) {
+    uint64_t marked = 0;
+
+    for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
+        uint64_t entry = table->entries[i];
+        if (!pte_present(entry)) {
+            continue;
+        }
+
+        if (level == 1 || pte_huge(entry)) {
+            table->entries[i] = entry | PAGE_GLOBAL;
+            marked++;
+            continue;
+        }
+
+        page_table_t *next = phys_to_page_table_ptr(pte_address(entry));
+        if (next) {
+            marked += mark_table_global(next, level - 1);
+        }
+    }
+
+    return marked;
+}
+
+/*
+ * Enable CR4.PGE and mark the existing higher-half kernel mappings global
+ * Later kernel mappings pick up the bit through leaf_global_flag()
+ */
+static void init_global_pages(void) {
+    uint64_t marked = 0;
+
+    for (uint32_t i = PML4_KERNEL_FIRST_ENTRY; i < ENTRIES_PER_PAGE_TABLE; i++) {
+        uint64_t entry = kernel_page_dir.pml4->entries[i];
+        if (!pte_present(entry)) {
+            continue;
+        }
+
+        page_table_t *pdpt = phys_to_page_table_ptr(pte_address(entry));
+        if (pdpt) {
+            marked += mark_table_global(pdpt, 3);
+        }
+    }
+
+    set_cr4(get_cr4() | CR4_PGE);
+    global_pages_enabled = 1;
+    flush_tlb_global();
+
+    BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
+        kprint("Marked ");
+        kprint_decimal(marked);
+        kprint(" kernel leaf entries global\n");
+    });
+}
+
+/* ========================================================================
+ * CROSS-CPU TLB SHOOTDOWN
+ * ======================================================================== */
+
+/*
+ * Check whether a CPU may hold kernel translations and takes interrupts
+ * The BSP always does; APs only once handed to the scheduler. APs still
+ * polling for boot work run with interrupts off and flush everything
+ * before each work item instead
+ */
+static int tlb_shootdown_target(uint32_t cpu) {
+    const cpu_local_t *info = smp_get_cpu(cpu);
+    if (!info) {
+        return 0;
+    }
+    return cpu == 0 || __atomic_load_n(&info->state, __ATOMIC_ACQUIRE) == SMP_CPU_SCHEDULING;
+}
+
+/*
+ * Flush the published range if this CPU still owes it
+ */
+static void tlb_shootdown_service(uint32_t cpu) {
+    if (!__atomic_load_n(&tlb_shootdown.pending[cpu], __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    flush_tlb_range(tlb_shootdown.vaddr, tlb_shootdown.npages);
+    __atomic_store_n(&tlb_shootdown.pending[cpu], 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Drop a torn-down kernel range from every other CPU's TLB
+ * Only interrupts other CPUs while an AP is scheduling. An initiator
+ * waiting for the lock keeps serving the shootdown in flight, as its
+ * holder may be waiting on this CPU with interrupts off
+ */
+static void tlb_shootdown_kernel(uint64_t vaddr, uint64_t npages) {
+    uint32_t cpus = smp_cpu_count();
+    if (cpus == 1) {
+        return;
+    }
+    if (cpus > SMP_MAX_CPUS) {
+        cpus = SMP_MAX_CPUS;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    uint32_t self = smp_current_cpu();
+
+    while (!spin_trylock(&tlb_shootdown.lock)) {
+        tlb_shootdown_service(self);
+        __asm__ volatile ("pause" ::: "memory");
+    }
+
+    tlb_shootdown.vaddr = vaddr;
+    tlb_shootdown.npages = npages;
+
+    uint32_t sent = 0;
+    for (uint32_t cpu = 0; cpu < cpus; cpu++) {
+        if (cpu == self || !tlb_shootdown_target(cpu)) {
+            continue;
+        }
+        __atomic_store_n(&tlb_shootdown.pending[cpu], 1, __ATOMIC_RELEASE);
+        smp_send_ipi(cpu, IRQ_TLB_SHOOTDOWN_VECTOR);
+        sent++;
+    }
+
+    /* CPUs that left the scheduler for good no longer owe the flush */
+    for (uint32_t cpu = 0; cpu < cpus && sent; cpu++) {
+        while (__atomic_load_n(&tlb_shootdown.pending[cpu], __ATOMIC_ACQUIRE)) {
+            if (!tlb_shootdown_target(cpu)) {
+                tlb_shootdown.pending[cpu] = 0;
+                break;
+            }
+            __asm__ volatile ("pause" ::: "memory");
+        }
+    }
+
+    if (sent) {
+        tlb_shootdown.shootdowns++;
+        tlb_shootdown.ipis += sent;
+    }
+
+    spin_unlock(&tlb_shootdown.lock);
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Shootdown IPI handler (interrupts disabled)
+ */
+void paging_handle_tlb_shootdown(void) {
+    tlb_shootdown_service(smp_current_cpu());
+}
+
+/*
+ * Drop every translation this CPU holds, global kernel ones included
+ */
+void paging_flush_local_tlb(void) {
+    if (global_pages_enabled) {
+        flush_tlb_global();
+    } else {
+        flush_tlb();
+    }
+}
+
+void get_tlb_shootdown_stats(uint64_t *shootdowns, uint64_t *ipis) {
+    if (shootdowns) {
+        *shootdowns = tlb_shootdown.shootdowns;
+    }
+    if (ipis) {
+        *ipis = tlb_shootdown.ipis;
+    }
+}
+
+/* ========================================================================
+ * PCID MANAGEMENT
+ * ======================================================================== */
+
+/*
+ * Give a new process page directory its own PCID
+ * The directory starts with a stale generation so its first load flushes
+ * whatever a previous owner of the PCID left in the TLB. Without PCID
+ * support, or when every PCID is taken, the directory stays untagged (0)
+ */
+void paging_assign_pcid(process_page_dir_t *page_dir) {
+    if (!page_dir) {
+        return;
+    }
+
+    page_dir->pcid = 0;
+    page_dir_tlb_stale(page_dir);
+
+    if (!pcid_state.enabled) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&pcid_state.lock);
+    for (uint32_t word = 0; word < PCID_COUNT / 64; word++) {
+        uint64_t free_bits = ~pcid_state.bitmap[word];
+        if (word == 0) {
+            free_bits &= ~1ULL;  /* PCID 0 belongs to the kernel */
+        }
+        if (!free_bits) {
+            continue;
+        }
+
+        uint32_t bit = (uint32_t)__builtin_ctzll(free_bits);
+        pcid_state.bitmap[word] |= 1ULL << bit;
+        pcid_state.in_use++;
+        page_dir->pcid = (uint16_t)(word * 64 + bit);
+        break;
+    }
+    spin_unlock_irqrestore(&pcid_state.lock, flags);
+}
+
+/*
+ * Return a destroyed directory's PCID for reuse
+ */
+void paging_release_pcid(process_page_dir_t *page_dir) {
+    if (!page_dir || page_dir->pcid == 0) {
+        return;
+    }
+
+    uint16_t pcid = page_dir->pcid;
+    uint64_t flags = spin_lock_irqsave(&pcid_state.lock);
+    pcid_state.bitmap[pcid / 64] &= ~(1ULL << (pcid % 64));
+    pcid_state.in_use--;
+    spin_unlock_irqrestore(&pcid_state.lock, flags);
+    page_dir->pcid = 0;
+}
+
+/*
+ * Compute the CR3 value that loads page_dir on the calling CPU
+ * With PCIDs the load keeps the directory's cached translations (no-flush
+ * bit) unless shared kernel mappings changed since it last ran on this CPU
+ */
+uint64_t paging_cr3_for(process_page_dir_t *page_dir) {
+    uint64_t cr3 = page_dir->pml4_phys;
+
+    if (!pcid_state.enabled) {
+        return cr3;
+    }
+
+    cr3 |= page_dir->pcid;
+
+    uint64_t flags = cpu_irq_save();
+    uint32_t cpu = smp_current_cpu();
+
+    /* An untagged process directory shares PCID 0 with the kernel */
+    if (page_dir->pcid == 0 && page_dir != &kernel_page_dir) {
+        kernel_page_dir.tlb_generation[cpu] = 0;
+        pcid_state.flush_loads[cpu]++;
+        cpu_irq_restore(flags);
+        return cr3;
+    }
+
+    uint64_t generation = __atomic_load_n(&pcid_state.kernel_generation, __ATOMIC_ACQUIRE);
+    if (pcid_state.noflush && page_dir->tlb_generation[cpu] == generation) {
+        cr3 |= CR3_NOFLUSH;
+        pcid_state.noflush_loads[cpu]++;
+    } else {
+        pcid_state.flush_loads[cpu]++;
+    }
+    page_dir->tlb_generation[cpu] = generation;
+
+    cpu_irq_restore(flags);
+    return cr3;
+}
+
+/*
+ * Kernel page directory shared by all kernel tasks
+ */
+process_page_dir_t *paging_get_kernel_directory(void) {
+    return &kernel_page_dir;
+}
+
+int paging_pcid_enabled(void) {
+    return pcid_state.enabled;
+}
+
+/*
+ * Allow or forbid no-flush CR3 loads (benchmarks compare both modes)
+ */
+void paging_set_pcid_noflush(int enable) {
+    pcid_state.noflush = enable ? 1 : 0;
+}
+
+void get_pcid_stats(uint32_t *in_use, uint64_t *noflush_loads, uint64_t *flush_loads) {
+    uint64_t noflush = 0;
+    uint64_t flush = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        noflush += pcid_state.noflush_loads[cpu];
+        flush += pcid_state.flush_loads[cpu];
+    }
+
+    if (in_use) {
+        *in_use = pcid_state.in_use;
+    }
+    if (noflush_loads) {
+        *noflush_loads = noflush;
+    }
+    if (flush_loads) {
+        *flush_loads = flush;
+    }
+}
+
+/*
+ * Turn on CR4.PCIDE when the CPU supports it
+ * Must run while CR3 still carries PCID 0
+ */
+static void init_pcid(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    if (!(ecx & CPUID_FEAT_ECX_PCID)) {
+        boot_log_debug("PCID not supported, address space switches flush the TLB");
+        return;
+    }
+
+    if (get_cr3() & CR3_PCID_MASK) {
+        boot_log_debug("CR3 low bits set, leaving PCID disabled");
+        return;
+    }
+
+    set_cr4(get_cr4() | CR4_PCIDE);
+    pcid_state.enabled = 1;
+    boot_log_debug("PCID enabled for process address spaces");
+}
+
+/*
+ * Bring a secondary CPU onto the kernel page tables
+ * Mirrors the CR4 paging features the BSP enabled so task CR3 values and
+ * global kernel mappings mean the same thing on every CPU
+ */
+void paging_init_secondary(void) {
+    set_cr3(kernel_page_dir.pml4_phys);
+
+    uint64_t cr4 = get_cr4();
+    if (global_pages_enabled) {
+        cr4 |= CR4_PGE;
+    }
+    if (pcid_state.enabled) {
+        cr4 |= CR4_PCIDE;
+    }
+    set_cr4(cr4);
+}
+
+/* ========================================================================
+ * PROCESS PAGE DIRECTORY MANAGEMENT
+ * ======================================================================== */
+
+/*
+ * Switch to a different process page directory
+ * Used for process context switching
+ */
+int switch_page_directory(process_page_dir_t *page_dir) {
+    if (!page_dir || !page_dir->pml4) {
+        kprint("switch_page_directory: Invalid page directory\n");
+        return -1;
+    }
+
+    /* Update CR3 to switch to new page directory */
+    set_cr3(paging_cr3_for(page_dir));
+    current_page_dir = page_dir;
+
+    boot_log_debug("Switched to process page directory");
+    return 0;
+}
+
+/*
+ * Get current process page directory
+ */
+process_page_dir_t *get_current_page_directory(void) {
+    return current_page_dir;
+}
+
+/* ========================================================================
+ * SYSTEM INITIALIZATION
+ * ======================================================================== */
+
+/*
+ * Initialize paging system during early kernel boot
+ * Sets up process-centric paging infrastructure
+ */
+void init_paging(void) {
+    boot_log_debug("Initializing paging system");
+
+    /* Get current CR3 value set by bootloader */
+    uint64_t cr3 = get_cr3();
+    kernel_page_dir.pml4_phys = cr3 & ~0xFFF;
+
+    /* Ensure kernel PML4 pointer references the mapped table */
+    page_table_t *pml4_ptr = phys_to_page_table_ptr(kernel_page_dir.pml4_phys);
+    if (!pml4_ptr) {
+        kernel_panic("Failed to translate kernel PML4 physical address");
+    }
+    kernel_page_dir.pml4 = pml4_ptr;
+
+    init_global_pages();
+    init_pcid();
+
+    /* Verify higher-half kernel mapping exists */
+    uint64_t kernel_phys = virt_to_phys(KERNEL_VIRTUAL_BASE);
+    if (kernel_phys == 0) {
+        kernel_panic("Higher-half kernel mapping not found");
+    }
+
+    BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
+        kprint("Higher-half kernel mapping verified at ");
+        kprint_hex(kernel_phys);
+        kprint("\n");
+    });
+
+    /* Verify identity mapping exists for early boot hardware access */
+    uint64_t identity_phys = virt_to_phys(0x100000); /* 1MB mark */
+    if (identity_phys == 0x100000 || is_hhdm_available()) {
+        boot_log_debug("Identity mapping verified");
+    } else {
+        boot_log_debug("Identity mapping not found (may be normal after early boot)");
     }
 
     boot_log_debug("Paging system initialized successfully");
@@ -722,3 +2142,40 @@ uint64_t get_page_size(uint64_t vaddr) {
     /* Must be 4KB page if PT entry exists */
     return PAGE_SIZE_4KB;
 }
+
+/*
+ * Get the flag bits of the leaf entry translating vaddr
+ * Returns 0 if the address is not mapped
+ */
+uint64_t get_page_flags(uint64_t vaddr) {
+    if (!current_page_dir || !current_page_dir->pml4) {
+        return 0;
+    }
+
+    uint64_t pml4_entry = current_page_dir->pml4->entries[pml4_index(vaddr)];
+    if (!pte_present(pml4_entry)) {
+        return 0;
+    }
+
+    page_table_t *pdpt = phys_to_page_table_ptr(pte_address(pml4_entry));
+    uint64_t pdpt_entry = pdpt->entries[pdpt_index(vaddr)];
+    if (!pte_present(pdpt_entry)) {
+        return 0;
+    }
+    if (pte_huge(pdpt_entry)) {
+        return pdpt_entry & ~PTE_ADDRESS_MASK;
+    }
+
+    page_table_t *pd = phys_to_page_table_ptr(pte_address(pdpt_entry));
+    uint64_t pd_entry = pd->entries[pd_index(vaddr)];
+    if (!pte_present(pd_entry)) {
+        return 0;
+    }
+    if (pte_huge(pd_entry)) {
+        return pd_entry & ~PTE_ADDRESS_MASK;
+    }
+
+    page_table_t *pt = phys_to_page_table_ptr(pte_address(pd_entry));
+    uint64_t pt_entry = pt->entries[pt_index(vaddr)];
+    return pte_present(pt_entry) ? (pt_entry & ~PTE_ADDRESS_MASK) : 0;
+}
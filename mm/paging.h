@@ -10,6 +10,14 @@
  */
 
 #include "../boot/constants.h"
+#include "../drivers/smp.h"
+
+/* map_range() physical bases requesting freshly allocated backing frames */
+#define MAP_RANGE_ALLOC               0ULL
+#define MAP_RANGE_ALLOC_ZERO          1ULL  /* Unaligned, so never a real base */
+
+/* unmap_range() flags */
+#define UNMAP_RANGE_FREE_FRAMES       0x1  /* Return backing frames to the page allocator */
 
 /* Page table structure - aligned as required by x86_64 */
 typedef struct {
@@ -22,6 +30,8 @@ typedef struct process_page_dir {
     uint64_t pml4_phys;                    /* Physical address of PML4 */
     uint32_t ref_count;                    /* Reference count for sharing */
     uint32_t process_id;                   /* Process ID for debugging */
+    uint16_t pcid;                         /* PCID tagging this address space (0 = kernel) */
+    uint64_t tlb_generation[SMP_MAX_CPUS]; /* Kernel TLB generation last synced under the PCID, per CPU */
     struct process_page_dir *next;         /* Link for process list */
 } process_page_dir_t;
 
@@ -33,11 +43,49 @@ uint64_t virt_to_phys(uint64_t vaddr);
 int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags);
 int map_page_2mb(uint64_t vaddr, uint64_t paddr, uint64_t flags);
 int unmap_page(uint64_t vaddr);
+int split_page_2mb(uint64_t vaddr);
+int map_range(uint64_t vaddr, uint64_t paddr, uint64_t npages, uint64_t flags);
+uint64_t unmap_range(uint64_t vaddr, uint64_t npages, uint32_t flags);
 int switch_page_directory(process_page_dir_t *page_dir);
 process_page_dir_t *get_current_page_directory(void);
 void init_paging(void);
+void paging_init_secondary(void);
+
+/* Cross-CPU TLB maintenance */
+void paging_flush_local_tlb(void);
+void paging_handle_tlb_shootdown(void);
+void get_tlb_shootdown_stats(uint64_t *shootdowns, uint64_t *ipis);
+
+/* PCID-tagged address spaces */
+void paging_assign_pcid(process_page_dir_t *page_dir);
+void paging_release_pcid(process_page_dir_t *page_dir);
+uint64_t paging_cr3_for(process_page_dir_t *page_dir);
+process_page_dir_t *paging_get_kernel_directory(void);
+int paging_pcid_enabled(void);
+void paging_set_pcid_noflush(int enable);
+void get_pcid_stats(uint32_t *in_use, uint64_t *noflush_loads, uint64_t *flush_loads);
+
+/* Copy-on-write address space sharing */
+int paging_clone_user_cow(process_page_dir_t *src, process_page_dir_t *dst, uint64_t *shared_pages);
+int paging_resolve_cow_fault(uint64_t vaddr);
+void get_cow_stats(uint64_t *copies, uint64_t *reuses);
+
+/* Page table occupancy and reclaim */
+void get_page_table_stats(uint64_t *allocated, uint64_t *reclaimed);
+
+/* Address space teardown */
+uint64_t paging_free_user_mappings(process_page_dir_t *page_dir);
+
+/* PML4 template cache for process creation */
+uint64_t paging_alloc_pml4(void);
+void paging_free_pml4(uint64_t pml4_phys);
+uint32_t paging_refill_pml4_cache(uint32_t max_pages);
+void paging_set_pml4_cache(int enable);
+void get_pml4_cache_stats(uint32_t *cached, uint64_t *hits, uint64_t *misses);
+
 int is_mapped(uint64_t vaddr);
 uint64_t get_page_size(uint64_t vaddr);
+uint64_t get_page_flags(uint64_t vaddr);
 void get_memory_layout_info(uint64_t *kernel_virt_base, uint64_t *kernel_phys_base);
 
 #endif /* MM_PAGING_H */
@@ -11,12 +11,15 @@
 #include "../boot/log.h"
 #include "../boot/integration.h"
 #include "kernel_heap.h"
+#include "kmem_cache.h"
 #include "page_alloc.h"
 #include "paging.h"
 #include "phys_virt.h"
+#include "vmem_regions.h"
 
 /* Forward declarations */
 void kernel_panic(const char *message);
+int destroy_process_vm(uint32_t process_id);
 
 /* ========================================================================
  * PROCESS VIRTUAL MEMORY CONSTANTS
@@ -32,6 +35,9 @@ void kernel_panic(const char *message);
 
 /* Process limits are defined in boot/constants.h */
 
+/* PML4 pages built ahead of the first process creations */
+#define PROCESS_PML4_PREFILL          4
+
 /* Process memory allocation flags */
 #define VM_FLAG_READ                  0x01   /* Page is readable */
 #define VM_FLAG_WRITE                 0x02   /* Page is writable */
@@ -80,6 +86,9 @@ typedef struct vm_manager {
 /* Global VM manager instance */
 static vm_manager_t vm_manager = {0};
 
+/* Object cache backing VMA descriptors */
+static kmem_cache_t *vma_cache = NULL;
+
 /* ========================================================================
  * UTILITY FUNCTIONS
  * ======================================================================== */
@@ -89,7 +98,7 @@ static vm_manager_t vm_manager = {0};
  * Returns pointer to VMA, NULL on failure
  */
 static vm_area_t *alloc_vma(void) {
-    vm_area_t *vma = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+    vm_area_t *vma = (vm_area_t *)kmem_cache_alloc(vma_cache);
     if (!vma) {
         kprint("alloc_vma: Failed to allocate VMA structure\n");
         return NULL;
@@ -110,13 +119,10 @@ static vm_area_t *alloc_vma(void) {
 static void free_vma(vm_area_t *vma) {
     if (!vma) return;
 
-    kfree(vma);
+    kmem_cache_free(vma_cache, vma);
 }
 
 static int map_user_range(uint64_t start_addr, uint64_t end_addr, uint64_t map_flags, uint32_t *pages_mapped_out) {
-    extern process_page_dir_t *get_current_page_directory(void);
-    extern int switch_page_directory(process_page_dir_t *page_dir);
-    
     if (start_addr & (PAGE_SIZE_4KB - 1) || end_addr & (PAGE_SIZE_4KB - 1) || end_addr <= start_addr) {
         kprint("map_user_range: Unaligned or invalid range\n");
         return -1;
@@ -124,47 +130,22 @@ static int map_user_range(uint64_t start_addr, uint64_t end_addr, uint64_t map_f
 
     /* This function should be called with the target process's page directory already active */
     /* But if not, we'll use the current one (which should be the process's during creation) */
-    
-    uint64_t current = start_addr;
-    uint32_t mapped = 0;
-
-    while (current < end_addr) {
-        uint64_t phys = alloc_page_frame(0);
-        if (!phys) {
-            kprint("map_user_range: Physical allocation failed\n");
-            goto rollback;
-        }
 
-        if (map_page_4kb(current, phys, map_flags) != 0) {
-            kprint("map_user_range: Virtual mapping failed\n");
-            free_page_frame(phys);
-            goto rollback;
-        }
+    uint64_t pages = (end_addr - start_addr) / PAGE_SIZE_4KB;
 
-        mapped++;
-        current += PAGE_SIZE_4KB;
-    }
-
-    if (pages_mapped_out) {
-        *pages_mapped_out = mapped;
-    }
-    return 0;
-
-rollback:
-    while (mapped > 0) {
-        current -= PAGE_SIZE_4KB;
-        uint64_t phys = mm_virt_to_phys(current);
-        if (phys) {
-            unmap_page(current);
-            free_page_frame(phys);
+    /* map_range rolls back its own partial work on failure */
+    if (map_range(start_addr, MAP_RANGE_ALLOC, pages, map_flags) != 0) {
+        kprint("map_user_range: Range mapping failed\n");
+        if (pages_mapped_out) {
+            *pages_mapped_out = 0;
         }
-        mapped--;
+        return -1;
     }
 
     if (pages_mapped_out) {
-        *pages_mapped_out = 0;
+        *pages_mapped_out = (uint32_t)pages;
     }
-    return -1;
+    return 0;
 }
 
 static void unmap_user_range(uint64_t start_addr, uint64_t end_addr) {
@@ -172,25 +153,22 @@ static void unmap_user_range(uint64_t start_addr, uint64_t end_addr) {
         return;
     }
 
-    for (uint64_t addr = start_addr; addr < end_addr; addr += PAGE_SIZE_4KB) {
-        uint64_t phys = mm_virt_to_phys(addr);
-        if (phys) {
-            unmap_page(addr);
-            free_page_frame(phys);
-        }
-    }
+    uint64_t first_page = start_addr & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+    uint64_t pages = (end_addr - first_page + PAGE_SIZE_4KB - 1) / PAGE_SIZE_4KB;
+    unmap_range(first_page, pages, UNMAP_RANGE_FREE_FRAMES);
 }
 
 /*
  * Find process VM descriptor by process ID
+ * A process always occupies the slot indexed by its PID modulo MAX_PROCESSES
  */
 static process_vm_t *find_process_vm(uint32_t process_id) {
-    for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
-        if (vm_manager.processes[i].process_id == process_id) {
-            return &vm_manager.processes[i];
-        }
+    if (process_id == INVALID_PROCESS_ID) {
+        return NULL;
     }
-    return NULL;
+
+    process_vm_t *process = &vm_manager.processes[process_id % MAX_PROCESSES];
+    return (process->process_id == process_id) ? process : NULL;
 }
 
 /*
@@ -266,55 +244,63 @@ static int remove_vma_from_process(process_vm_t *process, uint64_t start, uint64
  * ======================================================================== */
 
 /*
- * Create a new process virtual memory space
- * Returns process ID, INVALID_PROCESS_ID on failure
+ * Claim a free process slot and give it a fresh page directory
+ * The directory inherits the kernel mappings and gets a PCID; the caller
+ * adds user mappings and links the process into the global list.
+ * Returns NULL on failure
  */
-uint32_t create_process_vm(void) {
+static process_vm_t *alloc_process_vm(void) {
     if (vm_manager.num_processes >= MAX_PROCESSES) {
         kprint("create_process_vm: Maximum processes reached\n");
-        return INVALID_PROCESS_ID;
+        return NULL;
     }
 
-    /* Find first free process slot */
+    /*
+     * Take the next PID whose slot is free so lookups index slots directly.
+     * Fewer than MAX_PROCESSES are live, so MAX_PROCESSES candidates (plus
+     * the two reserved IDs on wraparound) cover every slot
+     */
     process_vm_t *process = NULL;
-    for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
-        if (vm_manager.processes[i].process_id == INVALID_PROCESS_ID) {
-            process = &vm_manager.processes[i];
-            break;
+    uint32_t process_id = INVALID_PROCESS_ID;
+    for (uint32_t tries = 0; tries < MAX_PROCESSES + 2 && !process; tries++) {
+        uint32_t candidate = vm_manager.next_process_id++;
+        if (candidate == 0 || candidate == INVALID_PROCESS_ID) {
+            continue;  /* 0 is the kernel */
+        }
+
+        process_vm_t *slot = &vm_manager.processes[candidate % MAX_PROCESSES];
+        if (slot->process_id == INVALID_PROCESS_ID) {
+            process = slot;
+            process_id = candidate;
         }
     }
 
     if (!process) {
         kprint("create_process_vm: No free process slots available\n");
-        return INVALID_PROCESS_ID;
+        return NULL;
     }
 
-    /* Allocate new page directory */
-    uint64_t pml4_phys = alloc_page_frame(0);
+    /* Take a PML4 that already carries the kernel mappings */
+    uint64_t pml4_phys = paging_alloc_pml4();
     if (!pml4_phys) {
         kprint("create_process_vm: Failed to allocate PML4\n");
-        return INVALID_PROCESS_ID;
+        return NULL;
     }
 
     /* Prepare new page table */
     page_table_t *pml4 = (page_table_t *)mm_phys_to_virt(pml4_phys);
     if (!pml4) {
         kprint("create_process_vm: No HHDM/identity map available for PML4\n");
-        free_page_frame(pml4_phys);
-        return INVALID_PROCESS_ID;
-    }
-    for (uint32_t i = 0; i < ENTRIES_PER_PAGE_TABLE; i++) {
-        pml4->entries[i] = 0;
+        paging_free_pml4(pml4_phys);
+        return NULL;
     }
 
-    uint32_t process_id = vm_manager.next_process_id++;
-
     /* Allocate process page directory descriptor */
     process_page_dir_t *page_dir = (process_page_dir_t*)kmalloc(sizeof(process_page_dir_t));
     if (!page_dir) {
         kprint("create_process_vm: Failed to allocate page directory\n");
-        free_page_frame(pml4_phys);
-        return INVALID_PROCESS_ID;
+        paging_free_pml4(pml4_phys);
+        return NULL;
     }
 
     page_dir->pml4 = pml4;
@@ -323,8 +309,8 @@ uint32_t create_process_vm(void) {
     page_dir->process_id = process_id;
     page_dir->next = NULL;
 
-    /* Inherit kernel mappings */
-    paging_copy_kernel_mappings(page_dir->pml4);
+    /* Tag the address space so switches to it can keep its TLB entries */
+    paging_assign_pcid(page_dir);
 
     /* Initialize process VM descriptor */
     process->process_id = process_id;
@@ -340,6 +326,42 @@ uint32_t create_process_vm(void) {
     process->flags = 0;
     process->next = vm_manager.process_list;
 
+    return process;
+}
+
+/*
+ * Undo alloc_process_vm for a process that never went live
+ */
+static void release_process_vm(process_vm_t *process) {
+    vm_area_t *vma = process->vma_list;
+    while (vma) {
+        vm_area_t *next = vma->next;
+        free_vma(vma);
+        vma = next;
+    }
+
+    paging_release_pcid(process->page_dir);
+    paging_free_pml4(process->page_dir->pml4_phys);
+    kfree(process->page_dir);
+    process->page_dir = NULL;
+    process->vma_list = NULL;
+    process->next = NULL;
+    process->process_id = INVALID_PROCESS_ID;
+}
+
+/*
+ * Create a new process virtual memory space
+ * Returns process ID, INVALID_PROCESS_ID on failure
+ */
+uint32_t create_process_vm(void) {
+    process_vm_t *process = alloc_process_vm();
+    if (!process) {
+        return INVALID_PROCESS_ID;
+    }
+
+    uint32_t process_id = process->process_id;
+    process_page_dir_t *page_dir = process->page_dir;
+
     /* Add standard VMA regions */
     add_vma_to_process(process, process->code_start, process->data_start,
                        VM_FLAG_READ | VM_FLAG_EXEC | VM_FLAG_USER);
@@ -350,15 +372,12 @@ uint32_t create_process_vm(void) {
 
     /* Map initial stack pages eagerly */
     /* Temporarily switch to process page directory for mapping */
-    extern process_page_dir_t *get_current_page_directory(void);
-    extern int switch_page_directory(process_page_dir_t *page_dir);
     process_page_dir_t *saved_page_dir = get_current_page_directory();
     
     /* Switch to process's page directory */
     if (switch_page_directory(page_dir) != 0) {
         kprint("create_process_vm: Failed to switch to process page directory\n");
-        free_page_frame(page_dir->pml4_phys);
-        kfree(page_dir);
+        release_process_vm(process);
         return INVALID_PROCESS_ID;
     }
     
@@ -371,10 +390,7 @@ uint32_t create_process_vm(void) {
             switch_page_directory(saved_page_dir);
         }
         unmap_user_range(process->stack_start, process->stack_end);
-        free_page_frame(process->page_dir->pml4_phys);
-        kfree(process->page_dir);
-        process->page_dir = NULL;
-        process->process_id = INVALID_PROCESS_ID;
+        release_process_vm(process);
         return INVALID_PROCESS_ID;
     }
     
@@ -396,6 +412,72 @@ uint32_t create_process_vm(void) {
     return process_id;
 }
 
+/*
+ * Clone a process virtual memory space copy-on-write
+ * Every user page is shared read-only with its reference count bumped;
+ * the first write from either side copies only the touched page, so a
+ * clone costs page-table copies rather than memory copies. The child
+ * gets its own copy of the parent's VMA regions.
+ * Returns the new process ID, INVALID_PROCESS_ID on failure
+ */
+uint32_t process_vm_clone(uint32_t process_id) {
+    process_vm_t *parent = find_process_vm(process_id);
+    if (process_id == INVALID_PROCESS_ID || !parent || !parent->page_dir) {
+        kprint("process_vm_clone: Invalid source process\n");
+        return INVALID_PROCESS_ID;
+    }
+
+    process_vm_t *child = alloc_process_vm();
+    if (!child) {
+        return INVALID_PROCESS_ID;
+    }
+
+    child->code_start = parent->code_start;
+    child->data_start = parent->data_start;
+    child->heap_start = parent->heap_start;
+    child->heap_end = parent->heap_end;
+    child->stack_start = parent->stack_start;
+    child->stack_end = parent->stack_end;
+    child->flags = parent->flags;
+
+    for (vm_area_t *vma = parent->vma_list; vma; vma = vma->next) {
+        if (add_vma_to_process(child, vma->start_addr, vma->end_addr, vma->flags) != 0) {
+            kprint("process_vm_clone: Failed to copy VMA list\n");
+            release_process_vm(child);
+            return INVALID_PROCESS_ID;
+        }
+    }
+
+    /* Link first so a partial clone is torn down like any other process */
+    uint32_t child_id = child->process_id;
+    vm_manager.process_list = child;
+    vm_manager.num_processes++;
+
+    uint64_t shared_pages = 0;
+    if (paging_clone_user_cow(parent->page_dir, child->page_dir, &shared_pages) != 0) {
+        kprint("process_vm_clone: Failed to share user mappings\n");
+        destroy_process_vm(child_id);
+        return INVALID_PROCESS_ID;
+    }
+
+    child->total_pages += (uint32_t)shared_pages;
+
+    /* Demand paging in the child needs the parent's regions as well */
+    if (clone_process_vma_space(process_id, child_id) != 0) {
+        kprint("process_vm_clone: Failed to clone VMA regions\n");
+        destroy_process_vm(child_id);
+        return INVALID_PROCESS_ID;
+    }
+
+    kprint("Cloned process VM space for PID ");
+    kprint_decimal(process_id);
+    kprint(" as PID ");
+    kprint_decimal(child_id);
+    kprint("\n");
+
+    return child_id;
+}
+
 /*
  * Destroy a process virtual memory space
  * Frees all allocated pages and removes from system
@@ -417,37 +499,31 @@ int destroy_process_vm(uint32_t process_id) {
     kprint_decimal(process_id);
     kprint("\n");
 
-    /* Switch to process's page directory for unmapping */
-    extern process_page_dir_t *get_current_page_directory(void);
-    extern int switch_page_directory(process_page_dir_t *page_dir);
-    process_page_dir_t *saved_page_dir = get_current_page_directory();
-    
-    if (process->page_dir && switch_page_directory(process->page_dir) != 0) {
-        kprint("destroy_process_vm: Failed to switch to process page directory\n");
-        /* Continue with cleanup even if switch fails */
-    }
-
-    /* Free all VMAs */
+    /* Free all VMAs; their pages go with the page tables below */
     vm_area_t *vma = process->vma_list;
     while (vma) {
-        if (vma->flags & VM_FLAG_USER) {
-            unmap_user_range(vma->start_addr, vma->end_addr);
-        }
         vm_area_t *next = vma->next;
         free_vma(vma);
         vma = next;
     }
     process->vma_list = NULL;
 
-    /* Switch back to kernel page directory */
-    if (saved_page_dir && saved_page_dir != process->page_dir) {
-        switch_page_directory(saved_page_dir);
-    }
-
     /* Free page directory structures */
     if (process->page_dir) {
+        /* Never leave CR3 on a PML4 that is about to be freed */
+        if (get_current_page_directory() == process->page_dir) {
+            switch_page_directory(paging_get_kernel_directory());
+        }
+
+        /*
+         * One pass over the user half frees every mapping, including ones
+         * made outside the VMA list, and the tables holding them. Shared
+         * copy-on-write frames just lose this space's reference
+         */
+        paging_free_user_mappings(process->page_dir);
+        paging_release_pcid(process->page_dir);
         if (process->page_dir->pml4_phys) {
-            free_page_frame(process->page_dir->pml4_phys);
+            paging_free_pml4(process->page_dir->pml4_phys);
         }
         kfree(process->page_dir);
         process->page_dir = NULL;
@@ -594,6 +670,14 @@ int init_process_vm(void) {
     vm_manager.active_process = NULL;
     vm_manager.process_list = NULL;
 
+    if (!vma_cache) {
+        vma_cache = kmem_cache_create("vm_area", sizeof(vm_area_t), 0);
+        if (!vma_cache) {
+            boot_log_info("init_process_vm: Failed to create VMA cache");
+            return -1;
+        }
+    }
+
     /* Initialize all process slots */
     for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
         vm_manager.processes[i].process_id = INVALID_PROCESS_ID;
@@ -604,6 +688,8 @@ int init_process_vm(void) {
         vm_manager.processes[i].next = NULL;
     }
 
+    paging_refill_pml4_cache(PROCESS_PML4_PREFILL);
+
     boot_log_debug("Process VM manager initialized");
     return 0;
 }
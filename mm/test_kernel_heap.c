@@ -1,13 +1,19 @@
 /*
  * SlopOS Kernel Heap Regression Tests
- * Tests for heap free-list search correctness and fragmentation handling
+ * Tests for heap free-list search correctness, fragmentation handling,
+ * kfree coalescing cost, heap trimming, the large allocation path and its
+ * fallback once the span table is full, huge-page heap backing and the
+ * slab object caches layered under kmalloc
  */
 
 #include <stdint.h>
 #include <stddef.h>
 #include "../boot/constants.h"
 #include "../drivers/serial.h"
+#include "../lib/cpu.h"
 #include "kernel_heap.h"
+#include "kmem_cache.h"
+#include "paging.h"
 
 /* ========================================================================
  * HEAP REGRESSION TESTS
@@ -37,32 +43,37 @@ int test_heap_free_list_search(void) {
     kprint_decimal(initial_heap_size);
     kprint(" bytes\n");
 
+    /*
+     * Sizes stay between KMEM_CACHE_MAX_KMALLOC_SIZE and the 64KB large
+     * allocation threshold so the requests exercise the heap free lists
+     */
+
     /* Step 1: Allocate a small block that will be at the head */
-    void *small_ptr = kmalloc(32);
+    void *small_ptr = kmalloc(4096);
     if (!small_ptr) {
         kprint("HEAP_TEST: Failed to allocate small block\n");
         return -1;
     }
-    kprint("HEAP_TEST: Allocated small block at head (32 bytes)\n");
+    kprint("HEAP_TEST: Allocated small block at head (4096 bytes)\n");
 
     /* Step 2: Allocate a larger block (this will be in a larger size class or later) */
-    void *large_ptr = kmalloc(1024);
+    void *large_ptr = kmalloc(32768);
     if (!large_ptr) {
         kprint("HEAP_TEST: Failed to allocate large block\n");
         kfree(small_ptr);
         return -1;
     }
-    kprint("HEAP_TEST: Allocated large block (1024 bytes)\n");
+    kprint("HEAP_TEST: Allocated large block (32768 bytes)\n");
 
     /* Step 3: Allocate another medium block to create fragmentation */
-    void *medium_ptr = kmalloc(256);
+    void *medium_ptr = kmalloc(8192);
     if (!medium_ptr) {
         kprint("HEAP_TEST: Failed to allocate medium block\n");
         kfree(small_ptr);
         kfree(large_ptr);
         return -1;
     }
-    kprint("HEAP_TEST: Allocated medium block (256 bytes)\n");
+    kprint("HEAP_TEST: Allocated medium block (8192 bytes)\n");
 
     get_heap_stats(&stats_mid);
     uint64_t mid_heap_size = stats_mid.total_size;
@@ -79,12 +90,12 @@ int test_heap_free_list_search(void) {
 
     /* Step 5: Now allocate a size that should fit in the large freed block
      * but might be in a size class where small block is at head
-     * We need to request something larger than the small block (32) but
-     * that could be satisfied by the large block (1024+256 coalesced potentially)
+     * We need to request something larger than the small block (4096) but
+     * that could be satisfied by the large block (32768 coalesced potentially)
      */
-    void *requested_size = kmalloc(512);
+    void *requested_size = kmalloc(16384);
     if (!requested_size) {
-        kprint("HEAP_TEST: Failed to allocate 512-byte block (should have found free space)\n");
+        kprint("HEAP_TEST: Failed to allocate 16384-byte block (should have found free space)\n");
         kfree(medium_ptr);
         get_heap_stats(&stats_after);
         
@@ -95,7 +106,7 @@ int test_heap_free_list_search(void) {
         }
         return -1;
     }
-    kprint("HEAP_TEST: Successfully allocated 512-byte block\n");
+    kprint("HEAP_TEST: Successfully allocated 16384-byte block\n");
 
     get_heap_stats(&stats_after);
     uint64_t final_heap_size = stats_after.total_size;
@@ -153,7 +164,7 @@ int test_heap_fragmentation_behind_head(void) {
 
     /* Allocate several blocks of similar size (same size class) */
     void *ptrs[5];
-    size_t sizes[] = {128, 256, 128, 512, 256}; /* Mix to create same-size-class blocks */
+    size_t sizes[] = {4096, 8192, 4096, 16384, 8192}; /* Mix to create same-size-class blocks (above slab sizes) */
     
     for (int i = 0; i < 5; i++) {
         ptrs[i] = kmalloc(sizes[i]);
@@ -184,14 +195,14 @@ int test_heap_fragmentation_behind_head(void) {
     kprint("HEAP_TEST: Freed block 2 (small)\n");
 
     /* Now free a larger one (index 1 or 3) */
-    kfree(ptrs[3]); /* 512 bytes - larger */
+    kfree(ptrs[3]); /* 16384 bytes - larger */
     kprint("HEAP_TEST: Freed block 3 (large, should be behind head in list)\n");
 
     /* Now try to allocate something that needs the large block but is in same size class */
-    /* Request something larger than the small blocks but that fits in the 512-byte block */
-    void *needed = kmalloc(400); /* Needs more than small blocks, fits in 512 */
+    /* Request something larger than the small blocks but that fits in the 16384-byte block */
+    void *needed = kmalloc(12800); /* Needs more than small blocks, fits in 16384 */
     if (!needed) {
-        kprint("HEAP_TEST: Failed to allocate 400-byte block\n");
+        kprint("HEAP_TEST: Failed to allocate 12800-byte block\n");
         kfree(ptrs[1]);
         kfree(ptrs[4]);
         get_heap_stats(&stats_after);
@@ -233,6 +244,476 @@ int test_heap_fragmentation_behind_head(void) {
     return 0;
 }
 
+/*
+ * Test: Object cache slab lifecycle
+ *
+ * Fills one slab, spills into a second, then frees everything and checks
+ * that only a single empty slab is retained by the cache.
+ */
+int test_kmem_cache_slab_lifecycle(void) {
+    kprint("HEAP_TEST: Starting object cache slab lifecycle test\n");
+
+    kmem_cache_t *cache = kmem_cache_create("test-48", 48, 0);
+    if (!cache) {
+        kprint("HEAP_TEST: Failed to create object cache\n");
+        return -1;
+    }
+
+    kmem_cache_stats_t stats;
+    kmem_cache_get_stats(cache, &stats);
+    uint32_t count = stats.objects_per_slab + 1;
+
+    if (count > 512) {
+        kprint("HEAP_TEST: Unexpected objects per slab\n");
+        kmem_cache_destroy(cache);
+        return -1;
+    }
+
+    static void *objects[512];
+    int result = 0;
+    uint32_t allocated = 0;
+
+    for (; allocated < count; allocated++) {
+        objects[allocated] = kmem_cache_alloc(cache);
+        if (!objects[allocated]) {
+            kprint("HEAP_TEST: Object cache allocation failed\n");
+            result = -1;
+            break;
+        }
+        if (((uintptr_t)objects[allocated] & 7) != 0) {
+            kprint("HEAP_TEST: Object cache returned misaligned object\n");
+            allocated++;
+            result = -1;
+            break;
+        }
+    }
+
+    if (result == 0) {
+        kmem_cache_get_stats(cache, &stats);
+        if (stats.active_objects != count || stats.total_slabs != 2) {
+            kprint("HEAP_TEST: Expected two slabs after spilling one full slab\n");
+            result = -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < allocated; i++) {
+        kmem_cache_free(cache, objects[i]);
+    }
+
+    kmem_cache_get_stats(cache, &stats);
+    if (result == 0 && (stats.active_objects != 0 || stats.total_slabs != 1 ||
+                        stats.slabs_released != 1)) {
+        kprint("HEAP_TEST: Empty slabs were not released back to the page allocator\n");
+        result = -1;
+    }
+
+    /* A freed object must be handed out again before fresh slab space */
+    if (result == 0) {
+        void *first = kmem_cache_alloc(cache);
+        kmem_cache_free(cache, first);
+        void *second = kmem_cache_alloc(cache);
+        if (!first || first != second) {
+            kprint("HEAP_TEST: Object cache did not reuse freed object\n");
+            result = -1;
+        }
+        kmem_cache_free(cache, second);
+    }
+
+    /* A second free of the same object must be rejected */
+    if (result == 0) {
+        void *keep = kmem_cache_alloc(cache);
+        void *object = kmem_cache_alloc(cache);
+        kmem_cache_free(cache, object);
+        kmem_cache_free(cache, object);
+        kmem_cache_get_stats(cache, &stats);
+        void *a = kmem_cache_alloc(cache);
+        void *b = kmem_cache_alloc(cache);
+        if (!keep || !object || stats.active_objects != 1 || !a || a == b) {
+            kprint("HEAP_TEST: Object cache accepted a double free\n");
+            result = -1;
+        }
+        kmem_cache_free(cache, a);
+        kmem_cache_free(cache, b);
+        kmem_cache_free(cache, keep);
+    }
+
+    if (kmem_cache_destroy(cache) != 0) {
+        kprint("HEAP_TEST: Failed to destroy object cache\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("HEAP_TEST: Object cache slab lifecycle test PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Small kmalloc requests bypass the heap free lists
+ */
+int test_kmalloc_small_uses_slab(void) {
+    kprint("HEAP_TEST: Starting small kmalloc routing test\n");
+
+    heap_stats_t stats_before, stats_after;
+    get_heap_stats(&stats_before);
+
+    void *small = kmalloc(24);
+    void *edge = kmalloc(KMEM_CACHE_MAX_KMALLOC_SIZE);
+    int result = 0;
+
+    if (!small || !edge) {
+        kprint("HEAP_TEST: Small kmalloc failed\n");
+        result = -1;
+    } else if (!kmem_cache_owns(small) || !kmem_cache_owns(edge)) {
+        kprint("HEAP_TEST: Small kmalloc was not served by an object cache\n");
+        result = -1;
+    }
+
+    get_heap_stats(&stats_after);
+    if (result == 0 && stats_after.allocation_count != stats_before.allocation_count) {
+        kprint("HEAP_TEST: Small kmalloc touched the heap free lists\n");
+        result = -1;
+    }
+
+    kfree(small);
+    kfree(edge);
+
+    if (result == 0) {
+        kprint("HEAP_TEST: Small kmalloc routing test PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Benchmark: kfree latency as the free-block count grows
+ *
+ * Allocates pairs of heap blocks and frees every other one so the free
+ * lists fill with blocks that cannot merge. At each checkpoint a batch of
+ * blocks sitting between two free neighbours is released, forcing both
+ * boundary-tag lookups. Average cycles per kfree must stay roughly flat.
+ */
+#define KFREE_BENCH_PAIRS             16384
+#define KFREE_BENCH_BATCH             128
+#define KFREE_BENCH_BLOCK_SIZE        (KMEM_CACHE_MAX_KMALLOC_SIZE + 512)
+#define KFREE_BENCH_MAX_SLOWDOWN      4
+
+int test_heap_kfree_latency_scaling(void) {
+    kprint("HEAP_TEST: Starting kfree latency scaling benchmark\n");
+
+    const uint32_t block_count = KFREE_BENCH_PAIRS * 2;
+    void **blocks = kmalloc(sizeof(void *) * block_count);
+    if (!blocks) {
+        kprint("HEAP_TEST: Failed to allocate benchmark pointer table\n");
+        return -1;
+    }
+
+    uint32_t allocated = 0;
+    for (; allocated < block_count; allocated++) {
+        blocks[allocated] = kmalloc(KFREE_BENCH_BLOCK_SIZE);
+        if (!blocks[allocated]) {
+            break;
+        }
+    }
+
+    if (allocated < block_count) {
+        kprint("HEAP_TEST: Benchmark could only allocate ");
+        kprint_decimal(allocated);
+        kprint(" blocks\n");
+        for (uint32_t i = 0; i < allocated; i++) {
+            kfree(blocks[i]);
+        }
+        kfree(blocks);
+        return -1;
+    }
+
+    static const uint32_t checkpoints[] = { 1024, 4096, KFREE_BENCH_PAIRS };
+    uint64_t first_avg = 0;
+    uint64_t last_avg = 0;
+    uint32_t freed_pairs = 0;
+
+    for (uint32_t c = 0; c < sizeof(checkpoints) / sizeof(checkpoints[0]); c++) {
+        /* Grow the population of unmergeable free blocks */
+        for (; freed_pairs < checkpoints[c]; freed_pairs++) {
+            kfree(blocks[freed_pairs * 2]);
+            blocks[freed_pairs * 2] = NULL;
+        }
+
+        heap_stats_t stats;
+        get_heap_stats(&stats);
+
+        /* Free odd blocks whose neighbours on both sides are already free */
+        uint32_t first_pair = freed_pairs - 1 - KFREE_BENCH_BATCH * 2;
+        uint64_t start = cpu_read_tsc();
+        for (uint32_t i = 0; i < KFREE_BENCH_BATCH; i++) {
+            uint32_t index = (first_pair + i * 2) * 2 + 1;
+            kfree(blocks[index]);
+            blocks[index] = NULL;
+        }
+        uint64_t avg = (cpu_read_tsc() - start) / KFREE_BENCH_BATCH;
+
+        kprint("HEAP_TEST:   ");
+        kprint_decimal(stats.free_blocks);
+        kprint(" free blocks: ");
+        kprint_decimal(avg);
+        kprint(" cycles per kfree\n");
+
+        if (c == 0) {
+            first_avg = avg;
+        }
+        last_avg = avg;
+    }
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        if (blocks[i]) {
+            kfree(blocks[i]);
+        }
+    }
+    kfree(blocks);
+
+    if (last_avg > (first_avg + 1) * KFREE_BENCH_MAX_SLOWDOWN) {
+        kprint("HEAP_TEST: FAILED - kfree latency grows with free-block count\n");
+        return -1;
+    }
+
+    kprint("HEAP_TEST: kfree latency scaling benchmark PASSED\n");
+    return 0;
+}
+
+/*
+ * Test: kheap_trim returns free heap pages and trimmed blocks are reusable
+ */
+int test_heap_trim_releases_pages(void) {
+    kprint("HEAP_TEST: Starting heap trim test\n");
+
+    const size_t region_size = 60 * 1024;
+
+    void *before = kmalloc(16384);
+    void *region = kmalloc(region_size);
+    void *after = kmalloc(16384);
+    if (!before || !region || !after) {
+        kprint("HEAP_TEST: Failed to allocate trim test blocks\n");
+        kfree(before);
+        kfree(region);
+        kfree(after);
+        return -1;
+    }
+
+    heap_stats_t stats_before, stats_after;
+    get_heap_stats(&stats_before);
+
+    /* kfree may already trim if the hole joins a large free tail */
+    kfree(region);
+    kheap_trim();
+    get_heap_stats(&stats_after);
+
+    uint64_t released = stats_after.trimmed_bytes - stats_before.trimmed_bytes;
+    int result = 0;
+
+    /* Everything but the header and footer pages of the hole can go */
+    if (released < region_size - 2 * PAGE_SIZE_4KB ||
+        stats_after.total_size >= stats_before.total_size) {
+        kprint("HEAP_TEST: FAILED - heap trim released ");
+        kprint_decimal(released);
+        kprint(" bytes\n");
+        result = -1;
+    }
+
+    /* Reuse the trimmed hole; every page must be backed again */
+    uint8_t *reuse = kmalloc(region_size);
+    if (!reuse) {
+        kprint("HEAP_TEST: Failed to allocate from trimmed heap\n");
+        result = -1;
+    } else {
+        for (size_t i = 0; i < region_size; i += PAGE_SIZE_4KB) {
+            reuse[i] = (uint8_t)i;
+        }
+        reuse[region_size - 1] = 0xA5;
+        kfree(reuse);
+    }
+
+    kfree(before);
+    kfree(after);
+
+    if (result == 0) {
+        kprint("HEAP_TEST: Heap trim test PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Allocations above the large threshold get their own page span
+ */
+int test_kmalloc_large_span(void) {
+    kprint("HEAP_TEST: Starting large allocation span test\n");
+
+    /* Larger than the old 1MB kmalloc limit */
+    const size_t large_size = 3 * 1024 * 1024 + 123;
+
+    heap_stats_t stats_before, stats_mid, stats_after;
+    get_heap_stats(&stats_before);
+
+    uint8_t *buffer = kmalloc(large_size);
+    if (!buffer) {
+        kprint("HEAP_TEST: Failed to allocate large span\n");
+        return -1;
+    }
+
+    int result = 0;
+
+    if (((uintptr_t)buffer & (PAGE_SIZE_4KB - 1)) != 0) {
+        kprint("HEAP_TEST: Large span is not page aligned\n");
+        result = -1;
+    }
+
+    for (size_t i = 0; i < large_size; i += PAGE_SIZE_4KB) {
+        buffer[i] = (uint8_t)(i >> 12);
+    }
+    buffer[large_size - 1] = 0x5A;
+
+    get_heap_stats(&stats_mid);
+    if (stats_mid.large_allocations != stats_before.large_allocations + 1 ||
+        stats_mid.total_size != stats_before.total_size) {
+        kprint("HEAP_TEST: Large span was served from the heap free lists\n");
+        result = -1;
+    }
+
+    kfree(buffer);
+
+    get_heap_stats(&stats_after);
+    if (stats_after.large_allocations != stats_before.large_allocations ||
+        stats_after.large_allocated_size != stats_before.large_allocated_size) {
+        kprint("HEAP_TEST: Large span was not released\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("HEAP_TEST: Large allocation span test PASSED\n");
+    }
+    return result;
+}
+
+/* Large allocations made by the span table test, past its 256 entries */
+#define HEAP_TEST_LARGE_SPANS       264
+static uint8_t *heap_test_large_blocks[HEAP_TEST_LARGE_SPANS];
+
+/*
+ * Test: Large allocations keep succeeding once the span table is full
+ * Requests past the table's capacity must fall back to the free lists
+ * instead of failing while memory is still available
+ */
+int test_kmalloc_large_table_full(void) {
+    kprint("HEAP_TEST: Starting large span table overflow test\n");
+
+    const size_t large_size = 64 * 1024 + 1;
+
+    heap_stats_t stats_before, stats_mid;
+    get_heap_stats(&stats_before);
+
+    int result = 0;
+    uint32_t count = 0;
+    for (; count < HEAP_TEST_LARGE_SPANS; count++) {
+        heap_test_large_blocks[count] = kmalloc(large_size);
+        if (!heap_test_large_blocks[count]) {
+            kprint("HEAP_TEST: FAILED - large allocation ");
+            kprint_decimal(count);
+            kprint(" failed\n");
+            result = -1;
+            break;
+        }
+        heap_test_large_blocks[count][0] = (uint8_t)count;
+        heap_test_large_blocks[count][large_size - 1] = (uint8_t)~count;
+    }
+
+    get_heap_stats(&stats_mid);
+    uint64_t spans = stats_mid.large_allocations - stats_before.large_allocations;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (heap_test_large_blocks[i][0] != (uint8_t)i ||
+            heap_test_large_blocks[i][large_size - 1] != (uint8_t)~i) {
+            kprint("HEAP_TEST: FAILED - large allocations overlap\n");
+            result = -1;
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        kfree(heap_test_large_blocks[i]);
+    }
+
+    if (result == 0) {
+        kprint("HEAP_TEST: ");
+        kprint_decimal(spans);
+        kprint(" page spans, ");
+        kprint_decimal(count - spans);
+        kprint(" served by the heap, large span table overflow test PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Heap growth is backed by 2MB pages
+ *
+ * The huge-page counter must be a whole number of 2MB chunks within the
+ * mapped heap, and a fresh 2MB-sized growth must map at least one chunk
+ * with a huge page when memory is not fragmented.
+ */
+int test_heap_huge_page_backing(void) {
+    kprint("HEAP_TEST: Starting huge-page heap backing test\n");
+
+    heap_stats_t stats_before, stats_mid;
+    get_heap_stats(&stats_before);
+
+    int result = 0;
+
+    if (stats_before.huge_page_bytes % PAGE_SIZE_2MB != 0 ||
+        stats_before.huge_page_bytes > stats_before.total_size) {
+        kprint("HEAP_TEST: FAILED - huge-page counter inconsistent\n");
+        result = -1;
+    }
+
+    /* 60KB blocks stay on the TLSF path; 64 of them force heap growth */
+    void *blocks[64];
+    uint32_t count = 0;
+    for (; count < 64; count++) {
+        blocks[count] = kmalloc(60 * 1024);
+        if (!blocks[count]) {
+            break;
+        }
+    }
+
+    get_heap_stats(&stats_mid);
+    if (stats_mid.total_size > stats_before.total_size &&
+        stats_mid.huge_page_bytes <= stats_before.huge_page_bytes) {
+        kprint("HEAP_TEST: FAILED - heap grew without any 2MB page\n");
+        result = -1;
+    }
+
+    uint32_t huge_blocks = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (get_page_size((uint64_t)(uintptr_t)blocks[i]) == PAGE_SIZE_2MB) {
+            huge_blocks++;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        kfree(blocks[i]);
+    }
+
+    if (count < 64 || huge_blocks == 0) {
+        kprint("HEAP_TEST: FAILED - no allocation landed on a 2MB page\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("HEAP_TEST: ");
+        kprint_decimal(huge_blocks);
+        kprint(" of ");
+        kprint_decimal(count);
+        kprint(" blocks on 2MB pages, huge-page heap backing test PASSED\n");
+    }
+    return result;
+}
+
 /*
  * Run all kernel heap regression tests
  * Returns number of tests passed
@@ -257,6 +738,55 @@ int run_kernel_heap_tests(void) {
         kprint("HEAP_TEST: test_heap_fragmentation_behind_head FAILED\n");
     }
 
+    total++;
+    if (test_kmem_cache_slab_lifecycle() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_kmem_cache_slab_lifecycle FAILED\n");
+    }
+
+    total++;
+    if (test_kmalloc_small_uses_slab() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_kmalloc_small_uses_slab FAILED\n");
+    }
+
+    total++;
+    if (test_heap_kfree_latency_scaling() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_heap_kfree_latency_scaling FAILED\n");
+    }
+
+    total++;
+    if (test_heap_trim_releases_pages() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_heap_trim_releases_pages FAILED\n");
+    }
+
+    total++;
+    if (test_kmalloc_large_span() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_kmalloc_large_span FAILED\n");
+    }
+
+    total++;
+    if (test_kmalloc_large_table_full() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_kmalloc_large_table_full FAILED\n");
+    }
+
+    total++;
+    if (test_heap_huge_page_backing() == 0) {
+        passed++;
+    } else {
+        kprint("HEAP_TEST: test_heap_huge_page_backing FAILED\n");
+    }
+
     kprint("HEAP_TEST: Completed ");
     kprint_decimal(total);
     kprint(" tests, ");
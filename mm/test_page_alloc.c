@@ -0,0 +1,288 @@
+/*
+ * SlopOS Page Allocator Regression Tests
+ * Tests for buddy block alignment, contiguity, merge-on-free, the
+ * pre-zeroed frame pool and deferred frame map initialization
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../boot/constants.h"
+#include "../drivers/serial.h"
+#include "page_alloc.h"
+#include "phys_virt.h"
+
+/* ========================================================================
+ * PAGE ALLOCATOR REGRESSION TESTS
+ * ======================================================================== */
+
+/*
+ * Test: Multi-order blocks are naturally aligned
+ *
+ * A block of 2^order pages must start on a 2^order page boundary, and
+ * contiguous multi-page requests must account for exactly the pages asked for.
+ */
+int test_page_alloc_order_alignment(void) {
+    kprint("PAGE_TEST: Starting buddy order alignment test\n");
+
+    int result = 0;
+
+    for (uint32_t order = 0; order <= 6; order++) {
+        uint64_t phys = alloc_pages(order, 0);
+        if (!phys) {
+            kprint("PAGE_TEST: FAILED - alloc_pages returned 0 for order ");
+            kprint_decimal(order);
+            kprint("\n");
+            return -1;
+        }
+
+        uint64_t block_bytes = (uint64_t)PAGE_SIZE_4KB << order;
+        if (phys & (block_bytes - 1)) {
+            kprint("PAGE_TEST: FAILED - block not aligned for order ");
+            kprint_decimal(order);
+            kprint("\n");
+            result = -1;
+        }
+
+        free_page_frame(phys);
+    }
+
+    uint32_t total, free_before, free_mid, free_after;
+    get_page_allocator_stats(&total, &free_before, NULL);
+
+    /* 5 pages come from an order-3 block with the excess handed back */
+    uint64_t run = alloc_page_frames(5, 0);
+    get_page_allocator_stats(NULL, &free_mid, NULL);
+    if (!run) {
+        kprint("PAGE_TEST: FAILED - alloc_page_frames(5) returned 0\n");
+        return -1;
+    }
+
+    if (free_before - free_mid != 5) {
+        kprint("PAGE_TEST: FAILED - contiguous run consumed ");
+        kprint_decimal(free_before - free_mid);
+        kprint(" pages instead of 5\n");
+        result = -1;
+    }
+
+    /* Every page of the run is an independent frame */
+    for (uint32_t i = 0; i < 5; i++) {
+        if (free_page_frame(run + (uint64_t)i * PAGE_SIZE_4KB) != 0) {
+            kprint("PAGE_TEST: FAILED - could not free page of contiguous run\n");
+            result = -1;
+        }
+    }
+
+    get_page_allocator_stats(NULL, &free_after, NULL);
+    if (free_after != free_before) {
+        kprint("PAGE_TEST: FAILED - free frame count not restored\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("PAGE_TEST: PASSED - buddy blocks aligned and contiguous runs split\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Freeing split halves merges them back into the parent block
+ *
+ * A two-page run splits an order-1 (or larger) block; once both pages are
+ * freed the per-order free block counts must match the snapshot exactly.
+ */
+int test_page_alloc_buddy_merge(void) {
+    kprint("PAGE_TEST: Starting buddy merge test\n");
+
+    uint32_t before[PAGE_ALLOC_MAX_ORDER + 1];
+    for (uint32_t order = 0; order <= PAGE_ALLOC_MAX_ORDER; order++) {
+        before[order] = page_allocator_free_blocks(order);
+    }
+
+    uint64_t run = alloc_page_frames(2, 0);
+    if (!run) {
+        kprint("PAGE_TEST: FAILED - alloc_page_frames(2) returned 0\n");
+        return -1;
+    }
+
+    int result = 0;
+    if (run & (2 * PAGE_SIZE_4KB - 1)) {
+        kprint("PAGE_TEST: FAILED - two-page run does not start an order-1 block\n");
+        result = -1;
+    }
+
+    /* Free the upper half first so the merge happens on the second free */
+    free_page_frame(run + PAGE_SIZE_4KB);
+    free_page_frame(run);
+
+    for (uint32_t order = 0; order <= PAGE_ALLOC_MAX_ORDER; order++) {
+        if (page_allocator_free_blocks(order) != before[order]) {
+            kprint("PAGE_TEST: FAILED - free blocks of order ");
+            kprint_decimal(order);
+            kprint(" not restored after merge\n");
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        kprint("PAGE_TEST: PASSED - freed buddies merged into parent block\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Zeroed requests are served from the pre-zeroed pool
+ *
+ * After a refill, ALLOC_FLAG_ZERO must take a pooled frame (counted as a
+ * hit) and the frame must read back as zero even if it was dirty before.
+ */
+int test_page_zero_pool_hit(void) {
+    kprint("PAGE_TEST: Starting pre-zeroed pool test\n");
+
+    /* Dirty a frame and free it so the refill is likely to reuse it */
+    uint64_t dirty = alloc_page_frame(0);
+    if (!dirty) {
+        kprint("PAGE_TEST: FAILED - alloc_page_frame returned 0\n");
+        return -1;
+    }
+    uint8_t *dirty_virt = (uint8_t *)mm_phys_to_virt(dirty);
+    if (dirty_virt) {
+        for (uint32_t i = 0; i < PAGE_SIZE_4KB; i++) {
+            dirty_virt[i] = 0xA5;
+        }
+    }
+    free_page_frame(dirty);
+
+    page_alloc_refill_zero_pool(4);
+
+    uint32_t pooled_before = 0;
+    uint64_t hits_before = 0;
+    get_page_zero_pool_stats(&pooled_before, &hits_before, NULL);
+    if (pooled_before == 0) {
+        kprint("PAGE_TEST: FAILED - refill left the pool empty\n");
+        return -1;
+    }
+
+    uint64_t phys = alloc_page_frame(ALLOC_FLAG_ZERO);
+    if (!phys) {
+        kprint("PAGE_TEST: FAILED - zeroed allocation returned 0\n");
+        return -1;
+    }
+
+    int result = 0;
+    uint32_t pooled_after = 0;
+    uint64_t hits_after = 0;
+    get_page_zero_pool_stats(&pooled_after, &hits_after, NULL);
+    if (hits_after != hits_before + 1 || pooled_after + 1 != pooled_before) {
+        kprint("PAGE_TEST: FAILED - zeroed allocation did not hit the pool\n");
+        result = -1;
+    }
+
+    const uint64_t *words = (const uint64_t *)mm_phys_to_virt(phys);
+    if (!words) {
+        kprint("PAGE_TEST: FAILED - no mapping for pooled frame\n");
+        result = -1;
+    } else {
+        for (uint32_t i = 0; i < PAGE_SIZE_4KB / sizeof(uint64_t); i++) {
+            if (words[i] != 0) {
+                kprint("PAGE_TEST: FAILED - pooled frame is not zero\n");
+                result = -1;
+                break;
+            }
+        }
+    }
+
+    free_page_frame(phys);
+
+    if (result == 0) {
+        kprint("PAGE_TEST: PASSED - zeroed request served from pool\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Deferred frame map sections come online on request
+ *
+ * Sections skipped at boot must all initialize through
+ * page_alloc_init_deferred() and add their frames to the free lists.
+ */
+int test_page_alloc_deferred_sections(void) {
+    kprint("PAGE_TEST: Starting deferred section init test\n");
+
+    uint32_t pending_before = 0;
+    uint32_t free_before = 0;
+    get_page_frame_init_stats(&pending_before, NULL, NULL);
+    get_page_allocator_stats(NULL, &free_before, NULL);
+
+    uint32_t initialized = page_alloc_init_deferred(0xFFFFFFFF);
+
+    uint32_t pending_after = 0;
+    uint32_t free_after = 0;
+    get_page_frame_init_stats(&pending_after, NULL, NULL);
+    get_page_allocator_stats(NULL, &free_after, NULL);
+
+    if (initialized != pending_before || pending_after != 0) {
+        kprint("PAGE_TEST: FAILED - deferred sections left pending\n");
+        return -1;
+    }
+
+    if (initialized > 0 && free_after <= free_before) {
+        kprint("PAGE_TEST: FAILED - deferred sections released no frames\n");
+        return -1;
+    }
+
+    kprint("PAGE_TEST: PASSED - ");
+    kprint_decimal(initialized);
+    kprint(" deferred sections initialized\n");
+    return 0;
+}
+
+/* ========================================================================
+ * TEST SUITE RUNNER
+ * ======================================================================== */
+
+/*
+ * Run all page allocator tests
+ * Returns number of passed tests
+ */
+int run_page_alloc_tests(void) {
+    kprint("PAGE_TEST: Running page allocator regression tests\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_page_alloc_order_alignment() == 0) {
+        passed++;
+    } else {
+        kprint("PAGE_TEST: test_page_alloc_order_alignment FAILED\n");
+    }
+
+    total++;
+    if (test_page_alloc_buddy_merge() == 0) {
+        passed++;
+    } else {
+        kprint("PAGE_TEST: test_page_alloc_buddy_merge FAILED\n");
+    }
+
+    total++;
+    if (test_page_zero_pool_hit() == 0) {
+        passed++;
+    } else {
+        kprint("PAGE_TEST: test_page_zero_pool_hit FAILED\n");
+    }
+
+    total++;
+    if (test_page_alloc_deferred_sections() == 0) {
+        passed++;
+    } else {
+        kprint("PAGE_TEST: test_page_alloc_deferred_sections FAILED\n");
+    }
+
+    kprint("PAGE_TEST: Completed ");
+    kprint_decimal(total);
+    kprint(" tests, ");
+    kprint_decimal(passed);
+    kprint(" passed\n");
+
+    return passed;
+}
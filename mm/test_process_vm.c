@@ -7,22 +7,30 @@
 #include <stddef.h>
 #include "../boot/constants.h"
 #include "../drivers/serial.h"
+#include "../lib/cpu.h"
 #include "paging.h"
+#include "vmem_regions.h"
 
 /* Forward declarations from process_vm module */
 extern uint32_t create_process_vm(void);
 extern int destroy_process_vm(uint32_t process_id);
 extern void get_process_vm_stats(uint32_t *total_processes, uint32_t *active_processes);
 extern process_page_dir_t *process_vm_get_page_dir(uint32_t process_id);
+extern uint32_t process_vm_clone(uint32_t process_id);
 
 /* Forward declarations from paging module */
 extern int switch_page_directory(process_page_dir_t *page_dir);
 extern process_page_dir_t *get_current_page_directory(void);
 extern uint64_t virt_to_phys(uint64_t vaddr);
 extern int map_page_4kb(uint64_t vaddr, uint64_t paddr, uint64_t flags);
+extern int unmap_page(uint64_t vaddr);
 
 /* Forward declarations from page_alloc module */
 extern uint64_t alloc_page_frame(uint32_t flags);
+extern int free_page_frame(uint64_t phys_addr);
+extern uint32_t page_frame_ref_count(uint64_t phys_addr);
+extern int get_page_allocator_stats(uint32_t *total, uint32_t *free, uint32_t *allocated);
+extern void get_page_zero_pool_stats(uint32_t *pooled, uint64_t *hits, uint64_t *misses);
 
 /* ========================================================================
  * VM MANAGER REGRESSION TESTS
@@ -457,6 +465,946 @@ int test_user_stack_accessibility(void) {
     return 0;
 }
 
+/* Unused higher-half window above the large kmalloc spans for range tests */
+#define RANGE_BENCH_VADDR             0xFFFFFFFFE0000000ULL
+#define RANGE_BENCH_PAGES             (0x4000000ULL / PAGE_SIZE_4KB)  /* 64MB */
+
+/*
+ * Test: Batched range mapping microbenchmark
+ * Maps and unmaps 64MB with per-page map_page_4kb calls, with map_range
+ * using 4KB entries and with map_range promoting to 2MB entries, checks
+ * the mappings and frame accounting, and reports cycles for each
+ */
+int test_map_range_benchmark(void) {
+    kprint("VM_TEST: Starting 64MB map_range benchmark\n");
+
+    uint32_t free_start = 0;
+    get_page_allocator_stats(NULL, &free_start, NULL);
+    if (free_start < RANGE_BENCH_PAGES * 2) {
+        kprint("VM_TEST: Not enough free frames for range benchmark, skipping\n");
+        return 0;
+    }
+
+    /* Per-page baseline; also leaves the page tables for this window behind */
+    uint64_t start = cpu_read_tsc();
+    for (uint64_t i = 0; i < RANGE_BENCH_PAGES; i++) {
+        uint64_t phys = alloc_page_frame(0);
+        if (!phys || map_page_4kb(RANGE_BENCH_VADDR + i * PAGE_SIZE_4KB, phys, PAGE_KERNEL_RW) != 0) {
+            kprint("VM_TEST: Per-page mapping failed\n");
+            if (phys) {
+                free_page_frame(phys);
+            }
+            unmap_range(RANGE_BENCH_VADDR, i, UNMAP_RANGE_FREE_FRAMES);
+            return -1;
+        }
+    }
+    uint64_t single_map = cpu_read_tsc() - start;
+
+    start = cpu_read_tsc();
+    for (uint64_t i = 0; i < RANGE_BENCH_PAGES; i++) {
+        uint64_t virt = RANGE_BENCH_VADDR + i * PAGE_SIZE_4KB;
+        uint64_t phys = virt_to_phys(virt);
+        unmap_page(virt);
+        free_page_frame(phys);
+    }
+    uint64_t single_unmap = cpu_read_tsc() - start;
+
+    uint32_t free_before = 0;
+    get_page_allocator_stats(NULL, &free_before, NULL);
+
+    /* Batched 4KB mapping over the now table-backed window */
+    start = cpu_read_tsc();
+    if (map_range(RANGE_BENCH_VADDR, MAP_RANGE_ALLOC, RANGE_BENCH_PAGES, PAGE_KERNEL_RW) != 0) {
+        kprint("VM_TEST: map_range failed\n");
+        return -1;
+    }
+    uint64_t range_map = cpu_read_tsc() - start;
+
+    int result = 0;
+    for (uint64_t i = 0; i < RANGE_BENCH_PAGES; i += 511) {
+        if (!virt_to_phys(RANGE_BENCH_VADDR + i * PAGE_SIZE_4KB)) {
+            kprint("VM_TEST: map_range left a page unmapped\n");
+            result = -1;
+            break;
+        }
+    }
+
+    start = cpu_read_tsc();
+    uint64_t unmapped = unmap_range(RANGE_BENCH_VADDR, RANGE_BENCH_PAGES, UNMAP_RANGE_FREE_FRAMES);
+    uint64_t range_unmap = cpu_read_tsc() - start;
+
+    uint32_t free_after = 0;
+    get_page_allocator_stats(NULL, &free_after, NULL);
+    if (unmapped != RANGE_BENCH_PAGES || free_after != free_before) {
+        kprint("VM_TEST: unmap_range did not release every frame\n");
+        result = -1;
+    }
+
+    /* Batched mapping with 2MB promotion in the next, table-free 64MB */
+    uint64_t huge_vaddr = RANGE_BENCH_VADDR + RANGE_BENCH_PAGES * PAGE_SIZE_4KB;
+    start = cpu_read_tsc();
+    if (map_range(huge_vaddr, MAP_RANGE_ALLOC, RANGE_BENCH_PAGES, PAGE_KERNEL_RW | PAGE_SIZE) != 0) {
+        kprint("VM_TEST: map_range with 2MB promotion failed\n");
+        return -1;
+    }
+    uint64_t huge_map = cpu_read_tsc() - start;
+
+    uint32_t huge_chunks = 0;
+    for (uint64_t off = 0; off < RANGE_BENCH_PAGES * PAGE_SIZE_4KB; off += PAGE_SIZE_2MB) {
+        if (get_page_size(huge_vaddr + off) == PAGE_SIZE_2MB) {
+            huge_chunks++;
+        }
+    }
+
+    start = cpu_read_tsc();
+    unmapped = unmap_range(huge_vaddr, RANGE_BENCH_PAGES, UNMAP_RANGE_FREE_FRAMES);
+    uint64_t huge_unmap = cpu_read_tsc() - start;
+
+    if (unmapped != RANGE_BENCH_PAGES || is_mapped(huge_vaddr)) {
+        kprint("VM_TEST: unmap_range did not clear the 2MB mappings\n");
+        result = -1;
+    }
+
+    kprint("VM_TEST:   map_page_4kb loop: ");
+    kprint_decimal(single_map);
+    kprint(" cycles map, ");
+    kprint_decimal(single_unmap);
+    kprint(" cycles unmap\n");
+    kprint("VM_TEST:   map_range 4KB:     ");
+    kprint_decimal(range_map);
+    kprint(" cycles map, ");
+    kprint_decimal(range_unmap);
+    kprint(" cycles unmap\n");
+    kprint("VM_TEST:   map_range 2MB:     ");
+    kprint_decimal(huge_map);
+    kprint(" cycles map, ");
+    kprint_decimal(huge_unmap);
+    kprint(" cycles unmap (");
+    kprint_decimal(huge_chunks);
+    kprint(" of 32 chunks promoted)\n");
+
+    if (range_map > single_map) {
+        kprint("VM_TEST: FAILED - map_range slower than per-page mapping\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("VM_TEST: map_range benchmark PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Kernel mappings are global, user mappings are not
+ * Kernel text and a fresh kernel range mapping must carry PAGE_GLOBAL so
+ * they survive CR3 reloads; a process stack page must stay per-PCID
+ */
+int test_kernel_mappings_global(void) {
+    kprint("VM_TEST: Starting global kernel mapping test\n");
+
+    int result = 0;
+
+    if (!(get_page_flags(KERNEL_VIRTUAL_BASE) & PAGE_GLOBAL)) {
+        kprint("VM_TEST: Kernel image mapping is not global\n");
+        result = -1;
+    }
+
+    if (map_range(RANGE_BENCH_VADDR, MAP_RANGE_ALLOC, 4, PAGE_KERNEL_RW) != 0) {
+        kprint("VM_TEST: Failed to map kernel test range\n");
+        return -1;
+    }
+    if (!(get_page_flags(RANGE_BENCH_VADDR) & PAGE_GLOBAL)) {
+        kprint("VM_TEST: New kernel mapping is not global\n");
+        result = -1;
+    }
+    unmap_range(RANGE_BENCH_VADDR, 4, UNMAP_RANGE_FREE_FRAMES);
+
+    uint32_t pid = create_process_vm();
+    if (pid == INVALID_PROCESS_ID) {
+        kprint("VM_TEST: Failed to create process for global mapping test\n");
+        return -1;
+    }
+
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    switch_page_directory(process_vm_get_page_dir(pid));
+    uint64_t user_flags = get_page_flags(PROCESS_STACK_TOP - PAGE_SIZE_4KB);
+    if (saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+    destroy_process_vm(pid);
+
+    if (!(user_flags & PAGE_PRESENT) || (user_flags & PAGE_GLOBAL)) {
+        kprint("VM_TEST: User stack mapping missing or marked global\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("VM_TEST: Global kernel mapping test PASSED\n");
+    }
+    return result;
+}
+
+/* Address-space ping-pong parameters */
+#define PCID_BENCH_ROUND_TRIPS        2000
+#define PCID_BENCH_TOUCH_PAGES        64     /* User stack pages read per visit */
+
+/*
+ * Visit an address space: load it and read one word from each of the
+ * first touched stack pages so the switch cost includes TLB refills
+ */
+static uint64_t pcid_bench_visit(process_page_dir_t *page_dir) {
+    const uint64_t stack_base = PROCESS_STACK_TOP - PROCESS_STACK_SIZE;
+    uint64_t sum = 0;
+
+    switch_page_directory(page_dir);
+    for (uint32_t i = 0; i < PCID_BENCH_TOUCH_PAGES; i++) {
+        sum += *(volatile uint64_t *)(uintptr_t)(stack_base + (uint64_t)i * PAGE_SIZE_4KB);
+    }
+    return sum;
+}
+
+static uint64_t pcid_bench_run(process_page_dir_t *a, process_page_dir_t *b) {
+    uint64_t start = cpu_read_tsc();
+    for (uint32_t i = 0; i < PCID_BENCH_ROUND_TRIPS; i++) {
+        pcid_bench_visit(a);
+        pcid_bench_visit(b);
+    }
+    return (cpu_read_tsc() - start) / PCID_BENCH_ROUND_TRIPS;
+}
+
+/*
+ * Test: PCID address-space switch ping-pong benchmark
+ * Alternates between two process address spaces, touching user pages in
+ * each, with no-flush CR3 loads and with flushing loads, and reports the
+ * cycles per round trip. Also checks that PCIDs are distinct and recycled
+ */
+int test_pcid_switch_benchmark(void) {
+    kprint("VM_TEST: Starting PCID switch ping-pong benchmark\n");
+
+    uint32_t pid_a = create_process_vm();
+    uint32_t pid_b = create_process_vm();
+    if (pid_a == INVALID_PROCESS_ID || pid_b == INVALID_PROCESS_ID) {
+        kprint("VM_TEST: Failed to create processes for PCID benchmark\n");
+        destroy_process_vm(pid_a);
+        destroy_process_vm(pid_b);
+        return -1;
+    }
+
+    process_page_dir_t *dir_a = process_vm_get_page_dir(pid_a);
+    process_page_dir_t *dir_b = process_vm_get_page_dir(pid_b);
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    int result = 0;
+
+    if (paging_pcid_enabled() && (dir_a->pcid == 0 || dir_a->pcid == dir_b->pcid)) {
+        kprint("VM_TEST: Process directories did not get distinct PCIDs\n");
+        result = -1;
+    }
+
+    uint64_t noflush_before = 0;
+    get_pcid_stats(NULL, &noflush_before, NULL);
+
+    paging_set_pcid_noflush(1);
+    uint64_t tagged = pcid_bench_run(dir_a, dir_b);
+
+    uint64_t noflush_after = 0;
+    get_pcid_stats(NULL, &noflush_after, NULL);
+
+    paging_set_pcid_noflush(0);
+    uint64_t flushing = pcid_bench_run(dir_a, dir_b);
+    paging_set_pcid_noflush(1);
+
+    if (saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+
+    if (paging_pcid_enabled() && noflush_after - noflush_before < PCID_BENCH_ROUND_TRIPS) {
+        kprint("VM_TEST: Switches did not use no-flush CR3 loads\n");
+        result = -1;
+    }
+
+    kprint("VM_TEST:   PCID ");
+    kprint(paging_pcid_enabled() ? "enabled" : "unsupported");
+    kprint(": ");
+    kprint_decimal(tagged);
+    kprint(" cycles per round trip with no-flush loads, ");
+    kprint_decimal(flushing);
+    kprint(" with flushing loads\n");
+
+    /* Destroyed address spaces hand their PCIDs back */
+    uint32_t in_use_before = 0;
+    uint32_t in_use_after = 0;
+    get_pcid_stats(&in_use_before, NULL, NULL);
+    destroy_process_vm(pid_a);
+    destroy_process_vm(pid_b);
+    get_pcid_stats(&in_use_after, NULL, NULL);
+
+    if (paging_pcid_enabled() && in_use_before - in_use_after != 2) {
+        kprint("VM_TEST: PCIDs were not recycled on destroy\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("VM_TEST: PCID switch benchmark PASSED\n");
+    }
+    return result;
+}
+
+/* Demand paging benchmark parameters */
+#define VMA_BENCH_VADDR               0x40000000ULL                   /* mmap base */
+#define VMA_BENCH_PAGES               (0x4000000ULL / PAGE_SIZE_4KB)  /* 64MB */
+
+/*
+ * Touch every page of a fresh 64MB anonymous VMA with the given
+ * fault-around window. Faults are raised by calling the fault handler
+ * for each unmapped page, since boot tests may run with exception
+ * overrides installed. Returns cycles spent, or 0 on failure
+ */
+static uint64_t vma_bench_touch(uint32_t pid, uint32_t fault_around, vma_fault_stats_t *stats) {
+    if (!create_vma_region(pid, VMA_BENCH_VADDR, VMA_BENCH_PAGES * PAGE_SIZE_4KB,
+                           VMA_READ | VMA_WRITE | VMA_USER, VMA_TYPE_ANONYMOUS)) {
+        return 0;
+    }
+    set_vma_policy(pid, VMA_BENCH_VADDR, VMA_POLICY_DEMAND | VMA_POLICY_ZERO);
+    set_vma_fault_around(fault_around);
+
+    uint64_t start = cpu_read_tsc();
+    for (uint64_t i = 0; i < VMA_BENCH_PAGES; i++) {
+        uint64_t vaddr = VMA_BENCH_VADDR + i * PAGE_SIZE_4KB;
+        if (!virt_to_phys(vaddr) && handle_vma_page_fault(pid, vaddr) != 0) {
+            start = 0;
+            break;
+        }
+        *(volatile uint64_t *)(uintptr_t)vaddr = i;
+    }
+    uint64_t cycles = start ? cpu_read_tsc() - start : 0;
+
+    get_vma_fault_stats(pid, VMA_BENCH_VADDR, stats);
+    destroy_vma_region(pid, VMA_BENCH_VADDR);
+    set_vma_fault_around(VMA_FAULT_AROUND_PAGES);
+    return cycles;
+}
+
+/*
+ * Test: Demand paging fault-around benchmark
+ * Touches every page of a 64MB VMA once with single-page faults and once
+ * with the default fault-around window, checks the per-VMA counters and
+ * that teardown returns every frame
+ */
+int test_vma_fault_around_benchmark(void) {
+    kprint("VM_TEST: Starting demand paging fault-around benchmark\n");
+
+    uint32_t pid = create_process_vm();
+    if (pid == INVALID_PROCESS_ID) {
+        kprint("VM_TEST: Failed to create process for demand paging benchmark\n");
+        return -1;
+    }
+    if (create_process_vma_space(pid) != 0) {
+        destroy_process_vm(pid);
+        return -1;
+    }
+
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    switch_page_directory(process_vm_get_page_dir(pid));
+
+    uint32_t free_before = 0;
+    uint32_t free_after = 0;
+    vma_fault_stats_t single = {0};
+    vma_fault_stats_t around = {0};
+    int result = 0;
+
+    get_page_allocator_stats(NULL, &free_before, NULL);
+    uint64_t single_cycles = vma_bench_touch(pid, 1, &single);
+    uint64_t around_cycles = vma_bench_touch(pid, VMA_FAULT_AROUND_PAGES, &around);
+    get_page_allocator_stats(NULL, &free_after, NULL);
+
+    if (saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+
+    if (!single_cycles || !around_cycles) {
+        kprint("VM_TEST: Demand paging failed to back a touched page\n");
+        result = -1;
+    } else if (single.faults != VMA_BENCH_PAGES || single.pages_faulted != VMA_BENCH_PAGES ||
+               around.faults != VMA_BENCH_PAGES / VMA_FAULT_AROUND_PAGES ||
+               around.pages_faulted != VMA_BENCH_PAGES) {
+        kprint("VM_TEST: Fault counters do not match the touched pages\n");
+        result = -1;
+    }
+
+    /* Page tables stay behind; every data frame must come back */
+    if (free_before - free_after > VMA_BENCH_PAGES / 512 + 4) {
+        kprint("VM_TEST: VMA teardown leaked frames\n");
+        result = -1;
+    }
+
+    kprint("VM_TEST:   64MB touch: ");
+    kprint_decimal(single_cycles / VMA_BENCH_PAGES);
+    kprint(" cycles/page with single-page faults (");
+    kprint_decimal(single.faults);
+    kprint(" faults), ");
+    kprint_decimal(around_cycles / VMA_BENCH_PAGES);
+    kprint(" with fault-around (");
+    kprint_decimal(around.faults);
+    kprint(" faults)\n");
+
+    destroy_process_vma_space(pid);
+    destroy_process_vm(pid);
+
+    if (result == 0) {
+        kprint("VM_TEST: Demand paging fault-around benchmark PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Test: Copy-on-write address space cloning
+ * A clone must share the parent's stack frames read-only instead of
+ * copying them. A write from the clone copies just that page, and the
+ * parent's later write re-enables its mapping in place. The clone also
+ * gets a copy of the parent's VMA regions. Write faults are
+ * resolved by calling the COW handler directly, as boot tests may run
+ * with exception overrides installed
+ */
+int test_process_vm_cow_clone(void) {
+    kprint("VM_TEST: Starting copy-on-write clone test\n");
+
+    const uint64_t stack_base = PROCESS_STACK_TOP - PROCESS_STACK_SIZE;
+    const uint32_t stack_pages = PROCESS_STACK_SIZE / PAGE_SIZE_4KB;
+    const uint64_t clone_region = 0x40000000ULL;
+
+    uint32_t parent = create_process_vm();
+    if (parent == INVALID_PROCESS_ID || create_process_vma_space(parent) != 0 ||
+        !create_vma_region(parent, clone_region, PAGE_SIZE_4KB, VMA_READ | VMA_WRITE | VMA_USER,
+                           VMA_TYPE_ANONYMOUS)) {
+        kprint("VM_TEST: Failed to create parent process\n");
+        destroy_process_vma_space(parent);
+        destroy_process_vm(parent);
+        return -1;
+    }
+
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    process_page_dir_t *parent_dir = process_vm_get_page_dir(parent);
+    switch_page_directory(parent_dir);
+    *(volatile uint64_t *)(uintptr_t)stack_base = 0xC0FFEE;
+    uint64_t parent_phys = virt_to_phys(stack_base);
+
+    uint32_t free_before = 0;
+    uint32_t free_after = 0;
+    uint64_t copies_before = 0;
+    uint64_t reuses_before = 0;
+    get_page_allocator_stats(NULL, &free_before, NULL);
+    get_cow_stats(&copies_before, &reuses_before);
+
+    uint32_t child = process_vm_clone(parent);
+    get_page_allocator_stats(NULL, &free_after, NULL);
+
+    int result = 0;
+    if (child == INVALID_PROCESS_ID) {
+        kprint("VM_TEST: process_vm_clone failed\n");
+        switch_page_directory(saved_page_dir);
+        destroy_process_vm(parent);
+        destroy_process_vma_space(parent);
+        return -1;
+    }
+
+    /* The clone carries its own copy of the parent's regions */
+    vma_fault_stats_t region_stats;
+    if (get_vma_fault_stats(child, clone_region, &region_stats) != 0) {
+        kprint("VM_TEST: Clone is missing the parent's VMA regions\n");
+        result = -1;
+    }
+
+    /* Only page tables may be allocated, never copies of the stack */
+    if (free_before - free_after >= stack_pages / 4) {
+        kprint("VM_TEST: Clone consumed frames for user pages\n");
+        result = -1;
+    }
+
+    uint64_t parent_flags = get_page_flags(stack_base);
+    if ((parent_flags & PAGE_WRITABLE) || !(parent_flags & PAGE_COW) ||
+        page_frame_ref_count(parent_phys) != 2) {
+        kprint("VM_TEST: Parent page not shared read-only after clone\n");
+        result = -1;
+    }
+
+    /* Child write copies the page and leaves the parent's data alone */
+    switch_page_directory(process_vm_get_page_dir(child));
+    if (virt_to_phys(stack_base) != parent_phys ||
+        paging_resolve_cow_fault(stack_base) != 0) {
+        kprint("VM_TEST: Child could not resolve COW write\n");
+        result = -1;
+    } else {
+        volatile uint64_t *word = (volatile uint64_t *)(uintptr_t)stack_base;
+        if (virt_to_phys(stack_base) == parent_phys || *word != 0xC0FFEE) {
+            kprint("VM_TEST: Child COW copy has wrong frame or contents\n");
+            result = -1;
+        }
+        *word = 0xBAD;
+    }
+
+    /* Parent is now the only sharer and just regains write access */
+    switch_page_directory(parent_dir);
+    if (paging_resolve_cow_fault(stack_base) != 0 || virt_to_phys(stack_base) != parent_phys ||
+        *(volatile uint64_t *)(uintptr_t)stack_base != 0xC0FFEE ||
+        !(get_page_flags(stack_base) & PAGE_WRITABLE)) {
+        kprint("VM_TEST: Parent did not regain its page in place\n");
+        result = -1;
+    }
+
+    uint64_t copies_after = 0;
+    uint64_t reuses_after = 0;
+    get_cow_stats(&copies_after, &reuses_after);
+    if (copies_after - copies_before != 1 || reuses_after - reuses_before != 1) {
+        kprint("VM_TEST: COW counters do not match one copy and one reuse\n");
+        result = -1;
+    }
+
+    switch_page_directory(saved_page_dir);
+
+    /* Untouched shared pages drop to one reference per teardown */
+    uint64_t shared_probe = stack_base + PAGE_SIZE_4KB;
+    switch_page_directory(parent_dir);
+    uint64_t probe_phys = virt_to_phys(shared_probe);
+    switch_page_directory(saved_page_dir);
+
+    destroy_process_vm(child);
+    if (page_frame_ref_count(probe_phys) != 1) {
+        kprint("VM_TEST: Destroying clone did not drop shared references\n");
+        result = -1;
+    }
+    destroy_process_vm(parent);
+    destroy_process_vma_space(child);
+    destroy_process_vma_space(parent);
+
+    if (result == 0) {
+        kprint("VM_TEST: Copy-on-write clone test PASSED\n");
+    }
+    return result;
+}
+
+/* VMA tree test layout: 2-page VMAs every 4 pages from the mmap base */
+#define VMA_TREE_BASE                 0x40000000ULL
+#define VMA_TREE_COUNT                32
+#define VMA_TREE_STRIDE               (4 * PAGE_SIZE_4KB)
+
+/*
+ * Test: VMA tree lookup and gap finding
+ * Inserts VMAs out of address order, then checks that every VMA and every
+ * hole resolves correctly, and that placement without a start address
+ * takes the lowest gap that fits
+ */
+int test_vma_tree_lookup(void) {
+    kprint("VM_TEST: Starting VMA tree lookup test\n");
+
+    uint32_t pid = create_process_vm();
+    if (pid == INVALID_PROCESS_ID || create_process_vma_space(pid) != 0) {
+        kprint("VM_TEST: Failed to create process for VMA tree test\n");
+        destroy_process_vm(pid);
+        return -1;
+    }
+
+    /* Destroying VMAs unmaps in the current address space */
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    switch_page_directory(process_vm_get_page_dir(pid));
+
+    int result = 0;
+    vma_fault_stats_t stats;
+
+    /* 13 is coprime with the count, so this visits every slot once */
+    for (uint32_t i = 0; i < VMA_TREE_COUNT; i++) {
+        uint64_t start = VMA_TREE_BASE + (uint64_t)((i * 13) % VMA_TREE_COUNT) * VMA_TREE_STRIDE;
+        if (create_vma_region(pid, start, 2 * PAGE_SIZE_4KB, VMA_READ | VMA_USER,
+                              VMA_TYPE_ANONYMOUS) != start) {
+            kprint("VM_TEST: Failed to insert VMA\n");
+            result = -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < VMA_TREE_COUNT && result == 0; i++) {
+        uint64_t start = VMA_TREE_BASE + (uint64_t)i * VMA_TREE_STRIDE;
+        if (get_vma_fault_stats(pid, start + PAGE_SIZE_4KB, &stats) != 0 ||
+            get_vma_fault_stats(pid, start + 2 * PAGE_SIZE_4KB, &stats) == 0) {
+            kprint("VM_TEST: VMA lookup returned wrong region\n");
+            result = -1;
+        }
+    }
+
+    /* Remove the sixth VMA to open a 6-page hole */
+    if (result == 0 && destroy_vma_region(pid, VMA_TREE_BASE + 5 * VMA_TREE_STRIDE) != 0) {
+        result = -1;
+    }
+
+    if (result == 0) {
+        uint64_t small = create_vma_region(pid, 0, 2 * PAGE_SIZE_4KB, VMA_READ | VMA_USER,
+                                           VMA_TYPE_ANONYMOUS);
+        uint64_t large = create_vma_region(pid, 0, 4 * PAGE_SIZE_4KB, VMA_READ | VMA_USER,
+                                           VMA_TYPE_ANONYMOUS);
+        if (small != VMA_TREE_BASE + 2 * PAGE_SIZE_4KB ||
+            large != VMA_TREE_BASE + 4 * VMA_TREE_STRIDE + 2 * PAGE_SIZE_4KB) {
+            kprint("VM_TEST: Gap search did not pick the lowest fitting hole\n");
+            result = -1;
+        }
+    }
+
+    destroy_process_vma_space(pid);
+    if (saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+    destroy_process_vm(pid);
+
+    if (result == 0) {
+        kprint("VM_TEST: VMA tree lookup test PASSED\n");
+    }
+    return result;
+}
+
+/*
+ * Test: VMA descriptors are recycled
+ * Repeatedly fills and empties a space; the live count must return to
+ * baseline each round and the high-water mark must not creep upward
+ */
+int test_vma_descriptor_recycle(void) {
+    kprint("VM_TEST: Starting VMA descriptor recycle test\n");
+
+    uint32_t pid = create_process_vm();
+    if (pid == INVALID_PROCESS_ID || create_process_vma_space(pid) != 0) {
+        kprint("VM_TEST: Failed to create process for VMA recycle test\n");
+        destroy_process_vm(pid);
+        return -1;
+    }
+
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    switch_page_directory(process_vm_get_page_dir(pid));
+
+    uint32_t base_vmas = 0;
+    uint32_t base_peak = 0;
+    get_vmem_stats(&base_vmas, &base_peak, NULL, NULL, NULL);
+
+    int result = 0;
+    for (uint32_t round = 0; round < 4 && result == 0; round++) {
+        for (uint32_t i = 0; i < 16; i++) {
+            if (!create_vma_region(pid, 0, PAGE_SIZE_4KB, VMA_READ | VMA_USER,
+                                   VMA_TYPE_ANONYMOUS)) {
+                kprint("VM_TEST: Failed to create VMA during recycle round\n");
+                result = -1;
+                break;
+            }
+        }
+
+        /* Placement without a start address packs them from the mmap base */
+        for (uint32_t i = 0; i < 16; i++) {
+            destroy_vma_region(pid, VMA_TREE_BASE + (uint64_t)i * PAGE_SIZE_4KB);
+        }
+
+        uint32_t live = 0;
+        get_vmem_stats(&live, NULL, NULL, NULL, NULL);
+        if (live != base_vmas) {
+            kprint("VM_TEST: VMA count did not return to baseline\n");
+            result = -1;
+        }
+    }
+
+    uint32_t peak = 0;
+    get_vmem_stats(NULL, &peak, NULL, NULL, NULL);
+    uint32_t expected_peak = (base_vmas + 16 > base_peak) ? base_vmas + 16 : base_peak;
+    if (result == 0 && peak != expected_peak) {
+        kprint("VM_TEST: VMA high-water mark is ");
+        kprint_decimal(peak);
+        kprint(", expected ");
+        kprint_decimal(expected_peak);
+        kprint("\n");
+        result = -1;
+    }
+
+    destroy_process_vma_space(pid);
+    if (saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+    destroy_process_vm(pid);
+
+    if (result == 0) {
+        kprint("VM_TEST: VMA descriptor recycle test PASSED\n");
+    }
+    return result;
+}
+
+/* Sparse mapping far from every other test region (own PML4 slot) */
+#define TABLE_RECLAIM_VADDR           0x7000000000ULL
+#define TABLE_RECLAIM_PAGES           3
+
+/*
+ * Test: Empty page tables are freed on unmap
+ * Maps a few pages in an untouched part of a process address space and
+ * unmaps them again, first one page through unmap_page and then the rest
+ * through unmap_range. Every table allocated for the mapping must be
+ * reclaimed once the last page goes, restoring the free frame count
+ */
+int test_page_table_reclaim(void) {
+    kprint("VM_TEST: Starting page table reclaim test\n");
+
+    uint32_t pid = create_process_vm();
+    if (pid == INVALID_PROCESS_ID) {
+        kprint("VM_TEST: Failed to create process for reclaim test\n");
+        return -1;
+    }
+
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    switch_page_directory(process_vm_get_page_dir(pid));
+
+    /* Zeroed tables may come from the pre-zeroed pool but are freed to the buddy lists */
+    uint32_t free_before = 0;
+    uint32_t free_after = 0;
+    uint32_t pooled_before = 0;
+    uint32_t pooled_after = 0;
+    uint64_t allocated_before = 0;
+    uint64_t reclaimed_before = 0;
+    get_page_allocator_stats(NULL, &free_before, NULL);
+    get_page_zero_pool_stats(&pooled_before, NULL, NULL);
+    get_page_table_stats(&allocated_before, &reclaimed_before);
+
+    int result = 0;
+    if (map_range(TABLE_RECLAIM_VADDR, MAP_RANGE_ALLOC, TABLE_RECLAIM_PAGES, PAGE_USER_RW) != 0) {
+        kprint("VM_TEST: map_range failed in reclaim test\n");
+        switch_page_directory(saved_page_dir);
+        destroy_process_vm(pid);
+        return -1;
+    }
+
+    uint64_t allocated_after = 0;
+    uint64_t reclaimed_after = 0;
+    get_page_table_stats(&allocated_after, NULL);
+    uint64_t tables = allocated_after - allocated_before;
+    if (tables == 0) {
+        kprint("VM_TEST: Mapping allocated no page tables\n");
+        result = -1;
+    }
+
+    /* Tables still hold live entries after a partial unmap */
+    uint64_t first_phys = virt_to_phys(TABLE_RECLAIM_VADDR);
+    unmap_page(TABLE_RECLAIM_VADDR);
+    free_page_frame(first_phys);
+    get_page_table_stats(NULL, &reclaimed_after);
+    if (reclaimed_after != reclaimed_before || !is_mapped(TABLE_RECLAIM_VADDR + PAGE_SIZE_4KB)) {
+        kprint("VM_TEST: Page tables reclaimed while still in use\n");
+        result = -1;
+    }
+
+    unmap_range(TABLE_RECLAIM_VADDR + PAGE_SIZE_4KB, TABLE_RECLAIM_PAGES - 1,
+                UNMAP_RANGE_FREE_FRAMES);
+    get_page_table_stats(NULL, &reclaimed_after);
+    get_page_allocator_stats(NULL, &free_after, NULL);
+    get_page_zero_pool_stats(&pooled_after, NULL, NULL);
+
+    if (reclaimed_after - reclaimed_before != tables) {
+        kprint("VM_TEST: Reclaimed ");
+        kprint_decimal(reclaimed_after - reclaimed_before);
+        kprint(" of ");
+        kprint_decimal(tables);
+        kprint(" page tables\n");
+        result = -1;
+    }
+
+    if (free_after + pooled_after != free_before + pooled_before) {
+        kprint("VM_TEST: Free frame count not restored after unmap\n");
+        result = -1;
+    }
+
+    switch_page_directory(saved_page_dir);
+    destroy_process_vm(pid);
+
+    if (result == 0) {
+        kprint("VM_TEST: Page table reclaim test PASSED\n");
+    }
+    return result;
+}
+
+/* Teardown test layout: a dense run plus pages in two more PML4 slots */
+#define TEARDOWN_DENSE_VADDR          0x6000000000ULL
+#define TEARDOWN_DENSE_PAGES          (0x1000000ULL / PAGE_SIZE_4KB)  /* 16MB */
+#define TEARDOWN_SPARSE_VADDR         0x7000000000ULL
+#define TEARDOWN_SPARSE_STRIDE        0x8000000000ULL                 /* One PML4 slot */
+#define TEARDOWN_SPARSE_SLOTS         2
+
+/*
+ * Test: Process teardown frees the whole address space in one pass
+ * Mappings made outside the VMA list must come back too, together with
+ * the stack and every page table, so the free frame count (counting
+ * pooled and cached pages) ends above the post-creation snapshot by at
+ * least the stack and the PML4
+ */
+int test_process_vm_bulk_teardown(void) {
+    kprint("VM_TEST: Starting bulk address space teardown test\n");
+
+    const uint32_t stack_pages = PROCESS_STACK_SIZE / PAGE_SIZE_4KB;
+
+    uint32_t pid = create_process_vm();
+    if (pid == INVALID_PROCESS_ID) {
+        kprint("VM_TEST: Failed to create process for teardown test\n");
+        return -1;
+    }
+
+    uint32_t free_before = 0;
+    uint32_t free_after = 0;
+    uint32_t pooled_before = 0;
+    uint32_t pooled_after = 0;
+    uint32_t cached = 0;
+    get_page_allocator_stats(NULL, &free_before, NULL);
+    get_page_zero_pool_stats(&pooled_before, NULL, NULL);
+    get_pml4_cache_stats(&cached, NULL, NULL);
+    pooled_before += cached;
+
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    switch_page_directory(process_vm_get_page_dir(pid));
+
+    int result = 0;
+    if (map_range(TEARDOWN_DENSE_VADDR, MAP_RANGE_ALLOC, TEARDOWN_DENSE_PAGES,
+                  PAGE_USER_RW) != 0) {
+        kprint("VM_TEST: Failed to map dense teardown range\n");
+        result = -1;
+    }
+    for (uint32_t i = 0; i < TEARDOWN_SPARSE_SLOTS && result == 0; i++) {
+        if (map_range(TEARDOWN_SPARSE_VADDR + (uint64_t)i * TEARDOWN_SPARSE_STRIDE,
+                      MAP_RANGE_ALLOC, 1, PAGE_USER_RW) != 0) {
+            kprint("VM_TEST: Failed to map sparse teardown page\n");
+            result = -1;
+        }
+    }
+
+    /* Leave the process directory active to exercise the self-teardown path */
+    uint64_t start = cpu_read_tsc();
+    destroy_process_vm(pid);
+    uint64_t cycles = cpu_read_tsc() - start;
+
+    if (get_current_page_directory() != paging_get_kernel_directory()) {
+        kprint("VM_TEST: Teardown left CR3 on the destroyed directory\n");
+        result = -1;
+    }
+    if (saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+
+    get_page_allocator_stats(NULL, &free_after, NULL);
+    get_page_zero_pool_stats(&pooled_after, NULL, NULL);
+    get_pml4_cache_stats(&cached, NULL, NULL);
+    pooled_after += cached;
+    if (free_after + pooled_after < free_before + pooled_before + stack_pages + 1) {
+        kprint("VM_TEST: Teardown leaked ");
+        kprint_decimal(free_before + pooled_before + stack_pages + 1 - free_after - pooled_after);
+        kprint(" frames\n");
+        result = -1;
+    }
+
+    kprint("VM_TEST:   teardown of ");
+    kprint_decimal(TEARDOWN_DENSE_PAGES + TEARDOWN_SPARSE_SLOTS + stack_pages);
+    kprint(" pages: ");
+    kprint_decimal(cycles);
+    kprint(" cycles\n");
+
+    if (result == 0) {
+        kprint("VM_TEST: Bulk address space teardown test PASSED\n");
+    }
+    return result;
+}
+
+/* Process lifecycle benchmark: create/destroy pairs per mode */
+#define LIFECYCLE_BENCH_ROUNDS        64
+
+/*
+ * Time create_process_vm/destroy_process_vm pairs, returning total create
+ * and destroy cycles through the out parameters. Returns -1 on failure
+ */
+static int lifecycle_bench_run(uint64_t *create_cycles, uint64_t *destroy_cycles) {
+    *create_cycles = 0;
+    *destroy_cycles = 0;
+
+    for (uint32_t i = 0; i < LIFECYCLE_BENCH_ROUNDS; i++) {
+        uint64_t start = cpu_read_tsc();
+        uint32_t pid = create_process_vm();
+        uint64_t created = cpu_read_tsc();
+        if (pid == INVALID_PROCESS_ID) {
+            return -1;
+        }
+        destroy_process_vm(pid);
+        uint64_t destroyed = cpu_read_tsc();
+
+        *create_cycles += created - start;
+        *destroy_cycles += destroyed - created;
+    }
+
+    return 0;
+}
+
+/*
+ * Test: Process creation pops a ready-made PML4
+ * Runs create/destroy pairs with the PML4 cache disabled and enabled and
+ * reports the average latency of each. With the cache on, every PML4 after
+ * the first must come from the cache and carry the kernel half exactly
+ */
+int test_process_vm_lifecycle_benchmark(void) {
+    kprint("VM_TEST: Starting process create/destroy benchmark\n");
+
+    uint64_t cold_create = 0;
+    uint64_t cold_destroy = 0;
+    uint64_t warm_create = 0;
+    uint64_t warm_destroy = 0;
+    int result = 0;
+
+    paging_set_pml4_cache(0);
+    if (lifecycle_bench_run(&cold_create, &cold_destroy) != 0) {
+        kprint("VM_TEST: Process creation failed without PML4 cache\n");
+        result = -1;
+    }
+
+    paging_set_pml4_cache(1);
+    uint64_t hits_before = 0;
+    uint64_t hits_after = 0;
+    get_pml4_cache_stats(NULL, &hits_before, NULL);
+    if (result == 0 && lifecycle_bench_run(&warm_create, &warm_destroy) != 0) {
+        kprint("VM_TEST: Process creation failed with PML4 cache\n");
+        result = -1;
+    }
+    get_pml4_cache_stats(NULL, &hits_after, NULL);
+
+    if (result == 0 && hits_after - hits_before < LIFECYCLE_BENCH_ROUNDS - 1) {
+        kprint("VM_TEST: PML4 cache missed during create/destroy pairs\n");
+        result = -1;
+    }
+
+    /* A recycled PML4 must match the kernel template */
+    uint32_t pid = create_process_vm();
+    process_page_dir_t *page_dir = process_vm_get_page_dir(pid);
+    process_page_dir_t *kernel_dir = paging_get_kernel_directory();
+    if (!page_dir) {
+        kprint("VM_TEST: Failed to create process for template check\n");
+        result = -1;
+    } else {
+        for (uint32_t i = ENTRIES_PER_PAGE_TABLE / 2; i < ENTRIES_PER_PAGE_TABLE; i++) {
+            if ((page_dir->pml4->entries[i] & ~0xFFFULL) !=
+                (kernel_dir->pml4->entries[i] & ~0xFFFULL)) {
+                kprint("VM_TEST: Cached PML4 kernel half out of sync\n");
+                result = -1;
+                break;
+            }
+        }
+    }
+    destroy_process_vm(pid);
+
+    kprint("VM_TEST:   create/destroy: ");
+    kprint_decimal(cold_create / LIFECYCLE_BENCH_ROUNDS);
+    kprint("/");
+    kprint_decimal(cold_destroy / LIFECYCLE_BENCH_ROUNDS);
+    kprint(" cycles built, ");
+    kprint_decimal(warm_create / LIFECYCLE_BENCH_ROUNDS);
+    kprint("/");
+    kprint_decimal(warm_destroy / LIFECYCLE_BENCH_ROUNDS);
+    kprint(" cycles cached\n");
+
+    if (result == 0) {
+        kprint("VM_TEST: Process create/destroy benchmark PASSED\n");
+    }
+    return result;
+}
+
 /*
  * Run all VM manager regression tests
  * Returns number of tests passed
@@ -492,6 +1440,56 @@ int run_vm_manager_tests(void) {
         passed++;
     }
 
+    total++;
+    if (test_map_range_benchmark() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_pcid_switch_benchmark() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_vma_fault_around_benchmark() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_process_vm_cow_clone() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_vma_tree_lookup() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_vma_descriptor_recycle() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_page_table_reclaim() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_process_vm_bulk_teardown() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_process_vm_lifecycle_benchmark() == 0) {
+        passed++;
+    }
+
+    total++;
+    if (test_kernel_mappings_global() == 0) {
+        passed++;
+    }
+
     kprint("VM_TEST: Completed ");
     kprint_decimal(total);
     kprint(" tests, ");
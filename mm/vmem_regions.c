@@ -9,42 +9,24 @@
 #include "../boot/constants.h"
 #include "../drivers/serial.h"
 #include "../boot/log.h"
+#include "kmem_cache.h"
 #include "page_alloc.h"
 #include "paging.h"
+#include "vmem_regions.h"
 
 /* Forward declarations */
 void kernel_panic(const char *message);
+process_page_dir_t *process_vm_get_page_dir(uint32_t process_id);
 
 /* ========================================================================
  * VIRTUAL MEMORY REGION CONSTANTS
  * ======================================================================== */
 
-/* Virtual memory region types */
-#define VMA_TYPE_CODE                 0x01   /* Code segment */
-#define VMA_TYPE_DATA                 0x02   /* Data segment */
-#define VMA_TYPE_HEAP                 0x03   /* Heap region */
-#define VMA_TYPE_STACK                0x04   /* Stack region */
-#define VMA_TYPE_SHARED               0x05   /* Shared memory */
-#define VMA_TYPE_DEVICE               0x06   /* Device memory mapping */
-#define VMA_TYPE_ANONYMOUS            0x07   /* Anonymous mapping */
-
-/* Virtual memory access flags */
-#define VMA_READ                      0x01   /* Region is readable */
-#define VMA_WRITE                     0x02   /* Region is writable */
-#define VMA_EXEC                      0x04   /* Region is executable */
-#define VMA_USER                      0x08   /* User-accessible region */
-#define VMA_SHARED                    0x10   /* Shared between processes */
-#define VMA_GROWSDOWN                 0x20   /* Stack-like region (grows down) */
-#define VMA_LOCKED                    0x40   /* Region is locked in memory */
-
-/* Virtual memory allocation policies */
-#define VMA_POLICY_DEMAND             0x01   /* Allocate on demand */
-#define VMA_POLICY_PREFAULT           0x02   /* Pre-allocate physical pages */
-#define VMA_POLICY_ZERO               0x04   /* Zero pages on allocation */
-
 /* Maximum number of VMAs per process */
 #define MAX_VMAS_PER_PROCESS          64
-#define INVALID_VMA_ID                0xFFFFFFFF
+
+/* Top of the address range VMAs may occupy (end of user space) */
+#define VMA_SPACE_END                 0x800000000000ULL
 
 /* ========================================================================
  * VIRTUAL MEMORY REGION STRUCTURES
@@ -61,14 +43,21 @@ typedef struct vma_region {
     uint64_t file_offset;         /* File offset (for file mappings) */
     uint32_t process_id;          /* Owning process ID */
     uint32_t vma_id;              /* Unique VMA identifier */
-    struct vma_region *next;      /* Next VMA in process */
-    struct vma_region *prev;      /* Previous VMA in process */
+    vma_fault_stats_t fault_stats; /* Demand paging counters */
+    struct vma_region *next;      /* Next VMA in process (address order) */
+    struct vma_region *prev;      /* Previous VMA in process (address order) */
+    struct vma_region *left;      /* Lower-addressed subtree */
+    struct vma_region *right;     /* Higher-addressed subtree */
+    uint32_t height;              /* AVL subtree height */
+    uint64_t subtree_gap;         /* Largest free gap below any VMA in subtree */
 } vma_region_t;
 
 /* Per-process VMA management */
 typedef struct process_vma_space {
     uint32_t process_id;          /* Process identifier */
-    vma_region_t *vma_list;       /* Head of VMA list */
+    vma_region_t *vma_list;       /* Lowest VMA (head of address-ordered list) */
+    vma_region_t *vma_tree;       /* Root of AVL tree keyed by start address */
+    vma_region_t *last_vma;       /* Last VMA found by address lookup */
     uint32_t num_vmas;            /* Number of VMAs */
     uint64_t total_size;          /* Total virtual memory size */
     uint64_t code_start;          /* Code segment start */
@@ -82,32 +71,38 @@ typedef struct process_vma_space {
 
 /* Global VMA manager */
 typedef struct vma_manager {
-    vma_region_t vma_pool[MAX_PROCESSES * MAX_VMAS_PER_PROCESS];  /* VMA pool */
-    uint32_t vma_pool_index;      /* Next free VMA index */
     process_vma_space_t process_spaces[MAX_PROCESSES];  /* Per-process spaces */
     uint32_t num_processes;       /* Number of processes */
     uint32_t next_vma_id;         /* Next VMA ID to assign */
     uint32_t total_vmas;          /* Total VMAs allocated */
+    uint32_t peak_vmas;           /* High-water mark of total_vmas */
     uint64_t total_virtual_memory; /* Total virtual memory mapped */
+    uint64_t peak_virtual_memory; /* High-water mark of total_virtual_memory */
+    uint32_t fault_around_pages;  /* Fault-around window in pages */
 } vma_manager_t;
 
 /* Global VMA manager instance */
 static vma_manager_t vma_manager = {0};
 
+/* Object cache backing VMA descriptors */
+static kmem_cache_t *vma_region_cache = NULL;
+
 /* ========================================================================
  * UTILITY FUNCTIONS
  * ======================================================================== */
 
 /*
- * Allocate a new VMA from the pool
+ * Allocate a new VMA descriptor
+ * Descriptors come from an object cache, so freed ones are recycled and
+ * the backing memory grows and shrinks with the number of live regions
  */
 static vma_region_t *alloc_vma(void) {
-    if (vma_manager.vma_pool_index >= (MAX_PROCESSES * MAX_VMAS_PER_PROCESS)) {
-        kprint("alloc_vma: VMA pool exhausted\n");
+    vma_region_t *vma = (vma_region_t *)kmem_cache_alloc(vma_region_cache);
+    if (!vma) {
+        kprint("alloc_vma: Failed to allocate VMA descriptor\n");
         return NULL;
     }
 
-    vma_region_t *vma = &vma_manager.vma_pool[vma_manager.vma_pool_index++];
     vma->start_addr = 0;
     vma->end_addr = 0;
     vma->flags = 0;
@@ -117,15 +112,25 @@ static vma_region_t *alloc_vma(void) {
     vma->file_offset = 0;
     vma->process_id = 0;
     vma->vma_id = vma_manager.next_vma_id++;
+    vma->fault_stats.faults = 0;
+    vma->fault_stats.pages_faulted = 0;
+    vma->fault_stats.pages_prefaulted = 0;
     vma->next = NULL;
     vma->prev = NULL;
+    vma->left = NULL;
+    vma->right = NULL;
+    vma->height = 1;
+    vma->subtree_gap = 0;
 
     vma_manager.total_vmas++;
+    if (vma_manager.total_vmas > vma_manager.peak_vmas) {
+        vma_manager.peak_vmas = vma_manager.total_vmas;
+    }
     return vma;
 }
 
 /*
- * Free VMA back to pool
+ * Return a VMA descriptor to the cache
  */
 static void free_vma(vma_region_t *vma) {
     if (!vma) {
@@ -133,36 +138,42 @@ static void free_vma(vma_region_t *vma) {
     }
 
     vma->ref_count = 0;
+    kmem_cache_free(vma_region_cache, vma);
     vma_manager.total_vmas--;
 }
 
 /*
  * Find process VMA space by process ID
+ * Spaces live in the slot indexed by PID modulo MAX_PROCESSES; the process
+ * VM manager hands out PIDs so that live processes never share a slot
  */
 static process_vma_space_t *find_process_vma_space(uint32_t process_id) {
-    for (uint32_t i = 0; i < vma_manager.num_processes; i++) {
-        if (vma_manager.process_spaces[i].process_id == process_id) {
-            return &vma_manager.process_spaces[i];
-        }
+    if (process_id == INVALID_PROCESS_ID) {
+        return NULL;
     }
-    return NULL;
+
+    process_vma_space_t *space = &vma_manager.process_spaces[process_id % MAX_PROCESSES];
+    return (space->process_id == process_id) ? space : NULL;
 }
 
 /*
  * Check if address range overlaps with existing VMAs
+ * VMAs never overlap each other, so one descent by address suffices
  */
 static int check_vma_overlap(process_vma_space_t *space, uint64_t start, uint64_t end) {
     if (!space) {
         return 0;
     }
 
-    vma_region_t *vma = space->vma_list;
+    vma_region_t *vma = space->vma_tree;
     while (vma) {
-        /* Check for overlap */
-        if (!(end <= vma->start_addr || start >= vma->end_addr)) {
+        if (end <= vma->start_addr) {
+            vma = vma->left;
+        } else if (start >= vma->end_addr) {
+            vma = vma->right;
+        } else {
             return 1;  /* Overlap detected */
         }
-        vma = vma->next;
     }
 
     return 0;  /* No overlap */
@@ -190,72 +201,233 @@ static uint64_t vma_flags_to_page_flags(uint32_t vma_flags) {
     return page_flags;
 }
 
+/*
+ * Unmap a VMA, returning its frames unless it maps device memory
+ */
+static void vma_unmap_all(vma_region_t *vma) {
+    uint64_t pages = (vma->end_addr - vma->start_addr) / PAGE_SIZE_4KB;
+    uint32_t unmap_flags = (vma->type == VMA_TYPE_DEVICE) ? 0 : UNMAP_RANGE_FREE_FRAMES;
+    unmap_range(vma->start_addr, pages, unmap_flags);
+}
+
 /* ========================================================================
- * VMA LIST MANAGEMENT
+ * VMA TREE MANAGEMENT
  * ======================================================================== */
 
 /*
- * Insert VMA into process VMA list (sorted by address)
+ * VMAs of a space sit in an AVL tree keyed by start address and on a
+ * doubly linked list in the same order. Each node caches the largest free
+ * gap below any VMA of its subtree, so lookups, overlap checks and gap
+ * searches all take O(log n)
  */
-static void insert_vma_sorted(process_vma_space_t *space, vma_region_t *new_vma) {
-    if (!space || !new_vma) {
-        return;
+
+static inline uint32_t vma_height(const vma_region_t *vma) {
+    return vma ? vma->height : 0;
+}
+
+/* Free space between a VMA and its lower neighbour */
+static inline uint64_t vma_gap_below(const vma_region_t *vma) {
+    return vma->start_addr - (vma->prev ? vma->prev->end_addr : 0);
+}
+
+/*
+ * Recompute a node's height and subtree gap from its children
+ */
+static void vma_tree_update(vma_region_t *vma) {
+    uint32_t left_height = vma_height(vma->left);
+    uint32_t right_height = vma_height(vma->right);
+    vma->height = 1 + (left_height > right_height ? left_height : right_height);
+
+    uint64_t gap = vma_gap_below(vma);
+    if (vma->left && vma->left->subtree_gap > gap) {
+        gap = vma->left->subtree_gap;
+    }
+    if (vma->right && vma->right->subtree_gap > gap) {
+        gap = vma->right->subtree_gap;
     }
+    vma->subtree_gap = gap;
+}
 
-    /* Empty list */
-    if (!space->vma_list) {
-        space->vma_list = new_vma;
-        space->num_vmas++;
-        space->total_size += (new_vma->end_addr - new_vma->start_addr);
-        return;
+static vma_region_t *vma_rotate_right(vma_region_t *vma) {
+    vma_region_t *pivot = vma->left;
+    vma->left = pivot->right;
+    pivot->right = vma;
+    vma_tree_update(vma);
+    vma_tree_update(pivot);
+    return pivot;
+}
+
+static vma_region_t *vma_rotate_left(vma_region_t *vma) {
+    vma_region_t *pivot = vma->right;
+    vma->right = pivot->left;
+    pivot->left = vma;
+    vma_tree_update(vma);
+    vma_tree_update(pivot);
+    return pivot;
+}
+
+/*
+ * Restore the AVL invariant at a node whose subtrees changed
+ * Returns the new subtree root
+ */
+static vma_region_t *vma_tree_rebalance(vma_region_t *vma) {
+    vma_tree_update(vma);
+
+    int32_t balance = (int32_t)vma_height(vma->left) - (int32_t)vma_height(vma->right);
+    if (balance > 1) {
+        if (vma_height(vma->left->left) < vma_height(vma->left->right)) {
+            vma->left = vma_rotate_left(vma->left);
+        }
+        return vma_rotate_right(vma);
+    }
+    if (balance < -1) {
+        if (vma_height(vma->right->right) < vma_height(vma->right->left)) {
+            vma->right = vma_rotate_right(vma->right);
+        }
+        return vma_rotate_left(vma);
     }
 
-    /* Insert at beginning */
-    if (new_vma->start_addr < space->vma_list->start_addr) {
-        new_vma->next = space->vma_list;
-        space->vma_list->prev = new_vma;
-        space->vma_list = new_vma;
-        space->num_vmas++;
-        space->total_size += (new_vma->end_addr - new_vma->start_addr);
+    return vma;
+}
+
+static vma_region_t *vma_tree_insert(vma_region_t *root, vma_region_t *vma) {
+    if (!root) {
+        vma_tree_update(vma);
+        return vma;
+    }
+
+    if (vma->start_addr < root->start_addr) {
+        root->left = vma_tree_insert(root->left, vma);
+    } else {
+        root->right = vma_tree_insert(root->right, vma);
+    }
+    return vma_tree_rebalance(root);
+}
+
+static vma_region_t *vma_tree_remove_min(vma_region_t *root, vma_region_t **min) {
+    if (!root->left) {
+        *min = root;
+        return root->right;
+    }
+
+    root->left = vma_tree_remove_min(root->left, min);
+    return vma_tree_rebalance(root);
+}
+
+static vma_region_t *vma_tree_remove(vma_region_t *root, vma_region_t *vma) {
+    if (!root) {
+        return NULL;
+    }
+
+    if (vma->start_addr < root->start_addr) {
+        root->left = vma_tree_remove(root->left, vma);
+    } else if (vma->start_addr > root->start_addr) {
+        root->right = vma_tree_remove(root->right, vma);
+    } else {
+        if (!root->left || !root->right) {
+            return root->left ? root->left : root->right;
+        }
+
+        vma_region_t *successor = NULL;
+        vma_region_t *right = vma_tree_remove_min(root->right, &successor);
+        successor->left = root->left;
+        successor->right = right;
+        root = successor;
+    }
+
+    return vma_tree_rebalance(root);
+}
+
+/*
+ * Refresh cached gaps on the path from root to the VMA starting at addr
+ */
+static void vma_tree_refresh_path(vma_region_t *root, uint64_t addr) {
+    if (!root) {
         return;
     }
 
-    /* Find insertion point */
-    vma_region_t *current = space->vma_list;
-    while (current->next && current->next->start_addr < new_vma->start_addr) {
-        current = current->next;
+    if (addr < root->start_addr) {
+        vma_tree_refresh_path(root->left, addr);
+    } else if (addr > root->start_addr) {
+        vma_tree_refresh_path(root->right, addr);
     }
+    vma_tree_update(root);
+}
 
-    /* Insert after current */
-    new_vma->next = current->next;
-    new_vma->prev = current;
+/*
+ * Find the highest VMA starting below addr
+ */
+static vma_region_t *vma_tree_predecessor(vma_region_t *root, uint64_t addr) {
+    vma_region_t *best = NULL;
+    while (root) {
+        if (root->start_addr < addr) {
+            best = root;
+            root = root->right;
+        } else {
+            root = root->left;
+        }
+    }
+    return best;
+}
 
-    if (current->next) {
-        current->next->prev = new_vma;
+/*
+ * Insert VMA into the process VMA tree and address-ordered list
+ */
+static void insert_vma_sorted(process_vma_space_t *space, vma_region_t *new_vma) {
+    if (!space || !new_vma) {
+        return;
     }
-    current->next = new_vma;
+
+    vma_region_t *prev = vma_tree_predecessor(space->vma_tree, new_vma->start_addr);
+    vma_region_t *next = prev ? prev->next : space->vma_list;
+
+    new_vma->prev = prev;
+    new_vma->next = next;
+    if (prev) {
+        prev->next = new_vma;
+    } else {
+        space->vma_list = new_vma;
+    }
+    if (next) {
+        next->prev = new_vma;
+    }
+
+    /* The new VMA shrinks the gap below next, an ancestor of the new leaf */
+    space->vma_tree = vma_tree_insert(space->vma_tree, new_vma);
 
     space->num_vmas++;
     space->total_size += (new_vma->end_addr - new_vma->start_addr);
 }
 
 /*
- * Remove VMA from process VMA list
+ * Remove VMA from the process VMA tree and list
  */
 static void remove_vma_from_list(process_vma_space_t *space, vma_region_t *vma) {
     if (!space || !vma) {
         return;
     }
 
+    vma_region_t *next = vma->next;
+
     /* Update linked list pointers */
     if (vma->prev) {
-        vma->prev->next = vma->next;
+        vma->prev->next = next;
     } else {
-        space->vma_list = vma->next;
+        space->vma_list = next;
     }
 
-    if (vma->next) {
-        vma->next->prev = vma->prev;
+    if (next) {
+        next->prev = vma->prev;
+    }
+
+    space->vma_tree = vma_tree_remove(space->vma_tree, vma);
+    if (next) {
+        /* The gap below next grew by the removed region */
+        vma_tree_refresh_path(space->vma_tree, next->start_addr);
+    }
+
+    if (space->last_vma == vma) {
+        space->last_vma = NULL;
     }
 
     space->num_vmas--;
@@ -263,33 +435,95 @@ static void remove_vma_from_list(process_vma_space_t *space, vma_region_t *vma)
 
     vma->next = NULL;
     vma->prev = NULL;
+    vma->left = NULL;
+    vma->right = NULL;
 }
 
 /*
  * Find VMA containing virtual address
+ * Sequential faults mostly land in the VMA hit last, so check it first
  */
 static vma_region_t *find_vma_by_address(process_vma_space_t *space, uint64_t vaddr) {
     if (!space) {
         return NULL;
     }
 
-    vma_region_t *vma = space->vma_list;
+    vma_region_t *vma = space->last_vma;
+    if (vma && vaddr >= vma->start_addr && vaddr < vma->end_addr) {
+        return vma;
+    }
+
+    vma = space->vma_tree;
     while (vma) {
-        if (vaddr >= vma->start_addr && vaddr < vma->end_addr) {
+        if (vaddr < vma->start_addr) {
+            vma = vma->left;
+        } else if (vaddr >= vma->end_addr) {
+            vma = vma->right;
+        } else {
+            space->last_vma = vma;
             return vma;
         }
-        vma = vma->next;
     }
 
     return NULL;
 }
 
+/*
+ * Find the lowest-addressed VMA with at least size free bytes below it
+ * at or above floor. Subtrees whose largest gap is too small are skipped
+ */
+static vma_region_t *vma_tree_find_gap(vma_region_t *root, uint64_t size, uint64_t floor) {
+    if (!root || root->subtree_gap < size) {
+        return NULL;
+    }
+
+    /* Gaps of the left subtree all end at or below this VMA's start */
+    if (root->start_addr > floor) {
+        vma_region_t *found = vma_tree_find_gap(root->left, size, floor);
+        if (found) {
+            return found;
+        }
+    }
+
+    uint64_t gap_start = root->prev ? root->prev->end_addr : 0;
+    if (gap_start < floor) {
+        gap_start = floor;
+    }
+    if (root->start_addr >= gap_start && root->start_addr - gap_start >= size) {
+        return root;
+    }
+
+    return vma_tree_find_gap(root->right, size, floor);
+}
+
+/*
+ * Find a free, page-aligned address range of size bytes at or above floor
+ * Returns 0 if the address space has no such gap
+ */
+static uint64_t find_vma_gap(process_vma_space_t *space, uint64_t size, uint64_t floor) {
+    vma_region_t *vma = vma_tree_find_gap(space->vma_tree, size, floor);
+    if (vma) {
+        uint64_t gap_start = vma->prev ? vma->prev->end_addr : 0;
+        return (gap_start > floor) ? gap_start : floor;
+    }
+
+    /* Above the highest VMA */
+    vma_region_t *last = vma_tree_predecessor(space->vma_tree, VMA_SPACE_END);
+    uint64_t start = (last && last->end_addr > floor) ? last->end_addr : floor;
+    if (start >= VMA_SPACE_END || VMA_SPACE_END - start < size) {
+        return 0;
+    }
+    return start;
+}
+
 /* ========================================================================
  * VIRTUAL MEMORY ALLOCATION
  * ======================================================================== */
 
 /*
  * Create a new VMA in process address space
+ * A start of 0 places the VMA in the lowest free gap above mmap_start.
+ * Returns the VMA start address, 0 on failure
  */
 uint64_t create_vma_region(uint32_t process_id, uint64_t start, uint64_t size,
                            uint32_t flags, uint32_t type) {
@@ -298,13 +532,26 @@ uint64_t create_vma_region(uint32_t process_id, uint64_t start, uint64_t size,
         return 0;
     }
 
+    process_vma_space_t *space = find_process_vma_space(process_id);
+    if (!space) {
+        kprint("create_vma_region: Process not found\n");
+        return 0;
+    }
+
+    if (start == 0) {
+        start = find_vma_gap(space, size, space->mmap_start);
+        if (!start) {
+            kprint("create_vma_region: No free gap for region\n");
+            return 0;
+        }
+    }
+
     /* Align addresses to page boundaries */
     uint64_t aligned_start = start & ~(PAGE_SIZE_4KB - 1);
     uint64_t aligned_end = aligned_start + size;
 
-    process_vma_space_t *space = find_process_vma_space(process_id);
-    if (!space) {
-        kprint("create_vma_region: Process not found\n");
+    if (space->num_vmas >= MAX_VMAS_PER_PROCESS) {
+        kprint("create_vma_region: Too many VMAs in process\n");
         return 0;
     }
 
@@ -333,6 +580,9 @@ uint64_t create_vma_region(uint32_t process_id, uint64_t start, uint64_t size,
     insert_vma_sorted(space, vma);
 
     vma_manager.total_virtual_memory += size;
+    if (vma_manager.total_virtual_memory > vma_manager.peak_virtual_memory) {
+        vma_manager.peak_virtual_memory = vma_manager.total_virtual_memory;
+    }
 
     kprint("Created VMA: ");
     kprint_hex(aligned_start);
@@ -361,9 +611,7 @@ int destroy_vma_region(uint32_t process_id, uint64_t vaddr) {
     }
 
     /* Unmap all pages in the region */
-    for (uint64_t addr = vma->start_addr; addr < vma->end_addr; addr += PAGE_SIZE_4KB) {
-        unmap_page(addr);
-    }
+    vma_unmap_all(vma);
 
     uint64_t size = vma->end_addr - vma->start_addr;
 
@@ -382,8 +630,50 @@ int destroy_vma_region(uint32_t process_id, uint64_t vaddr) {
     return 0;
 }
 
+/* ========================================================================
+ * DEMAND PAGING
+ * ======================================================================== */
+
+/*
+ * Map every unmapped page in [start, end) of a VMA
+ * Unmapped runs go to map_range in one batch each. Returns the number of
+ * pages mapped, or -1 if a run could not be backed
+ */
+static int64_t vma_populate(vma_region_t *vma, uint64_t start, uint64_t end) {
+    uint64_t page_flags = vma_flags_to_page_flags(vma->flags);
+    uint64_t backing = (vma->policy & VMA_POLICY_ZERO) ? MAP_RANGE_ALLOC_ZERO : MAP_RANGE_ALLOC;
+    int64_t mapped = 0;
+    uint64_t addr = start;
+
+    while (addr < end) {
+        if (virt_to_phys(addr)) {
+            addr += PAGE_SIZE_4KB;
+            continue;
+        }
+
+        uint64_t run_end = addr + PAGE_SIZE_4KB;
+        while (run_end < end && !virt_to_phys(run_end)) {
+            run_end += PAGE_SIZE_4KB;
+        }
+
+        uint64_t pages = (run_end - addr) / PAGE_SIZE_4KB;
+        if (map_range(addr, backing, pages, page_flags) != 0) {
+            return -1;
+        }
+
+        mapped += (int64_t)pages;
+        addr = run_end;
+    }
+
+    return mapped;
+}
+
 /*
  * Handle page fault in VMA region (demand paging)
+ * Must run with the faulting process's page directory active. Maps the
+ * faulting page plus the unmapped pages of its aligned fault-around window
+ * (the whole VMA under VMA_POLICY_PREFAULT). Returns -1 if the address is
+ * outside every VMA or already mapped, so the caller treats it as a real fault
  */
 int handle_vma_page_fault(uint32_t process_id, uint64_t fault_addr) {
     process_vma_space_t *space = find_process_vma_space(process_id);
@@ -393,43 +683,102 @@ int handle_vma_page_fault(uint32_t process_id, uint64_t fault_addr) {
 
     vma_region_t *vma = find_vma_by_address(space, fault_addr);
     if (!vma) {
-        kprint("handle_vma_page_fault: Address not in any VMA\n");
         return -1;
     }
 
     /* Align fault address to page boundary */
-    uint64_t page_addr = fault_addr & ~(PAGE_SIZE_4KB - 1);
+    uint64_t page_addr = fault_addr & ~(uint64_t)(PAGE_SIZE_4KB - 1);
+    if (virt_to_phys(page_addr)) {
+        return -1;  /* Protection fault on a present page */
+    }
+
+    uint64_t window_start = vma->start_addr;
+    uint64_t window_end = vma->end_addr;
+
+    if (!(vma->policy & VMA_POLICY_PREFAULT)) {
+        uint64_t window_bytes = (uint64_t)vma_manager.fault_around_pages * PAGE_SIZE_4KB;
+        if (window_bytes < PAGE_SIZE_4KB) {
+            window_bytes = PAGE_SIZE_4KB;
+        }
 
-    /* Allocate physical page */
-    uint32_t alloc_flags = 0;
-    if (vma->policy & VMA_POLICY_ZERO) {
-        alloc_flags |= 0x01;  /* Zero page flag */
+        uint64_t aligned = page_addr - (page_addr % window_bytes);
+        if (aligned > window_start) {
+            window_start = aligned;
+        }
+        if (aligned + window_bytes < window_end) {
+            window_end = aligned + window_bytes;
+        }
+    }
+
+    int64_t mapped = vma_populate(vma, window_start, window_end);
+    if (mapped < 0) {
+        /* Out of frames for the window - settle for the faulting page */
+        mapped = vma_populate(vma, page_addr, page_addr + PAGE_SIZE_4KB);
+        if (mapped <= 0) {
+            kprint("handle_vma_page_fault: Failed to back faulting page\n");
+            return -1;
+        }
+    }
+
+    vma->fault_stats.faults++;
+    vma->fault_stats.pages_faulted += (uint64_t)mapped;
+    return 0;
+}
+
+/*
+ * Change the allocation policy of the VMA containing vaddr
+ * Switching to VMA_POLICY_PREFAULT populates the whole region right away
+ * when the owning process's page directory is active; otherwise the first
+ * fault populates it
+ */
+int set_vma_policy(uint32_t process_id, uint64_t vaddr, uint32_t policy) {
+    process_vma_space_t *space = find_process_vma_space(process_id);
+    if (!space) {
+        return -1;
     }
 
-    uint64_t phys_page = alloc_page_frame(alloc_flags);
-    if (!phys_page) {
-        kprint("handle_vma_page_fault: Failed to allocate physical page\n");
+    vma_region_t *vma = find_vma_by_address(space, vaddr);
+    if (!vma) {
+        kprint("set_vma_policy: VMA not found\n");
         return -1;
     }
 
-    /* Map virtual page to physical page */
-    uint64_t page_flags = vma_flags_to_page_flags(vma->flags);
-    if (map_page_2mb(page_addr, phys_page, page_flags) != 0) {
-        /* Try 4KB mapping if 2MB fails */
-        kprint("VMA page fault: Mapped 4KB page at ");
-        kprint_hex(page_addr);
-        kprint("\n");
+    vma->policy = policy;
+
+    process_page_dir_t *page_dir = get_current_page_directory();
+    if ((policy & VMA_POLICY_PREFAULT) && page_dir && page_dir->process_id == process_id) {
+        int64_t mapped = vma_populate(vma, vma->start_addr, vma->end_addr);
+        if (mapped < 0) {
+            kprint("set_vma_policy: Failed to prefault region\n");
+            return -1;
+        }
+        vma->fault_stats.pages_prefaulted += (uint64_t)mapped;
     }
 
-    kprint("VMA page fault handled: ");
-    kprint_hex(page_addr);
-    kprint(" -> ");
-    kprint_hex(phys_page);
-    kprint("\n");
+    return 0;
+}
 
+/*
+ * Get demand paging counters of the VMA containing vaddr
+ */
+int get_vma_fault_stats(uint32_t process_id, uint64_t vaddr, vma_fault_stats_t *stats) {
+    process_vma_space_t *space = find_process_vma_space(process_id);
+    vma_region_t *vma = find_vma_by_address(space, vaddr);
+    if (!vma || !stats) {
+        return -1;
+    }
+
+    *stats = vma->fault_stats;
     return 0;
 }
 
+/*
+ * Set the fault-around window (1 disables populating neighbours)
+ */
+void set_vma_fault_around(uint32_t pages) {
+    vma_manager.fault_around_pages = pages ? pages : 1;
+}
+
 /* ========================================================================
  * PROCESS VMA SPACE MANAGEMENT
  * ======================================================================== */
@@ -443,10 +792,20 @@ int create_process_vma_space(uint32_t process_id) {
         return -1;
     }
 
-    process_vma_space_t *space = &vma_manager.process_spaces[vma_manager.num_processes];
+    if (process_id == INVALID_PROCESS_ID) {
+        return -1;
+    }
+
+    process_vma_space_t *space = &vma_manager.process_spaces[process_id % MAX_PROCESSES];
+    if (space->process_id != INVALID_PROCESS_ID) {
+        kprint("create_process_vma_space: VMA space slot already in use\n");
+        return -1;
+    }
 
     space->process_id = process_id;
     space->vma_list = NULL;
+    space->vma_tree = NULL;
+    space->last_vma = NULL;
     space->num_vmas = 0;
     space->total_size = 0;
     space->code_start = 0x400000;       /* 4MB */
@@ -466,6 +825,59 @@ int create_process_vma_space(uint32_t process_id) {
     return 0;
 }
 
+/*
+ * Clone the VMA space of one process into a new process
+ * Regions keep their flags, type and policy; fault counters start over.
+ * A source without a VMA space leaves nothing to clone. The new space is
+ * torn down again if any region cannot be copied
+ */
+int clone_process_vma_space(uint32_t src_process_id, uint32_t dst_process_id) {
+    process_vma_space_t *src = find_process_vma_space(src_process_id);
+    if (!src) {
+        return 0;
+    }
+
+    if (create_process_vma_space(dst_process_id) != 0) {
+        return -1;
+    }
+
+    process_vma_space_t *dst = find_process_vma_space(dst_process_id);
+    dst->code_start = src->code_start;
+    dst->data_start = src->data_start;
+    dst->heap_start = src->heap_start;
+    dst->heap_current = src->heap_current;
+    dst->stack_start = src->stack_start;
+    dst->mmap_start = src->mmap_start;
+    dst->flags = src->flags;
+
+    for (vma_region_t *vma = src->vma_list; vma; vma = vma->next) {
+        vma_region_t *copy = alloc_vma();
+        if (!copy) {
+            kprint("clone_process_vma_space: Failed to copy region\n");
+            destroy_process_vma_space(dst_process_id);
+            return -1;
+        }
+
+        copy->start_addr = vma->start_addr;
+        copy->end_addr = vma->end_addr;
+        copy->flags = vma->flags;
+        copy->type = vma->type;
+        copy->policy = vma->policy;
+        copy->file_offset = vma->file_offset;
+        copy->process_id = dst_process_id;
+
+        /* Appending in address order keeps every insert next to its predecessor */
+        insert_vma_sorted(dst, copy);
+        vma_manager.total_virtual_memory += copy->end_addr - copy->start_addr;
+    }
+
+    if (vma_manager.total_virtual_memory > vma_manager.peak_virtual_memory) {
+        vma_manager.peak_virtual_memory = vma_manager.total_virtual_memory;
+    }
+
+    return 0;
+}
+
 /*
  * Destroy VMA space for process
  */
@@ -475,23 +887,41 @@ int destroy_process_vma_space(uint32_t process_id) {
         return -1;
     }
 
+    /*
+     * Pages live in the process page directory. Once destroy_process_vm
+     * has freed it in bulk only the descriptors are left to drop
+     */
+    process_page_dir_t *page_dir = process_vm_get_page_dir(process_id);
+    process_page_dir_t *saved_page_dir = get_current_page_directory();
+    if (page_dir && page_dir != saved_page_dir) {
+        switch_page_directory(page_dir);
+    }
+
     /* Free all VMAs in the process */
     vma_region_t *vma = space->vma_list;
     while (vma) {
         vma_region_t *next = vma->next;
 
         /* Unmap all pages */
-        for (uint64_t addr = vma->start_addr; addr < vma->end_addr; addr += PAGE_SIZE_4KB) {
-            unmap_page(addr);
+        if (page_dir) {
+            vma_unmap_all(vma);
         }
 
         free_vma(vma);
         vma = next;
     }
 
+    if (page_dir && page_dir != saved_page_dir && saved_page_dir) {
+        switch_page_directory(saved_page_dir);
+    }
+
+    vma_manager.total_virtual_memory -= space->total_size;
+
     /* Clear space */
     space->process_id = INVALID_PROCESS_ID;
     space->vma_list = NULL;
+    space->vma_tree = NULL;
+    space->last_vma = NULL;
     space->num_vmas = 0;
     space->total_size = 0;
 
@@ -514,22 +944,28 @@ int destroy_process_vma_space(uint32_t process_id) {
 int init_vmem_regions(void) {
     boot_log_debug("Initializing virtual memory region manager");
 
-    vma_manager.vma_pool_index = 0;
     vma_manager.num_processes = 0;
     vma_manager.next_vma_id = 1;
     vma_manager.total_vmas = 0;
+    vma_manager.peak_vmas = 0;
     vma_manager.total_virtual_memory = 0;
-
-    /* Initialize VMA pool */
-    for (uint32_t i = 0; i < (MAX_PROCESSES * MAX_VMAS_PER_PROCESS); i++) {
-        vma_manager.vma_pool[i].vma_id = INVALID_VMA_ID;
-        vma_manager.vma_pool[i].ref_count = 0;
+    vma_manager.peak_virtual_memory = 0;
+    vma_manager.fault_around_pages = VMA_FAULT_AROUND_PAGES;
+
+    if (!vma_region_cache) {
+        vma_region_cache = kmem_cache_create("vma_region", sizeof(vma_region_t), 0);
+        if (!vma_region_cache) {
+            boot_log_info("init_vmem_regions: Failed to create VMA cache");
+            return -1;
+        }
     }
 
     /* Initialize process spaces */
     for (uint32_t i = 0; i < MAX_PROCESSES; i++) {
         vma_manager.process_spaces[i].process_id = INVALID_PROCESS_ID;
         vma_manager.process_spaces[i].vma_list = NULL;
+        vma_manager.process_spaces[i].vma_tree = NULL;
+        vma_manager.process_spaces[i].last_vma = NULL;
         vma_manager.process_spaces[i].num_vmas = 0;
     }
 
@@ -539,18 +975,25 @@ int init_vmem_regions(void) {
 
 /*
  * Get VMA manager statistics
+ * Peaks are high-water marks since initialization
  */
-void get_vmem_stats(uint32_t *total_vmas, uint32_t *processes,
-                    uint64_t *virtual_memory) {
+void get_vmem_stats(uint32_t *total_vmas, uint32_t *peak_vmas, uint32_t *processes,
+                    uint64_t *virtual_memory, uint64_t *peak_virtual_memory) {
     if (total_vmas) {
         *total_vmas = vma_manager.total_vmas;
     }
+    if (peak_vmas) {
+        *peak_vmas = vma_manager.peak_vmas;
+    }
     if (processes) {
         *processes = vma_manager.num_processes;
     }
     if (virtual_memory) {
         *virtual_memory = vma_manager.total_virtual_memory;
     }
+    if (peak_virtual_memory) {
+        *peak_virtual_memory = vma_manager.peak_virtual_memory;
+    }
 }
 
 /*
@@ -0,0 +1,60 @@
+/*
+ * SlopOS Memory Management - Virtual Memory Region Interface
+ * VMA creation, demand paging and per-region fault statistics
+ */
+
+#ifndef MM_VMEM_REGIONS_H
+#define MM_VMEM_REGIONS_H
+
+#include <stdint.h>
+
+/* Virtual memory region types */
+#define VMA_TYPE_CODE                 0x01   /* Code segment */
+#define VMA_TYPE_DATA                 0x02   /* Data segment */
+#define VMA_TYPE_HEAP                 0x03   /* Heap region */
+#define VMA_TYPE_STACK                0x04   /* Stack region */
+#define VMA_TYPE_SHARED               0x05   /* Shared memory */
+#define VMA_TYPE_DEVICE               0x06   /* Device memory mapping */
+#define VMA_TYPE_ANONYMOUS            0x07   /* Anonymous mapping */
+
+/* Virtual memory access flags */
+#define VMA_READ                      0x01   /* Region is readable */
+#define VMA_WRITE                     0x02   /* Region is writable */
+#define VMA_EXEC                      0x04   /* Region is executable */
+#define VMA_USER                      0x08   /* User-accessible region */
+#define VMA_SHARED                    0x10   /* Shared between processes */
+#define VMA_GROWSDOWN                 0x20   /* Stack-like region (grows down) */
+#define VMA_LOCKED                    0x40   /* Region is locked in memory */
+
+/* Virtual memory allocation policies */
+#define VMA_POLICY_DEMAND             0x01   /* Allocate on demand */
+#define VMA_POLICY_PREFAULT           0x02   /* Pre-allocate physical pages */
+#define VMA_POLICY_ZERO               0x04   /* Zero pages on allocation */
+
+/* Pages populated around a faulting address (aligned window) */
+#define VMA_FAULT_AROUND_PAGES        16
+
+/* Per-VMA demand paging statistics */
+typedef struct vma_fault_stats {
+    uint64_t faults;              /* Faults resolved in this VMA */
+    uint64_t pages_faulted;       /* Pages mapped by those faults */
+    uint64_t pages_prefaulted;    /* Pages mapped ahead of any fault */
+} vma_fault_stats_t;
+
+uint64_t create_vma_region(uint32_t process_id, uint64_t start, uint64_t size,
+                           uint32_t flags, uint32_t type);
+int destroy_vma_region(uint32_t process_id, uint64_t vaddr);
+int set_vma_policy(uint32_t process_id, uint64_t vaddr, uint32_t policy);
+int handle_vma_page_fault(uint32_t process_id, uint64_t fault_addr);
+int get_vma_fault_stats(uint32_t process_id, uint64_t vaddr, vma_fault_stats_t *stats);
+void set_vma_fault_around(uint32_t pages);
+
+int create_process_vma_space(uint32_t process_id);
+int clone_process_vma_space(uint32_t src_process_id, uint32_t dst_process_id);
+int destroy_process_vma_space(uint32_t process_id);
+int init_vmem_regions(void);
+void get_vmem_stats(uint32_t *total_vmas, uint32_t *peak_vmas, uint32_t *processes,
+                    uint64_t *virtual_memory, uint64_t *peak_virtual_memory);
+void print_process_vmas(uint32_t process_id);
+
+#endif /* MM_VMEM_REGIONS_H */
@@ -6,6 +6,7 @@
 
 .section .text
 .global context_switch
+.global context_switch_release
 
 #
 # context_switch(void *old_context, void *new_context)
@@ -41,10 +42,19 @@
 #   Offset 0xA8: fs
 #   Offset 0xB0: gs
 #   Offset 0xB8: ss
-#   Offset 0xC0: cr3
+#   Offset 0xC0: cr3 (may carry a PCID and the no-flush bit 63)
+#
+# context_switch_release(void *old_context, void *new_context, uint8_t *release)
+#
+# Same switch, but also clears the byte at release (when not NULL) as soon
+# as old_context is fully saved. Lets another CPU wait for the old task's
+# state to be complete before it resumes the task
 #
 
 context_switch:
+    xorl    %edx, %edx              # No release byte for the plain switch
+
+context_switch_release:
     # Save actual RDI and RSI register values before using them as context pointers
     # We need to preserve the task's real register state, not the function arguments
     # Use R8 and R9 as temporary storage for the context pointers
@@ -101,6 +111,12 @@ context_switch:
     movq    %cr3, %rax              # Get current page directory
     movq    %rax, 0xC0(%r8)          # Save cr3
 
+    # Old context is complete; nothing below touches the old stack
+    test    %rdx, %rdx              # Test if a release byte was passed
+    jz      skip_release            # Plain context_switch
+    movb    $0, (%rdx)              # Hand the old task to other CPUs
+skip_release:
+
     # Move new_context pointer from r9 to rsi for loading
     movq    %r9, %rsi                # Restore new_context pointer to rsi
 
@@ -121,8 +137,10 @@ load_new_context:
     
     # Load page directory first (if it's different)
     movq    0xC0(%r15), %rax         # Load new cr3
+    movq    %rax, %rcx               # Copy for comparison
+    btrq    $63, %rcx                # Ignore the PCID no-flush bit
     movq    %cr3, %rdx               # Get current cr3
-    cmpq    %rax, %rdx               # Compare with new cr3
+    cmpq    %rcx, %rdx               # Compare with new cr3
     je      skip_cr3_load            # Skip if same page directory
     movq    %rax, %cr3               # Load new page directory
 skip_cr3_load:
@@ -1,6 +1,6 @@
 /*
  * SlopOS Framebuffer Draw Task
- * Continuously renders animated primitives while yielding cooperatively.
+ * Continuously renders animated primitives, sleeping between frames.
  */
 
 #include "../drivers/serial.h"
@@ -8,6 +8,9 @@
 #include "../video/graphics.h"
 #include "scheduler.h"
 
+/* Delay between animation frames */
+#define DRAW_FRAME_INTERVAL_MS 20
+
 /* Simple color palette for animation */
 static const uint32_t kPalette[] = {
     COLOR_RED,
@@ -98,12 +101,10 @@ static void framebuffer_draw_task(void *arg) {
 
         scan_offset = (scan_offset + 8) % (width ? width : 1);
 
-        /* Simple delay to slow down the animation a bit */
-        for (volatile uint32_t spin = 0; spin < 250000; spin++) {
-            __asm__ volatile("pause");
+        /* Sleep until the next frame; fall back to yielding if we cannot block */
+        if (task_sleep_ms(DRAW_FRAME_INTERVAL_MS) != 0) {
+            yield();
         }
-
-        yield();
     }
 }
 
@@ -1,7 +1,11 @@
 /*
- * SlopOS Cooperative Round-Robin Scheduler
- * Implements fair task scheduling with voluntary yielding
- * Tasks must yield control voluntarily - no preemption
+ * SlopOS Priority Round-Robin Scheduler
+ * Runs the highest-priority ready task, round-robin within a priority level
+ * Tasks yield voluntarily or are preempted when their time slice runs out
+ *
+ * Every CPU has its own scheduler instance: run queues, current and idle
+ * task. A CPU with nothing of its own to run steals TASK_FLAG_SMP tasks
+ * from the CPU with the most of them queued
  */
 
 #include <stdint.h>
@@ -11,11 +15,21 @@
 #include "../boot/log.h"
 #include "../drivers/serial.h"
 #include "../drivers/pit.h"
+#include "../drivers/irq.h"
+#include "../drivers/apic.h"
+#include "../drivers/smp.h"
+#include "../boot/idt.h"
+#include "../mm/page_alloc.h"
 #include "../mm/paging.h"
+#include "../lib/cpu.h"
+#include "../lib/spinlock.h"
 #include "scheduler.h"
+#include "timer.h"
 
 /* Forward declarations from context_switch.s */
 extern void context_switch(void *old_context, void *new_context);
+extern void context_switch_release(void *old_context, void *new_context,
+                                   volatile uint8_t *release);
 extern void simple_context_switch(void *old_context, void *new_context);
 
 /* Forward declarations from process_vm.c */
@@ -25,40 +39,58 @@ extern process_page_dir_t *process_vm_get_page_dir(uint32_t process_id);
  * SCHEDULER CONSTANTS
  * ======================================================================== */
 
-#define SCHED_MAX_READY_TASKS         32        /* Maximum tasks in ready queue */
 #define SCHED_DEFAULT_TIME_SLICE      10        /* Default time slice units */
 #define SCHED_IDLE_TASK_ID            0xFFFFFFFE /* Special idle task ID */
-
-/* Scheduling policies */
-#define SCHED_POLICY_ROUND_ROBIN      0         /* Round-robin scheduling */
-#define SCHED_POLICY_PRIORITY         1         /* Priority-based scheduling */
-#define SCHED_POLICY_COOPERATIVE      2         /* Pure cooperative scheduling */
+#define SCHED_IDLE_ZERO_BATCH         1         /* Frames zeroed per idle pass */
+#define SCHED_IDLE_DEFERRED_BATCH     1         /* Frame map sections per idle pass */
+#define SCHED_CR3_ADDRESS_MASK        0x000FFFFFFFFFF000ULL /* PML4 address bits of a saved CR3 */
+#define SCHED_CR3_NOFLUSH             (1ULL << 63)          /* PCID no-flush hint, never read back */
+#define SCHED_PRIORITY_LEVELS         (TASK_PRIORITY_IDLE + 1) /* One run queue per priority */
+#define SCHED_AGING_THRESHOLD         16        /* Dispatches a queue head waits before a boost */
+#define SCHED_IDLE_MAX_SLEEP_TICKS    100       /* Longest tickless sleep with no timer pending */
+#define SCHED_IDLE_TIMER_VECTOR       (IRQ_BASE_VECTOR + 0) /* Idle wakeups arrive as timer IRQs */
+#define CPUID_FEAT_ECX_MONITOR        (1U << 3) /* MONITOR/MWAIT available */
+#define CPUID_FEAT_ECX_HYPERVISOR     (1U << 31) /* Running as a guest */
+#define SCHED_CPU_START_SPINS         100000000ULL /* Wait for an AP to start or stop */
 
 /* ========================================================================
  * SCHEDULER DATA STRUCTURES
  * ======================================================================== */
 
-/* Ready queue for runnable tasks */
+/* Ready queue for runnable tasks, linked through task_t run_prev/run_next */
 typedef struct ready_queue {
-    task_t *tasks[SCHED_MAX_READY_TASKS];  /* Array of task pointers */
-    uint32_t head;                         /* Head index (next to run) */
-    uint32_t tail;                         /* Tail index (last added) */
+    task_t *head;                          /* Next to run */
+    task_t *tail;                          /* Last added */
     uint32_t count;                        /* Number of tasks in queue */
 } ready_queue_t;
 
-/* Scheduler control structure */
+/*
+ * Per-priority run queues
+ * Bit n of the bitmap is set while level n holds ready tasks, so the next
+ * task comes from the lowest set bit in O(1)
+ */
+typedef struct run_queues {
+    ready_queue_t levels[SCHED_PRIORITY_LEVELS]; /* FIFO per priority level */
+    uint32_t bitmap;                       /* Non-empty levels */
+    uint32_t count;                        /* Ready tasks across all levels */
+    volatile uint32_t migratable;          /* Queued TASK_FLAG_SMP tasks (read unlocked) */
+    uint64_t dispatches;                   /* Tasks dequeued so far (aging clock) */
+    uint64_t aging_boosts;                 /* Starved queue heads moved up a level */
+} run_queues_t;
+
+/*
+ * Per-CPU scheduler state
+ * The lock covers the run queues and is taken with interrupts disabled;
+ * everything else is only touched by the owning CPU, except
+ * reschedule_pending, which other CPUs set before a reschedule IPI
+ */
 typedef struct scheduler {
-    ready_queue_t ready_queue;             /* Queue of ready tasks */
+    spinlock_t lock;                       /* Protects run_queues */
+    run_queues_t run_queues;               /* Ready tasks by priority */
     task_t *current_task;                  /* Currently running task */
     task_t *idle_task;                     /* Idle task (always ready) */
-
-    /* Scheduling policy and configuration */
-    uint8_t policy;                        /* Current scheduling policy */
-    uint8_t enabled;                       /* Scheduler enabled flag */
-    uint16_t time_slice;                   /* Current time slice value */
-
-    /* Return context for testing (when scheduler exits) */
-    task_context_t return_context;         /* Context to return to when scheduler exits */
+    uint32_t cpu;                          /* Logical CPU index */
+    volatile uint8_t online;               /* CPU is running this scheduler */
 
     /* Statistics and monitoring */
     uint64_t total_switches;               /* Total context switches */
@@ -66,18 +98,57 @@ typedef struct scheduler {
     uint64_t idle_time;                    /* Time spent in idle task */
     uint64_t total_ticks;                  /* Timer ticks observed */
     uint64_t total_preemptions;            /* Forced preemptions */
+    uint64_t cr3_writes;                   /* Switches that loaded a new CR3 */
+    uint64_t cr3_writes_skipped;           /* Switches that kept the current CR3 */
+    uint64_t wakeup_preemptions;           /* Wakeups that preempted a lower-priority task */
+    uint64_t task_sleeps;                  /* Blocking sleeps started */
+    uint64_t steals;                       /* Tasks taken from other CPUs */
     uint32_t schedule_calls;               /* Number of schedule() calls */
-    uint8_t preemption_enabled;            /* Preemption toggle */
-    uint8_t reschedule_pending;            /* Deferred reschedule request */
+    volatile uint8_t reschedule_pending;   /* Deferred reschedule request */
     uint8_t in_schedule;                   /* Recursion guard */
-    uint8_t reserved;                      /* Padding */
+
+    /* Tickless idle (BSP only) */
+    uint64_t idle_halts;                   /* Times the CPU halted in idle */
+    uint64_t idle_wakeups;                 /* Interrupts that ended an idle halt */
+    uint64_t idle_cycles;                  /* TSC cycles spent halted */
+    uint64_t idle_tickless;                /* Halts with the periodic tick stopped */
+    uint64_t idle_ticks_skipped;           /* Ticks credited after tickless halts */
+    uint64_t idle_halt_tsc;                /* TSC at the current halt */
+    uint64_t idle_halt_tick;               /* Tick count at the current halt */
+    uint64_t idle_halt_deadline;           /* Tick the halt's one-shot is armed for */
+    uint8_t idle_halted;                   /* Halt in progress, not yet accounted */
+    uint8_t idle_halt_tickless;            /* Current halt armed a one-shot timer */
 } scheduler_t;
 
-/* Global scheduler instance */
-static scheduler_t scheduler = {0};
+/* Policy and configuration shared by every CPU */
+typedef struct scheduler_config {
+    uint8_t policy;                        /* Current scheduling policy */
+    volatile uint8_t enabled;              /* Scheduler enabled flag */
+    uint8_t preemption_enabled;            /* Preemption toggle */
+    uint8_t idle_use_mwait;                /* Halt with MONITOR/MWAIT */
+    uint8_t bsp_tick;                      /* BSP receives a periodic tick */
+    volatile uint8_t stopping;             /* Secondary CPUs must leave the scheduler */
+    uint16_t time_slice;                   /* Current time slice value */
+    uint64_t start_tsc;                    /* TSC when the scheduler started */
+
+    /* Return context for testing (when scheduler exits) */
+    task_context_t return_context;         /* Context to return to when scheduler exits */
+} scheduler_config_t;
+
+static scheduler_t cpu_schedulers[SMP_MAX_CPUS];
+static scheduler_config_t sched_config = {0};
+
+/*
+ * Scheduler of the calling CPU
+ * Call with interrupts disabled: a TASK_FLAG_SMP task may otherwise be
+ * moved to another CPU between the lookup and the use
+ */
+static inline scheduler_t *sched_local(void) {
+    return &cpu_schedulers[smp_current_cpu()];
+}
 
 static uint32_t scheduler_get_default_time_slice(void) {
-    return scheduler.time_slice ? scheduler.time_slice : SCHED_DEFAULT_TIME_SLICE;
+    return sched_config.time_slice ? sched_config.time_slice : SCHED_DEFAULT_TIME_SLICE;
 }
 
 static void scheduler_reset_task_quantum(task_t *task) {
@@ -98,14 +169,9 @@ static void scheduler_reset_task_quantum(task_t *task) {
  * Initialize the ready queue
  */
 static void ready_queue_init(ready_queue_t *queue) {
-    queue->head = 0;
-    queue->tail = 0;
+    queue->head = NULL;
+    queue->tail = NULL;
     queue->count = 0;
-
-    /* Clear all task pointers */
-    for (uint32_t i = 0; i < SCHED_MAX_READY_TASKS; i++) {
-        queue->tasks[i] = NULL;
-    }
 }
 
 /*
@@ -116,78 +182,298 @@ static int ready_queue_empty(ready_queue_t *queue) {
 }
 
 /*
- * Check if ready queue is full
+ * Check if task is linked into this ready queue
+ * Unqueued tasks always have run_prev cleared, so only the head needs a
+ * direct comparison
  */
-static int ready_queue_full(ready_queue_t *queue) {
-    return queue->count >= SCHED_MAX_READY_TASKS;
+static int ready_queue_contains(ready_queue_t *queue, task_t *task) {
+    return task->run_prev != NULL || queue->head == task;
 }
 
 /*
- * Add task to ready queue
- * Returns 0 on success, -1 if queue is full
+ * Add task to the tail of the ready queue
+ * Returns 0 on success, -1 on invalid task
  */
 static int ready_queue_enqueue(ready_queue_t *queue, task_t *task) {
-    if (!task || ready_queue_full(queue)) {
+    if (!task) {
         return -1;
     }
 
-    /* Add task to tail of queue */
-    queue->tasks[queue->tail] = task;
-    queue->tail = (queue->tail + 1) % SCHED_MAX_READY_TASKS;
+    task->run_prev = queue->tail;
+    task->run_next = NULL;
+    if (queue->tail) {
+        queue->tail->run_next = task;
+    } else {
+        queue->head = task;
+    }
+    queue->tail = task;
     queue->count++;
 
     return 0;
 }
 
 /*
- * Remove task from front of ready queue
- * Returns task pointer, NULL if queue is empty
+ * Remove specific task from ready queue in O(1)
+ * Returns 0 on success, -1 if task not found
  */
-static task_t *ready_queue_dequeue(ready_queue_t *queue) {
-    if (ready_queue_empty(queue)) {
-        return NULL;
+static int ready_queue_remove(ready_queue_t *queue, task_t *task) {
+    if (!task || !ready_queue_contains(queue, task)) {
+        return -1;
     }
 
-    /* Remove task from head of queue */
-    task_t *task = queue->tasks[queue->head];
-    queue->tasks[queue->head] = NULL;
-    queue->head = (queue->head + 1) % SCHED_MAX_READY_TASKS;
+    if (task->run_prev) {
+        task->run_prev->run_next = task->run_next;
+    } else {
+        queue->head = task->run_next;
+    }
+    if (task->run_next) {
+        task->run_next->run_prev = task->run_prev;
+    } else {
+        queue->tail = task->run_prev;
+    }
+
+    task->run_prev = NULL;
+    task->run_next = NULL;
     queue->count--;
 
-    return task;
+    return 0;
 }
 
 /*
- * Remove specific task from ready queue
- * Returns 0 on success, -1 if task not found
+ * Queue level a task joins when it becomes ready
+ * Only the priority policy separates levels; the others keep one FIFO
  */
-static int ready_queue_remove(ready_queue_t *queue, task_t *task) {
-    if (!task || ready_queue_empty(queue)) {
+static uint8_t task_base_level(const task_t *task) {
+    if (sched_config.policy != SCHED_POLICY_PRIORITY) {
+        return TASK_PRIORITY_NORMAL;
+    }
+    return task->priority < SCHED_PRIORITY_LEVELS ? task->priority : TASK_PRIORITY_IDLE;
+}
+
+static void run_queues_init(run_queues_t *rq) {
+    for (uint32_t level = 0; level < SCHED_PRIORITY_LEVELS; level++) {
+        ready_queue_init(&rq->levels[level]);
+    }
+    rq->bitmap = 0;
+    rq->count = 0;
+    rq->migratable = 0;
+    rq->dispatches = 0;
+}
+
+/*
+ * Add task to the tail of a level
+ * A task that is already queued keeps its place
+ * Returns 0 on success, -1 on invalid task
+ */
+static int run_queues_enqueue(run_queues_t *rq, task_t *task, uint8_t level) {
+    if (!task) {
+        return -1;
+    }
+    if (task->queue_level < SCHED_PRIORITY_LEVELS &&
+        ready_queue_contains(&rq->levels[task->queue_level], task)) {
+        return 0;
+    }
+    if (ready_queue_enqueue(&rq->levels[level], task) != 0) {
+        return -1;
+    }
+
+    task->queue_level = level;
+    task->queue_stamp = rq->dispatches;
+    rq->bitmap |= 1U << level;
+    rq->count++;
+    if (task->flags & TASK_FLAG_SMP) {
+        rq->migratable++;
+    }
+    return 0;
+}
+
+/*
+ * Remove a specific task from whichever level holds it
+ * Returns 0 on success, -1 if task not queued
+ */
+static int run_queues_remove(run_queues_t *rq, task_t *task) {
+    uint8_t level = task->queue_level;
+    if (level >= SCHED_PRIORITY_LEVELS || ready_queue_remove(&rq->levels[level], task) != 0) {
         return -1;
     }
 
-    /* Find task in queue */
-    for (uint32_t i = 0; i < queue->count; i++) {
-        uint32_t index = (queue->head + i) % SCHED_MAX_READY_TASKS;
+    rq->count--;
+    if (task->flags & TASK_FLAG_SMP) {
+        rq->migratable--;
+    }
+    if (ready_queue_empty(&rq->levels[level])) {
+        rq->bitmap &= ~(1U << level);
+    }
+    return 0;
+}
+
+/*
+ * Move queue heads that waited too long one level up
+ * Only heads are checked (the oldest task of each FIFO), so this stays
+ * O(levels) while bounding how long a low-priority task can starve
+ */
+static void run_queues_age(run_queues_t *rq) {
+    for (uint32_t level = 1; level < SCHED_PRIORITY_LEVELS; level++) {
+        ready_queue_t *queue = &rq->levels[level];
+        if (ready_queue_empty(queue)) {
+            continue;
+        }
+
+        task_t *head = queue->head;
+        if (rq->dispatches - head->queue_stamp < SCHED_AGING_THRESHOLD) {
+            continue;
+        }
+
+        run_queues_remove(rq, head);
+        run_queues_enqueue(rq, head, (uint8_t)(level - 1));
+        rq->aging_boosts++;
+    }
+}
+
+/*
+ * Remove the first task of the highest-priority non-empty level
+ * Returns task pointer, NULL if nothing is ready
+ */
+static task_t *run_queues_dequeue(run_queues_t *rq) {
+    if (!rq->bitmap) {
+        return NULL;
+    }
+
+    rq->dispatches++;
+    if (rq->count > 1) {
+        run_queues_age(rq);
+    }
+
+    uint32_t level = (uint32_t)__builtin_ctz(rq->bitmap);
+    task_t *task = rq->levels[level].head;
+    run_queues_remove(rq, task);
+    return task;
+}
 
-        if (queue->tasks[index] == task) {
-            /* Shift all tasks after this one forward */
-            for (uint32_t j = i; j < queue->count - 1; j++) {
-                uint32_t curr_index = (queue->head + j) % SCHED_MAX_READY_TASKS;
-                uint32_t next_index = (queue->head + j + 1) % SCHED_MAX_READY_TASKS;
-                queue->tasks[curr_index] = queue->tasks[next_index];
+/*
+ * Remove the first TASK_FLAG_SMP task, highest priority first, whose
+ * context is already saved (not still switching out on its last CPU)
+ * Returns task pointer, NULL if there is none
+ */
+static task_t *run_queues_take_migratable(run_queues_t *rq) {
+    uint32_t bitmap = rq->bitmap;
+    while (bitmap) {
+        uint32_t level = (uint32_t)__builtin_ctz(bitmap);
+        bitmap &= bitmap - 1;
+
+        for (task_t *task = rq->levels[level].head; task; task = task->run_next) {
+            if ((task->flags & TASK_FLAG_SMP) && !task->on_cpu) {
+                run_queues_remove(rq, task);
+                return task;
             }
+        }
+    }
+    return NULL;
+}
+
+/* ========================================================================
+ * CROSS-CPU HELPERS
+ * ======================================================================== */
+
+/*
+ * Lock the run queues the task belongs to
+ * A task only changes CPU under its old CPU's lock, so the owner is
+ * checked again once the lock is held. Call with interrupts disabled
+ */
+static scheduler_t *task_rq_lock(task_t *task) {
+    for (;;) {
+        scheduler_t *sched = &cpu_schedulers[task->cpu];
+        spin_lock(&sched->lock);
+        if (sched == &cpu_schedulers[task->cpu]) {
+            return sched;
+        }
+        spin_unlock(&sched->lock);
+    }
+}
+
+/*
+ * Check whether the task runs, or is about to run, on another CPU
+ * Called with the task's run queue lock held
+ */
+static int task_running_elsewhere(scheduler_t *local, task_t *task) {
+    if (task == local->current_task) {
+        return 0;
+    }
+    if (task->on_cpu) {
+        return 1;
+    }
+    return task->state == TASK_STATE_RUNNING && task->cpu != local->cpu &&
+           cpu_schedulers[task->cpu].online;
+}
 
-            /* Clear the last slot and update tail */
-            queue->tail = (queue->tail - 1 + SCHED_MAX_READY_TASKS) % SCHED_MAX_READY_TASKS;
-            queue->tasks[queue->tail] = NULL;
-            queue->count--;
+/* Interrupt a CPU so it runs schedule() on its way out of the handler */
+static void sched_send_reschedule(scheduler_t *sched) {
+    sched->reschedule_pending = 1;
+    smp_send_ipi(sched->cpu, IRQ_RESCHEDULE_VECTOR);
+}
 
-            return 0;
+/*
+ * Wake one idle CPU other than the listed ones so it can steal a newly
+ * queued TASK_FLAG_SMP task
+ */
+static void sched_kick_idle_cpu(scheduler_t *busy, scheduler_t *local) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        scheduler_t *sched = &cpu_schedulers[i];
+        if (sched == busy || sched == local || !sched->online || sched->reschedule_pending) {
+            continue;
+        }
+        if (sched->current_task && sched->current_task == sched->idle_task) {
+            sched_send_reschedule(sched);
+            return;
         }
     }
+}
+
+/*
+ * Queue a ready task on the run queues of sched (lock held)
+ * A wakeup that outranks the task running there takes that CPU at its
+ * next interrupt exit instead of waiting out the current time slice.
+ * Returns 1 if the target CPU must be interrupted to notice, 0 if not,
+ * -1 on failure
+ */
+static int sched_enqueue_locked(scheduler_t *sched, task_t *task) {
+    if (task->time_slice_remaining == 0) {
+        scheduler_reset_task_quantum(task);
+    }
+
+    if (run_queues_enqueue(&sched->run_queues, task, task_base_level(task)) != 0) {
+        return -1;
+    }
+
+    task_t *current = sched->current_task;
+    if (!sched_config.enabled || !sched_config.preemption_enabled || !current ||
+        current == task || (current->flags & TASK_FLAG_NO_PREEMPT) ||
+        (current != sched->idle_task && task->queue_level >= current->queue_level)) {
+        return 0;
+    }
+
+    if (sched->reschedule_pending) {
+        return 0;
+    }
+    if (current != sched->idle_task) {
+        sched->wakeup_preemptions++;
+    }
+    sched->reschedule_pending = 1;
+    return 1;
+}
+
+/*
+ * Let other CPUs know about a task just queued on sched
+ * Called after the queue lock is dropped, with interrupts disabled
+ */
+static void sched_notify_enqueue(scheduler_t *sched, task_t *task, int preempt) {
+    scheduler_t *local = sched_local();
 
-    return -1;  /* Task not found */
+    if (preempt > 0 && sched != local) {
+        smp_send_ipi(sched->cpu, IRQ_RESCHEDULE_VECTOR);
+    } else if (preempt == 0 && (task->flags & TASK_FLAG_SMP)) {
+        sched_kick_idle_cpu(sched, local);
+    }
 }
 
 /* ========================================================================
@@ -195,7 +481,7 @@ static int ready_queue_remove(ready_queue_t *queue, task_t *task) {
  * ======================================================================== */
 
 /*
- * Add task to ready queue for scheduling
+ * Add task to the ready queue of the CPU it belongs to
  */
 int schedule_task(task_t *task) {
     if (!task) {
@@ -211,50 +497,121 @@ int schedule_task(task_t *task) {
         return -1;
     }
 
-    if (task->time_slice_remaining == 0) {
-        scheduler_reset_task_quantum(task);
-    }
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = task_rq_lock(task);
+    int result = sched_enqueue_locked(sched, task);
+    spin_unlock(&sched->lock);
 
-    if (ready_queue_enqueue(&scheduler.ready_queue, task) != 0) {
-        return -1;
+    if (result >= 0) {
+        sched_notify_enqueue(sched, task, result);
     }
+    cpu_irq_restore(flags);
 
-    return 0;
+    return result < 0 ? -1 : 0;
 }
 
 /*
  * Remove task from scheduler (task blocked or terminated)
+ * Returns -1 if the task is running on another CPU
  */
 int unschedule_task(task_t *task) {
     if (!task) {
         return -1;
     }
 
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *local = sched_local();
+    scheduler_t *sched = task_rq_lock(task);
+
+    if (task_running_elsewhere(local, task)) {
+        spin_unlock(&sched->lock);
+        cpu_irq_restore(flags);
+        return -1;
+    }
+
     /* Remove from ready queue if present */
-    ready_queue_remove(&scheduler.ready_queue, task);
+    run_queues_remove(&sched->run_queues, task);
+    spin_unlock(&sched->lock);
 
     /* If this was the current task, mark for rescheduling */
-    if (scheduler.current_task == task) {
-        scheduler.current_task = NULL;
+    if (local->current_task == task) {
+        local->current_task = NULL;
     }
 
+    /*
+     * The idle task never blocks, so it is only unscheduled on termination,
+     * which frees its control block
+     */
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (cpu_schedulers[i].idle_task == task) {
+            cpu_schedulers[i].idle_task = NULL;
+        }
+    }
+
+    cpu_irq_restore(flags);
     return 0;
 }
 
 /*
- * Select next task to run using round-robin policy
+ * Take a TASK_FLAG_SMP task from the CPU with the most of them queued
+ * Only the victim's lock is held, so CPUs stealing from each other cannot
+ * deadlock. Returns the task (now owned by thief), NULL if none was found
+ */
+static task_t *sched_steal_task(scheduler_t *thief) {
+    scheduler_t *victim = NULL;
+    uint32_t most = 0;
+
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        scheduler_t *sched = &cpu_schedulers[i];
+        if (sched == thief || !sched->online) {
+            continue;
+        }
+        uint32_t migratable = sched->run_queues.migratable;
+        if (migratable > most) {
+            most = migratable;
+            victim = sched;
+        }
+    }
+
+    if (!victim) {
+        return NULL;
+    }
+
+    spin_lock(&victim->lock);
+    task_t *task = run_queues_take_migratable(&victim->run_queues);
+    if (task) {
+        task->cpu = (uint8_t)thief->cpu;
+        task_set_current(task);
+    }
+    spin_unlock(&victim->lock);
+
+    if (task) {
+        thief->steals++;
+    }
+    return task;
+}
+
+/*
+ * Select next task to run: highest priority first, round-robin within a
+ * level, then work stolen from other CPUs, then the idle task
+ * The chosen task is marked running before its queue lock is dropped, so
+ * no other CPU can tear it down while it is being switched to
  */
-static task_t *select_next_task(void) {
-    task_t *next_task = NULL;
+static task_t *select_next_task(scheduler_t *sched) {
+    spin_lock(&sched->lock);
+    task_t *next_task = run_queues_dequeue(&sched->run_queues);
+    if (next_task) {
+        task_set_current(next_task);
+    }
+    spin_unlock(&sched->lock);
 
-    /* Get next task from ready queue */
-    if (!ready_queue_empty(&scheduler.ready_queue)) {
-        next_task = ready_queue_dequeue(&scheduler.ready_queue);
+    if (!next_task) {
+        next_task = sched_steal_task(sched);
     }
 
     /* If no tasks available, use idle task */
-    if (!next_task && scheduler.idle_task && !task_is_terminated(scheduler.idle_task)) {
-        next_task = scheduler.idle_task;
+    if (!next_task && sched->idle_task && !task_is_terminated(sched->idle_task)) {
+        next_task = sched->idle_task;
     }
 
     return next_task;
@@ -262,38 +619,59 @@ static task_t *select_next_task(void) {
 
 /*
  * Perform context switch to new task
+ * Called with interrupts disabled. Returns once the old task is resumed,
+ * possibly on another CPU
  */
-static void switch_to_task(task_t *new_task) {
+static void switch_to_task(scheduler_t *sched, task_t *new_task) {
     if (!new_task) {
         return;
     }
 
-    task_t *old_task = scheduler.current_task;
+    task_t *old_task = sched->current_task;
 
     if (old_task == new_task) {
         return;
     }
 
+    /* The CPU that last ran the task may still be saving its context */
+    while (new_task->on_cpu) {
+        __asm__ volatile ("pause" ::: "memory");
+    }
+    new_task->on_cpu = 1;
+
     uint64_t timestamp = debug_get_timestamp();
     task_record_context_switch(old_task, new_task, timestamp);
 
     /* Update scheduler state */
-    scheduler.current_task = new_task;
+    sched->current_task = new_task;
     task_set_current(new_task);
     scheduler_reset_task_quantum(new_task);
-    scheduler.total_switches++;
+    sched->total_switches++;
 
-    /* Ensure CR3 matches the task's process address space */
+    /* Ensure CR3 matches the task's process address space (PCID-tagged) */
     if (new_task->process_id != INVALID_PROCESS_ID) {
         process_page_dir_t *page_dir = process_vm_get_page_dir(new_task->process_id);
         if (page_dir && page_dir->pml4_phys) {
-            new_task->context.cr3 = page_dir->pml4_phys;
+            new_task->context.cr3 = paging_cr3_for(page_dir);
+        }
+    } else {
+        process_page_dir_t *kernel_dir = paging_get_kernel_directory();
+        if ((new_task->context.cr3 & SCHED_CR3_ADDRESS_MASK) == kernel_dir->pml4_phys) {
+            new_task->context.cr3 = paging_cr3_for(kernel_dir);
         }
     }
 
+    /* context_switch only writes CR3 when the address space changes */
+    if ((new_task->context.cr3 & ~SCHED_CR3_NOFLUSH) == cpu_read_cr3()) {
+        sched->cr3_writes_skipped++;
+    } else {
+        sched->cr3_writes++;
+    }
+
     /* Perform actual context switch */
     if (old_task) {
-        context_switch(&old_task->context, &new_task->context);
+        /* Other CPUs may pick the old task up once its context is saved */
+        context_switch_release(&old_task->context, &new_task->context, &old_task->on_cpu);
     } else {
         /* First task - no old context to save */
         context_switch(NULL, &new_task->context);
@@ -309,29 +687,48 @@ static void switch_to_task(task_t *new_task) {
  * This is the core of the cooperative scheduler
  */
 void schedule(void) {
-    if (!scheduler.enabled) {
+    if (!sched_config.enabled) {
         return;
     }
 
-    scheduler.in_schedule++;
-    scheduler.schedule_calls++;
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = sched_local();
+
+    sched->in_schedule++;
+    sched->schedule_calls++;
 
-    /* Get current task and put it back in ready queue if still runnable */
-    task_t *current = scheduler.current_task;
-    if (current && current != scheduler.idle_task) {
+    /* Get current task and put it back in its ready queue if still runnable */
+    task_t *current = sched->current_task;
+    if (current && current != sched->idle_task) {
         if (task_is_running(current)) {
-            if (task_set_state(current->task_id, TASK_STATE_READY) != 0) {
+            scheduler_t *owner = task_rq_lock(current);
+            int queued = -1;
+            if (task_update_state(current, TASK_STATE_READY) != 0) {
                 kprint("schedule: failed to mark task ");
                 kprint_decimal(current->task_id);
                 kprint(" ready\n");
-            } else if (ready_queue_enqueue(&scheduler.ready_queue, current) != 0) {
-                kprint("schedule: ready queue full when re-queuing task ");
-                kprint_decimal(current->task_id);
-                kprint("\n");
+            } else if (owner == sched) {
+                queued = run_queues_enqueue(&sched->run_queues, current,
+                                            task_base_level(current));
             } else {
+                /* The task was handed to another CPU (see scheduler_task_exit) */
+                queued = sched_enqueue_locked(owner, current);
+            }
+            if (queued >= 0) {
                 scheduler_reset_task_quantum(current);
             }
-        } else if (!task_is_blocked(current) && !task_is_terminated(current)) {
+            spin_unlock(&owner->lock);
+
+            if (queued < 0) {
+                kprint("schedule: failed to re-queue task ");
+                kprint_decimal(current->task_id);
+                kprint("\n");
+            } else if (owner != sched) {
+                sched_notify_enqueue(owner, current, queued);
+            }
+        } else if (!task_is_blocked(current) && !task_is_terminated(current) &&
+                   !task_is_ready(current)) {
+            /* Ready means a wakeup already queued it again */
             kprint("schedule: skipping requeue for task ");
             kprint_decimal(current->task_id);
             kprint(" in state ");
@@ -341,17 +738,20 @@ void schedule(void) {
     }
 
     /* Select next task to run */
-    task_t *next_task = select_next_task();
+    task_t *next_task = select_next_task(sched);
     if (!next_task) {
         /* No tasks to run - check if we should exit scheduler */
         /* For testing purposes, if idle task has terminated, exit scheduler */
-        if (scheduler.idle_task && task_is_terminated(scheduler.idle_task)) {
+        if (sched->idle_task && task_is_terminated(sched->idle_task)) {
             /* Idle task terminated - exit scheduler by switching to return context */
-            scheduler.enabled = 0;
+            sched_config.enabled = 0;
             /* Switch back to the saved return context */
-            if (scheduler.current_task) {
-                scheduler.in_schedule--;
-                context_switch(&scheduler.current_task->context, &scheduler.return_context);
+            if (sched->current_task) {
+                sched->in_schedule--;
+                context_switch_release(&sched->current_task->context,
+                                       &sched_config.return_context,
+                                       &sched->current_task->on_cpu);
+                cpu_irq_restore(flags);
                 return;
             } else {
                 /* No current task - this shouldn't happen */
@@ -363,14 +763,16 @@ void schedule(void) {
     }
 
     /* Switch to the selected task */
-    scheduler.in_schedule--;
-    switch_to_task(next_task);
+    sched->in_schedule--;
+    switch_to_task(sched, next_task);
+    cpu_irq_restore(flags);
     return;
 
 out:
-    if (scheduler.in_schedule > 0) {
-        scheduler.in_schedule--;
+    if (sched->in_schedule > 0) {
+        sched->in_schedule--;
     }
+    cpu_irq_restore(flags);
 }
 
 /*
@@ -378,39 +780,136 @@ out:
  * Current task gives up CPU and allows other tasks to run
  */
 void yield(void) {
-    scheduler.total_yields++;
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = sched_local();
+    sched->total_yields++;
 
-    if (scheduler.current_task) {
-        task_record_yield(scheduler.current_task);
+    if (sched->current_task) {
+        task_record_yield(sched->current_task);
     }
 
     /* Trigger rescheduling */
     schedule();
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Mark the running task blocked and take it off its run queue
+ * Called with the task's queue lock held, which unblock_task also takes,
+ * so a wakeup from another CPU lands either before this or after the task
+ * is blocked
+ */
+static void sched_block_task_locked(scheduler_t *owner, task_t *task) {
+    if (task_update_state(task, TASK_STATE_BLOCKED) != 0) {
+        kprint("block_current_task: invalid state transition for task ");
+        kprint_decimal(task->task_id);
+        kprint("\n");
+    }
+
+    /*
+     * Remove from the ready queue but stay current, so the switch away
+     * saves this task's context for when it is unblocked
+     */
+    run_queues_remove(&owner->run_queues, task);
 }
 
 /*
  * Block current task (remove from ready queue)
  */
 void block_current_task(void) {
-    task_t *current = scheduler.current_task;
+    uint64_t flags = cpu_irq_save();
+    task_t *current = sched_local()->current_task;
     if (!current) {
+        cpu_irq_restore(flags);
         return;
     }
 
-    /* Mark task as blocked */
-    if (task_set_state(current->task_id, TASK_STATE_BLOCKED) != 0) {
-        kprint("block_current_task: invalid state transition for task ");
-        kprint_decimal(current->task_id);
-        kprint("\n");
-    }
+    scheduler_t *owner = task_rq_lock(current);
+    sched_block_task_locked(owner, current);
+    spin_unlock(&owner->lock);
 
-    /* Remove from ready queue and schedule next task */
-    unschedule_task(current);
     schedule();
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Sleep timer expiry: wake the task if it is still blocked
+ * The check is made under the task's queue lock, pairing with the pending
+ * check in task_sleep_until, so a task that is about to block is not missed
+ */
+static void task_sleep_expired(void *arg) {
+    task_t *task = (task_t *)arg;
+
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = task_rq_lock(task);
+    int result = -1;
+    if (task_is_blocked(task)) {
+        task_update_state(task, TASK_STATE_READY);
+        result = sched_enqueue_locked(sched, task);
+    }
+    spin_unlock(&sched->lock);
+
+    if (result >= 0) {
+        sched_notify_enqueue(sched, task, result);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Block the current task until the timer tick count reaches deadline
+ * Returns 0 once the deadline passed, -1 if the caller cannot block (no
+ * running scheduler, no BSP tick to expire timers, or the caller is the
+ * idle task)
+ */
+int task_sleep_until(uint64_t deadline) {
+    if (irq_get_timer_ticks() >= deadline) {
+        return 0;
+    }
+
+    /* Interrupts stay off until the switch so the wakeup cannot be lost */
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = sched_local();
+    task_t *current = sched->current_task;
+    if (!sched_config.enabled || !sched_config.preemption_enabled || !sched_config.bsp_tick ||
+        !current || !sched->idle_task || current == sched->idle_task) {
+        cpu_irq_restore(flags);
+        return -1;
+    }
+
+    ktimer_init(&current->sleep_timer, task_sleep_expired, current);
+    if (kernel_timer_add(&current->sleep_timer, deadline) == 0) {
+        sched->task_sleeps++;
+        for (;;) {
+            /* Checked under the lock the expiry callback wakes us with */
+            scheduler_t *owner = task_rq_lock(current);
+            if (!ktimer_pending(&current->sleep_timer)) {
+                spin_unlock(&owner->lock);
+                break;
+            }
+            sched_block_task_locked(owner, current);
+            spin_unlock(&owner->lock);
+
+            schedule();
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/*
+ * Block the current task for at least the given number of milliseconds
+ * Returns 0 on success, -1 if the caller cannot block
+ */
+int task_sleep_ms(uint32_t milliseconds) {
+    if (milliseconds == 0) {
+        return 0;
+    }
+    return task_sleep_until(irq_get_timer_ticks() + kernel_timer_ms_to_ticks(milliseconds));
 }
 
 int task_wait_for(uint32_t task_id) {
-    task_t *current = scheduler.current_task;
+    task_t *current = scheduler_get_current_task();
     if (!current) {
         return -1;
     }
@@ -431,6 +930,7 @@ int task_wait_for(uint32_t task_id) {
     }
 
     current->waiting_on_task_id = task_id;
+    task_add_waiter(target, current);
     block_current_task();
 
     current->waiting_on_task_id = INVALID_TASK_ID;
@@ -445,22 +945,37 @@ int unblock_task(task_t *task) {
         return -1;
     }
 
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = task_rq_lock(task);
+
     /* Mark task as ready */
-    if (task_set_state(task->task_id, TASK_STATE_READY) != 0) {
+    if (task_update_state(task, TASK_STATE_READY) != 0) {
         kprint("unblock_task: invalid state transition for task ");
         kprint_decimal(task->task_id);
         kprint("\n");
     }
 
     /* Add back to ready queue */
-    return schedule_task(task);
+    int result = sched_enqueue_locked(sched, task);
+    spin_unlock(&sched->lock);
+
+    if (result >= 0) {
+        sched_notify_enqueue(sched, task, result);
+    }
+    cpu_irq_restore(flags);
+
+    return result < 0 ? -1 : 0;
 }
 
 /*
  * Terminate the currently running task and hand control to the scheduler
+ * Tasks on an application processor first move back to the BSP, since
+ * freeing the task and its stack needs the BSP-only task table and heap
  */
 void scheduler_task_exit(void) {
-    task_t *current = scheduler.current_task;
+    __asm__ volatile ("cli" : : : "memory");
+    scheduler_t *sched = sched_local();
+    task_t *current = sched->current_task;
 
     if (!current) {
         kprintln("scheduler_task_exit: No current task");
@@ -470,6 +985,17 @@ void scheduler_task_exit(void) {
         }
     }
 
+    if (sched->cpu != 0) {
+        scheduler_t *owner = task_rq_lock(current);
+        current->flags &= ~TASK_FLAG_SMP;
+        current->cpu = 0;
+        spin_unlock(&owner->lock);
+
+        /* Resumes on the BSP */
+        schedule();
+        sched = sched_local();
+    }
+
     uint64_t timestamp = debug_get_timestamp();
     task_record_context_switch(current, NULL, timestamp);
 
@@ -477,7 +1003,7 @@ void scheduler_task_exit(void) {
         kprintln("scheduler_task_exit: Failed to terminate current task");
     }
 
-    scheduler.current_task = NULL;
+    sched->current_task = NULL;
     task_set_current(NULL);
 
     schedule();
@@ -493,66 +1019,337 @@ void scheduler_task_exit(void) {
  * ======================================================================== */
 
 /*
- * Idle task function - runs when no other tasks are ready
+ * Start the BSP's periodic tick
+ * The PIT only reaches the BSP through the legacy PIC. With the APIC on,
+ * the BSP's LAPIC timer ticks at the PIT rate on IRQ_LOCAL_TIMER_VECTOR
+ * instead, which the IRQ layer counts like a PIT tick. Runs on the BSP
+ */
+static void scheduler_bsp_tick_start(void) {
+    if (!apic_is_enabled()) {
+        pit_enable_irq();
+        sched_config.bsp_tick = 1;
+        return;
+    }
+
+    sched_config.bsp_tick =
+        apic_timer_periodic_us(IRQ_LOCAL_TIMER_VECTOR, 1000000 / pit_get_frequency()) == 0;
+    if (!sched_config.bsp_tick) {
+        kprint("SCHED: BSP has no local timer, sleeping tasks will yield instead\n");
+    }
+}
+
+static void scheduler_bsp_tick_stop(void) {
+    if (apic_is_enabled()) {
+        apic_timer_stop();
+    } else {
+        pit_disable_irq();
+    }
+    sched_config.bsp_tick = 0;
+}
+
+/*
+ * Account the halt that just ended and, if the periodic tick was stopped,
+ * credit the ticks that passed and run the timers that came due.
+ * Called on the BSP with interrupts disabled, from the first interrupt
+ * after the halt (before it can reschedule) or from the idle task itself
+ */
+static void scheduler_idle_wake(scheduler_t *sched) {
+    if (!sched->idle_halted) {
+        return;
+    }
+    sched->idle_halted = 0;
+    __atomic_store_n(&sched->idle_halt_deadline, 0, __ATOMIC_RELEASE);
+
+    uint64_t cycles = cpu_read_tsc() - sched->idle_halt_tsc;
+    sched->idle_cycles += cycles;
+    sched->idle_wakeups++;
+
+    if (!sched->idle_halt_tickless) {
+        return;
+    }
+    sched->idle_halt_tickless = 0;
+    apic_timer_stop();
+
+    uint64_t elapsed = (apic_timer_tsc_to_us(cycles) * pit_get_frequency()) / 1000000;
+    uint64_t expected = sched->idle_halt_tick + elapsed;
+    uint64_t ticks = irq_get_timer_ticks();
+    if (expected > ticks) {
+        irq_credit_timer_ticks(expected - ticks);
+        sched->idle_ticks_skipped += expected - ticks;
+    }
+    kernel_timers_run(irq_get_timer_ticks());
+
+    /* The one-shot took over the LAPIC timer from the periodic tick */
+    if (sched_config.preemption_enabled) {
+        scheduler_bsp_tick_start();
+    }
+}
+
+/*
+ * Note a kernel timer armed for the given tick
+ * A BSP halted on a one-shot for a later tick would sleep through it, so
+ * it gets a reschedule IPI; the wakeup runs due timers and rearms
+ */
+void scheduler_timer_added(uint64_t expires) {
+    scheduler_t *bsp = &cpu_schedulers[0];
+
+    /* Pairs with the deadline store before the BSP reads the next expiry */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (expires >= __atomic_load_n(&bsp->idle_halt_deadline, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    uint64_t flags = cpu_irq_save();
+    if (smp_current_cpu() != 0) {
+        smp_send_ipi(0, IRQ_RESCHEDULE_VECTOR);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Check whether another CPU has TASK_FLAG_SMP tasks this one could steal
+ */
+static int sched_migratable_elsewhere(scheduler_t *local) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        scheduler_t *sched = &cpu_schedulers[i];
+        if (sched != local && sched->online && sched->run_queues.migratable > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Halt until the next interrupt, sleeping through ticks when possible
+ * With nothing to run until the next timer comes due, the periodic tick is
+ * stopped and a LAPIC one-shot (TSC-deadline if available) is armed for
+ * that deadline instead. Timers added on other CPUs for an earlier tick
+ * wake the halt through scheduler_timer_added(). Falls back to halting on
+ * the periodic tick when no one-shot can be armed
+ */
+static void scheduler_idle_halt(scheduler_t *sched) {
+    __asm__ volatile ("cli" : : : "memory");
+
+    if (sched->run_queues.count > 0 || sched->reschedule_pending) {
+        __asm__ volatile ("sti" : : : "memory");
+        return;
+    }
+
+    /* Until the one-shot is armed, any timer added elsewhere wakes the halt */
+    __atomic_store_n(&sched->idle_halt_deadline, UINT64_MAX, __ATOMIC_SEQ_CST);
+
+    uint64_t now = irq_get_timer_ticks();
+    uint64_t sleep_ticks = SCHED_IDLE_MAX_SLEEP_TICKS;
+    uint64_t next;
+    if (kernel_timer_next_expiry(&next) == 0) {
+        if (next <= now) {
+            __atomic_store_n(&sched->idle_halt_deadline, 0, __ATOMIC_RELEASE);
+            kernel_timers_run(now);
+            __asm__ volatile ("sti" : : : "memory");
+            return;
+        }
+        if (next - now < sleep_ticks) {
+            sleep_ticks = next - now;
+        }
+    }
+
+    uint64_t sleep_us = (sleep_ticks * 1000000) / pit_get_frequency();
+    /* Arming the one-shot replaces the BSP's periodic LAPIC tick */
+    sched->idle_halt_tickless =
+        apic_timer_oneshot_us(SCHED_IDLE_TIMER_VECTOR, sleep_us) == 0;
+    if (sched->idle_halt_tickless) {
+        sched->idle_tickless++;
+    }
+    __atomic_store_n(&sched->idle_halt_deadline,
+                     sched->idle_halt_tickless ? now + sleep_ticks : 0, __ATOMIC_SEQ_CST);
+
+    sched->idle_halt_tick = now;
+    sched->idle_halt_tsc = cpu_read_tsc();
+    sched->idle_halted = 1;
+    sched->idle_halts++;
+
+    /* sti takes effect after the next instruction, so no wakeup is lost */
+    if (sched_config.idle_use_mwait) {
+        __asm__ volatile ("monitor" : : "a"(&sched->reschedule_pending), "c"(0), "d"(0));
+        __asm__ volatile ("sti; mwait" : : "a"(0), "c"(0) : "memory");
+    } else {
+        __asm__ volatile ("sti; hlt" : : : "memory");
+    }
+
+    __asm__ volatile ("cli" : : : "memory");
+    scheduler_idle_wake(sched);
+    __asm__ volatile ("sti" : : : "memory");
+}
+
+/*
+ * Idle task function - runs on the BSP when no other tasks are ready
  */
 static void idle_task_function(void *arg) {
     (void)arg;  /* Unused parameter */
+    scheduler_t *sched = &cpu_schedulers[0];
 
     while (1) {
-        /* Simple idle loop - could implement power management here */
-        scheduler.idle_time++;
+        sched->idle_time++;
+
+        /* Free stacks of exited tasks now that nothing runs on them */
+        task_reap_exited();
+
+        /* Use spare cycles to finish frame map init and pre-zero frames */
+        uint32_t housekeeping = page_alloc_init_deferred(SCHED_IDLE_DEFERRED_BATCH);
+        housekeeping += page_alloc_refill_zero_pool(SCHED_IDLE_ZERO_BATCH);
 
         /* Check if we should exit (for testing purposes) */
         /* If there are no user tasks and we're in a test environment, exit */
         extern int is_kernel_initialized(void);
-        if (is_kernel_initialized() && scheduler.idle_time > 1000) {
+        if (is_kernel_initialized()) {
             /* Count active tasks */
             extern void get_task_stats(uint32_t *total_tasks, uint32_t *active_tasks,
                                      uint64_t *context_switches);
             uint32_t active_tasks = 0;
             get_task_stats(NULL, &active_tasks, NULL);
-            if (active_tasks <= 1) {  /* Only idle task remains */
-                /* Exit idle loop - return to scheduler caller */
-                break;
+            uint32_t idle_tasks = 0;
+            for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+                if (cpu_schedulers[i].idle_task) {
+                    idle_tasks++;
+                }
+            }
+            if (active_tasks <= idle_tasks) {  /* Only idle tasks remain */
+                if (sched->idle_time > 1000) {
+                    /* Exit idle loop - return to scheduler caller */
+                    break;
+                }
+                continue;  /* Spin towards the exit instead of halting */
             }
         }
 
-        /* Yield periodically to check for new tasks */
-        if (scheduler.idle_time % 1000 == 0) {
+        if (sched->run_queues.count > 0 || sched_migratable_elsewhere(sched)) {
+            yield();
+        } else if (housekeeping > 0) {
+            continue;  /* Keep going while there is idle work left */
+        } else if (sched_config.preemption_enabled && sched_config.bsp_tick) {
+            /* Wakeups preempt idle from the interrupt that readies a task */
+            scheduler_idle_halt(sched);
+        } else if (sched->idle_time % 1000 == 0) {
+            /* No tick to wake a halted CPU: poll for new tasks */
             yield();
         }
     }
 
     /* Return to scheduler - this should only happen in test scenarios */
-    scheduler.enabled = 0;  /* Disable scheduler */
+    sched_config.enabled = 0;  /* Disable scheduler */
+}
+
+/*
+ * Leave the scheduler for good on an application processor
+ * The interrupted task is dropped where it stands: it no longer counts as
+ * running anywhere, so the BSP can terminate it during shutdown
+ */
+static void scheduler_secondary_stop(scheduler_t *sched) {
+    apic_timer_stop();
+
+    task_t *current = sched->current_task;
+    if (current) {
+        current->on_cpu = 0;
+    }
+    sched->current_task = NULL;
+    __atomic_store_n(&sched->online, 0, __ATOMIC_RELEASE);
+
+    smp_park_self();
+}
+
+/*
+ * Idle task of an application processor
+ * Looks for work (its own queue first, then other CPUs' TASK_FLAG_SMP
+ * tasks) and halts until the local timer tick or a reschedule IPI
+ */
+static void secondary_idle_task_function(void *arg) {
+    scheduler_t *sched = (scheduler_t *)arg;
+
+    for (;;) {
+        sched->idle_time++;
+        schedule();
+
+        __asm__ volatile ("cli" : : : "memory");
+        if (sched_config.stopping) {
+            scheduler_secondary_stop(sched);
+        }
+        if (sched->run_queues.count > 0 || sched->reschedule_pending ||
+            sched_migratable_elsewhere(sched)) {
+            sched->reschedule_pending = 0;
+            __asm__ volatile ("sti" : : : "memory");
+            continue;
+        }
+
+        uint64_t start = cpu_read_tsc();
+        sched->idle_halts++;
+        /* sti takes effect after the next instruction, so no wakeup is lost */
+        __asm__ volatile ("sti; hlt" : : : "memory");
+        sched->idle_cycles += cpu_read_tsc() - start;
+        sched->idle_wakeups++;
+    }
 }
 
 /* ========================================================================
  * INITIALIZATION AND CONFIGURATION
  * ======================================================================== */
 
+static void scheduler_cpu_init(scheduler_t *sched, uint32_t cpu) {
+    spin_lock_init(&sched->lock);
+    run_queues_init(&sched->run_queues);
+    sched->run_queues.aging_boosts = 0;
+
+    sched->current_task = NULL;
+    sched->idle_task = NULL;
+    sched->cpu = cpu;
+    sched->online = cpu == 0;
+    sched->total_switches = 0;
+    sched->total_yields = 0;
+    sched->idle_time = 0;
+    sched->total_ticks = 0;
+    sched->total_preemptions = 0;
+    sched->cr3_writes = 0;
+    sched->cr3_writes_skipped = 0;
+    sched->wakeup_preemptions = 0;
+    sched->task_sleeps = 0;
+    sched->steals = 0;
+    sched->schedule_calls = 0;
+    sched->reschedule_pending = 0;
+    sched->in_schedule = 0;
+    sched->idle_halts = 0;
+    sched->idle_wakeups = 0;
+    sched->idle_cycles = 0;
+    sched->idle_tickless = 0;
+    sched->idle_ticks_skipped = 0;
+    sched->idle_halted = 0;
+    sched->idle_halt_tickless = 0;
+}
+
 /*
  * Initialize the scheduler system
+ * Application processors already running the scheduler keep their state
  */
 int init_scheduler(void) {
-    /* Initialize ready queue */
-    ready_queue_init(&scheduler.ready_queue);
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (cpu != 0 && cpu_schedulers[cpu].online) {
+            continue;
+        }
+        scheduler_cpu_init(&cpu_schedulers[cpu], cpu);
+    }
 
     /* Initialize scheduler state */
-    scheduler.current_task = NULL;
-    scheduler.idle_task = NULL;
-    scheduler.policy = SCHED_POLICY_COOPERATIVE;
-    scheduler.enabled = 0;  /* Start disabled */
-    scheduler.time_slice = SCHED_DEFAULT_TIME_SLICE;
-    scheduler.total_switches = 0;
-    scheduler.total_yields = 0;
-    scheduler.idle_time = 0;
-    scheduler.schedule_calls = 0;
-    scheduler.total_ticks = 0;
-    scheduler.total_preemptions = 0;
-    scheduler.preemption_enabled = 0;
-    scheduler.reschedule_pending = 0;
-    scheduler.in_schedule = 0;
+    sched_config.policy = SCHED_POLICY_PRIORITY;
+    sched_config.enabled = 0;  /* Start disabled */
+    sched_config.stopping = 0;
+    sched_config.time_slice = SCHED_DEFAULT_TIME_SLICE;
+    sched_config.preemption_enabled = 0;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    /* Guests halt with hlt: it exits to the host, where mwait may only spin */
+    sched_config.idle_use_mwait = (ecx & CPUID_FEAT_ECX_MONITOR) &&
+                                  !(ecx & CPUID_FEAT_ECX_HYPERVISOR);
+
+    init_kernel_timers();
 
     return 0;
 }
@@ -579,32 +1376,120 @@ int create_idle_task(void) {
         return -1;
     }
 
-    scheduler.idle_task = idle_task;
+    cpu_schedulers[0].idle_task = idle_task;
     return 0;
 }
 
+/*
+ * First code an application processor runs for the scheduler
+ * Starts the local tick for time slices and switches to the CPU's idle
+ * task, abandoning the boot stack
+ */
+static void scheduler_secondary_entry(uint32_t cpu, void *arg) {
+    (void)cpu;
+    scheduler_t *sched = (scheduler_t *)arg;
+
+    uint32_t frequency = pit_get_frequency();
+    if (!frequency) {
+        frequency = PIT_DEFAULT_FREQUENCY_HZ;
+    }
+    if (apic_timer_periodic_us(IRQ_LOCAL_TIMER_VECTOR, 1000000 / frequency) != 0) {
+        kprint("SCHED: CPU ");
+        kprint_decimal(sched->cpu);
+        kprint(" has no local timer, running tasks until they yield\n");
+    }
+
+    __atomic_store_n(&sched->online, 1, __ATOMIC_RELEASE);
+    switch_to_task(sched, sched->idle_task);
+
+    /* Not reached: the idle task never returns */
+    for (;;) {
+        __asm__ volatile ("cli; hlt" : : : "memory");
+    }
+}
+
+/*
+ * Hand every started application processor to the scheduler
+ * Each gets an idle task and its own run queues. Runs on the BSP once the
+ * task manager is up. Returns the number of CPUs now scheduling
+ */
+int scheduler_start_secondaries(void) {
+    uint32_t started = 0;
+
+    for (uint32_t cpu = 1; cpu < smp_cpu_count() && cpu < SMP_MAX_CPUS; cpu++) {
+        const cpu_local_t *info = smp_get_cpu(cpu);
+        scheduler_t *sched = &cpu_schedulers[cpu];
+        if (!info || info->state != SMP_CPU_ONLINE || sched->online) {
+            continue;
+        }
+
+        uint32_t idle_task_id = task_create("idle", secondary_idle_task_function, sched,
+                                            TASK_PRIORITY_IDLE, TASK_FLAG_KERNEL_MODE);
+        task_t *idle_task = NULL;
+        if (idle_task_id == INVALID_TASK_ID || task_get_info(idle_task_id, &idle_task) != 0) {
+            kprint("SCHED: Failed to create idle task for CPU ");
+            kprint_decimal(cpu);
+            kprint("\n");
+            continue;
+        }
+        idle_task->cpu = (uint8_t)cpu;
+        sched->idle_task = idle_task;
+
+        if (smp_hand_over(cpu, scheduler_secondary_entry, sched) != 0) {
+            sched->idle_task = NULL;
+            task_terminate(idle_task_id);
+            continue;
+        }
+
+        uint64_t spins = 0;
+        while (!__atomic_load_n(&sched->online, __ATOMIC_ACQUIRE) &&
+               spins++ < SCHED_CPU_START_SPINS) {
+            __asm__ volatile ("pause" ::: "memory");
+        }
+        if (!sched->online) {
+            kprint("SCHED: CPU ");
+            kprint_decimal(cpu);
+            kprint(" did not start scheduling\n");
+            continue;
+        }
+        started++;
+    }
+
+    BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
+        kprint("SCHED: ");
+        kprint_decimal(started);
+        kprint(" application processors scheduling\n");
+    });
+    return (int)started;
+}
+
 /*
  * Start the scheduler (enable scheduling)
  */
 int start_scheduler(void) {
-    if (scheduler.enabled) {
+    if (sched_config.enabled) {
         return -1;
     }
 
-    scheduler.enabled = 1;
+    sched_config.enabled = 1;
+    sched_config.start_tsc = cpu_read_tsc();
 
     /* Save current context as return context for testing */
     extern void init_kernel_context(task_context_t *context);
-    init_kernel_context(&scheduler.return_context);
+    init_kernel_context(&sched_config.return_context);
 
     scheduler_set_preemption_enabled(1);
 
+    scheduler_t *sched = &cpu_schedulers[0];
+
     /* If we have tasks in ready queue, start scheduling */
-    if (!ready_queue_empty(&scheduler.ready_queue)) {
+    if (sched->run_queues.count > 0) {
         schedule();
-    } else if (scheduler.idle_task) {
+    } else if (sched->idle_task) {
         /* Start with idle task */
-        switch_to_task(scheduler.idle_task);
+        uint64_t flags = cpu_irq_save();
+        switch_to_task(sched, sched->idle_task);
+        cpu_irq_restore(flags);
     } else {
         return -1;
     }
@@ -617,20 +1502,60 @@ int start_scheduler(void) {
  * Stop the scheduler
  */
 void stop_scheduler(void) {
-    scheduler.enabled = 0;
+    sched_config.enabled = 0;
+}
+
+/*
+ * Take the application processors out of the scheduler and wait until
+ * each has halted with its current task released
+ */
+static void scheduler_stop_secondaries(void) {
+    sched_config.stopping = 1;
+
+    for (uint32_t cpu = 1; cpu < SMP_MAX_CPUS; cpu++) {
+        scheduler_t *sched = &cpu_schedulers[cpu];
+        if (!sched->online) {
+            continue;
+        }
+
+        sched_send_reschedule(sched);
+        uint64_t spins = 0;
+        while (__atomic_load_n(&sched->online, __ATOMIC_ACQUIRE) &&
+               spins++ < SCHED_CPU_START_SPINS) {
+            __asm__ volatile ("pause" ::: "memory");
+        }
+        if (sched->online) {
+            kprint("SCHED: CPU ");
+            kprint_decimal(cpu);
+            kprint(" did not stop\n");
+        }
+    }
 }
 
 /*
  * Prepare scheduler for shutdown and clear scheduling state
  */
 void scheduler_shutdown(void) {
-    if (scheduler.enabled) {
+    scheduler_stop_secondaries();
+
+    if (sched_config.enabled) {
         stop_scheduler();
     }
 
-    ready_queue_init(&scheduler.ready_queue);
-    scheduler.current_task = NULL;
-    scheduler.idle_task = NULL;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        scheduler_t *sched = &cpu_schedulers[cpu];
+        if (cpu != 0 && sched->online) {
+            continue;  /* Still running; leave its state alone */
+        }
+
+        /* The caller keeps running but no longer counts as on a CPU */
+        if (sched->current_task) {
+            sched->current_task->on_cpu = 0;
+        }
+        run_queues_init(&sched->run_queues);
+        sched->current_task = NULL;
+        sched->idle_task = NULL;
+    }
 }
 
 /* ========================================================================
@@ -638,71 +1563,225 @@ void scheduler_shutdown(void) {
  * ======================================================================== */
 
 /*
- * Get scheduler statistics
+ * Get scheduler statistics, summed over every CPU
  */
 void get_scheduler_stats(uint64_t *context_switches, uint64_t *yields,
                         uint32_t *ready_tasks, uint32_t *schedule_calls) {
+    uint64_t switches = 0, total_yields = 0;
+    uint32_t ready = 0, calls = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        scheduler_t *sched = &cpu_schedulers[cpu];
+        switches += sched->total_switches;
+        total_yields += sched->total_yields;
+        ready += sched->run_queues.count;
+        calls += sched->schedule_calls;
+    }
+
     if (context_switches) {
-        *context_switches = scheduler.total_switches;
+        *context_switches = switches;
     }
     if (yields) {
-        *yields = scheduler.total_yields;
+        *yields = total_yields;
     }
     if (ready_tasks) {
-        *ready_tasks = scheduler.ready_queue.count;
+        *ready_tasks = ready;
     }
     if (schedule_calls) {
-        *schedule_calls = scheduler.schedule_calls;
+        *schedule_calls = calls;
     }
 }
 
+/*
+ * Get one CPU's share of the work: context switches, tasks it stole from
+ * other CPUs and TSC cycles its idle task spent halted
+ * Returns 0 on success, -1 if the CPU never ran the scheduler
+ */
+int get_scheduler_cpu_stats(uint32_t cpu, uint64_t *context_switches, uint64_t *steals,
+                            uint64_t *idle_cycles) {
+    if (cpu >= SMP_MAX_CPUS || !cpu_schedulers[cpu].idle_task) {
+        return -1;
+    }
+
+    scheduler_t *sched = &cpu_schedulers[cpu];
+    if (context_switches) {
+        *context_switches = sched->total_switches;
+    }
+    if (steals) {
+        *steals = sched->steals;
+    }
+    if (idle_cycles) {
+        *idle_cycles = sched->idle_cycles;
+    }
+    return 0;
+}
+
+/*
+ * Get CR3 write statistics for context switches
+ */
+void get_scheduler_cr3_stats(uint64_t *cr3_writes, uint64_t *cr3_writes_skipped) {
+    uint64_t writes = 0, skipped = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        writes += cpu_schedulers[cpu].cr3_writes;
+        skipped += cpu_schedulers[cpu].cr3_writes_skipped;
+    }
+
+    if (cr3_writes) {
+        *cr3_writes = writes;
+    }
+    if (cr3_writes_skipped) {
+        *cr3_writes_skipped = skipped;
+    }
+}
+
+/*
+ * Get priority scheduling statistics
+ */
+void get_scheduler_priority_stats(uint64_t *aging_boosts, uint64_t *wakeup_preemptions) {
+    uint64_t boosts = 0, preemptions = 0;
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        boosts += cpu_schedulers[cpu].run_queues.aging_boosts;
+        preemptions += cpu_schedulers[cpu].wakeup_preemptions;
+    }
+
+    if (aging_boosts) {
+        *aging_boosts = boosts;
+    }
+    if (wakeup_preemptions) {
+        *wakeup_preemptions = preemptions;
+    }
+}
+
+void get_scheduler_sleep_stats(uint64_t *task_sleeps, uint64_t *timers_fired) {
+    if (task_sleeps) {
+        uint64_t sleeps = 0;
+        for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+            sleeps += cpu_schedulers[cpu].task_sleeps;
+        }
+        *task_sleeps = sleeps;
+    }
+    if (timers_fired) {
+        get_kernel_timer_stats(NULL, timers_fired, NULL);
+    }
+}
+
+/*
+ * Idle residency is reported for the BSP, which owns the tickless idle
+ */
+void get_scheduler_idle_stats(uint64_t *idle_cycles, uint64_t *total_cycles,
+                              uint64_t *wakeups, uint64_t *ticks_skipped) {
+    scheduler_t *sched = &cpu_schedulers[0];
+    if (idle_cycles) {
+        *idle_cycles = sched->idle_cycles;
+    }
+    if (total_cycles) {
+        *total_cycles = sched_config.start_tsc ? cpu_read_tsc() - sched_config.start_tsc : 0;
+    }
+    if (wakeups) {
+        *wakeups = sched->idle_wakeups;
+    }
+    if (ticks_skipped) {
+        *ticks_skipped = sched->idle_ticks_skipped;
+    }
+}
+
+/*
+ * Switch scheduling policy
+ * Only allowed while no task is queued on any CPU, since queued tasks sit
+ * on the levels of the old policy. Returns 0 on success, -1 otherwise
+ */
+int scheduler_set_policy(uint8_t policy) {
+    if (policy > SCHED_POLICY_COOPERATIVE) {
+        return -1;
+    }
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (cpu_schedulers[cpu].run_queues.count > 0) {
+            return -1;
+        }
+    }
+
+    sched_config.policy = policy;
+    return 0;
+}
+
+uint8_t scheduler_get_policy(void) {
+    return sched_config.policy;
+}
+
+/*
+ * Dequeue the task the calling CPU would run next without switching to it
+ * Lets benchmarks drive the run queues directly. Returns NULL if none ready
+ */
+task_t *scheduler_dequeue_next(void) {
+    uint64_t flags = cpu_irq_save();
+    scheduler_t *sched = sched_local();
+    spin_lock(&sched->lock);
+    task_t *task = run_queues_dequeue(&sched->run_queues);
+    spin_unlock(&sched->lock);
+    cpu_irq_restore(flags);
+    return task;
+}
+
 /*
  * Check if scheduler is enabled
  */
 int scheduler_is_enabled(void) {
-    return scheduler.enabled;
+    return sched_config.enabled;
 }
 
 /*
- * Get current task from scheduler
+ * Get current task of the calling CPU
  */
 task_t *scheduler_get_current_task(void) {
-    return scheduler.current_task;
+    uint64_t flags = cpu_irq_save();
+    task_t *current = sched_local()->current_task;
+    cpu_irq_restore(flags);
+    return current;
 }
 
 void scheduler_set_preemption_enabled(int enabled) {
-    scheduler.preemption_enabled = enabled ? 1 : 0;
-    if (scheduler.preemption_enabled) {
-        pit_enable_irq();
+    sched_config.preemption_enabled = enabled ? 1 : 0;
+    if (sched_config.preemption_enabled) {
+        scheduler_bsp_tick_start();
     } else {
-        scheduler.reschedule_pending = 0;
-        pit_disable_irq();
+        cpu_schedulers[0].reschedule_pending = 0;
+        scheduler_bsp_tick_stop();
     }
 }
 
 int scheduler_is_preemption_enabled(void) {
-    return scheduler.preemption_enabled;
+    return sched_config.preemption_enabled;
 }
 
+/*
+ * Timer tick on the calling CPU (interrupts disabled)
+ * The BSP's tick also drives the tick count and the kernel timers; every
+ * CPU charges its running task's time slice
+ */
 void scheduler_timer_tick(void) {
-    scheduler.total_ticks++;
+    scheduler_t *sched = sched_local();
+
+    if (sched->cpu == 0) {
+        scheduler_idle_wake(sched);
+        kernel_timers_run(irq_get_timer_ticks());
+    }
+    sched->total_ticks++;
 
-    if (!scheduler.enabled || !scheduler.preemption_enabled) {
+    if (!sched_config.enabled || !sched_config.preemption_enabled) {
         return;
     }
 
-    task_t *current = scheduler.current_task;
+    task_t *current = sched->current_task;
     if (!current) {
         return;
     }
 
-    if (scheduler.in_schedule) {
+    if (sched->in_schedule) {
         return;
     }
 
-    if (current == scheduler.idle_task) {
-        if (scheduler.ready_queue.count > 0) {
-            scheduler.reschedule_pending = 1;
+    if (current == sched->idle_task) {
+        if (sched->run_queues.count > 0) {
+            sched->reschedule_pending = 1;
         }
         return;
     }
@@ -719,31 +1798,39 @@ void scheduler_timer_tick(void) {
         return;
     }
 
-    if (scheduler.ready_queue.count == 0) {
+    if (sched->run_queues.count == 0) {
         scheduler_reset_task_quantum(current);
         return;
     }
 
-    if (!scheduler.reschedule_pending) {
-        scheduler.total_preemptions++;
+    if (!sched->reschedule_pending) {
+        sched->total_preemptions++;
     }
-    scheduler.reschedule_pending = 1;
+    sched->reschedule_pending = 1;
 }
 
 void scheduler_handle_post_irq(void) {
-    if (!scheduler.reschedule_pending) {
+    scheduler_t *sched = sched_local();
+
+    if (sched->cpu == 0) {
+        scheduler_idle_wake(sched);
+    } else if (sched_config.stopping) {
+        scheduler_secondary_stop(sched);
+    }
+
+    if (!sched->reschedule_pending) {
         return;
     }
 
-    if (!scheduler.enabled || !scheduler.preemption_enabled) {
-        scheduler.reschedule_pending = 0;
+    if (!sched_config.enabled || !sched_config.preemption_enabled) {
+        sched->reschedule_pending = 0;
         return;
     }
 
-    if (scheduler.in_schedule) {
+    if (sched->in_schedule) {
         return;
     }
 
-    scheduler.reschedule_pending = 0;
+    sched->reschedule_pending = 0;
     schedule();
 }
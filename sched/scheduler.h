@@ -10,6 +10,11 @@
 #include <stddef.h>
 #include "task.h"
 
+/* Scheduling policies */
+#define SCHED_POLICY_ROUND_ROBIN      0         /* Round-robin scheduling */
+#define SCHED_POLICY_PRIORITY         1         /* Priority-based scheduling */
+#define SCHED_POLICY_COOPERATIVE      2         /* Pure cooperative scheduling */
+
 /* ========================================================================
  * TASK MANAGEMENT FUNCTIONS
  * ======================================================================== */
@@ -69,6 +74,12 @@ void task_set_current(task_t *task);
  */
 int task_shutdown_all(void);
 
+/*
+ * Free the stacks and control blocks of tasks that terminated themselves
+ * (BSP task context only; the idle task calls this)
+ */
+void task_reap_exited(void);
+
 /* ========================================================================
  * SCHEDULER FUNCTIONS
  * ======================================================================== */
@@ -96,6 +107,12 @@ int start_scheduler(void);
  */
 void stop_scheduler(void);
 
+/*
+ * Hand the started application processors to the scheduler
+ * Returns the number of CPUs that joined
+ */
+int scheduler_start_secondaries(void);
+
 /*
  * Prepare scheduler for shutdown (stop scheduling and clear state)
  */
@@ -113,6 +130,23 @@ int schedule_task(task_t *task);
  */
 int unschedule_task(task_t *task);
 
+/*
+ * Select the scheduling policy (only while no task is queued)
+ * Returns 0 on success, non-zero on failure
+ */
+int scheduler_set_policy(uint8_t policy);
+
+/*
+ * Get the current scheduling policy
+ */
+uint8_t scheduler_get_policy(void);
+
+/*
+ * Dequeue the next task by policy without switching to it (benchmarks)
+ * Returns task pointer, NULL if no task is ready
+ */
+task_t *scheduler_dequeue_next(void);
+
 /*
  * Main scheduling function - select and switch to next task
  */
@@ -133,6 +167,13 @@ void block_current_task(void);
  */
 int task_wait_for(uint32_t task_id);
 
+/*
+ * Sleep on the kernel timer wheel without spinning
+ * Returns 0 after the deadline, -1 if the caller cannot block
+ */
+int task_sleep_until(uint64_t deadline);
+int task_sleep_ms(uint32_t milliseconds);
+
 /*
  * Unblock task (add back to ready queue)
  * Returns 0 on success, non-zero on failure
@@ -170,6 +211,11 @@ task_t *scheduler_get_current_task(void);
  */
 void scheduler_timer_tick(void);
 
+/*
+ * Wake the BSP from a tickless halt armed past a newly added timer
+ */
+void scheduler_timer_added(uint64_t expires);
+
 /*
  * Handle deferred rescheduling after interrupt processing
  */
@@ -185,12 +231,52 @@ void scheduler_handle_post_irq(void);
 void get_scheduler_stats(uint64_t *context_switches, uint64_t *yields,
                         uint32_t *ready_tasks, uint32_t *schedule_calls);
 
+/*
+ * Get how many context switches wrote CR3 and how many skipped the write
+ * because the incoming task shares the current address space
+ */
+void get_scheduler_cr3_stats(uint64_t *cr3_writes, uint64_t *cr3_writes_skipped);
+
+/*
+ * Get how many starved tasks were boosted a level and how many wakeups
+ * preempted a lower-priority running task
+ */
+void get_scheduler_priority_stats(uint64_t *aging_boosts, uint64_t *wakeup_preemptions);
+
+/*
+ * Get how many blocking sleeps were started and how many kernel timers fired
+ */
+void get_scheduler_sleep_stats(uint64_t *task_sleeps, uint64_t *timers_fired);
+
+/*
+ * Get idle residency (cycles halted out of cycles since the scheduler
+ * started), the interrupts that woke the idle CPU and the ticks skipped
+ * while the periodic tick was stopped
+ */
+void get_scheduler_idle_stats(uint64_t *idle_cycles, uint64_t *total_cycles,
+                              uint64_t *wakeups, uint64_t *ticks_skipped);
+
+/*
+ * Get one CPU's context switches, tasks it stole from other CPUs and cycles
+ * its idle task spent halted
+ * Returns 0 on success, -1 if the CPU never ran the scheduler
+ */
+int get_scheduler_cpu_stats(uint32_t cpu, uint64_t *context_switches, uint64_t *steals,
+                            uint64_t *idle_cycles);
+
 /*
  * Get task manager statistics
  */
 void get_task_stats(uint32_t *total_tasks, uint32_t *active_tasks,
                    uint64_t *context_switches);
 
+/*
+ * Get the task ID hash table size, how many task IDs were reused and how
+ * often the table grew
+ */
+void get_task_table_stats(uint32_t *id_buckets, uint32_t *ids_recycled,
+                          uint32_t *table_grows);
+
 /* ========================================================================
  * TEST FUNCTIONS
  * ======================================================================== */
@@ -10,11 +10,16 @@
 #include "../boot/debug.h"
 #include "../boot/log.h"
 #include "../drivers/serial.h"
+#include "../drivers/tty.h"
+#include "../drivers/smp.h"
+#include "../lib/cpu.h"
+#include "../lib/memory.h"
 #include "../mm/kernel_heap.h"
+#include "../mm/kmem_cache.h"
 #include "../mm/paging.h"
-#include "../mm/kernel_heap.h"
 #include "task.h"
 #include "scheduler.h"
+#include "timer.h"
 
 extern void task_entry_wrapper(void);
 
@@ -39,76 +44,225 @@ int process_vm_free(uint32_t process_id, uint64_t vaddr, uint64_t size);
 void kernel_panic(const char *message);
 process_page_dir_t *process_vm_get_page_dir(uint32_t process_id);
 
+/* Task ID hash table sizing */
+#define TASK_ID_HASH_INITIAL_BUCKETS  32        /* Power of two */
+#define TASK_ID_HASH_MAX_LOAD         2         /* Tasks per bucket before growing */
+#define TASK_FREE_IDS_INITIAL         64        /* Recycled ID stack capacity */
+
 /* Task manager structure */
 typedef struct task_manager {
-    task_t tasks[MAX_TASKS];             /* Task pool */
+    kmem_cache_t *task_cache;            /* Slab cache for task control blocks */
+    task_t **id_buckets;                 /* Task ID hash table (chained by id_next) */
+    uint32_t id_bucket_count;            /* Power of two */
+    task_t *all_tasks;                   /* Live tasks, newest first */
+    task_t *exited_tasks;                /* Self-terminated, stack not yet freed (all_next) */
+    uint32_t *free_ids;                  /* Stack of IDs released by terminated tasks */
+    uint32_t free_id_count;
+    uint32_t free_id_capacity;
     uint32_t num_tasks;                  /* Number of active tasks */
-    uint32_t next_task_id;               /* Next task ID to assign */
+    uint32_t next_task_id;               /* Next never-used task ID */
 
     /* Lifecycle statistics */
     uint64_t total_context_switches;     /* Total context switches performed */
     uint64_t total_yields;               /* Total voluntary yields */
     uint32_t tasks_created;              /* Total tasks created */
     uint32_t tasks_terminated;           /* Total tasks terminated */
+    uint32_t ids_recycled;               /* Task IDs handed out again */
+    uint32_t id_table_grows;             /* Hash table resizes */
 } task_manager_t;
 
 /* Global task manager instance */
 static task_manager_t task_manager = {0};
 
 /* Forward declarations */
-static void release_task_dependents(uint32_t completed_task_id);
+static void release_task_dependents(task_t *completed);
 
 /* ========================================================================
- * UTILITY FUNCTIONS
+ * TASK TABLE
  * ======================================================================== */
 
+static inline uint32_t task_id_bucket(uint32_t task_id) {
+    return task_id & (task_manager.id_bucket_count - 1);
+}
+
 /*
  * Find task by task ID
  * Returns pointer to task, NULL if not found
  */
 static task_t *find_task_by_id(uint32_t task_id) {
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        if (task_manager.tasks[i].task_id == task_id) {
-            return &task_manager.tasks[i];
-        }
+    if (!task_manager.id_buckets || task_id == INVALID_TASK_ID) {
+        return NULL;
     }
-    return NULL;
+
+    task_t *task = task_manager.id_buckets[task_id_bucket(task_id)];
+    while (task && task->task_id != task_id) {
+        task = task->id_next;
+    }
+    return task;
 }
 
 /*
- * Find free task slot
- * Returns pointer to free task slot, NULL if none available
+ * Double the hash table once the load factor is exceeded
+ * Failure is harmless: chains just get longer
  */
-static task_t *find_free_task_slot(void) {
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        if (task_manager.tasks[i].state == TASK_STATE_INVALID) {
-            return &task_manager.tasks[i];
+static void task_table_grow(void) {
+    uint32_t new_count = task_manager.id_bucket_count * 2;
+    task_t **buckets = (task_t **)kmalloc(new_count * sizeof(task_t *));
+    if (!buckets) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < new_count; i++) {
+        buckets[i] = NULL;
+    }
+
+    for (task_t *task = task_manager.all_tasks; task; task = task->all_next) {
+        uint32_t index = task->task_id & (new_count - 1);
+        task->id_next = buckets[index];
+        buckets[index] = task;
+    }
+
+    kfree(task_manager.id_buckets);
+    task_manager.id_buckets = buckets;
+    task_manager.id_bucket_count = new_count;
+    task_manager.id_table_grows++;
+}
+
+/* Link a task into the ID hash table and the live task list */
+static void task_table_insert(task_t *task) {
+    uint32_t index = task_id_bucket(task->task_id);
+    task->id_next = task_manager.id_buckets[index];
+    task_manager.id_buckets[index] = task;
+
+    task->all_prev = NULL;
+    task->all_next = task_manager.all_tasks;
+    if (task_manager.all_tasks) {
+        task_manager.all_tasks->all_prev = task;
+    }
+    task_manager.all_tasks = task;
+
+    task_manager.num_tasks++;
+    if (task_manager.num_tasks > task_manager.id_bucket_count * TASK_ID_HASH_MAX_LOAD) {
+        task_table_grow();
+    }
+}
+
+static void task_table_remove(task_t *task) {
+    task_t **link = &task_manager.id_buckets[task_id_bucket(task->task_id)];
+    while (*link && *link != task) {
+        link = &(*link)->id_next;
+    }
+    if (*link) {
+        *link = task->id_next;
+    }
+
+    if (task->all_prev) {
+        task->all_prev->all_next = task->all_next;
+    } else {
+        task_manager.all_tasks = task->all_next;
+    }
+    if (task->all_next) {
+        task->all_next->all_prev = task->all_prev;
+    }
+
+    task->id_next = NULL;
+    task->all_prev = NULL;
+    task->all_next = NULL;
+    if (task_manager.num_tasks > 0) {
+        task_manager.num_tasks--;
+    }
+}
+
+/*
+ * Take the most recently released ID, or a fresh one
+ * Returns INVALID_TASK_ID once the ID space is exhausted
+ */
+static uint32_t task_id_alloc(void) {
+    if (task_manager.free_id_count > 0) {
+        task_manager.ids_recycled++;
+        return task_manager.free_ids[--task_manager.free_id_count];
+    }
+
+    if (task_manager.next_task_id == INVALID_TASK_ID) {
+        return INVALID_TASK_ID;
+    }
+    return task_manager.next_task_id++;
+}
+
+/*
+ * Return an ID for reuse, growing the stack as needed
+ * If the stack cannot grow the ID is simply retired
+ */
+static void task_id_release(uint32_t task_id) {
+    if (task_manager.free_id_count == task_manager.free_id_capacity) {
+        uint32_t capacity = task_manager.free_id_capacity ?
+                            task_manager.free_id_capacity * 2 : TASK_FREE_IDS_INITIAL;
+        uint32_t *ids = (uint32_t *)kmalloc(capacity * sizeof(uint32_t));
+        if (!ids) {
+            return;
+        }
+        for (uint32_t i = 0; i < task_manager.free_id_count; i++) {
+            ids[i] = task_manager.free_ids[i];
         }
+        kfree(task_manager.free_ids);
+        task_manager.free_ids = ids;
+        task_manager.free_id_capacity = capacity;
     }
-    return NULL;
+
+    task_manager.free_ids[task_manager.free_id_count++] = task_id;
 }
 
 /*
  * Release tasks that were waiting on the specified task to complete
  */
-static void release_task_dependents(uint32_t completed_task_id) {
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        task_t *dependent = &task_manager.tasks[i];
+static void release_task_dependents(task_t *completed) {
+    task_t *dependent = completed->waiters;
+    completed->waiters = NULL;
 
-        if (!task_is_blocked(dependent)) {
-            continue;
-        }
+    while (dependent) {
+        task_t *next = dependent->next_waiter;
+        dependent->next_waiter = NULL;
 
-        if (dependent->waiting_on_task_id != completed_task_id) {
-            continue;
+        if (task_is_blocked(dependent) && dependent->waiting_on_task_id == completed->task_id) {
+            dependent->waiting_on_task_id = INVALID_TASK_ID;
+
+            if (unblock_task(dependent) != 0) {
+                kprint("task_terminate: Failed to unblock dependent task\n");
+            }
         }
+        dependent = next;
+    }
+}
+
+/*
+ * Register waiter to be woken when target terminates
+ * Called by task_wait_for before the waiter blocks
+ */
+int task_add_waiter(task_t *target, task_t *waiter) {
+    if (!target || !waiter || target == waiter) {
+        return -1;
+    }
 
-        dependent->waiting_on_task_id = INVALID_TASK_ID;
+    waiter->next_waiter = target->waiters;
+    target->waiters = waiter;
+    return 0;
+}
 
-        if (unblock_task(dependent) != 0) {
-            kprint("task_terminate: Failed to unblock dependent task\n");
-        }
+/* Drop a terminating waiter from the wait list of the task it waits on */
+static void task_remove_waiter(task_t *waiter) {
+    task_t *target = find_task_by_id(waiter->waiting_on_task_id);
+    if (!target) {
+        return;
+    }
+
+    task_t **link = &target->waiters;
+    while (*link && *link != waiter) {
+        link = &(*link)->next_waiter;
     }
+    if (*link) {
+        *link = waiter->next_waiter;
+    }
+    waiter->next_waiter = NULL;
 }
 
 /*
@@ -176,17 +330,27 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
         return INVALID_TASK_ID;
     }
 
-    if (task_manager.num_tasks >= MAX_TASKS) {
-        kprint("task_create: Maximum tasks reached\n");
+    if (!task_manager.task_cache || !task_manager.id_buckets) {
+        kprint("task_create: Task manager not initialized\n");
+        return INVALID_TASK_ID;
+    }
+
+    task_reap_exited();
+
+    /* Assign task ID */
+    uint32_t task_id = task_id_alloc();
+    if (task_id == INVALID_TASK_ID) {
+        kprint("task_create: Task IDs exhausted\n");
         return INVALID_TASK_ID;
     }
 
-    /* Find free task slot */
-    task_t *task = find_free_task_slot();
+    task_t *task = (task_t *)kmem_cache_alloc(task_manager.task_cache);
     if (!task) {
-        kprint("task_create: No free task slots\n");
+        kprint("task_create: Failed to allocate task control block\n");
+        task_id_release(task_id);
         return INVALID_TASK_ID;
     }
+    memset(task, 0, sizeof(*task));
 
     uint32_t process_id = INVALID_PROCESS_ID;
     uint64_t stack_base = 0;
@@ -197,6 +361,8 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
         void *stack = kmalloc(TASK_STACK_SIZE);
         if (!stack) {
             kprint("task_create: Failed to allocate kernel stack\n");
+            kmem_cache_free(task_manager.task_cache, task);
+            task_id_release(task_id);
             return INVALID_TASK_ID;
         }
 
@@ -206,6 +372,8 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
         process_id = create_process_vm();
         if (process_id == INVALID_PROCESS_ID) {
             kprint("task_create: Failed to create process VM\n");
+            kmem_cache_free(task_manager.task_cache, task);
+            task_id_release(task_id);
             return INVALID_TASK_ID;
         }
 
@@ -217,13 +385,12 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
         if (!stack_base) {
             kprint("task_create: Failed to allocate stack\n");
             destroy_process_vm(process_id);
+            kmem_cache_free(task_manager.task_cache, task);
+            task_id_release(task_id);
             return INVALID_TASK_ID;
         }
     }
 
-    /* Assign task ID */
-    uint32_t task_id = task_manager.next_task_id++;
-
     /* Initialize task control block */
     task->task_id = task_id;
 
@@ -251,6 +418,8 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
     task->yield_count = 0;
     task->last_run_timestamp = 0;
     task->waiting_on_task_id = INVALID_TASK_ID;
+    task->queue_level = priority;
+    task->queue_stamp = 0;
 
     /* Initialize CPU context */
     init_task_context(task);
@@ -268,7 +437,7 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
     }
 
     /* Update task manager */
-    task_manager.num_tasks++;
+    task_table_insert(task);
     task_manager.tasks_created++;
 
     BOOT_LOG_BLOCK(BOOT_LOG_LEVEL_DEBUG, {
@@ -282,6 +451,50 @@ uint32_t task_create(const char *name, task_entry_t entry_point, void *arg,
     return task_id;
 }
 
+/*
+ * Free a terminated task's stack or process address space
+ */
+static void task_release_resources(task_t *task) {
+    if (task->process_id != INVALID_PROCESS_ID) {
+        /* User mode tasks: free process VM space in one pass, then the VMA descriptors */
+        destroy_process_vm(task->process_id);
+        destroy_process_vma_space(task->process_id);
+    } else if (task->stack_base) {
+        /* Kernel tasks: free stack from kernel heap */
+        kfree((void *)task->stack_base);
+    }
+    task->stack_base = 0;
+}
+
+/*
+ * Free tasks that terminated themselves
+ * Exits finish on the BSP with interrupts disabled until the task has
+ * switched away, so any later caller on the BSP runs on another stack.
+ * Called from task context only: the heap is not safe to use from
+ * interrupt handlers
+ */
+void task_reap_exited(void) {
+    if (smp_current_cpu() != 0) {
+        return;
+    }
+
+    for (;;) {
+        uint64_t flags = cpu_irq_save();
+        task_t *task = task_manager.exited_tasks;
+        if (task) {
+            task_manager.exited_tasks = task->all_next;
+            task->all_next = NULL;
+        }
+        cpu_irq_restore(flags);
+
+        if (!task) {
+            break;
+        }
+        task_release_resources(task);
+        kmem_cache_free(task_manager.task_cache, task);
+    }
+}
+
 /*
  * Terminate a task and clean up resources
  */
@@ -305,14 +518,31 @@ int task_terminate(uint32_t task_id) {
         return -1;
     }
 
+    int self = task == scheduler_get_current_task();
+    if (!self) {
+        task_reap_exited();
+    }
+
+    /*
+     * Remove the task from the scheduler first: a task running on another
+     * CPU still uses its stack and cannot be torn down from here
+     */
+    if (unschedule_task(task) != 0) {
+        kprint("task_terminate: Task ");
+        kprint_decimal(resolved_id);
+        kprint(" is running on another CPU\n");
+        return -1;
+    }
+
     kprint("Terminating task '");
     kprint(task->name);
     kprint("' (ID ");
     kprint_decimal(resolved_id);
     kprint(")\n");
 
-    /* Ensure task is removed from scheduler structures */
-    unschedule_task(task);
+    /* Ensure task is removed from the timer wheel and tty waits */
+    kernel_timer_cancel(&task->sleep_timer);
+    tty_cancel_wait(task);
 
     /* Finalize runtime statistics if task was running */
     if (task->last_run_timestamp != 0) {
@@ -326,41 +556,37 @@ int task_terminate(uint32_t task_id) {
     /* Mark task as terminated */
     task->state = TASK_STATE_TERMINATED;
 
-    /* Wake any dependents waiting on this task */
-    release_task_dependents(resolved_id);
-
-    /* Free resources based on task mode */
-    if (task->process_id != INVALID_PROCESS_ID) {
-        /* User mode tasks: free process VM space */
-        destroy_process_vm(task->process_id);
-        destroy_process_vma_space(task->process_id);
-    } else if (task->stack_base) {
-        /* Kernel tasks: free stack from kernel heap */
-        kfree((void *)task->stack_base);
+    /* Wake any dependents waiting on this task, stop waiting on others */
+    release_task_dependents(task);
+    if (task->waiting_on_task_id != INVALID_TASK_ID) {
+        task_remove_waiter(task);
     }
 
-    /* Clear task control block */
+    /*
+     * Unlink the task and recycle the ID. The scheduler has already
+     * dropped its references (unschedule_task above). Both may allocate,
+     * so they run while the task's stack is still allocated and cannot be
+     * handed out again underneath a task terminating itself
+     */
+    task_table_remove(task);
     task->task_id = INVALID_TASK_ID;
     task->state = TASK_STATE_INVALID;
-    task->process_id = INVALID_PROCESS_ID;
-    task->stack_base = 0;
-    task->stack_pointer = 0;
-    task->stack_size = 0;
-    task->time_slice = 0;
-    task->time_slice_remaining = 0;
-    task->total_runtime = 0;
-    task->yield_count = 0;
-    task->entry_point = NULL;
-    task->entry_arg = NULL;
-    task->creation_time = 0;
-    task->waiting_on_task_id = INVALID_TASK_ID;
-    task->last_run_timestamp = 0;
+    task_id_release(resolved_id);
+    task_manager.tasks_terminated++;
 
-    /* Update task manager */
-    if (task_manager.num_tasks > 0) {
-        task_manager.num_tasks--;
+    /*
+     * A task terminating itself is still running on its stack (and, for
+     * user tasks, its address space): leave those to task_reap_exited()
+     */
+    if (self) {
+        uint64_t flags = cpu_irq_save();
+        task->all_next = task_manager.exited_tasks;
+        task_manager.exited_tasks = task;
+        cpu_irq_restore(flags);
+    } else {
+        task_release_resources(task);
+        kmem_cache_free(task_manager.task_cache, task);
     }
-    task_manager.tasks_terminated++;
 
     return 0;
 }
@@ -373,28 +599,20 @@ int task_shutdown_all(void) {
     int result = 0;
     task_t *current = scheduler_get_current_task();
 
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        task_t *task = &task_manager.tasks[i];
-
-        if (task->state == TASK_STATE_INVALID) {
-            continue;
-        }
-
-        if (task == current) {
-            continue;
-        }
+    task_t *task = task_manager.all_tasks;
+    while (task) {
+        task_t *next = task->all_next;
 
-        if (task->task_id == INVALID_TASK_ID) {
-            continue;
-        }
-
-        if (task_terminate(task->task_id) != 0) {
+        if (task != current && task->state != TASK_STATE_INVALID &&
+            task_terminate(task->task_id) != 0) {
             result = -1;
         }
-    }
 
-    task_manager.num_tasks = 0;
+        /* Terminating a task can only unblock others, never free them */
+        task = next;
+    }
 
+    task_reap_exited();
     return result;
 }
 
@@ -450,6 +668,17 @@ static int task_state_transition_allowed(uint8_t old_state, uint8_t new_state) {
 
 int task_set_state(uint32_t task_id, uint8_t new_state) {
     task_t *task = find_task_by_id(task_id);
+    if (!task) {
+        return -1;
+    }
+    return task_update_state(task, new_state);
+}
+
+/*
+ * Change the state of a task the caller already holds
+ * Skips the ID table lookup, so the scheduler can use it on any CPU
+ */
+int task_update_state(task_t *task, uint8_t new_state) {
     if (!task || task->state == TASK_STATE_INVALID) {
         return -1;
     }
@@ -458,7 +687,7 @@ int task_set_state(uint32_t task_id, uint8_t new_state) {
 
     if (!task_state_transition_allowed(old_state, new_state)) {
         kprint("task_set_state: invalid transition for task ");
-        kprint_decimal(task_id);
+        kprint_decimal(task->task_id);
         kprint(" (");
         kprint(task_state_to_string(old_state));
         kprint(" -> ");
@@ -469,7 +698,7 @@ int task_set_state(uint32_t task_id, uint8_t new_state) {
     task->state = new_state;
 
     kprint("Task ");
-    kprint_decimal(task_id);
+    kprint_decimal(task->task_id);
     kprint(" state: ");
     kprint_decimal(old_state);
     kprint(" -> ");
@@ -487,24 +716,40 @@ int task_set_state(uint32_t task_id, uint8_t new_state) {
  * Initialize the task management system
  */
 int init_task_manager(void) {
+    if (!task_manager.task_cache) {
+        task_manager.task_cache = kmem_cache_create("task", sizeof(task_t), 0);
+        if (!task_manager.task_cache) {
+            kprint("init_task_manager: Failed to create task cache\n");
+            return -1;
+        }
+    }
+
+    if (!task_manager.id_buckets) {
+        task_manager.id_buckets =
+            (task_t **)kmalloc(TASK_ID_HASH_INITIAL_BUCKETS * sizeof(task_t *));
+        if (!task_manager.id_buckets) {
+            kprint("init_task_manager: Failed to allocate task ID table\n");
+            return -1;
+        }
+        task_manager.id_bucket_count = TASK_ID_HASH_INITIAL_BUCKETS;
+    }
+
+    /* Clear the ID table (it keeps any size it grew to) */
+    for (uint32_t i = 0; i < task_manager.id_bucket_count; i++) {
+        task_manager.id_buckets[i] = NULL;
+    }
+
+    task_manager.all_tasks = NULL;
+    task_manager.exited_tasks = NULL;
+    task_manager.free_id_count = 0;
     task_manager.num_tasks = 0;
     task_manager.next_task_id = 1;
     task_manager.total_context_switches = 0;
     task_manager.total_yields = 0;
     task_manager.tasks_created = 0;
     task_manager.tasks_terminated = 0;
-
-    /* Clear task pool */
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        task_manager.tasks[i].task_id = INVALID_TASK_ID;
-        task_manager.tasks[i].state = TASK_STATE_INVALID;
-        task_manager.tasks[i].process_id = INVALID_PROCESS_ID;
-        task_manager.tasks[i].total_runtime = 0;
-        task_manager.tasks[i].yield_count = 0;
-        task_manager.tasks[i].last_run_timestamp = 0;
-        task_manager.tasks[i].waiting_on_task_id = INVALID_TASK_ID;
-        task_manager.tasks[i].time_slice_remaining = 0;
-    }
+    task_manager.ids_recycled = 0;
+    task_manager.id_table_grows = 0;
 
     return 0;
 }
@@ -525,6 +770,22 @@ void get_task_stats(uint32_t *total_tasks, uint32_t *active_tasks,
     }
 }
 
+/*
+ * Get task table statistics
+ */
+void get_task_table_stats(uint32_t *id_buckets, uint32_t *ids_recycled,
+                          uint32_t *table_grows) {
+    if (id_buckets) {
+        *id_buckets = task_manager.id_bucket_count;
+    }
+    if (ids_recycled) {
+        *ids_recycled = task_manager.ids_recycled;
+    }
+    if (table_grows) {
+        *table_grows = task_manager.id_table_grows;
+    }
+}
+
 /*
  * Record scheduler context switch information
  */
@@ -542,7 +803,7 @@ void task_record_context_switch(task_t *from, task_t *to, uint64_t timestamp) {
     }
 
     if (to && to != from) {
-        task_manager.total_context_switches++;
+        __atomic_fetch_add(&task_manager.total_context_switches, 1, __ATOMIC_RELAXED);
     }
 }
 
@@ -550,7 +811,7 @@ void task_record_context_switch(task_t *from, task_t *to, uint64_t timestamp) {
  * Record voluntary yield for task statistics
  */
 void task_record_yield(task_t *task) {
-    task_manager.total_yields++;
+    __atomic_fetch_add(&task_manager.total_yields, 1, __ATOMIC_RELAXED);
 
     if (task) {
         task->yield_count++;
@@ -592,9 +853,7 @@ void task_iterate_active(task_iterate_cb callback, void *context) {
         return;
     }
 
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        task_t *task = &task_manager.tasks[i];
-
+    for (task_t *task = task_manager.all_tasks; task; task = task->all_next) {
         if (task->state == TASK_STATE_INVALID || task->task_id == INVALID_TASK_ID) {
             continue;
         }
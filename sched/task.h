@@ -10,12 +10,12 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "../boot/constants.h"
+#include "timer.h"
 
 /* ========================================================================
  * TASK CONSTANTS
  * ======================================================================== */
 
-#define MAX_TASKS                     32        /* Maximum number of tasks */
 #define TASK_STACK_SIZE               0x8000    /* 32KB default stack size */
 #define TASK_NAME_MAX_LEN             32        /* Maximum task name length */
 #define INVALID_TASK_ID               0xFFFFFFFF /* Invalid task ID */
@@ -38,6 +38,14 @@
 #define TASK_FLAG_KERNEL_MODE         0x02  /* Task runs in kernel mode */
 #define TASK_FLAG_NO_PREEMPT          0x04  /* Task cannot be preempted */
 #define TASK_FLAG_SYSTEM              0x08  /* System/critical task */
+#define TASK_FLAG_SMP                 0x10  /* May run on any CPU (see below) */
+
+/*
+ * TASK_FLAG_SMP tasks can be stolen by idle application processors. The
+ * task table and the allocators are still BSP-only, so such a task may
+ * only compute, yield, sleep and exit while away from the BSP; its exit
+ * is finished on the BSP
+ */
 
 /* ========================================================================
  * TASK STRUCTURES
@@ -96,6 +104,20 @@ typedef struct task {
     uint32_t yield_count;                /* Number of voluntary yields */
     uint64_t last_run_timestamp;         /* Timestamp when task was last scheduled */
     uint32_t waiting_on_task_id;         /* Task this task is waiting on, if any */
+    uint8_t queue_level;                 /* Run queue level (priority minus aging boosts) */
+    uint64_t queue_stamp;                /* Dispatch count when the task joined its level */
+    struct task *run_prev;               /* Ready queue links (owned by the scheduler) */
+    struct task *run_next;
+    uint8_t cpu;                         /* CPU whose run queue the task belongs to */
+    volatile uint8_t on_cpu;             /* Context still live on a CPU, not yet saved */
+
+    /* Task table links */
+    struct task *id_next;                /* Next task in the same ID hash bucket */
+    struct task *all_prev;               /* List of live tasks */
+    struct task *all_next;
+    struct task *waiters;                /* Tasks blocked in task_wait_for on this task */
+    struct task *next_waiter;            /* Next task waiting on the same task */
+    ktimer_t sleep_timer;                /* Wakeup for task_sleep_until */
 
 } task_t;
 
@@ -114,9 +136,11 @@ void task_iterate_active(task_iterate_cb callback, void *context);
  * Task state helpers for scheduler coordination
  */
 uint8_t task_get_state(const task_t *task);
+int task_update_state(task_t *task, uint8_t new_state);
 bool task_is_ready(const task_t *task);
 bool task_is_running(const task_t *task);
 bool task_is_blocked(const task_t *task);
 bool task_is_terminated(const task_t *task);
+int task_add_waiter(task_t *target, task_t *waiter);
 
 #endif /* SCHED_TASK_H */
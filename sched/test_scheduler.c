@@ -0,0 +1,798 @@
+/*
+ * SlopOS Scheduler Run Queue Regression Tests
+ * Tests for priority selection, wakeup latency under load and aging of
+ * starved tasks. Queues are driven directly with placeholder task blocks,
+ * so the tests run before the scheduler starts. Also covers the dynamic
+ * task table and the timer wheel (including cancels from callbacks), and
+ * measures CPU-bound throughput across the application processors
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../boot/constants.h"
+#include "../drivers/serial.h"
+#include "../lib/cpu.h"
+#include "../drivers/smp.h"
+#include "scheduler.h"
+#include "timer.h"
+
+/* Busy LOW tasks queued ahead of the HIGH wakeup */
+#define SCHED_BENCH_LOW_TASKS         24
+#define SCHED_BENCH_WAKEUPS           64
+#define SCHED_BENCH_TICKS_PER_SLICE   10   /* Default time slice in timer ticks */
+
+/* Dispatches allowed before a starved LOW task must have run */
+#define SCHED_AGING_BOUND             256
+
+/* CPU-bound work items and the rounds of the mixing loop in each */
+#define SMP_BENCH_ITEMS               64
+#define SMP_BENCH_ROUNDS              200000
+
+/* Tasks created by the task table test, well past the old 32-slot pool */
+#define TASK_TABLE_TEST_TASKS         96
+
+/* Timers armed by the wheel test, spread over every wheel level */
+#define TIMER_TEST_TIMERS             192
+#define TIMER_TEST_START_TICK         1000003ULL
+#define TIMER_NEXT_TEST_TIMERS        48   /* Timers checked by the next-expiry test */
+#define TIMER_CANCEL_TEST_TIMERS      8    /* Timers sharing a tick in the cancel test */
+
+static task_t sched_bench_tasks[SCHED_BENCH_LOW_TASKS + 1];
+static uint64_t smp_bench_results[SMP_BENCH_ITEMS];
+
+typedef struct timer_test_entry {
+    ktimer_t timer;
+    uint64_t due;                        /* Tick the timer must fire on */
+    uint64_t fired_at;
+    uint32_t fire_count;
+} timer_test_entry_t;
+
+static timer_wheel_t timer_test_wheel;
+static timer_test_entry_t timer_test_entries[TIMER_TEST_TIMERS];
+static timer_test_entry_t timer_test_far;
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+static void sched_bench_init_task(task_t *task, uint32_t task_id, uint8_t priority) {
+    task->task_id = task_id;
+    task->state = TASK_STATE_READY;
+    task->priority = priority;
+    task->flags = TASK_FLAG_KERNEL_MODE;
+    task->time_slice = SCHED_BENCH_TICKS_PER_SLICE;
+    task->time_slice_remaining = SCHED_BENCH_TICKS_PER_SLICE;
+    task->queue_level = priority;
+    task->queue_stamp = 0;
+}
+
+/* Empty the run queues of everything the test queued */
+static void sched_bench_drain(void) {
+    while (scheduler_dequeue_next()) {
+    }
+}
+
+/*
+ * Queue the LOW tasks, then wake the HIGH task SCHED_BENCH_WAKEUPS times.
+ * Each dispatch of a LOW task stands for one expired time slice, after
+ * which it goes back to the tail of its queue; a full round of LOW slices
+ * runs between wakeups while the HIGH task is blocked. Returns the worst
+ * number of slices the HIGH task waited, -1 on failure; cycles gets the
+ * total cost of the queue operations from wakeup to dispatch
+ */
+static int sched_bench_run(uint8_t policy, uint64_t *cycles) {
+    if (scheduler_set_policy(policy) != 0) {
+        kprint("SCHED_TEST: Run queues not empty, cannot switch policy\n");
+        return -1;
+    }
+
+    task_t *high = &sched_bench_tasks[SCHED_BENCH_LOW_TASKS];
+    sched_bench_init_task(high, 0x1000, TASK_PRIORITY_HIGH);
+    for (uint32_t i = 0; i < SCHED_BENCH_LOW_TASKS; i++) {
+        sched_bench_init_task(&sched_bench_tasks[i], 0x1001 + i, TASK_PRIORITY_LOW);
+        if (schedule_task(&sched_bench_tasks[i]) != 0) {
+            sched_bench_drain();
+            return -1;
+        }
+    }
+
+    int worst = 0;
+    *cycles = 0;
+    for (uint32_t wake = 0; wake < SCHED_BENCH_WAKEUPS; wake++) {
+        for (uint32_t slice = 0; slice < SCHED_BENCH_LOW_TASKS; slice++) {
+            schedule_task(scheduler_dequeue_next());
+        }
+
+        uint64_t start = cpu_read_tsc();
+        if (schedule_task(high) != 0) {
+            worst = -1;
+            break;
+        }
+
+        int waited = 0;
+        task_t *next = scheduler_dequeue_next();
+        while (next && next != high) {
+            schedule_task(next);
+            next = scheduler_dequeue_next();
+            waited++;
+        }
+        *cycles += cpu_read_tsc() - start;
+
+        if (!next) {
+            kprint("SCHED_TEST: HIGH task lost from the run queues\n");
+            worst = -1;
+            break;
+        }
+        if (waited > worst) {
+            worst = waited;
+        }
+    }
+
+    sched_bench_drain();
+    return worst;
+}
+
+/* Entry point for task table test tasks; they are never run */
+static void task_table_test_entry(void *arg) {
+    (void)arg;
+}
+
+/* One CPU-bound work item; touches nothing but its own result slot */
+static void smp_bench_item(uint32_t item, void *arg) {
+    (void)arg;
+    uint64_t x = 0x9E3779B97F4A7C15ULL ^ item;
+    for (uint32_t round = 0; round < SMP_BENCH_ROUNDS; round++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    smp_bench_results[item] = x;
+}
+
+/* ========================================================================
+ * SCHEDULER RUN QUEUE TESTS
+ * ======================================================================== */
+
+/*
+ * Test: A woken HIGH task runs ahead of busy LOW tasks
+ * With one FIFO the wakeup waits behind every LOW task; with priority
+ * queues it must be dispatched next. Reports wakeup-to-run latency in
+ * time slices (and timer ticks) for both policies
+ */
+int test_sched_priority_wakeup_benchmark(void) {
+    kprint("SCHED_TEST: Starting HIGH wakeup latency benchmark\n");
+
+    uint8_t saved_policy = scheduler_get_policy();
+    uint64_t fifo_cycles = 0;
+    uint64_t prio_cycles = 0;
+
+    int fifo_worst = sched_bench_run(SCHED_POLICY_ROUND_ROBIN, &fifo_cycles);
+    int prio_worst = sched_bench_run(SCHED_POLICY_PRIORITY, &prio_cycles);
+    scheduler_set_policy(saved_policy);
+
+    if (fifo_worst < 0 || prio_worst < 0) {
+        kprint("SCHED_TEST: Benchmark could not queue its tasks\n");
+        return -1;
+    }
+
+    kprint("SCHED_TEST:   HIGH wakeup behind ");
+    kprint_decimal(SCHED_BENCH_LOW_TASKS);
+    kprint(" LOW tasks: FIFO waits ");
+    kprint_decimal((uint64_t)fifo_worst * SCHED_BENCH_TICKS_PER_SLICE);
+    kprint(" ticks, priority waits ");
+    kprint_decimal((uint64_t)prio_worst * SCHED_BENCH_TICKS_PER_SLICE);
+    kprint(" ticks (");
+    kprint_decimal(fifo_cycles / SCHED_BENCH_WAKEUPS);
+    kprint("/");
+    kprint_decimal(prio_cycles / SCHED_BENCH_WAKEUPS);
+    kprint(" queue cycles per wakeup)\n");
+
+    if (prio_worst != 0) {
+        kprint("SCHED_TEST: FAILED - HIGH task waited behind LOW tasks\n");
+        return -1;
+    }
+
+    kprint("SCHED_TEST: HIGH wakeup latency benchmark PASSED\n");
+    return 0;
+}
+
+/*
+ * Test: Aging keeps LOW tasks from starving
+ * A HIGH task that is always ready would otherwise win every dispatch;
+ * every LOW task must still be dispatched within a bounded number of
+ * dispatches, and the boosts must show up in the statistics
+ */
+int test_sched_priority_aging(void) {
+    kprint("SCHED_TEST: Starting priority aging test\n");
+
+    uint8_t saved_policy = scheduler_get_policy();
+    if (scheduler_set_policy(SCHED_POLICY_PRIORITY) != 0) {
+        kprint("SCHED_TEST: Run queues not empty, cannot switch policy\n");
+        return -1;
+    }
+
+    const uint32_t low_tasks = 4;
+    task_t *high = &sched_bench_tasks[SCHED_BENCH_LOW_TASKS];
+    sched_bench_init_task(high, 0x2000, TASK_PRIORITY_HIGH);
+    schedule_task(high);
+    for (uint32_t i = 0; i < low_tasks; i++) {
+        sched_bench_init_task(&sched_bench_tasks[i], 0x2001 + i, TASK_PRIORITY_LOW);
+        schedule_task(&sched_bench_tasks[i]);
+    }
+
+    uint64_t boosts_before = 0;
+    uint64_t boosts_after = 0;
+    get_scheduler_priority_stats(&boosts_before, NULL);
+
+    /* Dispatch until every LOW task ran once; the HIGH task always requeues */
+    uint32_t ran = 0;
+    uint32_t dispatches = 0;
+    while (ran != (1U << low_tasks) - 1 && dispatches < SCHED_AGING_BOUND) {
+        task_t *next = scheduler_dequeue_next();
+        if (!next) {
+            break;
+        }
+        dispatches++;
+        if (next != high) {
+            ran |= 1U << (uint32_t)(next - sched_bench_tasks);
+            continue;  /* LOW tasks finish after one slice */
+        }
+        schedule_task(high);
+    }
+
+    get_scheduler_priority_stats(&boosts_after, NULL);
+    sched_bench_drain();
+    scheduler_set_policy(saved_policy);
+
+    if (ran != (1U << low_tasks) - 1) {
+        kprint("SCHED_TEST: FAILED - LOW tasks starved for ");
+        kprint_decimal(dispatches);
+        kprint(" dispatches\n");
+        return -1;
+    }
+
+    if (boosts_after == boosts_before) {
+        kprint("SCHED_TEST: FAILED - LOW tasks ran without aging boosts\n");
+        return -1;
+    }
+
+    kprint("SCHED_TEST: PASSED - ");
+    kprint_decimal(low_tasks);
+    kprint(" LOW tasks ran within ");
+    kprint_decimal(dispatches);
+    kprint(" dispatches\n");
+    return 0;
+}
+
+/*
+ * Test: The task table grows past the old fixed pool
+ * Creates and queues TASK_TABLE_TEST_TASKS tasks, looks every one up by
+ * ID, terminates every other task while it is still queued and checks the
+ * freed IDs are handed out again. Reports the average lookup cost
+ */
+int test_task_table_scaling(void) {
+    kprint("SCHED_TEST: Starting task table scaling test\n");
+
+    if (init_task_manager() != 0) {
+        kprint("SCHED_TEST: FAILED - task manager init\n");
+        return -1;
+    }
+
+    static uint32_t ids[TASK_TABLE_TEST_TASKS];
+    uint32_t created = 0;
+    uint32_t max_id = 0;
+    int result = 0;
+
+    for (; created < TASK_TABLE_TEST_TASKS; created++) {
+        ids[created] = task_create("tbl", task_table_test_entry, NULL,
+                                   TASK_PRIORITY_NORMAL, TASK_FLAG_KERNEL_MODE);
+        if (ids[created] == INVALID_TASK_ID) {
+            kprint("SCHED_TEST: FAILED - task_create stopped at ");
+            kprint_decimal(created);
+            kprint(" tasks\n");
+            result = -1;
+            break;
+        }
+        if (ids[created] > max_id) {
+            max_id = ids[created];
+        }
+
+        task_t *task = NULL;
+        if (task_get_info(ids[created], &task) != 0 || schedule_task(task) != 0) {
+            kprint("SCHED_TEST: FAILED - could not queue created task\n");
+            created++;
+            result = -1;
+            break;
+        }
+    }
+
+    uint64_t lookup_cycles = 0;
+    if (result == 0) {
+        uint64_t start = cpu_read_tsc();
+        for (uint32_t i = 0; i < created; i++) {
+            task_t *task = NULL;
+            if (task_get_info(ids[i], &task) != 0 || task->task_id != ids[i]) {
+                kprint("SCHED_TEST: FAILED - lookup returned the wrong task\n");
+                result = -1;
+                break;
+            }
+        }
+        lookup_cycles = cpu_read_tsc() - start;
+    }
+
+    /* Terminate every other task straight out of the ready queue */
+    uint32_t recycled_before = 0;
+    get_task_table_stats(NULL, &recycled_before, NULL);
+    for (uint32_t i = 0; i < created; i += 2) {
+        if (task_terminate(ids[i]) != 0) {
+            result = -1;
+        }
+        ids[i] = INVALID_TASK_ID;
+    }
+
+    uint32_t queued = 0;
+    while (scheduler_dequeue_next()) {
+        queued++;
+    }
+    if (result == 0 && queued != created / 2) {
+        kprint("SCHED_TEST: FAILED - ready queue holds ");
+        kprint_decimal(queued);
+        kprint(" tasks after termination\n");
+        result = -1;
+    }
+
+    /* Fresh tasks must reuse the released IDs */
+    for (uint32_t i = 0; i < created && result == 0; i += 2) {
+        ids[i] = task_create("tbl", task_table_test_entry, NULL,
+                             TASK_PRIORITY_NORMAL, TASK_FLAG_KERNEL_MODE);
+        if (ids[i] == INVALID_TASK_ID || ids[i] > max_id) {
+            kprint("SCHED_TEST: FAILED - task ID was not recycled\n");
+            result = -1;
+        }
+    }
+
+    uint32_t buckets = 0;
+    uint32_t recycled_after = 0;
+    uint32_t grows = 0;
+    get_task_table_stats(&buckets, &recycled_after, &grows);
+
+    for (uint32_t i = 0; i < created; i++) {
+        if (ids[i] != INVALID_TASK_ID && task_terminate(ids[i]) != 0) {
+            result = -1;
+        }
+    }
+
+    uint32_t active = 0;
+    get_task_stats(NULL, &active, NULL);
+    if (active != 0) {
+        kprint("SCHED_TEST: FAILED - ");
+        kprint_decimal(active);
+        kprint(" tasks left behind\n");
+        result = -1;
+    }
+
+    if (result == 0) {
+        kprint("SCHED_TEST: PASSED - ");
+        kprint_decimal(created);
+        kprint(" tasks, ");
+        kprint_decimal(recycled_after - recycled_before);
+        kprint(" IDs recycled, ");
+        kprint_decimal(buckets);
+        kprint(" buckets after ");
+        kprint_decimal(grows);
+        kprint(" grows, ");
+        kprint_decimal(created ? lookup_cycles / created : 0);
+        kprint(" cycles per lookup\n");
+    }
+    return result;
+}
+
+/*
+ * Test: CPU-bound throughput scales across online CPUs
+ * Runs the same batch of work items on 1, 2, 4 and 8 CPUs (as many as are
+ * online), each CPU pulling the next free item as soon as it is done. Every
+ * run must compute exactly the single-CPU results; cycles and speedup over
+ * one CPU are reported for each width
+ */
+int test_smp_throughput_benchmark(void) {
+    kprint("SCHED_TEST: Starting SMP throughput benchmark\n");
+
+    uint32_t online = smp_online_count();
+    uint64_t expected[SMP_BENCH_ITEMS];
+    uint64_t single_cycles = 0;
+
+    for (uint32_t width = 1; width <= 8 && width <= online; width *= 2) {
+        uint32_t per_cpu[SMP_MAX_CPUS];
+        for (uint32_t i = 0; i < SMP_BENCH_ITEMS; i++) {
+            smp_bench_results[i] = 0;
+        }
+
+        uint64_t start = cpu_read_tsc();
+        int used = smp_parallel_for(SMP_BENCH_ITEMS, width, smp_bench_item, NULL, per_cpu);
+        uint64_t cycles = cpu_read_tsc() - start;
+
+        if (used != (int)width) {
+            kprint("SCHED_TEST: FAILED - only ");
+            kprint_decimal(used < 0 ? 0 : (uint64_t)used);
+            kprint(" of ");
+            kprint_decimal(width);
+            kprint(" CPUs took work\n");
+            return -1;
+        }
+
+        uint32_t ran = 0;
+        for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+            ran += per_cpu[i];
+        }
+        if (ran != SMP_BENCH_ITEMS) {
+            kprint("SCHED_TEST: FAILED - work items ran ");
+            kprint_decimal(ran);
+            kprint(" times\n");
+            return -1;
+        }
+
+        for (uint32_t i = 0; i < SMP_BENCH_ITEMS; i++) {
+            if (width == 1) {
+                expected[i] = smp_bench_results[i];
+            } else if (smp_bench_results[i] != expected[i]) {
+                kprint("SCHED_TEST: FAILED - work item result differs across CPUs\n");
+                return -1;
+            }
+        }
+
+        if (width == 1) {
+            single_cycles = cycles;
+        }
+
+        kprint("SCHED_TEST:   ");
+        kprint_decimal(width);
+        kprint(" CPU(s): ");
+        kprint_decimal(cycles);
+        kprint(" cycles for ");
+        kprint_decimal(SMP_BENCH_ITEMS);
+        uint64_t speedup = cycles ? (single_cycles * 100) / cycles : 0;
+        kprint(" items, speedup ");
+        kprint_decimal(speedup / 100);
+        kprint(speedup % 100 < 10 ? ".0" : ".");
+        kprint_decimal(speedup % 100);
+        kprint("x, BSP ran ");
+        kprint_decimal(per_cpu[0]);
+        kprint("\n");
+    }
+
+    kprint("SCHED_TEST: SMP throughput benchmark PASSED with ");
+    kprint_decimal(online);
+    kprint(" CPU(s) online\n");
+    return 0;
+}
+
+static void timer_test_fire(void *arg) {
+    timer_test_entry_t *entry = (timer_test_entry_t *)arg;
+    entry->fired_at = timer_test_wheel.clock - 1;
+    entry->fire_count++;
+}
+
+/*
+ * Delta for the i-th test timer: level 0, 1, 2 and 3 in turn, a few
+ * already overdue. Deterministic so every run checks the same layout
+ */
+static int64_t timer_test_delta(uint32_t i) {
+    uint64_t mix = (uint64_t)(i + 1) * 2654435761ULL;
+    switch (i % 5) {
+        case 0:  return (int64_t)(mix % 64);
+        case 1:  return (int64_t)(64 + mix % (4096 - 64));
+        case 2:  return (int64_t)(4096 + mix % (262144 - 4096));
+        case 3:  return (int64_t)(262144 + mix % 65536);
+        default: return -(int64_t)(mix % 32) - 1;
+    }
+}
+
+/*
+ * Test: timer wheel fires every timer exactly on its tick
+ * Arms timers on all four levels plus overdue ones, cancels one, parks one
+ * beyond the wheel range, then advances tick by tick across several
+ * cascades. Reports insert and per-tick cost in cycles
+ */
+int test_timer_wheel(void) {
+    kprint("SCHED_TEST: Starting timer wheel test\n");
+
+    timer_wheel_t *wheel = &timer_test_wheel;
+    timer_wheel_init(wheel, TIMER_TEST_START_TICK);
+
+    uint64_t last_due = TIMER_TEST_START_TICK;
+    uint64_t insert_cycles = 0;
+    for (uint32_t i = 0; i < TIMER_TEST_TIMERS; i++) {
+        timer_test_entry_t *entry = &timer_test_entries[i];
+        uint64_t expires = (uint64_t)((int64_t)TIMER_TEST_START_TICK + timer_test_delta(i));
+
+        entry->due = expires < TIMER_TEST_START_TICK ? TIMER_TEST_START_TICK : expires;
+        entry->fired_at = 0;
+        entry->fire_count = 0;
+        if (entry->due > last_due) {
+            last_due = entry->due;
+        }
+
+        ktimer_init(&entry->timer, timer_test_fire, entry);
+        uint64_t start = cpu_read_tsc();
+        int added = ktimer_add(wheel, &entry->timer, expires);
+        insert_cycles += cpu_read_tsc() - start;
+        if (added != 0) {
+            kprint("SCHED_TEST: FAILED - could not arm timer\n");
+            return -1;
+        }
+    }
+
+    if (ktimer_add(wheel, &timer_test_entries[0].timer, TIMER_TEST_START_TICK) == 0) {
+        kprint("SCHED_TEST: FAILED - armed a pending timer twice\n");
+        return -1;
+    }
+
+    /* Cancelled timers must never fire */
+    timer_test_entry_t *cancelled = &timer_test_entries[TIMER_TEST_TIMERS / 2];
+    if (ktimer_cancel(wheel, &cancelled->timer) != 0 || ktimer_pending(&cancelled->timer)) {
+        kprint("SCHED_TEST: FAILED - cancel did not disarm timer\n");
+        return -1;
+    }
+
+    timer_test_far.fire_count = 0;
+    ktimer_init(&timer_test_far.timer, timer_test_fire, &timer_test_far);
+    ktimer_add(wheel, &timer_test_far.timer, TIMER_TEST_START_TICK + TIMER_WHEEL_MAX_DELTA * 2);
+
+    uint64_t fired = 0;
+    uint64_t ticks = last_due - TIMER_TEST_START_TICK + 1;
+    uint64_t advance_start = cpu_read_tsc();
+    for (uint64_t tick = TIMER_TEST_START_TICK; tick <= last_due; tick++) {
+        fired += timer_wheel_advance(wheel, tick);
+    }
+    uint64_t advance_cycles = cpu_read_tsc() - advance_start;
+
+    int result = 0;
+    for (uint32_t i = 0; i < TIMER_TEST_TIMERS; i++) {
+        timer_test_entry_t *entry = &timer_test_entries[i];
+        uint32_t want = entry == cancelled ? 0 : 1;
+        if (entry->fire_count != want || (want && entry->fired_at != entry->due)) {
+            kprint("SCHED_TEST: FAILED - timer due at ");
+            kprint_decimal(entry->due);
+            kprint(" fired ");
+            kprint_decimal(entry->fire_count);
+            kprint(" times, last at ");
+            kprint_decimal(entry->fired_at);
+            kprint("\n");
+            result = -1;
+        }
+    }
+
+    if (timer_test_far.fire_count != 0 || !ktimer_pending(&timer_test_far.timer) ||
+        wheel->pending != 1) {
+        kprint("SCHED_TEST: FAILED - timer beyond the wheel range fired early\n");
+        result = -1;
+    }
+    ktimer_cancel(wheel, &timer_test_far.timer);
+
+    if (result == 0) {
+        kprint("SCHED_TEST: PASSED - ");
+        kprint_decimal(fired);
+        kprint(" timers fired on time, ");
+        kprint_decimal(wheel->cascaded);
+        kprint(" cascaded, ");
+        kprint_decimal(insert_cycles / TIMER_TEST_TIMERS);
+        kprint(" cycles per insert, ");
+        kprint_decimal(advance_cycles / ticks);
+        kprint(" cycles per tick over ");
+        kprint_decimal(ticks);
+        kprint(" ticks\n");
+    }
+    return result;
+}
+
+/*
+ * Test: next expiry matches the earliest pending timer
+ * Tickless idle sleeps until timer_wheel_next_expiry(), so it must never
+ * be later than a pending timer. Arms timers across all levels, then jumps
+ * the wheel from one reported expiry to the next, checking each against a
+ * scan of every timer and that the wheel is empty at the end
+ */
+int test_timer_wheel_next_expiry(void) {
+    kprint("SCHED_TEST: Starting timer wheel next expiry test\n");
+
+    timer_wheel_t *wheel = &timer_test_wheel;
+    timer_wheel_init(wheel, TIMER_TEST_START_TICK);
+
+    uint64_t expires = 0;
+    if (timer_wheel_next_expiry(wheel, &expires) == 0) {
+        kprint("SCHED_TEST: FAILED - empty wheel reported an expiry\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < TIMER_NEXT_TEST_TIMERS; i++) {
+        timer_test_entry_t *entry = &timer_test_entries[i];
+        int64_t delta = timer_test_delta(i * 7 + 3);
+        uint64_t due = (uint64_t)((int64_t)TIMER_TEST_START_TICK + delta);
+
+        entry->due = due < TIMER_TEST_START_TICK ? TIMER_TEST_START_TICK : due;
+        entry->fired_at = 0;
+        entry->fire_count = 0;
+        ktimer_init(&entry->timer, timer_test_fire, entry);
+        ktimer_add(wheel, &entry->timer, due);
+    }
+
+    uint32_t jumps = 0;
+    while (timer_wheel_next_expiry(wheel, &expires) == 0) {
+        uint64_t earliest = UINT64_MAX;
+        for (uint32_t i = 0; i < TIMER_NEXT_TEST_TIMERS; i++) {
+            timer_test_entry_t *entry = &timer_test_entries[i];
+            if (ktimer_pending(&entry->timer) && entry->due < earliest) {
+                earliest = entry->due;
+            }
+        }
+
+        if (expires != earliest) {
+            kprint("SCHED_TEST: FAILED - next expiry ");
+            kprint_decimal(expires);
+            kprint(", earliest timer due at ");
+            kprint_decimal(earliest);
+            kprint("\n");
+            return -1;
+        }
+
+        timer_wheel_advance(wheel, expires);
+        jumps++;
+    }
+
+    for (uint32_t i = 0; i < TIMER_NEXT_TEST_TIMERS; i++) {
+        timer_test_entry_t *entry = &timer_test_entries[i];
+        if (entry->fire_count != 1 || entry->fired_at != entry->due) {
+            kprint("SCHED_TEST: FAILED - timer missed its expiry after a jump\n");
+            return -1;
+        }
+    }
+
+    kprint("SCHED_TEST: PASSED - ");
+    kprint_decimal(TIMER_NEXT_TEST_TIMERS);
+    kprint(" timers expired in ");
+    kprint_decimal(jumps);
+    kprint(" jumps between reported expiries\n");
+    return 0;
+}
+
+/* Cancels every other timer of the cancel test, all due on the same tick */
+static void timer_test_cancel_siblings(void *arg) {
+    timer_test_entry_t *entry = (timer_test_entry_t *)arg;
+    entry->fired_at = timer_test_wheel.clock - 1;
+    entry->fire_count++;
+
+    for (uint32_t i = 0; i < TIMER_CANCEL_TEST_TIMERS; i++) {
+        if (&timer_test_entries[i] != entry) {
+            ktimer_cancel(&timer_test_wheel, &timer_test_entries[i].timer);
+        }
+    }
+}
+
+/*
+ * Test: a callback can cancel timers that expire on the same tick
+ * Whichever timer fires first cancels the rest, so exactly one may run,
+ * and the wheel must stay consistent enough to fire a timer armed after
+ */
+int test_timer_wheel_callback_cancel(void) {
+    kprint("SCHED_TEST: Starting timer wheel callback cancel test\n");
+
+    timer_wheel_t *wheel = &timer_test_wheel;
+    timer_wheel_init(wheel, TIMER_TEST_START_TICK);
+
+    uint64_t due = TIMER_TEST_START_TICK + 5;
+    for (uint32_t i = 0; i < TIMER_CANCEL_TEST_TIMERS; i++) {
+        timer_test_entry_t *entry = &timer_test_entries[i];
+        entry->due = due;
+        entry->fired_at = 0;
+        entry->fire_count = 0;
+        ktimer_init(&entry->timer, timer_test_cancel_siblings, entry);
+        ktimer_add(wheel, &entry->timer, due);
+    }
+
+    uint32_t fired = timer_wheel_advance(wheel, due);
+    uint32_t fire_count = 0;
+    for (uint32_t i = 0; i < TIMER_CANCEL_TEST_TIMERS; i++) {
+        fire_count += timer_test_entries[i].fire_count;
+        if (ktimer_pending(&timer_test_entries[i].timer)) {
+            kprint("SCHED_TEST: FAILED - cancelled sibling still pending\n");
+            return -1;
+        }
+    }
+
+    if (fired != 1 || fire_count != 1 || wheel->pending != 0) {
+        kprint("SCHED_TEST: FAILED - ");
+        kprint_decimal(fire_count);
+        kprint(" callbacks ran, ");
+        kprint_decimal(wheel->pending);
+        kprint(" timers left pending\n");
+        return -1;
+    }
+
+    timer_test_entry_t *after = &timer_test_entries[0];
+    after->due = due + 1;
+    after->fire_count = 0;
+    ktimer_init(&after->timer, timer_test_fire, after);
+    ktimer_add(wheel, &after->timer, after->due);
+    timer_wheel_advance(wheel, after->due);
+    if (after->fire_count != 1 || after->fired_at != after->due || wheel->pending != 0) {
+        kprint("SCHED_TEST: FAILED - timer armed after the cancels did not fire on time\n");
+        return -1;
+    }
+
+    kprint("SCHED_TEST: PASSED - callback cancelled ");
+    kprint_decimal(TIMER_CANCEL_TEST_TIMERS - 1);
+    kprint(" timers due on its own tick\n");
+    return 0;
+}
+
+/* ========================================================================
+ * TEST SUITE RUNNER
+ * ======================================================================== */
+
+/*
+ * Run all scheduler run queue tests
+ * Returns number of passed tests
+ */
+int run_sched_queue_tests(void) {
+    kprint("SCHED_TEST: Running scheduler run queue tests\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_sched_priority_wakeup_benchmark() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_sched_priority_wakeup_benchmark FAILED\n");
+    }
+
+    total++;
+    if (test_sched_priority_aging() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_sched_priority_aging FAILED\n");
+    }
+
+    total++;
+    if (test_task_table_scaling() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_task_table_scaling FAILED\n");
+    }
+
+    total++;
+    if (test_timer_wheel() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_timer_wheel FAILED\n");
+    }
+
+    total++;
+    if (test_timer_wheel_next_expiry() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_timer_wheel_next_expiry FAILED\n");
+    }
+
+    total++;
+    if (test_timer_wheel_callback_cancel() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_timer_wheel_callback_cancel FAILED\n");
+    }
+
+    total++;
+    if (test_smp_throughput_benchmark() == 0) {
+        passed++;
+    } else {
+        kprint("SCHED_TEST: test_smp_throughput_benchmark FAILED\n");
+    }
+
+    kprint("SCHED_TEST: Completed ");
+    kprint_decimal(total);
+    kprint(" tests, ");
+    kprint_decimal(passed);
+    kprint(" passed\n");
+
+    return passed;
+}
@@ -540,25 +540,55 @@ void print_scheduler_stats(void) {
                                    uint32_t *ready_tasks, uint32_t *schedule_calls);
     extern void get_task_stats(uint32_t *total_tasks, uint32_t *active_tasks,
                               uint64_t *context_switches);
+    extern void get_scheduler_cr3_stats(uint64_t *cr3_writes, uint64_t *cr3_writes_skipped);
+    extern void get_scheduler_sleep_stats(uint64_t *task_sleeps, uint64_t *timers_fired);
+    extern void get_scheduler_idle_stats(uint64_t *idle_cycles, uint64_t *total_cycles,
+                                         uint64_t *wakeups, uint64_t *ticks_skipped);
 
     uint64_t sched_switches, sched_yields;
     uint32_t ready_tasks, schedule_calls;
     uint32_t total_tasks, active_tasks;
     uint64_t task_switches;
     uint64_t task_yields = task_get_total_yields();
+    uint64_t cr3_writes, cr3_writes_skipped;
+    uint64_t task_sleeps, timers_fired;
+    uint64_t idle_cycles, total_cycles, idle_wakeups, ticks_skipped;
 
     get_scheduler_stats(&sched_switches, &sched_yields, &ready_tasks, &schedule_calls);
     get_task_stats(&total_tasks, &active_tasks, &task_switches);
+    get_scheduler_cr3_stats(&cr3_writes, &cr3_writes_skipped);
+    get_scheduler_sleep_stats(&task_sleeps, &timers_fired);
+    get_scheduler_idle_stats(&idle_cycles, &total_cycles, &idle_wakeups, &ticks_skipped);
 
     kprint("\n=== Scheduler Statistics ===\n");
     kprint("Context switches: ");
     kprint_decimal(sched_switches);
     kprint("\n");
 
+    kprint("CR3 writes on switch: ");
+    kprint_decimal(cr3_writes);
+    kprint(" (skipped ");
+    kprint_decimal(cr3_writes_skipped);
+    kprint(")\n");
+
     kprint("Voluntary yields: ");
     kprint_decimal(sched_yields);
     kprint("\n");
 
+    kprint("Timed sleeps: ");
+    kprint_decimal(task_sleeps);
+    kprint(" (timers fired ");
+    kprint_decimal(timers_fired);
+    kprint(")\n");
+
+    kprint("Idle residency: ");
+    kprint_decimal(total_cycles ? (idle_cycles * 100) / total_cycles : 0);
+    kprint("% (");
+    kprint_decimal(idle_wakeups);
+    kprint(" wakeups, ");
+    kprint_decimal(ticks_skipped);
+    kprint(" ticks skipped)\n");
+
     kprint("Schedule calls: ");
     kprint_decimal(schedule_calls);
     kprint("\n");
@@ -0,0 +1,346 @@
+/*
+ * SlopOS Kernel Timers
+ * Hierarchical timer wheel: four levels of 64 slots, level n slots each
+ * covering 64^n ticks. Insert and cancel are O(1); each tick expires one
+ * level 0 slot and, every 64 ticks, cascades one slot of the level above
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../drivers/pit.h"
+#include "../drivers/irq.h"
+#include "../lib/spinlock.h"
+#include "scheduler.h"
+#include "timer.h"
+
+/* Tasks on any CPU add and cancel kernel timers; the BSP's tick runs them */
+static timer_wheel_t kernel_wheel;
+static spinlock_t kernel_wheel_lock = SPINLOCK_INIT;
+static int kernel_wheel_ready = 0;
+
+/* ========================================================================
+ * TIMER WHEEL
+ * ======================================================================== */
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now) {
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            wheel->slots[level][slot] = NULL;
+        }
+    }
+    wheel->expiring = NULL;
+    wheel->clock = now;
+    wheel->pending = 0;
+    wheel->fired = 0;
+    wheel->cascaded = 0;
+}
+
+void ktimer_init(ktimer_t *timer, ktimer_fn fn, void *arg) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->slot = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->pending = 0;
+}
+
+/*
+ * Pick the slot for a timer relative to the wheel clock
+ * Overdue timers go to the slot processed next; deltas beyond the wheel
+ * range are parked in the top level and re-sorted when it cascades
+ */
+static ktimer_t **timer_wheel_slot(timer_wheel_t *wheel, uint64_t expires) {
+    if (expires < wheel->clock) {
+        return &wheel->slots[0][wheel->clock & TIMER_WHEEL_MASK];
+    }
+
+    uint64_t delta = expires - wheel->clock;
+    if (delta > TIMER_WHEEL_MAX_DELTA) {
+        delta = TIMER_WHEEL_MAX_DELTA;
+        expires = wheel->clock + delta;
+    }
+
+    uint32_t level = 0;
+    while (delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    uint32_t index = (uint32_t)(expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    return &wheel->slots[level][index];
+}
+
+static void timer_wheel_link(timer_wheel_t *wheel, ktimer_t *timer) {
+    ktimer_t **slot = timer_wheel_slot(wheel, timer->expires);
+
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+}
+
+static void timer_wheel_unlink(ktimer_t *timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->slot = NULL;
+}
+
+/*
+ * Arm a timer to fire at an absolute tick
+ * Returns 0 on success, -1 if it is already pending
+ */
+int ktimer_add(timer_wheel_t *wheel, ktimer_t *timer, uint64_t expires) {
+    if (!wheel || !timer || !timer->fn || timer->pending) {
+        return -1;
+    }
+
+    timer->expires = expires;
+    timer->pending = 1;
+    timer_wheel_link(wheel, timer);
+    wheel->pending++;
+    return 0;
+}
+
+/*
+ * Disarm a pending timer
+ * Returns 0 on success, -1 if it was not pending
+ */
+int ktimer_cancel(timer_wheel_t *wheel, ktimer_t *timer) {
+    if (!wheel || !timer || !timer->pending) {
+        return -1;
+    }
+
+    timer_wheel_unlink(timer);
+    timer->pending = 0;
+    wheel->pending--;
+    return 0;
+}
+
+/*
+ * Re-sort one slot of an upper level into the levels below
+ * Returns the slot index so the caller knows whether that level wrapped
+ */
+static uint32_t timer_wheel_cascade(timer_wheel_t *wheel, uint32_t level, uint32_t index) {
+    ktimer_t *timer = wheel->slots[level][index];
+    wheel->slots[level][index] = NULL;
+
+    while (timer) {
+        ktimer_t *next = timer->next;
+        timer_wheel_link(wheel, timer);
+        wheel->cascaded++;
+        timer = next;
+    }
+    return index;
+}
+
+/*
+ * Detach the next timer due at or before now
+ * A tick's slot moves to the expiring list before its callbacks run and
+ * timers leave it one at a time, so a callback may cancel or re-arm any
+ * timer, including one due on the same tick. The returned timer is no
+ * longer pending. Returns NULL once every tick up to now is processed
+ */
+static ktimer_t *timer_wheel_expire_next(timer_wheel_t *wheel, uint64_t now) {
+    while (!wheel->expiring && wheel->clock <= now) {
+        uint32_t index = (uint32_t)(wheel->clock & TIMER_WHEEL_MASK);
+
+        /* Level 0 wrapped: pull the next slot of each wrapped level down */
+        if (index == 0) {
+            for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                uint32_t upper = (uint32_t)(wheel->clock >> (TIMER_WHEEL_BITS * level)) &
+                                 TIMER_WHEEL_MASK;
+                if (timer_wheel_cascade(wheel, level, upper) != 0) {
+                    break;
+                }
+            }
+        }
+
+        wheel->expiring = wheel->slots[0][index];
+        wheel->slots[0][index] = NULL;
+        for (ktimer_t *timer = wheel->expiring; timer; timer = timer->next) {
+            timer->slot = &wheel->expiring;
+        }
+        wheel->clock++;
+    }
+
+    ktimer_t *timer = wheel->expiring;
+    if (!timer) {
+        return NULL;
+    }
+
+    timer_wheel_unlink(timer);
+    timer->pending = 0;
+    wheel->pending--;
+    wheel->fired++;
+    return timer;
+}
+
+/*
+ * Process every tick up to and including now, running expired callbacks
+ * Callbacks may re-arm their own timer and cancel others
+ * Returns number of timers fired
+ */
+uint32_t timer_wheel_advance(timer_wheel_t *wheel, uint64_t now) {
+    uint32_t fired = 0;
+    ktimer_t *timer;
+
+    while ((timer = timer_wheel_expire_next(wheel, now)) != NULL) {
+        fired++;
+        timer->fn(timer->arg);
+    }
+
+    return fired;
+}
+
+static uint64_t timer_slot_earliest(ktimer_t *timer, uint64_t earliest) {
+    for (; timer; timer = timer->next) {
+        if (timer->expires < earliest) {
+            earliest = timer->expires;
+        }
+    }
+    return earliest;
+}
+
+/*
+ * Find the earliest tick a pending timer is due, for tickless idle
+ * Level 0 slots map to exact ticks; an upper level's current slot may hold
+ * timers for its next revolution, so the next non-empty slot after it is
+ * checked as well. Overdue timers report the wheel clock.
+ * Returns 0 and sets *expires, or -1 if no timer is pending
+ */
+int timer_wheel_next_expiry(const timer_wheel_t *wheel, uint64_t *expires) {
+    if (!wheel || !expires || wheel->pending == 0) {
+        return -1;
+    }
+
+    uint64_t earliest = timer_slot_earliest(wheel->expiring, UINT64_MAX);
+
+    for (uint32_t offset = 0; offset < TIMER_WHEEL_SLOTS; offset++) {
+        ktimer_t *timer = wheel->slots[0][(wheel->clock + offset) & TIMER_WHEEL_MASK];
+        if (timer) {
+            earliest = timer_slot_earliest(timer, earliest);
+            break;
+        }
+    }
+
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t index = (uint32_t)(wheel->clock >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+        earliest = timer_slot_earliest(wheel->slots[level][index], earliest);
+
+        for (uint32_t offset = 1; offset < TIMER_WHEEL_SLOTS; offset++) {
+            ktimer_t *timer = wheel->slots[level][(index + offset) & TIMER_WHEEL_MASK];
+            if (timer) {
+                earliest = timer_slot_earliest(timer, earliest);
+                break;
+            }
+        }
+    }
+
+    *expires = earliest < wheel->clock ? wheel->clock : earliest;
+    return 0;
+}
+
+/* ========================================================================
+ * KERNEL TIMERS
+ * ======================================================================== */
+
+void init_kernel_timers(void) {
+    uint64_t flags = spin_lock_irqsave(&kernel_wheel_lock);
+    timer_wheel_init(&kernel_wheel, irq_get_timer_ticks());
+    kernel_wheel_ready = 1;
+    spin_unlock_irqrestore(&kernel_wheel_lock, flags);
+}
+
+int kernel_timer_add(ktimer_t *timer, uint64_t expires) {
+    if (!kernel_wheel_ready) {
+        return -1;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&kernel_wheel_lock);
+    int result = ktimer_add(&kernel_wheel, timer, expires);
+    spin_unlock_irqrestore(&kernel_wheel_lock, flags);
+
+    if (result == 0) {
+        scheduler_timer_added(expires);
+    }
+    return result;
+}
+
+int kernel_timer_cancel(ktimer_t *timer) {
+    if (!kernel_wheel_ready) {
+        return -1;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&kernel_wheel_lock);
+    int result = ktimer_cancel(&kernel_wheel, timer);
+    spin_unlock_irqrestore(&kernel_wheel_lock, flags);
+    return result;
+}
+
+int kernel_timer_next_expiry(uint64_t *expires) {
+    if (!kernel_wheel_ready) {
+        return -1;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&kernel_wheel_lock);
+    int result = timer_wheel_next_expiry(&kernel_wheel, expires);
+    spin_unlock_irqrestore(&kernel_wheel_lock, flags);
+    return result;
+}
+
+/*
+ * Called from the timer tick with interrupts disabled
+ * The lock is dropped around each callback so callbacks can wake tasks and
+ * re-arm timers, and other CPUs are not held off while they run
+ */
+void kernel_timers_run(uint64_t now) {
+    if (!kernel_wheel_ready) {
+        return;
+    }
+
+    for (;;) {
+        spin_lock(&kernel_wheel_lock);
+        ktimer_t *timer = timer_wheel_expire_next(&kernel_wheel, now);
+        spin_unlock(&kernel_wheel_lock);
+
+        if (!timer) {
+            break;
+        }
+        timer->fn(timer->arg);
+    }
+}
+
+/*
+ * Convert milliseconds to timer ticks, rounding up so a sleep never ends
+ * early; any non-zero duration is at least one tick
+ */
+uint64_t kernel_timer_ms_to_ticks(uint32_t milliseconds) {
+    uint32_t frequency = pit_get_frequency();
+    if (!frequency) {
+        frequency = PIT_DEFAULT_FREQUENCY_HZ;
+    }
+    return ((uint64_t)milliseconds * frequency + 999) / 1000;
+}
+
+void get_kernel_timer_stats(uint32_t *pending, uint64_t *fired, uint64_t *cascaded) {
+    if (pending) {
+        *pending = kernel_wheel.pending;
+    }
+    if (fired) {
+        *fired = kernel_wheel.fired;
+    }
+    if (cascaded) {
+        *cascaded = kernel_wheel.cascaded;
+    }
+}
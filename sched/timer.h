@@ -0,0 +1,81 @@
+/*
+ * SlopOS Kernel Timers
+ * Hierarchical timer wheel driven by the timer tick, with O(1) insert,
+ * cancel and per-tick expiry
+ */
+
+#ifndef SCHED_TIMER_H
+#define SCHED_TIMER_H
+
+#include <stdint.h>
+
+/* ========================================================================
+ * TIMER WHEEL CONSTANTS
+ * ======================================================================== */
+
+#define TIMER_WHEEL_BITS              6         /* Slots per level = 2^bits */
+#define TIMER_WHEEL_SLOTS             (1U << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK              (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS            4
+#define TIMER_WHEEL_MAX_DELTA         ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+/* ========================================================================
+ * TIMER STRUCTURES
+ * ======================================================================== */
+
+/* Expiry callback; runs in timer interrupt context */
+typedef void (*ktimer_fn)(void *arg);
+
+typedef struct ktimer {
+    struct ktimer *next;                 /* Slot list links */
+    struct ktimer *prev;
+    struct ktimer **slot;                /* Slot head while pending */
+    uint64_t expires;                    /* Absolute expiry tick */
+    ktimer_fn fn;
+    void *arg;
+    uint8_t pending;                     /* Armed and not yet fired */
+} ktimer_t;
+
+/*
+ * Level n slots cover 2^(6n) ticks each. Timers move down a level when
+ * the level below wraps, so each timer is touched at most once per level
+ */
+typedef struct timer_wheel {
+    ktimer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    ktimer_t *expiring;                  /* Due timers whose callbacks have not run */
+    uint64_t clock;                      /* Next tick to process */
+    uint32_t pending;                    /* Armed timers */
+    uint64_t fired;                      /* Callbacks run */
+    uint64_t cascaded;                   /* Timers moved down a level */
+} timer_wheel_t;
+
+/* ========================================================================
+ * TIMER WHEEL INTERFACE
+ * ======================================================================== */
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now);
+void ktimer_init(ktimer_t *timer, ktimer_fn fn, void *arg);
+int ktimer_add(timer_wheel_t *wheel, ktimer_t *timer, uint64_t expires);
+int ktimer_cancel(timer_wheel_t *wheel, ktimer_t *timer);
+uint32_t timer_wheel_advance(timer_wheel_t *wheel, uint64_t now);
+int timer_wheel_next_expiry(const timer_wheel_t *wheel, uint64_t *expires);
+
+static inline int ktimer_pending(const ktimer_t *timer) {
+    return timer->pending;
+}
+
+/* ========================================================================
+ * KERNEL TIMERS
+ * Global wheel in timer tick units (irq_get_timer_ticks); safe to call
+ * with interrupts enabled
+ * ======================================================================== */
+
+void init_kernel_timers(void);
+int kernel_timer_add(ktimer_t *timer, uint64_t expires);
+int kernel_timer_cancel(ktimer_t *timer);
+int kernel_timer_next_expiry(uint64_t *expires);
+void kernel_timers_run(uint64_t now);
+uint64_t kernel_timer_ms_to_ticks(uint32_t milliseconds);
+void get_kernel_timer_stats(uint32_t *pending, uint64_t *fired, uint64_t *cascaded);
+
+#endif /* SCHED_TIMER_H */
@@ -10,6 +10,13 @@
 #include "../mm/kernel_heap.h"
 #include "../mm/page_alloc.h"
 #include "../sched/scheduler.h"
+#include "../sched/kthread.h"
+#include "../drivers/smp.h"
+#include "../lib/cpu.h"
+
+#define SMPBENCH_DEFAULT_THREADS  8
+#define SMPBENCH_MAX_THREADS      32
+#define SMPBENCH_ITERATIONS       20000000ULL  /* Work per thread */
 
 static const shell_builtin_t builtin_table[] = {
     { "help",  builtin_help,  "List available commands" },
@@ -21,7 +28,8 @@ static const shell_builtin_t builtin_table[] = {
     { "cat",   builtin_cat,   "Display file contents" },
     { "write", builtin_write, "Write text to a file" },
     { "mkdir", builtin_mkdir, "Create a directory" },
-    { "rm",    builtin_rm,    "Remove a file" }
+    { "rm",    builtin_rm,    "Remove a file" },
+    { "smpbench", builtin_smpbench, "Run N CPU-bound threads across all CPUs" }
 };
 
 static const size_t builtin_count = sizeof(builtin_table) / sizeof(builtin_table[0]);
@@ -139,6 +147,11 @@ int builtin_info(int argc, char **argv) {
     uint32_t allocated_pages = 0;
     get_page_allocator_stats(&total_pages, &free_pages, &allocated_pages);
 
+    uint32_t zero_pooled = 0;
+    uint64_t zero_hits = 0;
+    uint64_t zero_misses = 0;
+    get_page_zero_pool_stats(&zero_pooled, &zero_hits, &zero_misses);
+
     uint32_t total_tasks = 0;
     uint32_t active_tasks = 0;
     uint64_t task_context_switches = 0;
@@ -151,6 +164,10 @@ int builtin_info(int argc, char **argv) {
     get_scheduler_stats(&scheduler_context_switches, &scheduler_yields,
                         &ready_tasks, &schedule_calls);
 
+    uint64_t cr3_writes = 0;
+    uint64_t cr3_writes_skipped = 0;
+    get_scheduler_cr3_stats(&cr3_writes, &cr3_writes_skipped);
+
     kprintln("Kernel information:");
 
     kprint("  Memory: total pages=");
@@ -161,6 +178,14 @@ int builtin_info(int argc, char **argv) {
     kprint_decimal(allocated_pages);
     kprintln("");
 
+    kprint("  Zero pool: pooled=");
+    kprint_decimal(zero_pooled);
+    kprint(", hits=");
+    kprint_decimal(zero_hits);
+    kprint(", misses=");
+    kprint_decimal(zero_misses);
+    kprintln("");
+
     kprint("  Tasks: total=");
     kprint_decimal(total_tasks);
     kprint(", active=");
@@ -179,6 +204,12 @@ int builtin_info(int argc, char **argv) {
     kprint_decimal(schedule_calls);
     kprintln("");
 
+    kprint("  CR3 on switch: writes=");
+    kprint_decimal(cr3_writes);
+    kprint(", skipped=");
+    kprint_decimal(cr3_writes_skipped);
+    kprintln("");
+
     return 0;
 }
 
@@ -462,3 +493,104 @@ int builtin_rm(int argc, char **argv) {
 
     return 0;
 }
+
+/* Per-CPU completions of the running smpbench (threads only compute) */
+static volatile uint32_t smpbench_completed[SMP_MAX_CPUS];
+static volatile uint64_t smpbench_sink;
+
+static void smpbench_worker(void *arg) {
+    uint64_t value = (uint64_t)(uintptr_t)arg + 1;
+    for (uint64_t i = 0; i < SMPBENCH_ITERATIONS; i++) {
+        /* xorshift64: pure register work, no shared memory */
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+    }
+    smpbench_sink = value;
+
+    uint64_t flags = cpu_irq_save();
+    uint32_t cpu = smp_current_cpu();
+    cpu_irq_restore(flags);
+    __atomic_fetch_add(&smpbench_completed[cpu], 1, __ATOMIC_RELAXED);
+}
+
+int builtin_smpbench(int argc, char **argv) {
+    if (argc > 2) {
+        kprintln("smpbench: too many arguments");
+        return 1;
+    }
+
+    uint32_t threads = SMPBENCH_DEFAULT_THREADS;
+    if (argc == 2) {
+        threads = 0;
+        for (const char *p = argv[1]; *p; p++) {
+            if (*p < '0' || *p > '9' || threads > SMPBENCH_MAX_THREADS) {
+                threads = 0;
+                break;
+            }
+            threads = threads * 10 + (uint32_t)(*p - '0');
+        }
+        if (threads == 0 || threads > SMPBENCH_MAX_THREADS) {
+            kprintln("smpbench: thread count must be 1-32");
+            return 1;
+        }
+    }
+
+    uint64_t switches_before[SMP_MAX_CPUS];
+    uint64_t steals_before[SMP_MAX_CPUS];
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        smpbench_completed[cpu] = 0;
+        switches_before[cpu] = 0;
+        steals_before[cpu] = 0;
+        get_scheduler_cpu_stats(cpu, &switches_before[cpu], &steals_before[cpu], NULL);
+    }
+
+    kthread_id_t ids[SMPBENCH_MAX_THREADS];
+    uint32_t spawned = 0;
+    uint64_t start = cpu_read_tsc();
+    for (uint32_t i = 0; i < threads; i++) {
+        kthread_id_t id = kthread_spawn_ex("smpbench", smpbench_worker, (void *)(uintptr_t)i,
+                                           TASK_PRIORITY_NORMAL, TASK_FLAG_SMP);
+        task_t *task = NULL;
+        if (id == INVALID_TASK_ID) {
+            break;
+        }
+        if (task_get_info(id, &task) != 0 || schedule_task(task) != 0) {
+            task_terminate(id);
+            break;
+        }
+        ids[spawned++] = id;
+    }
+
+    for (uint32_t i = 0; i < spawned; i++) {
+        kthread_join(ids[i]);
+    }
+    uint64_t cycles = cpu_read_tsc() - start;
+
+    kprint("smpbench: ");
+    kprint_decimal(spawned);
+    kprint(" threads x ");
+    kprint_decimal(SMPBENCH_ITERATIONS);
+    kprint(" iterations in ");
+    kprint_decimal(cycles);
+    kprintln(" cycles");
+
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        uint64_t switches = 0;
+        uint64_t steals = 0;
+        if (get_scheduler_cpu_stats(cpu, &switches, &steals, NULL) != 0) {
+            continue;
+        }
+        kprint("  CPU ");
+        kprint_decimal(cpu);
+        kprint(": completed=");
+        kprint_decimal(smpbench_completed[cpu]);
+        kprint(", steals=");
+        kprint_decimal(steals - steals_before[cpu]);
+        kprint(", switches=");
+        kprint_decimal(switches - switches_before[cpu]);
+        kprintln("");
+    }
+
+    return spawned == threads ? 0 : 1;
+}
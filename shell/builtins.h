@@ -24,5 +24,6 @@ int builtin_cat(int argc, char **argv);
 int builtin_write(int argc, char **argv);
 int builtin_mkdir(int argc, char **argv);
 int builtin_rm(int argc, char **argv);
+int builtin_smpbench(int argc, char **argv);
 
 #endif /* SHELL_BUILTINS_H */
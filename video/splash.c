@@ -10,19 +10,24 @@
 #include "graphics.h"
 #include "font.h"
 #include "../drivers/serial.h"
+#include "../sched/scheduler.h"
 
 /* ========================================================================
  * SPLASH SCREEN IMPLEMENTATION
  * ======================================================================== */
 
 /*
- * Simple delay function for splash screen timing
- * Note: This is a busy-wait delay, suitable for early boot
+ * Delay function for splash screen timing
+ * Sleeps on the kernel timers once the scheduler runs; before that it
+ * falls back to a busy-wait, suitable for early boot
  */
 static void splash_delay_ms(uint32_t milliseconds) {
+    if (task_sleep_ms(milliseconds) == 0) {
+        return;
+    }
+
     // Simple busy-wait delay (approximately 1ms per 1000000 iterations on typical hardware)
     // This is rough timing but sufficient for splash screen display
-    // TODO: Replace with PIT-backed timing once the timer driver is available this early.
     volatile uint64_t cycles = (uint64_t)milliseconds * 1000000;
     for (volatile uint64_t i = 0; i < cycles; i++) {
         __asm__ volatile ("nop");